@@ -18,33 +18,58 @@
 
 namespace dws {
 
+/// Writes log lines to a LogFile from a background thread.
+///
+/// Every thread that appends gets its own chain of staging chunks, which
+/// it fills without locking; the logging thread follows each chain behind
+/// the producer and recycles the chunks it has written.  The only lock on
+/// the append path is taken once per chunk to wake the logging thread, so
+/// threads logging at the same time do not contend on every line.  Lines
+/// of one thread stay in order; lines of different threads are written
+/// thread by thread, or merged by the time of append() within each flush
+/// with setOrderedByTime().  With setDeferredFormatting() the logging
+/// thread also formats the records of LOG_FMT statements.  When the file
+/// falls more than about 100 MB behind, the lines beyond that in a flush
+/// are dropped with a note.
 class AsyncLogging : noncopyable {
  private:
-    void threadFunc();
+    struct Chunk;
+    struct Staging;
+    class Writer;
 
-    using Buffer = detail::FixedBuffer<detail::kLargeBuffer>;
-    using BufferVector = std::vector<std::unique_ptr<Buffer>>;
-    using BufferPtr = BufferVector::value_type;
+    void threadFunc();
+    Staging *staging();
+    Chunk *room(Staging *staging, int size);
+    void drainAll(const std::vector<std::shared_ptr<Staging>> &stagings, Writer *writer);
 
     const int flushInterval_;
     std::atomic<bool> running_;
     const std::string basename_;
     const off_t rollSize_;
+    const uint64_t id_;  // tells this instance's stagings apart in a thread
+    bool ordered_;
+    bool deferred_;
     Thread thread_;
     CountDownLatch latch_;
     std::mutex mutex_;
     std::condition_variable cond_ GUARDED_BY(mutex_);
-    BufferPtr currentBuffer_ GUARDED_BY(mutex_);
-    BufferPtr nextBuffer_ GUARDED_BY(mutex_);
-    BufferVector buffers_ GUARDED_BY(mutex_);
+    bool wakeup_ GUARDED_BY(mutex_);
+    bool finished_ GUARDED_BY(mutex_);  // the logging thread has written its last
+    std::vector<std::shared_ptr<Staging>> stagings_ GUARDED_BY(mutex_);
+    // from reserveDeferred() to commitDeferred(), which then neither looks
+    // it up again nor finds it retired
+    static thread_local Staging *t_reserved;
 
  public:
     AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval = 3);
-    ~AsyncLogging() {
-        if (running_) {
-            stop();
-        }
-    }
+    ~AsyncLogging();
+
+    /// Merges the lines of all threads by the time they were appended, per
+    /// flush; costs a clock read per line.  Call before start().
+    void setOrderedByTime(bool on) { ordered_ = on; }
+    /// Takes LOG_FMT records and formats them in the logging thread, see
+    /// setDeferredLogging().  Call before start().
+    void setDeferredFormatting(bool on) { deferred_ = on; }
 
     void start() {
         running_ = true;
@@ -52,13 +77,15 @@ class AsyncLogging : noncopyable {
         latch_.wait();
     }
 
-    void stop() NO_THREAD_SAFETY_ANALYSIS {
-        running_ = false;
-        cond_.notify_one();
-        thread_.join();
-    }
+    void stop();
 
     void append(const char *logline, int len);
+
+    /// For LOG_FMT: room for the @c len bytes of arguments of a record of
+    /// @c site in this thread's staging, which commitDeferred() publishes;
+    /// nullptr if they do not fit or deferred formatting is off.
+    char *reserveDeferred(uint32_t site, int len);
+    void commitDeferred();
 };
 
 }  // namespace dws
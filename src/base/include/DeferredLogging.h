@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "AsyncLogging.h"
+#include "CurrentThread.h"
+#include "Logging.h"
+#include "StringPiece.h"
+
+namespace dws {
+
+/// Sends LOG_FMT statements to @c log, which formats them in its logging
+/// thread; nullptr formats them in the calling thread again, through
+/// Logger.  Call before log->start().
+void setDeferredLogging(AsyncLogging *log);
+
+namespace deferred {
+
+// How arguments are kept until they are formatted.  Integers and doubles
+// are copied as 8 bytes, strings as a 4 byte length and their bytes.
+enum ArgType : char {
+    kInt = 'i',
+    kUint = 'u',
+    kDouble = 'd',
+    kString = 's',
+    kPointer = 'p',
+};
+
+const int kMaxStringArg = detail::kSmallBuffer;
+
+/// What a LOG_FMT statement knows at compile time, registered once.
+struct Site {
+    Logger::LogLevel level;
+    const char *file;
+    int line;
+    const char *func;
+    const char *format;
+    const char *types;  // an ArgType per argument
+};
+
+/// Thread safe, ids start at 1.
+uint32_t registerSite(Logger::LogLevel level, const char *file, int line, const char *func,
+                      const char *format, const char *types);
+const Site *findSite(uint32_t id);
+
+/// Appends the line of a record made by log() to @c out, in the layout of
+/// Logger.
+void format(const Site &site, int64_t microSecondsSinceEpoch, const char *payload, int len,
+            std::string *out);
+
+template <typename T, typename Enable = void>
+struct Arg;
+
+template <typename T>
+struct Arg<T, std::enable_if_t<std::is_integral_v<T>>> {
+    static const ArgType kType = std::is_signed_v<T> ? kInt : kUint;
+    static int size(T) { return 8; }
+    static char *encode(char *out, T v) {
+        std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t> wide = v;
+        memcpy(out, &wide, 8);
+        return out + 8;
+    }
+    static T check(T v) { return v; }
+};
+
+template <typename T>
+struct Arg<T, std::enable_if_t<std::is_enum_v<T>>> {
+    using Underlying = std::underlying_type_t<T>;
+    static const ArgType kType = Arg<Underlying>::kType;
+    static int size(T) { return 8; }
+    static char *encode(char *out, T v) {
+        return Arg<Underlying>::encode(out, static_cast<Underlying>(v));
+    }
+    static Underlying check(T v) { return static_cast<Underlying>(v); }
+};
+
+template <typename T>
+struct Arg<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static const ArgType kType = kDouble;
+    static int size(T) { return 8; }
+    static char *encode(char *out, T v) {
+        double d = static_cast<double>(v);
+        memcpy(out, &d, 8);
+        return out + 8;
+    }
+    static T check(T v) { return v; }
+};
+
+struct StringArg {
+    static const ArgType kType = kString;
+    static int length(StringPiece s) { return std::min(s.size(), kMaxStringArg); }
+    static int size(StringPiece s) { return 4 + length(s); }
+    static char *encode(char *out, StringPiece s) {
+        int32_t len = length(s);
+        memcpy(out, &len, 4);
+        memcpy(out + 4, s.data(), len);
+        return out + 4 + len;
+    }
+};
+
+template <>
+struct Arg<const char *> : StringArg {
+    static StringPiece piece(const char *s) { return s ? StringPiece(s) : StringPiece("(null)"); }
+    static int size(const char *s) { return StringArg::size(piece(s)); }
+    static char *encode(char *out, const char *s) { return StringArg::encode(out, piece(s)); }
+    static const char *check(const char *s) { return s; }
+};
+
+template <>
+struct Arg<char *> : Arg<const char *> {};
+
+template <>
+struct Arg<std::string> : StringArg {
+    static int size(const std::string &s) { return StringArg::size(StringPiece(s)); }
+    static char *encode(char *out, const std::string &s) {
+        return StringArg::encode(out, StringPiece(s));
+    }
+    static const char *check(const std::string &s) { return s.c_str(); }
+};
+
+template <>
+struct Arg<StringPiece> : StringArg {
+    static const char *check(StringPiece s) { return s.data(); }
+};
+
+template <typename T>
+struct Arg<T *, std::enable_if_t<!std::is_same_v<std::remove_cv_t<T>, char>>> {
+    static const ArgType kType = kPointer;
+    static int size(const T *) { return 8; }
+    static char *encode(char *out, const T *p) {
+        uint64_t v = reinterpret_cast<uintptr_t>(p);
+        memcpy(out, &v, 8);
+        return out + 8;
+    }
+    static const void *check(const T *p) { return p; }
+};
+
+template <typename T>
+using ArgOf = Arg<std::decay_t<T>>;
+
+template <typename... Args>
+struct Types {
+    static constexpr char value[] = {ArgOf<Args>::kType..., '\0'};
+};
+
+template <typename... Args>
+const char *typesOf(const Args &...) {
+    return Types<Args...>::value;
+}
+
+/// Never called, lets the compiler check the arguments against the format.
+inline void checkFormat(const char *, ...) __attribute__((format(printf, 1, 2)));
+inline void checkFormat(const char *, ...) {}
+
+/// What the compiler checks in place of @c v.
+template <typename T>
+auto checkable(const T &v) {
+    return ArgOf<T>::check(v);
+}
+
+/// Formats and outputs through Logger right away.
+void formatNow(uint32_t site, const char *payload, int len);
+
+extern AsyncLogging *g_deferredLog;
+
+/// The hot path: the arguments are copied behind a record header straight
+/// into this thread's staging in the AsyncLogging.
+template <typename... Args>
+void log(uint32_t site, const Args &...args) {
+    const int len = 4 + (0 + ... + ArgOf<Args>::size(args));
+    const int32_t tid = CurrentThread::tid();
+    char *out = g_deferredLog ? g_deferredLog->reserveDeferred(site, len) : nullptr;
+    if (out) {
+        memcpy(out, &tid, 4);
+        out += 4;
+        ((out = ArgOf<Args>::encode(out, args)), ...);
+        g_deferredLog->commitDeferred();
+    } else {
+        // no logging thread, or the record does not fit in its staging
+        char stack[detail::kSmallBuffer];
+        std::string heap;
+        char *payload = stack;
+        if (len > static_cast<int>(sizeof stack)) {
+            heap.resize(len);
+            payload = &heap[0];
+        }
+        memcpy(payload, &tid, 4);
+        char *end = payload + 4;
+        ((end = ArgOf<Args>::encode(end, args)), ...);
+        formatNow(site, payload, static_cast<int>(end - payload));
+    }
+}
+
+}  // namespace deferred
+
+}  // namespace dws
+
+/// printf style logging which leaves the formatting to the AsyncLogging
+/// thread set with setDeferredLogging(): the statement registers its
+/// format once and afterwards only copies its arguments, tens of
+/// nanoseconds instead of formatting the line in place.  Supports the
+/// integer, floating point, string (%s, also for std::string and
+/// StringPiece) and %p conversions with flags, width and precision; the
+/// arguments, at most 12, are checked against the format at compile
+/// time.  Not for FATAL, which has to be written before abort().
+///     LOG_FMT(INFO, "%s served %d bytes in %.3f ms", peer, bytes, ms);
+#define LOG_FMT(level, format, ...)                                                             \
+    do {                                                                                        \
+        static_assert(dws::Logger::level != dws::Logger::FATAL, "use LOG_FATAL");               \
+        if (DWS_LOG_ENABLED(level)) {                                                           \
+            if (false) {                                                                        \
+                dws::deferred::checkFormat(format DWS_DEFERRED_CHECK(__VA_ARGS__));             \
+            }                                                                                   \
+            static const uint32_t dwsDeferredSite = dws::deferred::registerSite(                \
+                    dws::Logger::level, __FILE__, __LINE__, __func__, format,                   \
+                    dws::deferred::typesOf(__VA_ARGS__));                                       \
+            dws::deferred::log(dwsDeferredSite, ##__VA_ARGS__);                                 \
+        }                                                                                       \
+    } while (0)
+
+// DWS_DEFERRED_CHECK(a, b) is ", checkable(a), checkable(b)".
+#define DWS_DEFERRED_CHECK(...) \
+    DWS_DEFERRED_CAT(DWS_DEFERRED_CHECK_, DWS_DEFERRED_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define DWS_DEFERRED_CAT(a, b) DWS_DEFERRED_CAT_(a, b)
+#define DWS_DEFERRED_CAT_(a, b) a##b
+#define DWS_DEFERRED_NARGS(...) \
+    DWS_DEFERRED_NARGS_(_, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DWS_DEFERRED_NARGS_(_, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+#define DWS_DEFERRED_ARG(a) , ::dws::deferred::checkable(a)
+#define DWS_DEFERRED_CHECK_0()
+#define DWS_DEFERRED_CHECK_1(a) DWS_DEFERRED_ARG(a)
+#define DWS_DEFERRED_CHECK_2(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_1(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_3(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_2(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_4(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_3(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_5(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_4(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_6(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_5(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_7(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_6(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_8(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_7(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_9(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_8(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_10(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_9(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_11(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_10(__VA_ARGS__)
+#define DWS_DEFERRED_CHECK_12(a, ...) DWS_DEFERRED_ARG(a) DWS_DEFERRED_CHECK_11(__VA_ARGS__)
@@ -76,11 +76,7 @@ class LogStream : noncopyable {
     self &operator<<(std::uint64_t);
     self &operator<<(const void *);
 
-    self &operator<<(float v) {
-        *this << static_cast<double>(v);
-        return *this;
-    }
-
+    self &operator<<(float);
     self &operator<<(double);
     self &operator<<(long double);
 
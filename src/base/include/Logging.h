@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <string>
+
 #include "LogStream.h"
 #include "Timestamp.h"
 
@@ -54,9 +57,20 @@ class Logger {
     LogStream &stream() { return impl_.stream_; }
     static LogLevel logLevel();
     static void setLogLevel(LogLevel level);
+    /// The level of the source files of @c module, a file name without its
+    /// extension ("TcpConnection") or a directory on their path ("http").
+    /// The file wins over its directories and the innermost directory over
+    /// the outer ones; files of no module follow setLogLevel(level).  Also
+    /// read from DWS_LOG_LEVELS at startup, e.g. "http=DEBUG,Acceptor=WARN".
+    static void setLogLevel(const std::string &module, LogLevel level);
+    /// Back to the level of the enclosing module, or the default.
+    static void clearLogLevel(const std::string &module);
+    /// The lowest level of the default and every module.
+    static LogLevel lowestLogLevel();
     typedef void (*OutputFunc)(const char *msg, int len);
     typedef void (*FlushFunc)();
     static void setOutput(OutputFunc);
+    static OutputFunc output();
     static void setFlush(FlushFunc);
     static void setTimeZone(const TimeZone &tz);
 
@@ -81,24 +95,72 @@ class Logger {
 };
 
 extern Logger::LogLevel g_logLevel;
+extern std::atomic<int> g_lowestLogLevel;
+extern std::atomic<unsigned> g_logLevelGeneration;  // bumped by every setLogLevel()
 
 inline Logger::LogLevel Logger::logLevel() { return g_logLevel; }
 
-#define LOG(level)                                     \
-    if (dws::Logger::logLevel() <= dws::Logger::level) \
+inline Logger::LogLevel Logger::lowestLogLevel() {
+    return static_cast<LogLevel>(g_lowestLogLevel.load(std::memory_order_relaxed));
+}
+
+/// The level of the source file of a LOG statement, looked up once and
+/// again only after a level has been changed.
+class LogSite : noncopyable {
+ public:
+    explicit LogSite(const char *file) : file_(file), level_(0), generation_(0) {}
+
+    bool enabled(Logger::LogLevel level) {
+        // acquire pairs with refresh(): a current generation_ comes with its level_
+        if (generation_.load(std::memory_order_acquire) !=
+            g_logLevelGeneration.load(std::memory_order_acquire)) {
+            refresh();
+        }
+        return level >= level_.load(std::memory_order_relaxed);
+    }
+
+ private:
+    void refresh();
+
+    const char *file_;
+    std::atomic<int> level_;
+    std::atomic<unsigned> generation_;
+};
+
+// Statements below this level are compiled out, e.g. -DDWS_LOG_MIN_LEVEL=INFO
+// leaves no trace of LOG_TRACE and LOG_DEBUG in the binary.
+#ifndef DWS_LOG_MIN_LEVEL
+#define DWS_LOG_MIN_LEVEL TRACE
+#endif
+
+// Whether a statement of @c level in this file logs: a constant for the
+// compiler first, then one load for levels nothing is set to, then the
+// level of the file's module.
+#define DWS_LOG_ENABLED(level)                                                      \
+    (dws::Logger::level >= dws::Logger::DWS_LOG_MIN_LEVEL &&                        \
+     dws::Logger::level >= dws::Logger::lowestLogLevel() && []() -> dws::LogSite & { \
+         static dws::LogSite dwsLogSite(__FILE__);                                  \
+         return dwsLogSite;                                                         \
+     }().enabled(dws::Logger::level))
+
+#define LOG(level)                  \
+    if (DWS_LOG_ENABLED(level)) \
     dws::Logger(__FILE__, __LINE__, dws::Logger::level, __func__).stream()
-#define LOG_TRACE                                      \
-    if (dws::Logger::logLevel() <= dws::Logger::TRACE) \
+#define LOG_TRACE                   \
+    if (DWS_LOG_ENABLED(TRACE)) \
     dws::Logger(__FILE__, __LINE__, dws::Logger::TRACE, __func__).stream()
-#define LOG_DEBUG                                      \
-    if (dws::Logger::logLevel() <= dws::Logger::DEBUG) \
+#define LOG_DEBUG                   \
+    if (DWS_LOG_ENABLED(DEBUG)) \
     dws::Logger(__FILE__, __LINE__, dws::Logger::DEBUG, __func__).stream()
 #define LOG_INFO \
-    if (dws::Logger::logLevel() <= dws::Logger::INFO) dws::Logger(__FILE__, __LINE__).stream()
-#define LOG_WARN dws::Logger(__FILE__, __LINE__, dws::Logger::WARN).stream()
-#define LOG_ERROR dws::Logger(__FILE__, __LINE__, dws::Logger::ERROR).stream()
+    if (DWS_LOG_ENABLED(INFO)) dws::Logger(__FILE__, __LINE__).stream()
+#define LOG_WARN \
+    if (DWS_LOG_ENABLED(WARN)) dws::Logger(__FILE__, __LINE__, dws::Logger::WARN).stream()
+#define LOG_ERROR \
+    if (DWS_LOG_ENABLED(ERROR)) dws::Logger(__FILE__, __LINE__, dws::Logger::ERROR).stream()
 #define LOG_FATAL dws::Logger(__FILE__, __LINE__, dws::Logger::FATAL).stream()
-#define LOG_SYSERR dws::Logger(__FILE__, __LINE__, false).stream()
+#define LOG_SYSERR \
+    if (DWS_LOG_ENABLED(ERROR)) dws::Logger(__FILE__, __LINE__, false).stream()
 #define LOG_SYSFATAL dws::Logger(__FILE__, __LINE__, true).stream()
 
 const char *strerror_tl(int savedErrno);
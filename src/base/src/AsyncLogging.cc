@@ -1,43 +1,346 @@
 #include "AsyncLogging.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <queue>
 
+#include "DeferredLogging.h"
 #include "LogFile.h"
 #include "Timestamp.h"
 
 namespace dws {
 
+namespace {
+
+const int kChunkSize = 64 * 1024;
+// the producer wakes the logging thread after this many chunks rather
+// than waiting for the flush interval
+const int kChunksPerWakeup = 16;
+// as much as the 25 large buffers the logging thread used to keep
+const int64_t kMaxBytesPerFlush = 25 * static_cast<int64_t>(detail::kLargeBuffer);
+// with setOrderedByTime() or setDeferredFormatting() every line is preceded
+// by its time, its length and its LOG_FMT site, 0 for a formatted line
+const int kHeaderSize = sizeof(int64_t) + sizeof(int32_t) + sizeof(uint32_t);
+
+std::atomic<uint64_t> g_nextId(1);
+
+struct Record {
+    int64_t micros;
+    uint32_t site;
+    const char *data;
+    int len;
+};
+
+}  // namespace
+
+struct AsyncLogging::Chunk {
+    std::atomic<int> committed{0};
+    std::atomic<Chunk *> next{nullptr};
+    char data[kChunkSize];
+};
+
+// The chain of chunks of one producer thread.  The producer appends to
+// tail and links a new chunk when it is full; the logging thread reads
+// from head up to what has been committed and hands chunks it is done
+// with back through spare.
+struct AsyncLogging::Staging {
+    Staging() : tail(new Chunk), rolls(0), pending(0), head(tail), consumed(0) {}
+
+    ~Staging() {
+        while (head) {
+            Chunk *next = head->next.load(std::memory_order_relaxed);
+            delete head;
+            head = next;
+        }
+        delete spare.load(std::memory_order_relaxed);
+    }
+
+    // Calls @c fn for every committed range not seen yet, collects the
+    // chunks left behind in @c done.
+    template <typename Fn>
+    void drain(Fn fn, std::vector<std::pair<Staging *, Chunk *>> *done) {
+        for (;;) {
+            // a chunk with a successor is final, load next first
+            Chunk *next = head->next.load(std::memory_order_acquire);
+            int committed = head->committed.load(std::memory_order_acquire);
+            if (committed > consumed) {
+                fn(head->data + consumed, committed - consumed);
+                consumed = committed;
+            }
+            if (!next) {
+                return;
+            }
+            done->emplace_back(this, head);
+            head = next;
+            consumed = 0;
+        }
+    }
+
+    bool drained() const {
+        return !head->next.load(std::memory_order_acquire) &&
+               head->committed.load(std::memory_order_acquire) == consumed;
+    }
+
+    void recycle(Chunk *chunk) {
+        chunk->committed.store(0, std::memory_order_relaxed);
+        chunk->next.store(nullptr, std::memory_order_relaxed);
+        Chunk *expected = nullptr;
+        if (!spare.compare_exchange_strong(expected, chunk, std::memory_order_release)) {
+            delete chunk;
+        }
+    }
+
+    // producer thread
+    Chunk *tail;
+    int rolls;
+    int pending;  // the end of the reserved LOG_FMT record
+    // logging thread
+    Chunk *head;
+    int consumed;
+    std::atomic<Chunk *> spare{nullptr};
+    std::atomic<bool> retired{false};  // the logging thread has finished
+};
+
+// Writes to the LogFile and drops what goes beyond kMaxBytesPerFlush.
+class AsyncLogging::Writer : noncopyable {
+ public:
+    explicit Writer(LogFile *output) : output_(output), written_(0), dropped_(0) {}
+
+    void append(const char *data, int len) {
+        if (written_ + len > kMaxBytesPerFlush) {
+            dropped_ += len;
+            return;
+        }
+        written_ += len;
+        output_->append(data, len);
+    }
+
+    void flush() {
+        if (dropped_ > 0) {
+            char buf[256];
+            snprintf(buf, sizeof buf, "Dropped log messages at %s, %lld bytes\n",
+                     Timestamp::now().toFormattedString().c_str(),
+                     static_cast<long long>(dropped_));
+            fputs(buf, stderr);
+            output_->append(buf, static_cast<int>(strlen(buf)));
+        }
+        written_ = 0;
+        dropped_ = 0;
+        output_->flush();
+    }
+
+ private:
+    LogFile *output_;
+    int64_t written_;
+    int64_t dropped_;
+};
+
 AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval)
     : flushInterval_(flushInterval),
       running_(false),
       basename_(basename),
       rollSize_(rollSize),
+      id_(g_nextId.fetch_add(1)),
+      ordered_(false),
+      deferred_(false),
       thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
       latch_(1),
       mutex_(),
       cond_(),
-      currentBuffer_(new Buffer),
-      nextBuffer_(new Buffer),
-      buffers_() {
-    currentBuffer_->bzero();
-    nextBuffer_->bzero();
-    buffers_.reserve(16);
+      wakeup_(false),
+      finished_(false),
+      stagings_() {}
+
+AsyncLogging::~AsyncLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+void AsyncLogging::stop() {
+    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+thread_local AsyncLogging::Staging *AsyncLogging::t_reserved = nullptr;
+
+AsyncLogging::Staging *AsyncLogging::staging() {
+    static thread_local std::vector<std::pair<uint64_t, std::shared_ptr<Staging>>> t_stagings;
+    for (const auto &entry : t_stagings) {
+        if (entry.first == id_) {
+            return entry.second->retired.load(std::memory_order_relaxed) ? nullptr
+                                                                          : entry.second.get();
+        }
+    }
+    // the first line of this thread, forget instances which are gone
+    t_stagings.erase(std::remove_if(t_stagings.begin(), t_stagings.end(),
+                                    [](const auto &entry) {
+                                        return entry.second->retired.load(
+                                                std::memory_order_relaxed);
+                                    }),
+                     t_stagings.end());
+    auto staging = std::make_shared<Staging>();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_) {
+            return nullptr;
+        }
+        stagings_.push_back(staging);
+    }
+    t_stagings.emplace_back(id_, staging);
+    return staging.get();
+}
+
+AsyncLogging::Chunk *AsyncLogging::room(Staging *staging, int size) {
+    Chunk *chunk = staging->tail;
+    if (chunk->committed.load(std::memory_order_relaxed) + size <= kChunkSize) {
+        return chunk;
+    }
+    Chunk *next = staging->spare.exchange(nullptr, std::memory_order_acquire);
+    if (!next) {
+        next = new Chunk;
+    }
+    chunk->next.store(next, std::memory_order_release);
+    staging->tail = next;
+    if (++staging->rolls % kChunksPerWakeup == 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_ = true;
+        }
+        cond_.notify_one();
+    }
+    return next;
 }
 
 void AsyncLogging::append(const char *logline, int len) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (currentBuffer_->avail() > len) {
-        currentBuffer_->append(logline, len);
-    } else {
-        buffers_.push_back(std::move(currentBuffer_));
+    Staging *staging = this->staging();
+    if (!staging) {
+        return;
+    }
+    const int header = ordered_ || deferred_ ? kHeaderSize : 0;
+    len = std::min(len, kChunkSize - header);
+    Chunk *chunk = room(staging, header + len);
+    int used = chunk->committed.load(std::memory_order_relaxed);
+    char *out = chunk->data + used;
+    if (header > 0) {
+        int64_t micros = ordered_ ? Timestamp::now().microSecondsSinceEpoch() : 0;
+        int32_t length = len;
+        uint32_t site = 0;
+        memcpy(out, &micros, sizeof micros);
+        memcpy(out + sizeof micros, &length, sizeof length);
+        memcpy(out + sizeof micros + sizeof length, &site, sizeof site);
+        out += header;
+    }
+    memcpy(out, logline, len);
+    chunk->committed.store(used + header + len, std::memory_order_release);
+}
+
+char *AsyncLogging::reserveDeferred(uint32_t site, int len) {
+    if (!deferred_ || len > kChunkSize - kHeaderSize) {
+        return nullptr;
+    }
+    Staging *staging = this->staging();
+    if (!staging) {
+        return nullptr;
+    }
+    Chunk *chunk = room(staging, kHeaderSize + len);
+    int used = chunk->committed.load(std::memory_order_relaxed);
+    char *out = chunk->data + used;
+    int64_t micros = Timestamp::now().microSecondsSinceEpoch();
+    int32_t length = len;
+    memcpy(out, &micros, sizeof micros);
+    memcpy(out + sizeof micros, &length, sizeof length);
+    memcpy(out + sizeof micros + sizeof length, &site, sizeof site);
+    staging->pending = used + kHeaderSize + len;
+    t_reserved = staging;
+    return out + kHeaderSize;
+}
 
-        if (nextBuffer_) {
-            currentBuffer_ = std::move(nextBuffer_);
+void AsyncLogging::commitDeferred() {
+    // t_stagings keeps it alive even if stop() has retired it meanwhile
+    Staging *staging = t_reserved;
+    t_reserved = nullptr;
+    staging->tail->committed.store(staging->pending, std::memory_order_release);
+}
+
+void AsyncLogging::drainAll(const std::vector<std::shared_ptr<Staging>> &stagings,
+                            Writer *writer) {
+    std::vector<std::pair<Staging *, Chunk *>> done;
+    if (!ordered_ && !deferred_) {
+        for (const auto &staging : stagings) {
+            staging->drain([writer](const char *data, int len) { writer->append(data, len); },
+                           &done);
+        }
+    } else {
+        std::vector<std::vector<Record>> lines(stagings.size());
+        for (std::size_t i = 0; i < stagings.size(); ++i) {
+            std::vector<Record> &records = lines[i];
+            stagings[i]->drain(
+                    [&records](const char *data, int len) {
+                        const char *end = data + len;
+                        while (data < end) {
+                            Record record;
+                            int32_t length;
+                            memcpy(&record.micros, data, sizeof record.micros);
+                            memcpy(&length, data + sizeof record.micros, sizeof length);
+                            memcpy(&record.site, data + sizeof record.micros + sizeof length,
+                                   sizeof record.site);
+                            record.data = data + kHeaderSize;
+                            record.len = length;
+                            records.push_back(record);
+                            data += kHeaderSize + length;
+                        }
+                    },
+                    &done);
+        }
+        std::string line;
+        auto write = [writer, &line](const Record &record) {
+            if (record.site == 0) {
+                writer->append(record.data, record.len);
+                return;
+            }
+            const deferred::Site *site = deferred::findSite(record.site);
+            line.clear();
+            deferred::format(*site, record.micros, record.data, record.len, &line);
+            writer->append(line.data(), static_cast<int>(line.size()));
+        };
+        if (!ordered_) {
+            for (const auto &records : lines) {
+                for (const Record &record : records) {
+                    write(record);
+                }
+            }
         } else {
-            currentBuffer_.reset(new Buffer);
+            // each thread's lines are in order already, merge them
+            using Cursor = std::pair<std::size_t, std::size_t>;  // thread, line
+            auto later = [&lines](const Cursor &lhs, const Cursor &rhs) {
+                const Record &a = lines[lhs.first][lhs.second];
+                const Record &b = lines[rhs.first][rhs.second];
+                return a.micros != b.micros ? a.micros > b.micros : lhs.first > rhs.first;
+            };
+            std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+            for (std::size_t i = 0; i < lines.size(); ++i) {
+                if (!lines[i].empty()) {
+                    heads.emplace(i, 0);
+                }
+            }
+            while (!heads.empty()) {
+                Cursor cursor = heads.top();
+                heads.pop();
+                write(lines[cursor.first][cursor.second]);
+                if (++cursor.second < lines[cursor.first].size()) {
+                    heads.push(cursor);
+                }
+            }
         }
-        currentBuffer_->append(logline, len);
-        cond_.notify_one();
+    }
+    for (const auto &entry : done) {
+        entry.first->recycle(entry.second);
     }
 }
 
@@ -45,67 +348,41 @@ void AsyncLogging::threadFunc() {
     assert(running_);
     latch_.countDown();
     LogFile output(basename_, rollSize_, false);
-    BufferPtr newBuffer1(new Buffer);
-    BufferPtr newBuffer2(new Buffer);
-    newBuffer1->bzero();
-    newBuffer2->bzero();
-    BufferVector buffersToWrite;
-    buffersToWrite.reserve(16);
-    while (running_) {
-        assert(newBuffer1 && newBuffer1->length() == 0);
-        assert(newBuffer2 && newBuffer2->length() == 0);
-        assert(buffersToWrite.empty());
-
+    Writer writer(&output);
+    std::vector<std::shared_ptr<Staging>> stagings;
+    bool last = false;
+    while (!last) {
         {
             std::unique_lock<std::mutex> lock(mutex_);
-            if (buffers_.empty()) {
+            if (!wakeup_ && running_) {
                 cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
             }
-            buffers_.push_back(std::move(currentBuffer_));
-            currentBuffer_ = std::move(newBuffer1);
-            buffersToWrite.swap(buffers_);
-            if (!nextBuffer_) {
-                nextBuffer_ = std::move(newBuffer2);
-            }
+            wakeup_ = false;
+            last = !running_;
+            stagings = stagings_;
         }
 
-        assert(!buffersToWrite.empty());
+        drainAll(stagings, &writer);
+        writer.flush();
+        stagings.clear();
 
-        if (buffersToWrite.size() > 25) {
-            char buf[256];
-            snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd larger buffers\n",
-                     Timestamp::now().toFormattedString().c_str(), buffersToWrite.size() - 2);
-            fputs(buf, stderr);
-            output.append(buf, static_cast<int>(strlen(buf)));
-            buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
-        }
-
-        for (const auto &buffer : buffersToWrite) {
-            output.append(buffer->data(), buffer->length());
-        }
-
-        if (buffersToWrite.size() > 2) {
-            buffersToWrite.resize(2);
-        }
-
-        if (!newBuffer1) {
-            assert(!buffersToWrite.empty());
-            newBuffer1 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer1->reset();
-        }
-
-        if (!newBuffer2) {
-            assert(!buffersToWrite.empty());
-            newBuffer2 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer2->reset();
-        }
+        // forget the threads which have exited and been written out
+        std::lock_guard<std::mutex> lock(mutex_);
+        stagings_.erase(std::remove_if(stagings_.begin(), stagings_.end(),
+                                       [](const std::shared_ptr<Staging> &staging) {
+                                           return staging.use_count() == 1 &&
+                                                  staging->drained();
+                                       }),
+                        stagings_.end());
+    }
 
-        buffersToWrite.clear();
-        output.flush();
+    // lines appended from now on are dropped
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    for (const auto &staging : stagings_) {
+        staging->retired.store(true, std::memory_order_relaxed);
     }
-    output.flush();
+    stagings_.clear();
 }
 
 }  // namespace dws
@@ -0,0 +1,267 @@
+#include "DeferredLogging.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+
+#include "TimeZone.h"
+
+namespace dws {
+
+// in Logging.cc
+extern const char *LogLevelName[Logger::NUM_LOG_LEVELS];
+extern TimeZone g_logTimeZone;
+
+void setDeferredLogging(AsyncLogging *log) {
+    if (log) {
+        log->setDeferredFormatting(true);
+    }
+    deferred::g_deferredLog = log;
+}
+
+namespace deferred {
+
+AsyncLogging *g_deferredLog = nullptr;
+
+namespace {
+
+// Sites by id, in pages which never move.  A record carries its id to the
+// logging thread, which therefore sees the site written.
+const uint32_t kPageSize = 256;
+const uint32_t kMaxPages = 256;
+const Site **g_pages[kMaxPages];
+uint32_t g_numSites = 0;
+std::mutex g_sitesMutex;
+
+void appendf(std::string *out, const char *fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof buf, fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+    if (n < static_cast<int>(sizeof buf)) {
+        out->append(buf, n);
+        return;
+    }
+    std::size_t size = out->size();
+    out->resize(size + n + 1);
+    va_start(args, fmt);
+    vsnprintf(&(*out)[size], n + 1, fmt, args);
+    va_end(args);
+    out->resize(size + n);
+}
+
+// printf with the '*' widths and precisions of the conversion in front
+template <typename T>
+void appendSpec(std::string *out, const char *spec, int numStars, const int *stars, T value) {
+    switch (numStars) {
+        case 0:
+            appendf(out, spec, value);
+            break;
+        case 1:
+            appendf(out, spec, stars[0], value);
+            break;
+        default:
+            appendf(out, spec, stars[0], stars[1], value);
+            break;
+    }
+}
+
+// Reads the arguments of a record in the order of Site::types.
+class ArgReader {
+ public:
+    ArgReader(const char *types, const char *data, int len)
+        : types_(types), data_(data), end_(data + len) {}
+
+    // the next argument's type, 0 if there is none
+    char next() const { return *types_ != '\0' && end_ - data_ >= 4 ? *types_ : 0; }
+
+    int64_t int64() {
+        int64_t v = 0;
+        read(&v, 8);
+        return v;
+    }
+
+    double real() {
+        double v = 0;
+        read(&v, 8);
+        return v;
+    }
+
+    StringPiece string() {
+        int32_t len = 0;
+        read(&len, 4);
+        len = std::max(0, std::min(len, static_cast<int32_t>(end_ - data_)));
+        StringPiece s(data_, len);
+        data_ += len;
+        return s;
+    }
+
+ private:
+    void read(void *v, int n) {
+        ++types_;
+        if (end_ - data_ >= n) {
+            memcpy(v, data_, n);
+            data_ += n;
+        } else {
+            data_ = end_;
+        }
+    }
+
+    const char *types_;
+    const char *data_;
+    const char *end_;
+};
+
+// the message of the record, formatted like printf would
+void formatMessage(const Site &site, const char *args, int len, std::string *out) {
+    ArgReader reader(site.types, args, len);
+    const char *p = site.format;
+    while (*p) {
+        if (*p != '%') {
+            const char *percent = strchr(p, '%');
+            std::size_t n = percent ? percent - p : strlen(p);
+            out->append(p, n);
+            p += n;
+            continue;
+        }
+        if (p[1] == '%') {
+            out->push_back('%');
+            p += 2;
+            continue;
+        }
+        // the conversion without its length modifier, which is ours to set
+        char spec[32];
+        std::size_t n = 0;
+        spec[n++] = *p++;
+        int stars[2];
+        int numStars = 0;
+        while (*p && strchr("-+ #0'", *p) && n < 16) {
+            spec[n++] = *p++;
+        }
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                spec[n++] = *p++;
+            }
+            if (*p == '*') {
+                spec[n++] = *p++;
+                stars[numStars++] = static_cast<int>(reader.int64());
+            }
+            while (*p >= '0' && *p <= '9' && n < 24) {
+                spec[n++] = *p++;
+            }
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            ++p;
+        }
+        const char conversion = *p;
+        if (conversion == '\0') {
+            break;
+        }
+        ++p;
+        const char type = reader.next();
+        if (type == 0) {
+            out->append("<missing>");
+            continue;
+        }
+        if (type == kString) {
+            StringPiece s = reader.string();
+            if (n == 1) {
+                out->append(s.data(), s.size());
+            } else {
+                memcpy(spec + n, "s", 2);
+                appendSpec(out, spec, numStars, stars, s.as_string().c_str());
+            }
+            continue;
+        }
+        if (type == kPointer) {
+            memcpy(spec + n, "p", 2);
+            appendSpec(out, spec, numStars, stars,
+                       reinterpret_cast<void *>(static_cast<uintptr_t>(reader.int64())));
+            continue;
+        }
+        if (strchr("fFeEgGaA", conversion)) {
+            double v = type == kDouble ? reader.real() : static_cast<double>(reader.int64());
+            spec[n++] = conversion;
+            spec[n] = '\0';
+            appendSpec(out, spec, numStars, stars, v);
+            continue;
+        }
+        int64_t v = type == kDouble ? static_cast<int64_t>(reader.real()) : reader.int64();
+        if (conversion == 'c') {
+            memcpy(spec + n, "c", 2);
+            appendSpec(out, spec, numStars, stars, static_cast<int>(v));
+            continue;
+        }
+        const bool unsignedConversion = strchr("ouxX", conversion) != nullptr;
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = unsignedConversion ? conversion : type == kUint ? 'u' : 'd';
+        spec[n] = '\0';
+        if (unsignedConversion || type == kUint) {
+            appendSpec(out, spec, numStars, stars, static_cast<unsigned long long>(v));
+        } else {
+            appendSpec(out, spec, numStars, stars, static_cast<long long>(v));
+        }
+    }
+}
+
+}  // namespace
+
+uint32_t registerSite(Logger::LogLevel level, const char *file, int line, const char *func,
+                      const char *format, const char *types) {
+    std::lock_guard<std::mutex> lock(g_sitesMutex);
+    uint32_t id = ++g_numSites;
+    if (id >= kPageSize * kMaxPages) {
+        LOG_FATAL << "[deferred::registerSite] more than " << kPageSize * kMaxPages
+                  << " LOG_FMT statements";
+    }
+    const Site **&page = g_pages[id / kPageSize];
+    if (!page) {
+        page = new const Site *[kPageSize]();
+    }
+    page[id % kPageSize] =
+            new Site{level, Logger::SourceFile(file).data_, line, func, format, types};
+    return id;
+}
+
+const Site *findSite(uint32_t id) { return g_pages[id / kPageSize][id % kPageSize]; }
+
+void format(const Site &site, int64_t microSecondsSinceEpoch, const char *payload, int len,
+            std::string *out) {
+    const int64_t perSecond = Timestamp::kMicroSecondsPerSecond;
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / perSecond);
+    int microseconds = static_cast<int>(microSecondsSinceEpoch % perSecond);
+    bool local = g_logTimeZone.valid();
+    DateTime dt = local ? g_logTimeZone.toLocalTime(seconds) : TimeZone::toUTCTime(seconds);
+    int32_t tid = 0;
+    if (len >= 4) {
+        memcpy(&tid, payload, 4);
+    }
+    appendf(out, "%4d%02d%02d %02d:%02d:%02d.%06d%s%5d ", dt.year, dt.month, dt.day, dt.hour,
+            dt.minute, dt.second, microseconds, local ? " " : "Z ", tid);
+    out->append(LogLevelName[site.level], 6);
+    out->append(site.func);
+    out->push_back(' ');
+    if (len >= 4) {
+        formatMessage(site, payload + 4, len - 4, out);
+    }
+    appendf(out, " - %s:%d\n", site.file, site.line);
+}
+
+void formatNow(uint32_t id, const char *payload, int len) {
+    const Site &site = *findSite(id);
+    std::string message;
+    formatMessage(site, payload + 4, len - 4, &message);
+    Logger(site.file, site.line, site.level, site.func).stream() << message;
+}
+
+}  // namespace deferred
+
+}  // namespace dws
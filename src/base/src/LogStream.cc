@@ -1,13 +1,12 @@
 #include "LogStream.h"
 
-#include <algorithm>
+#include <charconv>
 #include <cinttypes>
 #include <cstdio>
 #include <cstring>
 #include <limits>
 #include <type_traits>
 
-// TODO(diligentliu): better itoa.
 #if defined(__clang__)
 #pragma clang diagnostic ignored "-Wtautological-compare"
 #else
@@ -17,48 +16,65 @@
 namespace dws {
 namespace detail {
 
-const char digits[] = "9876543210123456789";
-const char *zero = digits + 9;
-static_assert(sizeof(digits) == 20, "wrong number of digits");
+// "00" to "99", so that one division by 100 yields two digits
+const char digitPairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+static_assert(sizeof digitPairs == 201, "wrong number of digitPairs");
 
 const char digitsHex[] = "0123456789ABCDEF";
 static_assert(sizeof digitsHex == 17, "wrong number of digitsHex");
 
-// Efficient Integer to String Conversions, by Matthew Wilson.
+// Writes from the end of a scratch buffer, two digits at a time, and
+// copies the result out instead of reversing it.
 template <typename T>
 size_t convert(char buf[], T value) {
-    T i = value;
-    char *p = buf;
-
-    do {
-        int lsd = static_cast<int>(i % 10);
-        i /= 10;
-        *p++ = zero[lsd];
-    } while (i != 0);
-
+    using U = std::make_unsigned_t<T>;
+    // negated in unsigned arithmetic, which also covers the minimum
+    U i = value < 0 ? U(0) - static_cast<U>(value) : static_cast<U>(value);
+    char scratch[24];
+    char *end = scratch + sizeof scratch;
+    char *p = end;
+
+    while (i >= 100) {
+        unsigned pair = static_cast<unsigned>(i % 100);
+        i /= 100;
+        p -= 2;
+        memcpy(p, digitPairs + 2 * pair, 2);
+    }
+    if (i >= 10) {
+        p -= 2;
+        memcpy(p, digitPairs + 2 * i, 2);
+    } else {
+        *--p = static_cast<char>('0' + i);
+    }
     if (value < 0) {
-        *p++ = '-';
+        *--p = '-';
     }
-    *p = '\0';
-    std::reverse(buf, p);
 
-    return p - buf;
+    size_t len = end - p;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return len;
 }
 
 size_t convertHex(char buf[], uintptr_t value) {
-    uintptr_t i = value;
-    char *p = buf;
+    char scratch[2 * sizeof value];
+    char *end = scratch + sizeof scratch;
+    char *p = end;
 
     do {
-        int lsd = static_cast<int>(i % 16);
-        i /= 16;
-        *p++ = digitsHex[lsd];
-    } while (i != 0);
-
-    *p = '\0';
-    std::reverse(buf, p);
-
-    return p - buf;
+        *--p = digitsHex[value % 16];
+        value /= 16;
+    } while (value != 0);
+
+    size_t len = end - p;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return len;
 }
 
 template class FixedBuffer<kSmallBuffer>;
@@ -251,11 +267,21 @@ LogStream &LogStream::operator<<(const void *p) {
     return *this;
 }
 
-// FIXME: replace this with Grisu3 by Florian Loitsch.
+// The shortest digits which read back as the same value, in fixed or
+// scientific notation whichever is shorter.  libstdc++ implements
+// std::to_chars with Ryu, no locale and no format string to parse.
+LogStream &LogStream::operator<<(float v) {
+    if (buffer_.avail() >= kMaxNumericSize) {
+        char *p = buffer_.current();
+        buffer_.add(std::to_chars(p, p + kMaxNumericSize, v).ptr - p);
+    }
+    return *this;
+}
+
 LogStream &LogStream::operator<<(double v) {
     if (buffer_.avail() >= kMaxNumericSize) {
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
-        buffer_.add(len);
+        char *p = buffer_.current();
+        buffer_.add(std::to_chars(p, p + kMaxNumericSize, v).ptr - p);
     }
     return *this;
 }
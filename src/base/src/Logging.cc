@@ -1,8 +1,11 @@
 #include "Logging.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
+#include <map>
+#include <mutex>
 #include <sstream>
 
 #include "CurrentThread.h"
@@ -37,6 +40,98 @@ const char *LogLevelName[Logger::NUM_LOG_LEVELS] = {
         "TRACE ", "DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL ",
 };
 
+namespace {
+
+// The levels set for modules, created on first use so that LOG statements
+// run by other static initializers find them.
+struct ModuleLevels {
+    ModuleLevels() {
+        // DWS_LOG_LEVELS=http=DEBUG,Acceptor=WARN
+        const char *env = ::getenv("DWS_LOG_LEVELS");
+        std::istringstream in(env ? env : "");
+        std::string entry;
+        while (std::getline(in, entry, ',')) {
+            std::string::size_type equal = entry.find('=');
+            if (equal == std::string::npos) {
+                continue;
+            }
+            std::string name = entry.substr(equal + 1);
+            for (int level = 0; level < Logger::NUM_LOG_LEVELS; ++level) {
+                if (strncmp(LogLevelName[level], name.c_str(), name.size()) == 0 &&
+                    LogLevelName[level][name.size()] == ' ') {
+                    levels[entry.substr(0, equal)] = static_cast<Logger::LogLevel>(level);
+                }
+            }
+        }
+    }
+
+    // for a file of @c path, or the default
+    Logger::LogLevel find(StringPiece path) const {
+        if (levels.empty()) {
+            return g_logLevel;
+        }
+        const char *slash = static_cast<const char *>(memrchr(path.data(), '/', path.size()));
+        StringPiece name = slash ? StringPiece(slash + 1, path.end() - slash - 1) : path;
+        const char *dot = static_cast<const char *>(memchr(name.data(), '.', name.size()));
+        if (dot) {
+            name = StringPiece(name.data(), static_cast<int>(dot - name.data()));
+        }
+        for (;;) {
+            auto it = levels.find(name.as_string());
+            if (it != levels.end()) {
+                return it->second;
+            }
+            if (!slash) {
+                return g_logLevel;
+            }
+            // the directory enclosing what has been looked at
+            path = StringPiece(path.data(), static_cast<int>(slash - path.data()));
+            slash = static_cast<const char *>(memrchr(path.data(), '/', path.size()));
+            name = slash ? StringPiece(slash + 1, path.end() - slash - 1) : path;
+        }
+    }
+
+    void update() {
+        Logger::LogLevel lowest = g_logLevel;
+        for (const auto &entry : levels) {
+            lowest = std::min(lowest, entry.second);
+        }
+        g_lowestLogLevel.store(lowest, std::memory_order_relaxed);
+        g_logLevelGeneration.fetch_add(1, std::memory_order_release);
+    }
+
+    std::mutex mutex;
+    std::map<std::string, Logger::LogLevel> levels;
+};
+
+ModuleLevels &moduleLevels() {
+    static ModuleLevels levels;
+    return levels;
+}
+
+int initLowestLogLevel() {
+    ModuleLevels &modules = moduleLevels();
+    std::lock_guard<std::mutex> lock(modules.mutex);
+    modules.update();
+    return g_lowestLogLevel.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+// TRACE, and every statement consults its LogSite, until initialized
+std::atomic<int> g_lowestLogLevel(initLowestLogLevel());
+std::atomic<unsigned> g_logLevelGeneration(1);
+
+void LogSite::refresh() {
+    int savedErrno = errno;  // for LOG_SYSERR
+    ModuleLevels &modules = moduleLevels();
+    std::lock_guard<std::mutex> lock(modules.mutex);
+    unsigned generation = g_logLevelGeneration.load(std::memory_order_relaxed);
+    level_.store(modules.find(StringPiece(file_)), std::memory_order_relaxed);
+    generation_.store(generation, std::memory_order_release);  // after level_
+    errno = savedErrno;
+}
+
 // helper class for known string length at compile time
 class T {
  public:
@@ -134,10 +229,31 @@ Logger::~Logger() {
     }
 }
 
-void Logger::setLogLevel(Logger::LogLevel level) { g_logLevel = level; }
+void Logger::setLogLevel(Logger::LogLevel level) {
+    ModuleLevels &modules = moduleLevels();
+    std::lock_guard<std::mutex> lock(modules.mutex);
+    g_logLevel = level;
+    modules.update();
+}
+
+void Logger::setLogLevel(const std::string &module, LogLevel level) {
+    ModuleLevels &modules = moduleLevels();
+    std::lock_guard<std::mutex> lock(modules.mutex);
+    modules.levels[module] = level;
+    modules.update();
+}
+
+void Logger::clearLogLevel(const std::string &module) {
+    ModuleLevels &modules = moduleLevels();
+    std::lock_guard<std::mutex> lock(modules.mutex);
+    modules.levels.erase(module);
+    modules.update();
+}
 
 void Logger::setOutput(OutputFunc out) { g_output = out; }
 
+Logger::OutputFunc Logger::output() { return g_output; }
+
 void Logger::setFlush(FlushFunc flush) { g_flush = flush; }
 
 void Logger::setTimeZone(const TimeZone &tz) { g_logTimeZone = tz; }
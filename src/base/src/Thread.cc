@@ -125,7 +125,8 @@ void Thread::start() {
     assert(!started_);
     started_ = true;
     auto data = std::make_unique<detail::ThreadData>(func_, name_, &tid_, &sem);
-    thread_ = std::make_shared<std::thread>(&detail::startThread, data.get());
+    // startThread() owns and deletes the data once the thread is running.
+    thread_ = std::make_shared<std::thread>(&detail::startThread, data.release());
     sem_wait(&sem);
     assert(tid_ > 0);
 }
@@ -87,7 +87,7 @@ ThreadPool::Task ThreadPool::take() {
 
 bool ThreadPool::isFull() const {
     assert(!mutex_.try_lock());
-    return queue_.size() >= maxQueueSize_;
+    return maxQueueSize_ > 0 && queue_.size() >= maxQueueSize_;
 }
 
 void ThreadPool::runInThread() {
@@ -233,7 +233,7 @@ bool readTimeZoneFile(const char *zonefile, struct TimeZone::Data *data) {
 
 inline void fillHMS(int seconds, struct DateTime *dt) {
     dt->second = static_cast<int8_t>(seconds % 60);
-    auto minutes = static_cast<int8_t>(seconds / 60);
+    int minutes = seconds / 60;
     dt->minute = static_cast<int8_t>(minutes % 60);
     dt->hour = static_cast<int8_t>(minutes / 60);
 }
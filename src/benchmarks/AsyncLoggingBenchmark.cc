@@ -0,0 +1,84 @@
+// Log lines per second through AsyncLogging from several threads at once.
+//
+// usage: async_logging_benchmark [lines per thread] [max threads] [dir]
+//
+// Every thread logs its lines into the same AsyncLogging, which writes to
+// a file in dir (default /tmp).  Prints the rate at which the producers
+// get their lines appended for 1, 2, 4, ... threads, with LOG_INFO
+// formatting in place and with LOG_FMT leaving it to the logging thread;
+// the logging thread drains in the background and the time to write the
+// file is not counted.
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncLogging.h"
+#include "DeferredLogging.h"
+#include "Logging.h"
+#include "Timestamp.h"
+
+using dws::AsyncLogging;
+using dws::Timestamp;
+
+namespace {
+
+AsyncLogging* g_asyncLog = nullptr;
+
+void asyncOutput(const char* msg, int len) { g_asyncLog->append(msg, len); }
+
+double run(const std::string& basename, int lines, int threads, bool deferred) {
+    AsyncLogging log(basename, 1024 * 1024 * 1024);
+    g_asyncLog = &log;
+    dws::setDeferredLogging(deferred ? &log : nullptr);
+    log.start();
+    std::vector<std::thread> workers;
+    Timestamp start = Timestamp::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([lines, t, deferred] {
+            for (int i = 0; i < lines; ++i) {
+                if (deferred) {
+                    LOG_FMT(INFO, "request %d from worker %d served in %.6f seconds, %d bytes", i,
+                            t, 0.000123, 1024);
+                } else {
+                    LOG(INFO) << "request " << i << " from worker " << t << " served in "
+                              << 0.000123 << " seconds, " << 1024 << " bytes";
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = dws::timeDifference(Timestamp::now(), start);
+    log.stop();
+    dws::setDeferredLogging(nullptr);
+    return elapsed;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? atoi(argv[1]) : 100000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 8;
+    const char* dir = argc > 3 ? argv[3] : "/tmp";
+    if (chdir(dir) < 0) {
+        perror(dir);
+        return 1;
+    }
+    const std::string basename = "async_logging_benchmark";
+    dws::Logger::setOutput(asyncOutput);
+
+    printf("%d lines per thread into %s/%s.*\n", lines, dir, basename.c_str());
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        const double total = static_cast<double>(threads) * lines;
+        double eager = run(basename, lines, threads, false) / total;
+        double deferred = run(basename, lines, threads, true) / total;
+        printf("threads %2d  LOG %9.0f lines/s %4.0f ns  LOG_FMT %9.0f lines/s %4.0f ns\n",
+               threads, 1 / eager, eager * 1e9, 1 / deferred, deferred * 1e9);
+    }
+}
@@ -0,0 +1,151 @@
+// Request rate of HttpClient against HttpServer over loopback.
+//
+// usage: http_client_benchmark [ioThreads] [concurrency] [maxConnections] [pipelineDepth]
+//                              [seconds] [port]
+//
+// The client runs in its own loop and keeps concurrency requests
+// outstanding, sending the next one from each response callback.  The run
+// is repeated with "Connection: close" on every request, i.e. a new
+// connection per request as before the pool existed, so both numbers come
+// from the same machine.  Prints requests per second and connects made.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "HttpClient.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Logging.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::EventLoop;
+using dws::net::HttpClient;
+using dws::net::HttpClientResponse;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpServer;
+using dws::net::InetAddress;
+
+namespace {
+
+struct Result {
+    int64_t requests = 0;
+    int64_t errors = 0;
+    uint64_t connects = 0;
+    double elapsed = 0;
+};
+
+// Runs in the client loop, quits it when the last response is in.
+class Driver {
+ public:
+    Driver(EventLoop* loop, const InetAddress& server, const HttpClient::Options& options,
+           bool closeEach, double seconds)
+        : loop_(loop),
+          server_(server),
+          client_(loop, "HttpClientBenchmark", options),
+          closeEach_(closeEach),
+          seconds_(seconds),
+          outstanding_(0) {}
+
+    void start(int concurrency) {
+        start_ = Timestamp::now();
+        for (int i = 0; i < concurrency; ++i) {
+            sendOne();
+        }
+    }
+
+    Result result() const {
+        Result r = result_;
+        r.connects = client_.numConnects();
+        return r;
+    }
+
+ private:
+    void sendOne() {
+        HttpClient::Request request;
+        request.target = "/hello";
+        if (closeEach_) {
+            request.headers.emplace_back("Connection", "close");
+        }
+        ++outstanding_;
+        client_.send(server_, std::move(request),
+                     [this](HttpClient::Error error, const HttpClientResponse&) {
+                         --outstanding_;
+                         ++(error == HttpClient::kOk ? result_.requests : result_.errors);
+                         double elapsed = dws::timeDifference(Timestamp::now(), start_);
+                         if (elapsed < seconds_) {
+                             sendOne();
+                         } else if (outstanding_ == 0) {
+                             result_.elapsed = elapsed;
+                             loop_->quit();
+                         }
+                     });
+    }
+
+    EventLoop* loop_;
+    InetAddress server_;
+    HttpClient client_;
+    bool closeEach_;
+    double seconds_;
+    int outstanding_;
+    Timestamp start_;
+    Result result_;
+};
+
+Result run(const InetAddress& server, const HttpClient::Options& options, int concurrency,
+           bool closeEach, double seconds) {
+    EventLoop loop;
+    Driver driver(&loop, server, options, closeEach, seconds);
+    driver.start(concurrency);
+    loop.loop();
+    return driver.result();
+}
+
+void print(const char* mode, const Result& r) {
+    printf("%-10s %lld requests in %.2fs, %.0f requests/s, %lld errors, %llu connects\n", mode,
+           static_cast<long long>(r.requests), r.elapsed, static_cast<double>(r.requests) / r.elapsed,
+           static_cast<long long>(r.errors), static_cast<unsigned long long>(r.connects));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 1;
+    int concurrency = argc > 2 ? atoi(argv[2]) : 64;
+    int maxConnections = argc > 3 ? atoi(argv[3]) : 8;
+    int pipelineDepth = argc > 4 ? atoi(argv[4]) : 8;
+    double seconds = argc > 5 ? atof(argv[5]) : 3.0;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 29385);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    EventLoop loop;
+    InetAddress listenAddr(port, true);
+    HttpServer server(&loop, listenAddr, "HttpClientBenchmark");
+    server.setThreadNum(ioThreads);
+    server.setHttpCallback([](const HttpRequest&, HttpResponse* resp) {
+        resp->setBody(StringPiece("hello"));
+    });
+    server.start();
+
+    HttpClient::Options options;
+    options.maxConnectionsPerHost = maxConnections;
+    options.maxPipelineDepth = pipelineDepth;
+    options.maxInFlight = concurrency;
+    printf("io threads %d, concurrency %d, %d connections, pipeline depth %d\n", ioThreads,
+           concurrency, maxConnections, pipelineDepth);
+    Result pooled;
+    Result reconnect;
+    std::thread driver([&] {
+        pooled = run(listenAddr, options, concurrency, false, seconds);
+        reconnect = run(listenAddr, options, concurrency, true, seconds);
+        loop.quit();
+    });
+    loop.loop();
+    driver.join();
+    print("pooled", pooled);
+    print("close", reconnect);
+}
@@ -0,0 +1,125 @@
+// Hello-world throughput of HttpServer over loopback.
+//
+// usage: http_hello_benchmark [ioThreads] [connections] [pipelineDepth] [seconds] [port]
+//
+// Every client thread drives one keep-alive connection, writing
+// pipelineDepth requests at once and waiting for all responses before the
+// next batch.  Prints requests per second so runs can be compared over time.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Logging.h"
+
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpServer;
+using dws::net::InetAddress;
+
+namespace {
+
+const char kBody[] = "Hello, World!";
+
+void hello(const HttpRequest&, HttpResponse* resp) {
+    resp->setContentType(dws::StringPiece("text/plain"));
+    resp->setBody(dws::StringPiece(kBody));
+}
+
+std::size_t responseBytes() {
+    Buffer buf;
+    HttpResponse resp(&buf, false);
+    hello(HttpRequest(), &resp);
+    return buf.readableBytes();
+}
+
+int64_t runClient(const InetAddress& addr, int depth, const std::atomic<bool>& stop) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+        perror("connect");
+        ::close(fd);
+        return 0;
+    }
+    std::string batch;
+    for (int i = 0; i < depth; ++i) {
+        batch += "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+    const std::size_t expected = responseBytes() * depth;
+    std::vector<char> buf(64 * 1024);
+    int64_t requests = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size())) {
+            break;
+        }
+        std::size_t received = 0;
+        while (received < expected) {
+            ssize_t n = ::read(fd, buf.data(), buf.size());
+            if (n <= 0) {
+                ::close(fd);
+                return requests;
+            }
+            received += n;
+        }
+        requests += depth;
+    }
+    ::close(fd);
+    return requests;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int depth = argc > 3 ? atoi(argv[3]) : 16;
+    double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 29380);
+    dws::Logger::setLogLevel(dws::Logger::WARN);
+
+    EventLoop loop;
+    InetAddress listenAddr(port, true);
+    HttpServer server(&loop, listenAddr, "HttpHelloBenchmark");
+    server.setHttpCallback(hello);
+    server.setThreadNum(ioThreads);
+    server.start();
+
+    std::atomic<bool> stop(false);
+    std::vector<int64_t> requests(connections);
+    std::vector<std::thread> clients;
+    dws::Timestamp start = dws::Timestamp::now();
+    for (int i = 0; i < connections; ++i) {
+        clients.emplace_back([&, i] { requests[i] = runClient(listenAddr, depth, stop); });
+    }
+    loop.runAfter(seconds, [&] {
+        stop = true;
+        loop.quit();
+    });
+    loop.loop();
+    for (std::thread& t : clients) {
+        t.join();
+    }
+    double elapsed = dws::timeDifference(dws::Timestamp::now(), start);
+
+    int64_t total = 0;
+    for (int64_t n : requests) {
+        total += n;
+    }
+    printf("io threads %d, connections %d, pipeline depth %d: %lld requests in %.2fs, "
+           "%.0f requests/s, %.1f MiB/s responses\n",
+           ioThreads, connections, depth, static_cast<long long>(total), elapsed,
+           static_cast<double>(total) / elapsed,
+           static_cast<double>(total * responseBytes()) / elapsed / 1024 / 1024);
+}
@@ -0,0 +1,115 @@
+// Number formatting cost in LogStream against the implementation it
+// replaced.
+//
+// usage: log_stream_benchmark [iterations]
+//
+// Formats the same mix of integers (all magnitudes, both signs) and
+// doubles (access log style latencies and ratios) with LogStream and with
+// the old divide-by-10 loop plus std::reverse and snprintf("%.12g").
+// Prints ns per number.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "LogStream.h"
+#include "Timestamp.h"
+
+using dws::LogStream;
+using dws::Timestamp;
+
+namespace {
+
+namespace legacy {
+
+const char digits[] = "9876543210123456789";
+const char *zero = digits + 9;
+
+template <typename T>
+size_t convert(char buf[], T value) {
+    T i = value;
+    char *p = buf;
+    do {
+        int lsd = static_cast<int>(i % 10);
+        i /= 10;
+        *p++ = zero[lsd];
+    } while (i != 0);
+    if (value < 0) {
+        *p++ = '-';
+    }
+    *p = '\0';
+    std::reverse(buf, p);
+    return p - buf;
+}
+
+}  // namespace legacy
+
+template <typename Fn>
+double nsPer(int iterations, std::size_t count, Fn fn) {
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    double elapsed = dws::timeDifference(Timestamp::now(), start);
+    return elapsed * 1e9 / (static_cast<double>(iterations) * count);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> ints(4096);
+    for (auto &v : ints) {
+        v = static_cast<int64_t>(rng() >> (rng() % 64));
+        if (rng() % 2) {
+            v = -v;
+        }
+    }
+    std::vector<double> doubles(4096);
+    std::uniform_real_distribution<double> unit(0, 1);
+    for (auto &v : doubles) {
+        v = unit(rng) * std::pow(10.0, static_cast<int>(rng() % 12) - 6);
+    }
+
+    LogStream os;
+    char buf[64];
+    std::size_t sink = 0;
+    auto streamInts = [&] {
+        for (int64_t v : ints) {
+            if (os.buffer().avail() < 64) {
+                os.resetBuffer();
+            }
+            os << v;
+        }
+    };
+    auto legacyInts = [&] {
+        for (int64_t v : ints) {
+            sink += legacy::convert(buf, v);
+        }
+    };
+    auto streamDoubles = [&] {
+        for (double v : doubles) {
+            if (os.buffer().avail() < 64) {
+                os.resetBuffer();
+            }
+            os << v;
+        }
+    };
+    auto legacyDoubles = [&] {
+        for (double v : doubles) {
+            sink += snprintf(buf, sizeof buf, "%.12g", v);
+        }
+    };
+
+    printf("%d iterations of %zu numbers\n", iterations, ints.size());
+    printf("int64   LogStream %6.1f ns  legacy %6.1f ns\n",
+           nsPer(iterations, ints.size(), streamInts), nsPer(iterations, ints.size(), legacyInts));
+    printf("double  LogStream %6.1f ns  legacy %6.1f ns\n",
+           nsPer(iterations, doubles.size(), streamDoubles),
+           nsPer(iterations, doubles.size(), legacyDoubles));
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+// Multi-get throughput of MemcacheServer over loopback.
+//
+// usage: memcache_benchmark [ioThreads] [connections] [keysPerGet] [valueBytes] [seconds] [port]
+//
+// Modelled on mc-crusher's multi-get load: the keys are stored up front,
+// then every client thread drives one connection, sending a text get of
+// keysPerGet random keys and waiting for the whole reply before the next.
+// Hits of the connection's own shard go out with one writev() straight
+// from the items, the others are copied once by their shard.  Prints keys
+// fetched per second; point mc-crusher or memtier_benchmark at the same
+// port to compare with a real memcached.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "MemcacheServer.h"
+
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::MemcacheServer;
+
+namespace {
+
+const int kKeySpace = 10000;
+
+std::string keyOf(int i) {
+    char name[32];
+    snprintf(name, sizeof name, "key:%06d", i);
+    return name;
+}
+
+int connectTo(const InetAddress& addr) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+        perror("connect");
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool readBytes(int fd, std::vector<char>* buf, std::size_t bytes) {
+    std::size_t received = 0;
+    while (received < bytes) {
+        ssize_t n = ::read(fd, buf->data(), buf->size());
+        if (n <= 0) {
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+bool preload(const InetAddress& addr, int valueBytes) {
+    int fd = connectTo(addr);
+    if (fd < 0) {
+        return false;
+    }
+    std::string value(valueBytes, 'v');
+    std::string request;
+    for (int i = 0; i < kKeySpace; ++i) {
+        request += "set " + keyOf(i) + " 0 0 " + std::to_string(valueBytes) + " noreply\r\n" +
+                   value + "\r\n";
+    }
+    request += "version\r\n";
+    std::vector<char> buf(256);
+    bool ok = ::write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()) &&
+              readBytes(fd, &buf, sizeof "VERSION 1.6.0\r\n" - 1);
+    ::close(fd);
+    return ok;
+}
+
+int64_t runClient(const InetAddress& addr, int keysPerGet, int valueBytes, unsigned seed,
+                  const std::atomic<bool>& stop) {
+    int fd = connectTo(addr);
+    if (fd < 0) {
+        return 0;
+    }
+    std::mt19937 random(seed);
+    // "VALUE key:000000 0 <valueBytes>\r\n<value>\r\n" per key, "END\r\n" at last
+    const std::size_t expected =
+            keysPerGet * (sizeof "VALUE key:000000 0 \r\n" - 1 + std::to_string(valueBytes).size() +
+                          valueBytes + 2) +
+            5;
+    std::vector<char> buf(256 * 1024);
+    std::string request;
+    int64_t keys = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        request = "get";
+        for (int i = 0; i < keysPerGet; ++i) {
+            request += " " + keyOf(static_cast<int>(random() % kKeySpace));
+        }
+        request += "\r\n";
+        if (::write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size()) ||
+            !readBytes(fd, &buf, expected)) {
+            break;
+        }
+        keys += keysPerGet;
+    }
+    ::close(fd);
+    return keys;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int keysPerGet = argc > 3 ? atoi(argv[3]) : 50;
+    int valueBytes = argc > 4 ? atoi(argv[4]) : 4096;
+    double seconds = argc > 5 ? atof(argv[5]) : 5.0;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 29384);
+    dws::Logger::setLogLevel(dws::Logger::WARN);
+
+    EventLoop loop;
+    InetAddress listenAddr(port, true);
+    MemcacheServer server(&loop, listenAddr, "MemcacheBenchmark");
+    server.setThreadNum(ioThreads);
+    server.setMemoryLimit(256 * 1024 * 1024);
+    server.start();
+
+    std::atomic<bool> stop(false);
+    std::vector<int64_t> keys(connections);
+    dws::Timestamp start;
+    // clients finish their last get before the loop stops answering
+    std::thread driver([&] {
+        if (preload(listenAddr, valueBytes)) {
+            start = dws::Timestamp::now();
+            std::vector<std::thread> clients;
+            for (int i = 0; i < connections; ++i) {
+                clients.emplace_back([&, i] {
+                    keys[i] = runClient(listenAddr, keysPerGet, valueBytes,
+                                        static_cast<unsigned>(i + 1), stop);
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            stop = true;
+            for (std::thread& t : clients) {
+                t.join();
+            }
+        }
+        loop.quit();
+    });
+    loop.loop();
+    driver.join();
+    double elapsed = dws::timeDifference(dws::Timestamp::now(), start);
+
+    int64_t total = 0;
+    for (int64_t n : keys) {
+        total += n;
+    }
+    printf("io threads %d, connections %d, %d keys of %d bytes per get: %lld keys in %.2fs, "
+           "%.0f keys/s, %.1f MiB/s, %zu items\n",
+           ioThreads, connections, keysPerGet, valueBytes, static_cast<long long>(total), elapsed,
+           static_cast<double>(total) / elapsed,
+           static_cast<double>(total) * valueBytes / elapsed / (1024 * 1024), server.numItems());
+}
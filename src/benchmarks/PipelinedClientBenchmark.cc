@@ -0,0 +1,106 @@
+// Request/response throughput over one connection for several pipeline
+// windows.
+//
+// usage: pipelined_client_benchmark [requests] [size] [port]
+//
+// A line echo server and a PipelinedClient share one loop.  The client
+// keeps every request queued from the start and lets Options::maxInFlight
+// of them onto the connection at a time; window 1 is strict
+// request-response.  Prints requests/s per window.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "PipelinedClient.h"
+#include "TcpServer.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::PipelinedClient;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+ssize_t lineFramer(const Buffer& buf, uint64_t*) {
+    const char* eol = buf.findEOL();
+    return eol ? eol + 1 - buf.peek() : 0;
+}
+
+double run(const InetAddress& addr, int requests, std::size_t size, std::size_t window) {
+    EventLoop loop;
+    TcpServer server(&loop, addr, "LineEcho");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        const char* eol = buf->findEOL();
+        const char* end = eol;
+        while (eol) {
+            end = eol + 1;
+            eol = buf->findEOL(end);
+        }
+        if (end) {
+            conn->send(buf->peek(), static_cast<int>(end - buf->peek()));
+            buf->retrieveUntil(end);
+        }
+    });
+    server.start();
+
+    PipelinedClient::Options options;
+    options.maxInFlight = window;
+    options.maxQueued = static_cast<std::size_t>(requests);
+    options.timeoutSeconds = 60.0;
+    PipelinedClient client(&loop, addr, "Pipelined", lineFramer, options);
+    const std::string request = std::string(size - 1, 'r') + "\n";
+    int done = 0;
+    Timestamp start;
+    double elapsed = 0;
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setTcpNoDelay(true);
+            start = Timestamp::now();
+        } else {
+            loop.quit();
+        }
+    });
+    for (int i = 0; i < requests; ++i) {
+        client.send(request, [&](PipelinedClient::Error error, StringPiece) {
+            if (error != PipelinedClient::kOk) {
+                printf("request failed: %s\n", PipelinedClient::errorString(error));
+            }
+            if (++done == requests) {
+                elapsed = dws::timeDifference(Timestamp::now(), start);
+                client.disconnect();
+            }
+        });
+    }
+    client.connect();
+    loop.loop();
+    return elapsed;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int requests = argc > 1 ? atoi(argv[1]) : 200000;
+    std::size_t size = static_cast<std::size_t>(argc > 2 ? atoi(argv[2]) : 64);
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 29396);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    printf("%d requests of %zu bytes over one connection\n", requests, size);
+    for (std::size_t window : {1, 4, 16, 64, 256}) {
+        double elapsed = run(InetAddress(port, true), requests, size, window);
+        printf("window %3zu %9.0f requests/s\n", window, requests / elapsed);
+    }
+}
@@ -0,0 +1,133 @@
+// Pipelined SET/GET throughput of ShardedKvServer over loopback.
+//
+// usage: redis_kv_benchmark [ioThreads] [connections] [pipelineDepth] [seconds] [port]
+//
+// Modelled on `redis-benchmark -t set,get -P <depth> -r 100000`: every
+// client thread drives one connection, writing depth/2 SETs of random keys
+// with 3-byte values followed by GETs of the same keys, and waits for all
+// replies before the next batch.  Keys land on every shard, so most
+// commands cross loops.  Prints commands per second; point redis-benchmark
+// at the same port to compare with a real Redis.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "RespCodec.h"
+#include "ShardedKvServer.h"
+
+using dws::StringPiece;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::ShardedKvServer;
+namespace resp = dws::net::resp;
+
+namespace {
+
+const int kKeySpace = 100000;
+// "+OK\r\n" and "$3\r\nxxx\r\n"
+const std::size_t kSetReplyBytes = 5;
+const std::size_t kGetReplyBytes = 9;
+
+int64_t runClient(const InetAddress& addr, int depth, unsigned seed,
+                  const std::atomic<bool>& stop) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+        perror("connect");
+        ::close(fd);
+        return 0;
+    }
+    std::mt19937 random(seed);
+    const int half = depth / 2;
+    const std::size_t expected = half * (kSetReplyBytes + kGetReplyBytes);
+    Buffer batch;
+    std::vector<std::string> keys(half);
+    std::vector<char> buf(64 * 1024);
+    int64_t commands = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (std::string& key : keys) {
+            char name[32];
+            snprintf(name, sizeof name, "key:%012d", static_cast<int>(random() % kKeySpace));
+            key = name;
+            resp::appendCommand(&batch, {StringPiece("SET"), StringPiece(key), StringPiece("xxx")});
+        }
+        for (const std::string& key : keys) {
+            resp::appendCommand(&batch, {StringPiece("GET"), StringPiece(key)});
+        }
+        ssize_t size = static_cast<ssize_t>(batch.readableBytes());
+        if (::write(fd, batch.peek(), size) != size) {
+            break;
+        }
+        batch.retrieveAll();
+        std::size_t received = 0;
+        while (received < expected) {
+            ssize_t n = ::read(fd, buf.data(), buf.size());
+            if (n <= 0) {
+                ::close(fd);
+                return commands;
+            }
+            received += n;
+        }
+        commands += 2 * half;
+    }
+    ::close(fd);
+    return commands;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int depth = argc > 3 ? atoi(argv[3]) : 16;
+    double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 29383);
+    dws::Logger::setLogLevel(dws::Logger::WARN);
+
+    EventLoop loop;
+    InetAddress listenAddr(port, true);
+    ShardedKvServer server(&loop, listenAddr, "RedisKvBenchmark");
+    server.setThreadNum(ioThreads);
+    server.start();
+
+    std::atomic<bool> stop(false);
+    std::vector<int64_t> commands(connections);
+    std::vector<std::thread> clients;
+    dws::Timestamp start = dws::Timestamp::now();
+    for (int i = 0; i < connections; ++i) {
+        clients.emplace_back([&, i] {
+            commands[i] = runClient(listenAddr, depth, static_cast<unsigned>(i + 1), stop);
+        });
+    }
+    loop.runAfter(seconds, [&] {
+        stop = true;
+        loop.quit();
+    });
+    loop.loop();
+    for (std::thread& t : clients) {
+        t.join();
+    }
+    double elapsed = dws::timeDifference(dws::Timestamp::now(), start);
+
+    int64_t total = 0;
+    for (int64_t n : commands) {
+        total += n;
+    }
+    printf("io threads %d, connections %d, pipeline depth %d: %lld commands in %.2fs, "
+           "%.0f commands/s, %zu keys\n",
+           ioThreads, connections, depth, static_cast<long long>(total), elapsed,
+           static_cast<double>(total) / elapsed, server.numKeys());
+}
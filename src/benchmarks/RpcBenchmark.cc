@@ -0,0 +1,185 @@
+// Throughput and latency of RpcServer and RpcChannel over loopback.
+//
+// usage: rpc_benchmark [ioThreads] [channels] [window] [seconds] [port]
+//
+// Every channel runs in its own client loop and keeps window echo calls of
+// 64 bytes in flight, issuing the next call from the previous one's
+// callback.  Prints calls per second with p50/p99 latency, then the
+// round-trip latency of blocking callSync() on one channel.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CountDownLatch.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "RpcChannel.h"
+#include "RpcServer.h"
+
+using dws::CountDownLatch;
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::EventLoop;
+using dws::net::EventLoopThread;
+using dws::net::InetAddress;
+using dws::net::RpcChannel;
+using dws::net::RpcServer;
+namespace rpc = dws::net::rpc;
+
+namespace {
+
+const std::string kPayload(64, 'x');
+const int kSyncCalls = 10000;
+
+/// Keeps a window of calls in flight on one channel, loop thread only.
+class Caller {
+ public:
+    Caller(EventLoop* loop, const InetAddress& serverAddr)
+        : channel_(loop, serverAddr, "RpcBenchmarkClient"), done_(1), stopped_(false) {}
+
+    RpcChannel* channel() { return &channel_; }
+    std::vector<int64_t>& latencies() { return latencies_; }
+
+    void start(int window) {
+        channel_.getLoop()->runInLoop([this, window] {
+            outstanding_ = window;
+            for (int i = 0; i < window; ++i) {
+                issue();
+            }
+        });
+    }
+    void stop() { stopped_ = true; }
+    void wait() { done_.wait(); }
+
+ private:
+    void issue() {
+        Timestamp sent = Timestamp::now();
+        channel_.call(StringPiece("echo"), StringPiece(kPayload),
+                      [this, sent](rpc::Status status, const StringPiece&) {
+                          if (status == rpc::kOk) {
+                              latencies_.push_back(Timestamp::now().microSecondsSinceEpoch() -
+                                                   sent.microSecondsSinceEpoch());
+                          }
+                          if (stopped_.load(std::memory_order_relaxed) || status != rpc::kOk) {
+                              if (--outstanding_ == 0) {
+                                  done_.countDown();
+                              }
+                          } else {
+                              issue();
+                          }
+                      });
+    }
+
+    RpcChannel channel_;
+    CountDownLatch done_;
+    std::atomic<bool> stopped_;
+    int outstanding_ = 0;
+    std::vector<int64_t> latencies_;
+};
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    int channels = argc > 2 ? atoi(argv[2]) : 4;
+    int window = argc > 3 ? atoi(argv[3]) : 32;
+    double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 29382);
+    dws::Logger::setLogLevel(dws::Logger::WARN);
+
+    EventLoop loop;
+    InetAddress serverAddr(port, true);
+    RpcServer server(&loop, serverAddr, "RpcBenchmark");
+    server.setThreadNum(ioThreads);
+    server.registerMethod("echo", [](const StringPiece& request, const RpcServer::Done& done) {
+        done(rpc::kOk, request);
+    });
+    server.registerMethod("hold", [](const StringPiece&, const RpcServer::Done&) {});
+    server.start();
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<std::unique_ptr<Caller>> callers;
+    for (int i = 0; i < channels; ++i) {
+        threads.emplace_back(new EventLoopThread);
+        callers.emplace_back(new Caller(threads.back()->startLoop(), serverAddr));
+        callers.back()->channel()->connect();
+    }
+
+    double elapsed = 0;
+    std::vector<int64_t> syncLatencies;
+    // the server's acceptor runs in this thread's loop
+    std::thread driver([&] {
+        Timestamp start = Timestamp::now();
+        for (auto& caller : callers) {
+            caller->start(window);
+        }
+        ::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+        for (auto& caller : callers) {
+            caller->stop();
+        }
+        for (auto& caller : callers) {
+            caller->wait();
+        }
+        elapsed = dws::timeDifference(Timestamp::now(), start);
+
+        RpcChannel* channel = callers[0]->channel();
+        for (int i = 0; i < kSyncCalls; ++i) {
+            Timestamp sent = Timestamp::now();
+            channel->callSync(StringPiece("echo"), StringPiece(kPayload), nullptr);
+            syncLatencies.push_back(Timestamp::now().microSecondsSinceEpoch() -
+                                    sent.microSecondsSinceEpoch());
+        }
+
+        // a call left unanswered fails once the connection is fully closed
+        for (auto& caller : callers) {
+            CountDownLatch closed(1);
+            caller->channel()->call(StringPiece("hold"), StringPiece(),
+                                    [&closed](rpc::Status, const StringPiece&) {
+                                        closed.countDown();
+                                    });
+            caller->channel()->disconnect();
+            closed.wait();
+        }
+        loop.quit();
+    });
+    loop.loop();
+    driver.join();
+
+    std::vector<int64_t> latencies;
+    for (auto& caller : callers) {
+        latencies.insert(latencies.end(), caller->latencies().begin(),
+                         caller->latencies().end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(syncLatencies.begin(), syncLatencies.end());
+    printf("io threads %d, channels %d, window %d: %zu calls in %.2fs, %.0f calls/s, "
+           "p50 %lld us, p99 %lld us\n",
+           ioThreads, channels, window, latencies.size(), elapsed,
+           static_cast<double>(latencies.size()) / elapsed,
+           static_cast<long long>(percentile(latencies, 0.5)),
+           static_cast<long long>(percentile(latencies, 0.99)));
+    printf("callSync: %zu calls, p50 %lld us, p99 %lld us\n", syncLatencies.size(),
+           static_cast<long long>(percentile(syncLatencies, 0.5)),
+           static_cast<long long>(percentile(syncLatencies, 0.99)));
+
+    // channels go before their loops
+    callers.clear();
+    threads.clear();
+}
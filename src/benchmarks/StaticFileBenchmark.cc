@@ -0,0 +1,177 @@
+// Static file serving with StaticFileHandler against opening, stat-ing and
+// reading the file on every request.
+//
+// usage: static_file_benchmark [ioThreads] [concurrency] [seconds] [port]
+//
+// A 4 KiB file (kept in memory by the cache) and a 1 MiB file (sent with
+// sendfile) are served over loopback to an HttpClient with 8 keep-alive
+// connections.  The baseline handler does open/fstat/read/close per
+// request and copies the body into the output Buffer, as serving files
+// did before the cache.  Prints requests/s and MiB/s for each.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "HttpClient.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "StaticFileHandler.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::EventLoop;
+using dws::net::HttpClient;
+using dws::net::HttpClientResponse;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpServer;
+using dws::net::InetAddress;
+using dws::net::StaticFileHandler;
+
+namespace {
+
+struct Result {
+    int64_t requests = 0;
+    int64_t bytes = 0;
+    int64_t errors = 0;
+    double elapsed = 0;
+};
+
+// What a handler without the cache does.
+void openEveryTime(const std::string& root, const HttpRequest& req, HttpResponse* resp) {
+    std::string path = root + req.path().as_string();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) < 0) {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->finish();
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return;
+    }
+    std::string body(static_cast<std::size_t>(st.st_size), '\0');
+    ssize_t n = ::pread(fd, &body[0], body.size(), 0);
+    ::close(fd);
+    body.resize(n > 0 ? static_cast<std::size_t>(n) : 0);
+    resp->setContentType(StringPiece("application/octet-stream"));
+    resp->setBody(StringPiece(body));
+}
+
+Result run(const InetAddress& server, const std::string& target, int concurrency,
+           double seconds) {
+    EventLoop loop;
+    HttpClient::Options options;
+    options.maxConnectionsPerHost = 8;
+    options.maxInFlight = concurrency;
+    HttpClient client(&loop, "StaticFileBenchmark", options);
+    Result result;
+    int outstanding = 0;
+    Timestamp start(Timestamp::now());
+    std::function<void()> sendOne = [&] {
+        HttpClient::Request request;
+        request.target = target;
+        ++outstanding;
+        client.send(server, request, [&](HttpClient::Error error, const HttpClientResponse& resp) {
+            --outstanding;
+            if (error == HttpClient::kOk && resp.statusCode() == 200) {
+                ++result.requests;
+                result.bytes += resp.body().size();
+            } else {
+                ++result.errors;
+            }
+            double elapsed = dws::timeDifference(Timestamp::now(), start);
+            if (elapsed < seconds) {
+                sendOne();
+            } else if (outstanding == 0) {
+                result.elapsed = elapsed;
+                loop.quit();
+            }
+        });
+    };
+    for (int i = 0; i < concurrency; ++i) {
+        sendOne();
+    }
+    loop.loop();
+    return result;
+}
+
+void print(const char* mode, const Result& r) {
+    printf("%-18s %8.0f requests/s %8.1f MiB/s, %lld errors\n", mode,
+           static_cast<double>(r.requests) / r.elapsed,
+           static_cast<double>(r.bytes) / r.elapsed / (1024 * 1024),
+           static_cast<long long>(r.errors));
+}
+
+void writeFile(const std::string& path, std::size_t size) {
+    std::string data(size, 'x');
+    FILE* fp = ::fopen(path.c_str(), "wb");
+    if (fp == nullptr || ::fwrite(data.data(), 1, data.size(), fp) != data.size()) {
+        perror(path.c_str());
+        exit(1);
+    }
+    ::fclose(fp);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 1;
+    int concurrency = argc > 2 ? atoi(argv[2]) : 32;
+    double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 29389);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    char dir[] = "/tmp/dws_static_bench_XXXXXX";
+    if (::mkdtemp(dir) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    const std::string root(dir);
+    writeFile(root + "/small.bin", 4 * 1024);
+    writeFile(root + "/large.bin", 1024 * 1024);
+
+    EventLoop loop;
+    InetAddress cachedAddr(port, true);
+    InetAddress uncachedAddr(static_cast<uint16_t>(port + 1), true);
+    StaticFileHandler files(root);
+    HttpServer cached(&loop, cachedAddr, "Cached");
+    cached.setThreadNum(ioThreads);
+    cached.setHttpCallback(
+            [&](const HttpRequest& req, HttpResponse* resp) { files.handle(req, resp); });
+    cached.start();
+    HttpServer uncached(&loop, uncachedAddr, "Uncached");
+    uncached.setThreadNum(ioThreads);
+    uncached.setHttpCallback(
+            [&](const HttpRequest& req, HttpResponse* resp) { openEveryTime(root, req, resp); });
+    uncached.start();
+
+    printf("io threads %d, concurrency %d, 8 connections\n", ioThreads, concurrency);
+    Result results[4];
+    std::thread driver([&] {
+        results[0] = run(cachedAddr, "/small.bin", concurrency, seconds);
+        results[1] = run(uncachedAddr, "/small.bin", concurrency, seconds);
+        results[2] = run(cachedAddr, "/large.bin", concurrency, seconds);
+        results[3] = run(uncachedAddr, "/large.bin", concurrency, seconds);
+        loop.quit();
+    });
+    loop.loop();
+    driver.join();
+    print("4 KiB cached", results[0]);
+    print("4 KiB per request", results[1]);
+    print("1 MiB sendfile", results[2]);
+    print("1 MiB per request", results[3]);
+
+    ::unlink((root + "/small.bin").c_str());
+    ::unlink((root + "/large.bin").c_str());
+    ::rmdir(root.c_str());
+}
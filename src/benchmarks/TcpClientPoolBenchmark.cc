@@ -0,0 +1,118 @@
+// Echo throughput through TcpClientPool with one connection against
+// several connections spread over IO loops.
+//
+// usage: tcp_client_pool_benchmark [connections] [threads] [window] [seconds] [size] [port]
+//
+// A single-loop TcpServer echoes fixed-size messages.  The client
+// keeps @c window messages in flight through pool.send(), reports each
+// echoed one with complete() and sends the next.  The first run uses a
+// single connection in a single loop, the second @c connections over
+// @c threads IO loops.  Prints echoed messages/s and MiB/s.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "TcpClientPool.h"
+#include "TcpServer.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpClientPool;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+double run(const InetAddress& server, int connections, int threads, int window, double seconds,
+           std::size_t size, int64_t* echoed) {
+    EventLoop loop;
+    TcpClientPool::Options options;
+    options.minConnections = connections;
+    options.maxConnections = connections;
+    options.numThreads = threads;
+    TcpClientPool pool(&loop, server, "PoolBenchmark", options);
+    const std::string message(size, 'e');
+    std::atomic<int64_t> done(0);
+    std::atomic<bool> running(true);
+    pool.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        std::size_t replies = buf->readableBytes() / size;
+        buf->retrieve(replies * size);
+        pool.complete(conn, replies * size);
+        done += static_cast<int64_t>(replies);
+        for (std::size_t i = 0; i < replies && running; ++i) {
+            pool.send(StringPiece(message));
+        }
+    });
+    pool.start();
+    Timestamp start;
+    loop.runEvery(0.001, [&] {
+        if (pool.numConnected() == connections) {
+            loop.quit();
+        }
+    });
+    loop.loop();
+    start = Timestamp::now();
+    for (int i = 0; i < window; ++i) {
+        pool.send(StringPiece(message));
+    }
+    loop.runAfter(seconds, [&] { loop.quit(); });
+    loop.loop();
+    running = false;
+    double elapsed = dws::timeDifference(Timestamp::now(), start);
+    *echoed = done;
+    return elapsed;
+}
+
+void print(const char* mode, int64_t echoed, double elapsed, std::size_t size) {
+    printf("%-26s %9.0f messages/s %8.1f MiB/s\n", mode, static_cast<double>(echoed) / elapsed,
+           static_cast<double>(echoed) * static_cast<double>(size) / elapsed / (1024 * 1024));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int connections = argc > 1 ? atoi(argv[1]) : 4;
+    int threads = argc > 2 ? atoi(argv[2]) : 2;
+    int window = argc > 3 ? atoi(argv[3]) : 64;
+    double seconds = argc > 4 ? atof(argv[4]) : 2.0;
+    std::size_t size = static_cast<std::size_t>(argc > 5 ? atoi(argv[5]) : 1024);
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 29395);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    InetAddress addr(port, true);
+    EventLoop serverLoop;
+    TcpServer server(&serverLoop, addr, "EchoServer");
+    server.setThreadNum(0);
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback(
+            [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+    server.start();
+
+    printf("window %d, %zu byte messages\n", window, size);
+    std::thread driver([&] {
+        int64_t echoed = 0;
+        double elapsed = run(addr, 1, 0, window, seconds, size, &echoed);
+        print("1 connection, 1 loop", echoed, elapsed, size);
+        elapsed = run(addr, connections, threads, window, seconds, size, &echoed);
+        char mode[64];
+        snprintf(mode, sizeof mode, "%d connections, %d loops", connections, threads);
+        print(mode, echoed, elapsed, size);
+        serverLoop.queueInLoop([&serverLoop] { serverLoop.quit(); });
+    });
+    serverLoop.loop();
+    driver.join();
+}
@@ -0,0 +1,130 @@
+// Throughput of TcpProxy relaying to an echo backend over loopback, with
+// splice(2) and with copying through Buffers.
+//
+// usage: tcp_proxy_benchmark [ioThreads] [connections] [chunkKiB] [seconds] [port]
+//
+// Every connection has a writer thread streaming chunks for the given time
+// and a reader thread taking the echoes back, so both directions of the
+// proxy are loaded.  The two proxies share one backend and run one after
+// the other; prints echoed MiB/s for each and the direction counters.
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BackendPool.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "TcpProxy.h"
+#include "TcpServer.h"
+
+using dws::Timestamp;
+using dws::net::BackendPool;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpProxy;
+using dws::net::TcpServer;
+
+namespace {
+
+// Echoed bytes per second over all connections.
+double run(const InetAddress& proxyAddr, int connections, std::size_t chunk, double seconds) {
+    std::atomic<int64_t> echoed(0);
+    std::vector<int> fds;
+    std::vector<std::thread> threads;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < connections; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (::connect(fd, proxyAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+            perror("connect");
+            exit(1);
+        }
+        fds.push_back(fd);
+        threads.emplace_back([fd, chunk, seconds, start] {
+            std::string data(chunk, 'x');
+            while (dws::timeDifference(Timestamp::now(), start) < seconds) {
+                if (::write(fd, data.data(), data.size()) <= 0) {
+                    break;
+                }
+            }
+            ::shutdown(fd, SHUT_WR);
+        });
+        threads.emplace_back([fd, chunk, &echoed] {
+            std::vector<char> buf(chunk);
+            ssize_t n;
+            while ((n = ::read(fd, buf.data(), buf.size())) > 0) {
+                echoed += n;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = dws::timeDifference(Timestamp::now(), start);
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    return static_cast<double>(echoed.load()) / elapsed;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 1;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    std::size_t chunk = static_cast<std::size_t>(argc > 3 ? atoi(argv[3]) : 64) * 1024;
+    double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 29386);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    EventLoop loop;
+    InetAddress backendAddr(static_cast<uint16_t>(port + 2), true);
+    TcpServer backend(&loop, backendAddr, "EchoBackend");
+    backend.setThreadNum(ioThreads);
+    backend.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setHalfCloseCallback([](const TcpConnectionPtr& c) { c->shutdown(); });
+        }
+    });
+    backend.setMessageCallback(
+            [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+    backend.start();
+
+    BackendPool::Options options;
+    options.healthCheckIntervalSeconds = 0;
+    BackendPool pool(&loop, {backendAddr}, options);
+    InetAddress spliceAddr(port, true);
+    InetAddress copyAddr(static_cast<uint16_t>(port + 1), true);
+    TcpProxy spliceProxy(&loop, spliceAddr, "SpliceProxy", &pool);
+    TcpProxy copyProxy(&loop, copyAddr, "CopyProxy", &pool);
+    spliceProxy.setThreadNum(ioThreads);
+    copyProxy.setThreadNum(ioThreads);
+    copyProxy.setSplice(false);
+    spliceProxy.start();
+    copyProxy.start();
+
+    printf("io threads %d, %d connections, %zu KiB chunks\n", ioThreads, connections,
+           chunk / 1024);
+    double spliced = 0;
+    double copied = 0;
+    std::thread driver([&] {
+        spliced = run(spliceAddr, connections, chunk, seconds);
+        copied = run(copyAddr, connections, chunk, seconds);
+        loop.quit();
+    });
+    loop.loop();
+    driver.join();
+    printf("splice %8.1f MiB/s echoed, %llu spliced directions\n", spliced / (1024 * 1024),
+           static_cast<unsigned long long>(spliceProxy.splicedDirections()));
+    printf("copy   %8.1f MiB/s echoed, %llu copied directions\n", copied / (1024 * 1024),
+           static_cast<unsigned long long>(copyProxy.copiedDirections()));
+}
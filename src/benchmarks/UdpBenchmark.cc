@@ -0,0 +1,128 @@
+// UDP echo throughput with UdpSocket batching against one datagram per
+// system call.
+//
+// usage: udp_benchmark [ioThreads] [window] [seconds] [size] [port]
+//
+// A UdpServer echoes every datagram; a client loop in another thread
+// keeps @c window datagrams of @c size bytes in flight and sends another
+// for every reply.  Three runs: batchSize 1 (what recvfrom/sendto per
+// datagram costs), batchSize 64 with recvmmsg/sendmmsg, and batchSize 64
+// with GSO and GRO on top.  Prints echoed packets/s and system calls per
+// packet on the server.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "UdpServer.h"
+#include "UdpSocket.h"
+
+using dws::Timestamp;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::UdpServer;
+using dws::net::UdpSocket;
+using dws::net::UdpSocketPtr;
+
+namespace {
+
+struct Result {
+    int64_t packets = 0;
+    double elapsed = 0;
+    UdpSocket::Stats server;
+};
+
+int64_t runClient(const InetAddress& server, const UdpSocket::Options& options, int window,
+                  std::size_t size, double seconds, double* elapsed) {
+    EventLoop loop;
+    auto client = std::make_shared<UdpSocket>(&loop, InetAddress(0, true), options);
+    const std::string payload(size, 'x');
+    int64_t replies = 0;
+    int64_t lastReplies = 0;
+    Timestamp start(Timestamp::now());
+    client->setMessageCallback([&](const UdpSocketPtr& socket, const char*, std::size_t,
+                                   const InetAddress&, Timestamp) {
+        ++replies;
+        socket->send(server, payload.data(), payload.size());
+    });
+    client->start();
+    auto prime = [&] {
+        for (int i = 0; i < window; ++i) {
+            client->send(server, payload.data(), payload.size());
+        }
+    };
+    prime();
+    // lost datagrams shrink the window, refill it when replies stall
+    loop.runEvery(0.01, [&] {
+        if (replies == lastReplies) {
+            prime();
+        }
+        lastReplies = replies;
+    });
+    loop.runAfter(seconds, [&] {
+        *elapsed = dws::timeDifference(Timestamp::now(), start);
+        loop.quit();
+    });
+    loop.loop();
+    return replies;
+}
+
+Result run(EventLoop* loop, uint16_t port, int ioThreads, const UdpSocket::Options& options,
+           int window, std::size_t size, double seconds) {
+    InetAddress addr(port, true);
+    Result result;
+    auto server = std::make_unique<UdpServer>(loop, addr, "UdpBenchmark", options);
+    server->setThreadNum(ioThreads);
+    server->setMessageCallback([](const UdpSocketPtr& socket, const char* data, std::size_t len,
+                                  const InetAddress& peer, Timestamp) {
+        socket->send(peer, data, len);
+    });
+    server->start();
+    std::thread driver([&] {
+        result.packets = runClient(addr, options, window, size, seconds, &result.elapsed);
+        loop->queueInLoop([loop] { loop->quit(); });
+    });
+    loop->loop();
+    driver.join();
+    result.server = server->stats();
+    server.reset();
+    return result;
+}
+
+void print(const char* mode, const Result& r) {
+    double packets = static_cast<double>(r.server.packetsReceived);
+    printf("%-22s %10.0f echoes/s  server: %.3f recv calls/packet, %.3f send calls/packet\n",
+           mode, static_cast<double>(r.packets) / r.elapsed,
+           static_cast<double>(r.server.receiveCalls) / packets,
+           static_cast<double>(r.server.sendCalls) / packets);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 1;
+    int window = argc > 2 ? atoi(argv[2]) : 256;
+    double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    std::size_t size = static_cast<std::size_t>(argc > 4 ? atoi(argv[4]) : 64);
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 29391);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    printf("io threads %d, window %d, %zu byte datagrams\n", ioThreads, window, size);
+    EventLoop loop;
+    UdpSocket::Options single;
+    single.batchSize = 1;
+    print("one per syscall", run(&loop, port, ioThreads, single, window, size, seconds));
+    UdpSocket::Options batched;
+    print("recvmmsg/sendmmsg",
+          run(&loop, static_cast<uint16_t>(port + 1), ioThreads, batched, window, size, seconds));
+    UdpSocket::Options segmented;
+    segmented.gso = true;
+    segmented.gro = true;
+    print("mmsg + GSO/GRO", run(&loop, static_cast<uint16_t>(port + 2), ioThreads, segmented,
+                                 window, size, seconds));
+}
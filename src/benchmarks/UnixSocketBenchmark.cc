@@ -0,0 +1,93 @@
+// Ping-pong latency over TCP loopback against a Unix domain socket.
+//
+// usage: unix_socket_benchmark [roundTrips] [size] [port]
+//
+// One connection, one message of @c size bytes in flight: the client sends
+// it, the server echoes it and the client sends it again once it is back.
+// Server and client share one loop, so a round trip is two sends and two
+// reads through the kernel.  Prints round trips/s and microseconds each.
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpClient;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+double run(const InetAddress& addr, int roundTrips, std::size_t size) {
+    EventLoop loop;
+    TcpServer server(&loop, addr, "PingPongServer");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback(
+            [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+    server.start();
+
+    const std::string message(size, 'p');
+    int done = 0;
+    Timestamp start;
+    double elapsed = 0;
+    TcpClient client(&loop, addr, "PingPongClient");
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setTcpNoDelay(true);
+            start = Timestamp::now();
+            conn->send(dws::StringPiece(message));
+        } else {
+            loop.quit();
+        }
+    });
+    client.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        if (buf->readableBytes() < size) {
+            return;
+        }
+        buf->retrieve(size);
+        if (++done < roundTrips) {
+            conn->send(dws::StringPiece(message));
+        } else {
+            elapsed = dws::timeDifference(Timestamp::now(), start);
+            conn->shutdown();
+        }
+    });
+    client.connect();
+    loop.loop();
+    return elapsed;
+}
+
+void print(const char* mode, int roundTrips, double elapsed) {
+    printf("%-14s %9.0f round trips/s %7.2f us each\n", mode, roundTrips / elapsed,
+           elapsed * 1e6 / roundTrips);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int roundTrips = argc > 1 ? atoi(argv[1]) : 100000;
+    std::size_t size = static_cast<std::size_t>(argc > 2 ? atoi(argv[2]) : 64);
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 29394);
+    dws::Logger::setLogLevel(dws::Logger::ERROR);
+
+    printf("%d round trips of %zu bytes\n", roundTrips, size);
+    print("TCP loopback", roundTrips, run(InetAddress(port, true), roundTrips, size));
+    std::string path = "/tmp/dws_unix_bench_" + std::to_string(::getpid()) + ".sock";
+    print("AF_UNIX", roundTrips, run(InetAddress::fromUnixPath(path), roundTrips, size));
+}
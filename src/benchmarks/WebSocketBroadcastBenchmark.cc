@@ -0,0 +1,119 @@
+// Fan-out throughput of WebSocketServer::broadcast() over loopback.
+//
+// usage: web_socket_broadcast_benchmark [ioThreads] [sessions] [messages] [messageBytes] [port]
+//
+// Opens the sessions from four client threads, broadcasts the messages
+// back to back and reports how fast the frames reach every session.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logging.h"
+#include "WebSocketServer.h"
+
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::WebSocketServer;
+
+namespace {
+
+const int kClientThreads = 4;
+
+const char kHandshake[] =
+        "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+bool readBytes(int fd, std::size_t n) {
+    char buf[16 * 1024];
+    while (n > 0) {
+        ssize_t r = ::read(fd, buf, n < sizeof buf ? n : sizeof buf);
+        if (r <= 0) {
+            return false;
+        }
+        n -= r;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+    int sessions = argc > 2 ? atoi(argv[2]) : 1000;
+    int messages = argc > 3 ? atoi(argv[3]) : 1000;
+    int messageBytes = argc > 4 ? atoi(argv[4]) : 64;
+    uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 29381);
+    dws::Logger::setLogLevel(dws::Logger::WARN);
+
+    EventLoop loop;
+    InetAddress listenAddr(port, true);
+    WebSocketServer server(&loop, listenAddr, "WebSocketBroadcastBenchmark");
+    server.setThreadNum(ioThreads);
+    server.start();
+
+    const std::string message(messageBytes, 'm');
+    const std::size_t frameBytes =
+            dws::net::websocket::encodeFrame(dws::net::websocket::kText, dws::StringPiece(message))
+                    .size();
+    const std::size_t responseBytes = 129;  // the 101 response to kHandshake
+    std::atomic<int> opened(0);
+    std::atomic<int> finished(0);
+    dws::Timestamp start;
+    auto broadcastAll = [&] {
+        start = dws::Timestamp::now();
+        for (int i = 0; i < messages; ++i) {
+            server.broadcast(dws::StringPiece(message));
+        }
+    };
+
+    std::vector<std::thread> clients;
+    for (int t = 0; t < kClientThreads; ++t) {
+        clients.emplace_back([&, t] {
+            std::vector<int> fds;
+            for (int i = t; i < sessions; i += kClientThreads) {
+                int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0 ||
+                    ::write(fd, kHandshake, sizeof kHandshake - 1) < 0 ||
+                    !readBytes(fd, responseBytes)) {
+                    perror("handshake");
+                    exit(1);
+                }
+                fds.push_back(fd);
+            }
+            if (++opened == kClientThreads) {
+                // sessions register in their IO loops, give the last ones a moment
+                loop.runAfter(0.2, broadcastAll);
+            }
+            // every session receives all frames, read them socket by socket
+            for (int fd : fds) {
+                readBytes(fd, frameBytes * messages);
+                ::close(fd);
+            }
+            if (++finished == kClientThreads) {
+                loop.quit();
+            }
+        });
+    }
+
+    loop.loop();
+    double elapsed = dws::timeDifference(dws::Timestamp::now(), start);
+    for (std::thread& t : clients) {
+        t.join();
+    }
+
+    double frames = static_cast<double>(sessions) * messages;
+    printf("io threads %d, sessions %d, %d messages of %d bytes: %.0f frames in %.3fs, "
+           "%.0f frames/s, %.1f MiB/s\n",
+           ioThreads, sessions, messages, messageBytes, frames, elapsed, frames / elapsed,
+           frames * frameBytes / elapsed / 1024 / 1024);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+/// LRU cache of open regular files below a document root, so that serving
+/// a hot file costs neither open(2) nor stat(2).
+///
+/// An entry older than Options::revalidateSeconds is checked with one
+/// stat(2) of its path and reopened if the file was replaced or modified.
+/// Files up to Options::maxInMemoryFileBytes are read into memory instead
+/// of being kept open, as long as all of them fit Options::maxMemoryBytes.
+/// A File stays valid, with its descriptor open, while anyone holds it;
+/// eviction only drops the cache's reference.  Thread safe.
+class FileCache : noncopyable {
+ public:
+    struct Options {
+        std::size_t maxFiles = 1024;
+        std::size_t maxInMemoryFileBytes = 64 * 1024;
+        std::size_t maxMemoryBytes = 64 * 1024 * 1024;
+        /// 0 stats the path on every lookup, still saving the open(2).
+        double revalidateSeconds = 1.0;
+    };
+
+    struct File : noncopyable {
+        File() = default;
+        ~File();
+
+        int fd = -1;  // -1 when inMemory
+        int64_t size = 0;
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        int64_t mtimeNs = 0;
+        bool inMemory = false;
+        std::string contents;      // the whole file when inMemory
+        std::string etag;          // strong, quoted
+        std::string lastModified;  // IMF-fixdate
+    };
+    using FilePtr = std::shared_ptr<const File>;
+
+    explicit FileCache(const std::string& root);
+    FileCache(const std::string& root, const Options& options);
+
+    /// @c path starts with '/' and is taken below the root as it is, the
+    /// caller keeps it from escaping.  nullptr with *savedErrno set if the
+    /// file cannot be opened, EISDIR for directories and EACCES for other
+    /// non-regular files.
+    FilePtr open(const std::string& path, int* savedErrno);
+
+    const std::string& root() const { return root_; }
+    std::size_t size() const;
+    std::size_t memoryBytes() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+    /// "Sun, 06 Nov 1994 08:49:37 GMT".
+    static std::string formatHttpDate(int64_t secondsSinceEpoch);
+    /// -1 unless @c date is an IMF-fixdate.
+    static int64_t parseHttpDate(const std::string& date);
+
+ private:
+    struct Entry {
+        std::string path;
+        FilePtr file;
+        Timestamp validated;
+    };
+    using EntryList = std::list<Entry>;
+
+    FilePtr load(const std::string& path, int* savedErrno) const;
+    void insertLocked(const std::string& path, const FilePtr& file, Timestamp now);
+    void eraseLocked(EntryList::iterator it);
+
+    const std::string root_;
+    const Options options_;
+    mutable std::mutex mutex_;
+    EntryList lru_;  // most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    std::size_t memoryBytes_;
+    uint64_t hits_;
+    uint64_t misses_;
+};
+
+}  // namespace dws::net
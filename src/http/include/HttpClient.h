@@ -0,0 +1,136 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "HttpClientResponse.h"
+#include "HttpRequest.h"
+#include "HttpResponseParser.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "TcpConnection.h"
+
+namespace dws::net {
+
+class Connector;
+
+/// Asynchronous HTTP/1.1 client for one EventLoop, pooling keep-alive
+/// connections per server address.
+///
+/// Unlike TcpClient, which owns exactly one connection, every server gets a
+/// pool of up to Options::maxConnectionsPerHost connections opened on
+/// demand and reused across requests.  A request goes to an idle connection
+/// if there is one, otherwise to a new connection while the pool is below
+/// its size, otherwise it is pipelined behind requests in flight when
+/// Options::maxPipelineDepth allows, the request is idempotent and the
+/// server answered on that connection with HTTP/1.1.  The rest wait in
+/// order for a connection to become free.  Connect and request deadlines
+/// run on the loop's TimerQueue, idle connections are closed after
+/// Options::idleTimeoutSeconds.  An idempotent request that finds its
+/// reused connection closed by the server before any answer is sent again
+/// once, as RFC 7230 section 6.3.1 allows.
+///
+/// Use one client per loop.  Destroy the client in its loop thread or
+/// before the loop; requests outstanding then are dropped without their
+/// callbacks, and the client must not be destroyed from a callback.
+class HttpClient : noncopyable {
+ public:
+    enum Error {
+        kOk,
+        kConnectFailed,      // including the connect timeout
+        kTimeout,            // no complete response within the request timeout
+        kConnectionClosed,   // closed before the response was complete
+        kBadResponse,        // not parseable, or larger than maxResponseBodyBytes
+        kOverloaded,         // maxInFlight requests outstanding already
+    };
+
+    /// Runs in the client's loop.  @c response is empty unless the error is
+    /// kOk and only valid during the call, any 1xx responses are skipped.
+    using Callback = std::function<void(Error error, const HttpClientResponse& response)>;
+
+    struct Options {
+        double connectTimeoutSeconds = 3.0;
+        double requestTimeoutSeconds = 10.0;
+        double idleTimeoutSeconds = 60.0;
+        std::size_t maxConnectionsPerHost = 8;
+        /// Requests sent on one connection before their responses, 1 turns
+        /// pipelining off.
+        std::size_t maxPipelineDepth = 1;
+        /// Requests sent or waiting for a connection over all servers,
+        /// further ones fail with kOverloaded right away.
+        std::size_t maxInFlight = 1024;
+        std::size_t maxResponseBodyBytes = HttpResponseParser::kDefaultMaxBodyBytes;
+    };
+
+    struct Request {
+        HttpRequest::Method method = HttpRequest::kGet;
+        std::string target = "/";
+        /// Host header, the server's "ip:port" if empty.
+        std::string host;
+        /// Sent as given, Host and Content-Length are added by the client.
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        /// Options::requestTimeoutSeconds if not positive.
+        double timeoutSeconds = 0.0;
+    };
+
+    HttpClient(EventLoop* loop, const std::string& name);
+    HttpClient(EventLoop* loop, const std::string& name, const Options& options);
+    ~HttpClient();
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    const Options& options() const { return options_; }
+
+    /// Thread safe.
+    void send(const InetAddress& server, Request request, Callback cb);
+    void get(const InetAddress& server, const std::string& target, Callback cb);
+
+    /// Requests sent or waiting, loop thread only.
+    std::size_t numInFlight() const { return inFlight_; }
+    /// Connections open or being opened to all servers, loop thread only.
+    std::size_t numConnections() const;
+    /// Connections opened since the start, loop thread only.
+    uint64_t numConnects() const { return connects_; }
+
+ private:
+    struct Call;
+    struct Connection;
+    struct Pool;
+    using CallPtr = std::shared_ptr<Call>;
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    void sendInLoop(const InetAddress& server, Request request, Callback cb);
+    Pool* poolOf(const InetAddress& server);
+    /// Hands waiting requests to connections, opening new ones as needed.
+    void pump(Pool* pool);
+    Connection* pickConnection(Pool* pool, const Call& call);
+    void openConnection(Pool* pool);
+    void writeRequest(Connection* conn, const CallPtr& call);
+    void onConnected(const ConnectionPtr& conn, int sockfd);
+    void onConnectFailed(const ConnectionPtr& conn, int savedErrno);
+    void onMessage(const ConnectionPtr& conn, Buffer* buf);
+    void onClose(const ConnectionPtr& conn);
+    void onRequestTimeout(const CallPtr& call);
+    void closeIdleConnections();
+    void removeConnection(Pool* pool, const ConnectionPtr& conn);
+    void failWaiting(Pool* pool, Error error);
+    void complete(const CallPtr& call, Error error, const HttpClientResponse& response);
+    void stopConnector(const ConnectionPtr& conn);
+
+    EventLoop* loop_;
+    const std::string name_;
+    const Options options_;
+    std::size_t inFlight_;
+    uint64_t connects_;
+    int nextConnId_;
+    TimerId idleTimer_;
+    std::unordered_map<std::string, std::unique_ptr<Pool>> pools_;
+};
+
+}  // namespace dws::net
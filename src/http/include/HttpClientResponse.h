@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "HttpRequest.h"
+#include "StringPiece.h"
+#include "copyable.h"
+
+namespace dws::net {
+
+class HttpResponseParser;
+
+/// A parsed response as HttpClient hands it out.  Like HttpRequest, reason,
+/// headers and body are views into the connection's input Buffer and stay
+/// valid only for the duration of the callback.  Copy what must outlive it.
+class HttpClientResponse : public copyable {
+ public:
+    using Header = HttpRequest::Header;
+
+    HttpClientResponse() = default;
+
+    /// 0 if there is no response, e.g. the request failed.
+    int statusCode() const { return statusCode_; }
+    StringPiece reason() const { return view(reason_); }
+    HttpRequest::Version version() const { return version_; }
+    StringPiece body() const {
+        return chunked_ ? StringPiece(decodedBody_) : view(body_);
+    }
+    bool chunked() const { return chunked_; }
+
+    std::size_t numHeaders() const { return headers_.size(); }
+    Header header(std::size_t i) const {
+        return Header{view(headers_[i].field), view(headers_[i].value)};
+    }
+    /// Case-insensitive lookup of the first header named @c field, empty if
+    /// there is none.
+    StringPiece getHeader(const StringPiece& field) const;
+    /// Whether the server keeps the connection open after this response.
+    bool keepAlive() const;
+
+ private:
+    friend class HttpResponseParser;
+
+    // offsets from the start of the message, see HttpRequest
+    struct Span {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+    struct HeaderSpan {
+        Span field;
+        Span value;
+    };
+
+    StringPiece view(Span s) const { return StringPiece(base_ + s.offset, s.length); }
+    void clear();
+
+    const char* base_ = nullptr;
+    int statusCode_ = 0;
+    HttpRequest::Version version_ = HttpRequest::kUnknown;
+    bool chunked_ = false;
+    bool closeDelimited_ = false;
+    Span reason_;
+    Span body_;
+    std::vector<HeaderSpan> headers_;
+    std::string decodedBody_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "HttpRequest.h"
+#include "copyable.h"
+
+namespace dws::net {
+
+class Buffer;
+
+/// Incremental HTTP/1.x request parser working in place on an input Buffer.
+///
+/// parse() resumes where the previous call stopped, so bytes are scanned
+/// once however the request is split across reads.  Nothing is copied out of
+/// the buffer except chunked bodies: once a request is complete, request()
+/// refers to the first messageBytes() bytes of the buffer.  The caller
+/// handles it, retrieves those bytes and calls reset() before parsing the
+/// next, possibly already buffered, pipelined request.
+class HttpParser : public copyable {
+ public:
+    enum Result { kNeedMore, kComplete, kError };
+
+    static const std::size_t kMaxHeaderBytes = 64 * 1024;
+    static const std::size_t kMaxHeaders = 100;
+    static const std::size_t kDefaultMaxBodyBytes = 8 * 1024 * 1024;
+
+    explicit HttpParser(std::size_t maxBodyBytes = kDefaultMaxBodyBytes);
+
+    /// The request must start at buf.peek(), and the bytes seen by earlier
+    /// calls must still be there unchanged.
+    Result parse(const Buffer& buf);
+    const HttpRequest& request() const { return request_; }
+    HttpRequest& request() { return request_; }
+    /// Size of the completed request at the front of the buffer.
+    std::size_t messageBytes() const { return pos_; }
+    /// Status code to answer with after kError: 400, 413, 431, 501 or 505.
+    int errorStatus() const { return errorStatus_; }
+    void reset();
+
+ private:
+    enum State { kRequestLine, kHeaders, kBody, kChunkSize, kChunkData, kChunkTrailer, kDone, kFailed };
+
+    Result fail(int status) {
+        state_ = kFailed;
+        errorStatus_ = status;
+        return kError;
+    }
+    bool parseRequestLine(const char* begin, const char* end);
+    bool parseHeader(const char* begin, const char* end);
+    Result headersComplete();
+
+    std::size_t maxBodyBytes_;
+    State state_;
+    std::size_t pos_;  // bytes consumed from the start of the message
+    std::size_t chunkRemaining_;
+    int errorStatus_;
+    HttpRequest request_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "StringPiece.h"
+#include "Timestamp.h"
+#include "copyable.h"
+
+namespace dws::net {
+
+class HttpParser;
+
+/// A parsed request.  Method, target and headers are views into the
+/// connection's input Buffer and stay valid only until the buffer is
+/// modified, i.e. for the duration of the HttpServer callback.  Copy what
+/// must outlive it.
+class HttpRequest : public copyable {
+ public:
+    enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete, kOptions, kPatch };
+    enum Version { kUnknown, kHttp10, kHttp11 };
+
+    struct Header {
+        StringPiece field;
+        StringPiece value;
+    };
+
+    HttpRequest() = default;
+
+    Method method() const { return method_; }
+    const char* methodString() const { return methodName(method_); }
+    Version version() const { return version_; }
+    /// Request target without the query, e.g. "/index.html".
+    StringPiece path() const { return view(path_); }
+    /// Everything after '?', without it.
+    StringPiece query() const { return view(query_); }
+    StringPiece body() const {
+        return chunked_ ? StringPiece(decodedBody_) : view(body_);
+    }
+    bool chunked() const { return chunked_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+    void setReceiveTime(Timestamp t) { receiveTime_ = t; }
+
+    std::size_t numHeaders() const { return headers_.size(); }
+    Header header(std::size_t i) const {
+        return Header{view(headers_[i].field), view(headers_[i].value)};
+    }
+    /// Case-insensitive lookup of the first header named @c field, empty if
+    /// there is none.
+    StringPiece getHeader(const StringPiece& field) const;
+    /// HTTP/1.1 defaults to persistent connections, HTTP/1.0 needs
+    /// "Connection: keep-alive".
+    bool keepAlive() const;
+
+    /// "GET" etc., "UNKNOWN" for kInvalid.
+    static const char* methodName(Method method);
+    /// ASCII case-insensitive comparison, as header names and some values
+    /// require.
+    static bool equalsIgnoreCase(const StringPiece& a, const StringPiece& b);
+    /// Whether the comma separated @c list, e.g. a Connection header,
+    /// contains @c token, ignoring case and surrounding whitespace.
+    static bool containsToken(const StringPiece& list, const StringPiece& token);
+
+ private:
+    friend class HttpParser;
+
+    // Offsets from the start of the message, so that they survive the
+    // buffer being reallocated while the request is still incomplete.
+    struct Span {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+    struct HeaderSpan {
+        Span field;
+        Span value;
+    };
+
+    StringPiece view(Span s) const { return StringPiece(base_ + s.offset, s.length); }
+    void clear();
+
+    const char* base_ = nullptr;
+    Method method_ = kInvalid;
+    Version version_ = kUnknown;
+    bool chunked_ = false;
+    Span path_;
+    Span query_;
+    Span body_;
+    std::vector<HeaderSpan> headers_;
+    std::string decodedBody_;  // chunked bodies are not contiguous in the buffer
+    Timestamp receiveTime_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "StringPiece.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+class Buffer;
+class HttpRequest;
+
+/// Serializes a response straight into an output Buffer, no intermediate
+/// header map.  Calls must follow the wire order: status first, then
+/// headers, then either setBody() or beginChunked() / appendChunk() /
+/// endChunked().  A response left unfinished by the handler is completed by
+/// finish() with an empty body.
+class HttpResponse : noncopyable {
+ public:
+    enum HttpStatusCode {
+        k200Ok = 200,
+        k204NoContent = 204,
+        k206PartialContent = 206,
+        k301MovedPermanently = 301,
+        k304NotModified = 304,
+        k400BadRequest = 400,
+        k403Forbidden = 403,
+        k404NotFound = 404,
+        k405MethodNotAllowed = 405,
+        k413PayloadTooLarge = 413,
+        k416RangeNotSatisfiable = 416,
+        k500InternalServerError = 500,
+    };
+
+    /// A body that follows the header from a file descriptor.
+    struct FileBody {
+        int fd = -1;
+        int64_t offset = 0;
+        std::size_t length = 0;
+        std::shared_ptr<const void> owner;  // keeps fd open
+    };
+
+    HttpResponse(Buffer* output, bool closeConnection);
+    /// Answers @c request: keeps its connection persistence, omits the body
+    /// of HEAD responses while keeping their Content-Length, and sends
+    /// chunked bodies of HTTP/1.0 responses unframed up to the close.
+    HttpResponse(Buffer* output, const HttpRequest& request);
+
+    /// Must come first, the status line is written right away.  Without it
+    /// the response is "200 OK".
+    void setStatusCode(int code);
+    void setStatusCode(int code, const StringPiece& reason);
+    int statusCode() const { return statusCode_; }
+    /// Only before the body starts.
+    void setCloseConnection(bool on);
+    bool closeConnection() const { return closeConnection_; }
+    void setContentType(const StringPiece& contentType);
+    void addHeader(const StringPiece& field, const StringPiece& value);
+
+    /// Writes Content-Length and @c body, completing the response.
+    void setBody(const StringPiece& body);
+    /// Writes Content-Length for @c length bytes of @c fd from @c offset,
+    /// completing the response.  The bytes are not copied to the Buffer:
+    /// whoever sends the output, e.g. HttpServer with sendfile(2), takes
+    /// them from fileBody() after it.  Nothing is left there for HEAD and
+    /// bodyless statuses.
+    void setFileBody(int fd, int64_t offset, std::size_t length,
+                     std::shared_ptr<const void> owner);
+    FileBody* fileBody() { return &fileBody_; }
+    /// Switches to chunked transfer encoding for bodies produced piecewise.
+    void beginChunked();
+    void appendChunk(const StringPiece& data);
+    void endChunked();
+
+    bool finished() const { return state_ == kFinished; }
+    void finish();
+
+    static const char* reasonPhrase(int code);
+
+ private:
+    enum State { kStatus, kHeaders, kChunkedBody, kFinished };
+
+    void writeStatusLine();  // the default "200 OK" unless a status was set
+    void writeStatusLine(const StringPiece& reason);
+    void writeConnectionHeader();
+    /// Ends the header with the Content-Length of a body of @c length bytes,
+    /// false if the body must not be sent.
+    bool writeLengthHeaders(std::size_t length);
+
+    Buffer* output_;
+    State state_;
+    int statusCode_;
+    bool closeConnection_;
+    bool keepAliveHeader_;
+    bool headOnly_;
+    bool http10_;
+    FileBody fileBody_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+
+#include "HttpClientResponse.h"
+#include "copyable.h"
+
+namespace dws::net {
+
+class Buffer;
+
+/// Incremental HTTP/1.x response parser, the client side counterpart of
+/// HttpParser with the same in-place contract: once a response is
+/// complete, response() refers to the first messageBytes() bytes of the
+/// buffer until the caller retrieves them and calls reset().
+///
+/// Bodies are framed as RFC 7230 section 3.3.3 says: none for 1xx, 204,
+/// 304 and responses to HEAD, then chunked, then Content-Length, otherwise
+/// the body runs until the server closes the connection and is completed by
+/// parseAtClose().
+class HttpResponseParser : public copyable {
+ public:
+    enum Result { kNeedMore, kComplete, kError };
+
+    static const std::size_t kMaxHeaderBytes = 64 * 1024;
+    static const std::size_t kMaxHeaders = 100;
+    static const std::size_t kDefaultMaxBodyBytes = 64 * 1024 * 1024;
+
+    explicit HttpResponseParser(std::size_t maxBodyBytes = kDefaultMaxBodyBytes);
+
+    /// The response must start at buf.peek(), and the bytes seen by earlier
+    /// calls must still be there unchanged.  @c headRequest tells that it
+    /// answers a HEAD request and has no body whatever its headers say.
+    Result parse(const Buffer& buf, bool headRequest);
+    /// The server closed the connection with @c buf holding the rest of its
+    /// output: completes a close-delimited body, anything else unfinished is
+    /// an error.
+    Result parseAtClose(const Buffer& buf);
+    const HttpClientResponse& response() const { return response_; }
+    /// Size of the completed response at the front of the buffer.
+    std::size_t messageBytes() const { return pos_; }
+    /// Whether parse() has consumed any byte of the current response.
+    bool started() const { return pos_ > 0; }
+    void reset();
+
+ private:
+    enum State {
+        kStatusLine,
+        kHeaders,
+        kBody,
+        kBodyUntilClose,
+        kChunkSize,
+        kChunkData,
+        kChunkTrailer,
+        kDone,
+        kFailed
+    };
+
+    Result fail() {
+        state_ = kFailed;
+        return kError;
+    }
+    bool parseStatusLine(const char* begin, const char* end);
+    bool parseHeader(const char* begin, const char* end);
+    Result headersComplete(bool headRequest);
+
+    std::size_t maxBodyBytes_;
+    State state_;
+    std::size_t pos_;  // bytes consumed from the start of the message
+    std::size_t chunkRemaining_;
+    HttpClientResponse response_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "HttpParser.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "TcpServer.h"
+
+namespace dws::net {
+
+/// HTTP/1.1 server on top of TcpServer.
+///
+/// Requests are parsed in place in the connection's input Buffer and the
+/// callback serializes its response straight into the output Buffer.  All
+/// pipelined requests found in one read are answered in order and flushed
+/// with a single write.  The callback runs in the connection's IO loop and
+/// must complete the response before returning.
+class HttpServer : noncopyable {
+ public:
+    using HttpCallback = std::function<void(const HttpRequest&, HttpResponse*)>;
+
+    /// Pipelined requests are not parsed while more than this many response
+    /// bytes wait to be written, so a client that never reads cannot make
+    /// the output buffer grow without bound.
+    static const std::size_t kMaxPendingOutput = 1024 * 1024;
+
+    HttpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+    TcpServer* tcpServer() { return &server_; }
+    /// Not thread safe, callback registered before start().
+    void setHttpCallback(const HttpCallback& cb) { httpCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setMaxBodyBytes(std::size_t maxBodyBytes) { maxBodyBytes_ = maxBodyBytes; }
+    void start();
+
+ private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void onWriteComplete(const TcpConnectionPtr& conn);
+
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    std::size_t maxBodyBytes_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+#include "FileCache.h"
+#include "StringPiece.h"
+
+namespace dws::net {
+
+class HttpRequest;
+class HttpResponse;
+
+/// Serves the files below a document root from a FileCache, e.g. as or
+/// from an HttpServer::HttpCallback.
+///
+/// GET and HEAD only.  The path is percent-decoded and may not contain
+/// ".." segments; a path ending in '/' serves its index.html and a
+/// directory without the '/' is redirected to it.  Responses carry ETag and
+/// Last-Modified and honour If-None-Match and If-Modified-Since with 304,
+/// and a single byte Range (with If-Range) with 206 or 416; multiple ranges
+/// get the whole file.  Files kept in memory are copied into the output
+/// Buffer, others go out with sendfile(2) through HttpServer.
+class StaticFileHandler : noncopyable {
+ public:
+    explicit StaticFileHandler(const std::string& root,
+                               const FileCache::Options& options = FileCache::Options());
+
+    /// Completes @c resp, with an error status if there is no such file.
+    void handle(const HttpRequest& req, HttpResponse* resp);
+
+    FileCache* cache() { return &cache_; }
+
+    /// By file extension, "application/octet-stream" if unknown.
+    static const char* contentType(const StringPiece& path);
+    /// Decodes %XX escapes of @c path into @c out, false on malformed
+    /// escapes, NUL bytes and ".." segments.
+    static bool decodePath(const StringPiece& path, std::string* out);
+
+ private:
+    FileCache cache_;
+};
+
+}  // namespace dws::net
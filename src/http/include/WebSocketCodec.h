@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "StringPiece.h"
+
+namespace dws::net {
+
+class Buffer;
+
+/// RFC 6455 framing primitives.
+namespace websocket {
+
+enum Opcode {
+    kContinuation = 0x0,
+    kText = 0x1,
+    kBinary = 0x2,
+    kClose = 0x8,
+    kPing = 0x9,
+    kPong = 0xA,
+};
+
+enum CloseCode {
+    kNormalClosure = 1000,
+    kGoingAway = 1001,
+    kProtocolError = 1002,
+    kMessageTooBig = 1009,
+};
+
+/// The largest frame header: 2 bytes, 8 bytes of extended length, 4 of mask.
+const std::size_t kMaxHeaderBytes = 14;
+
+struct FrameHeader {
+    bool fin = false;
+    Opcode opcode = kContinuation;
+    bool masked = false;
+    uint64_t payloadLength = 0;
+    char maskKey[4] = {0, 0, 0, 0};
+    std::size_t headerBytes = 0;
+};
+
+enum ParseResult { kNeedMore, kOk, kBadFrame };
+
+/// Decodes the frame header at @c data, kBadFrame on reserved bits or
+/// opcodes and on malformed control frames.
+ParseResult parseFrameHeader(const char* data, std::size_t len, FrameHeader* header);
+
+/// XORs @c len bytes with the repeating 4-byte @c key, 32 or 16 bytes per
+/// instruction where AVX2 or SSE2 is available.
+void unmask(char* data, std::size_t len, const char key[4]);
+
+/// Writes an unmasked (server to client) frame header into @c out, which
+/// has room for kMaxHeaderBytes, and returns its size.
+std::size_t encodeFrameHeader(char* out, Opcode opcode, std::size_t payloadLength,
+                              bool fin = true);
+void appendFrame(Buffer* out, Opcode opcode, const StringPiece& payload, bool fin = true);
+std::string encodeFrame(Opcode opcode, const StringPiece& payload, bool fin = true);
+
+/// Sec-WebSocket-Accept for the client's Sec-WebSocket-Key.
+std::string acceptKey(const StringPiece& clientKey);
+
+}  // namespace websocket
+
+}  // namespace dws::net
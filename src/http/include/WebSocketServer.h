@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "HttpRequest.h"
+#include "TcpServer.h"
+#include "WebSocketCodec.h"
+
+namespace dws::net {
+
+/// WebSocket (RFC 6455) server on top of TcpServer.
+///
+/// The opening handshake is parsed with HttpParser.  Afterwards frames are
+/// unmasked in place in the input Buffer, so an unfragmented message is
+/// handed to the callback as a view into the buffer without a copy;
+/// fragmented messages are reassembled.  Pings are answered and the closing
+/// handshake is completed automatically.  Sessions are tracked per IO loop,
+/// so the connections must not be migrated to other loops.
+class WebSocketServer : noncopyable {
+ public:
+    /// The upgraded connection and the handshake request, e.g. for the path.
+    using OpenCallback = std::function<void(const TcpConnectionPtr&, const HttpRequest&)>;
+    using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
+    /// @c message is only valid during the call.
+    using MessageCallback = std::function<void(const TcpConnectionPtr&, const StringPiece& message,
+                                               websocket::Opcode opcode)>;
+
+    static const std::size_t kDefaultMaxMessageBytes = 1024 * 1024;
+
+    WebSocketServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+                    TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+    TcpServer* tcpServer() { return &server_; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setOpenCallback(const OpenCallback& cb) { openCallback_ = cb; }
+    void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
+    void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+    void setMaxMessageBytes(std::size_t maxMessageBytes) { maxMessageBytes_ = maxMessageBytes; }
+    void start();
+
+    /// Number of upgraded connections, thread safe.
+    std::size_t numSessions() const { return numSessions_.load(std::memory_order_relaxed); }
+
+    /// Sends one unfragmented message, thread safe.
+    static void send(const TcpConnectionPtr& conn, const StringPiece& message,
+                     websocket::Opcode opcode = websocket::kText);
+    /// Starts the closing handshake, thread safe.
+    static void close(const TcpConnectionPtr& conn, uint16_t code = websocket::kNormalClosure,
+                      const StringPiece& reason = StringPiece());
+    /// Sends @c message to every session.  The frame is encoded once and
+    /// shared by all IO loops, each of which writes it to its own sessions;
+    /// only what a socket does not accept right away is copied into that
+    /// connection's output buffer.  Thread safe.
+    void broadcast(const StringPiece& message, websocket::Opcode opcode = websocket::kText);
+
+ private:
+    struct Session;
+    // Sessions by the loop index of their connection id, each map touched by
+    // its own IO loop only.
+    using SessionMap = std::unordered_map<ConnectionId, TcpConnectionPtr>;
+
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    bool handshake(const TcpConnectionPtr& conn, Session* session, Buffer* buf);
+    void onFrames(const TcpConnectionPtr& conn, Session* session, Buffer* buf);
+    void failConnection(const TcpConnectionPtr& conn, Session* session, uint16_t code);
+    void broadcastInLoop(std::size_t loopIndex, const std::shared_ptr<const std::string>& frame);
+
+    TcpServer server_;
+    OpenCallback openCallback_;
+    CloseCallback closeCallback_;
+    MessageCallback messageCallback_;
+    std::size_t maxMessageBytes_;
+    std::vector<EventLoop*> loops_;
+    std::vector<SessionMap> sessions_;
+    std::atomic<std::size_t> numSessions_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,193 @@
+#include "FileCache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <iterator>
+
+#include "Logging.h"
+
+namespace dws::net {
+
+namespace {
+
+bool sameFile(const FileCache::File& file, const struct stat& st) {
+    return file.device == static_cast<uint64_t>(st.st_dev) &&
+           file.inode == static_cast<uint64_t>(st.st_ino) && file.size == st.st_size &&
+           file.mtimeNs == static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                                   st.st_mtim.tv_nsec;
+}
+
+bool readAll(int fd, std::string* contents, std::size_t size) {
+    contents->resize(size);
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, &(*contents)[done], size - done, static_cast<off_t>(done));
+        if (n <= 0) {
+            return false;  // an error, or the file shrank meanwhile
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+}  // namespace
+
+FileCache::File::~File() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+FileCache::FileCache(const std::string& root) : FileCache(root, Options()) {}
+
+FileCache::FileCache(const std::string& root, const Options& options)
+    : root_(!root.empty() && root.back() == '/' ? root.substr(0, root.size() - 1) : root),
+      options_(options),
+      memoryBytes_(0),
+      hits_(0),
+      misses_(0) {}
+
+FileCache::FilePtr FileCache::open(const std::string& path, int* savedErrno) {
+    Timestamp now(Timestamp::now());
+    FilePtr cached;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            if (timeDifference(now, it->second->validated) < options_.revalidateSeconds) {
+                ++hits_;
+                return it->second->file;
+            }
+            cached = it->second->file;
+        }
+    }
+    std::string fullPath = root_ + path;
+    if (cached) {
+        struct stat st;
+        if (::stat(fullPath.c_str(), &st) == 0 && sameFile(*cached, st)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(path);
+            if (it != index_.end() && it->second->file == cached) {
+                it->second->validated = now;
+            }
+            ++hits_;
+            return cached;
+        }
+    }
+    FilePtr file = load(fullPath, savedErrno);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++misses_;
+    auto it = index_.find(path);
+    if (it != index_.end()) {
+        eraseLocked(it->second);
+    }
+    if (file) {
+        insertLocked(path, file, now);
+    }
+    return file;
+}
+
+FileCache::FilePtr FileCache::load(const std::string& fullPath, int* savedErrno) const {
+    int fd = ::open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *savedErrno = errno;
+        return FilePtr();
+    }
+    auto file = std::make_shared<File>();
+    file->fd = fd;
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        *savedErrno = errno;
+        return FilePtr();
+    }
+    if (!S_ISREG(st.st_mode)) {
+        *savedErrno = S_ISDIR(st.st_mode) ? EISDIR : EACCES;
+        return FilePtr();
+    }
+    file->size = st.st_size;
+    file->device = static_cast<uint64_t>(st.st_dev);
+    file->inode = static_cast<uint64_t>(st.st_ino);
+    file->mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    char etag[48];
+    snprintf(etag, sizeof etag, "\"%llx-%llx\"", static_cast<unsigned long long>(file->size),
+             static_cast<unsigned long long>(file->mtimeNs));
+    file->etag = etag;
+    file->lastModified = formatHttpDate(st.st_mtim.tv_sec);
+    if (static_cast<std::size_t>(file->size) <= options_.maxInMemoryFileBytes) {
+        if (!readAll(fd, &file->contents, static_cast<std::size_t>(file->size))) {
+            *savedErrno = errno ? errno : EIO;
+            LOG_SYSERR << "[FileCache::load] " << fullPath;
+            return FilePtr();
+        }
+        file->inMemory = true;
+        ::close(fd);
+        file->fd = -1;
+    }
+    return file;
+}
+
+void FileCache::insertLocked(const std::string& path, const FilePtr& file, Timestamp now) {
+    lru_.push_front(Entry{path, file, now});
+    index_[path] = lru_.begin();
+    if (file->inMemory) {
+        memoryBytes_ += file->contents.size();
+    }
+    while (lru_.size() > 1 &&
+           (lru_.size() > options_.maxFiles || memoryBytes_ > options_.maxMemoryBytes)) {
+        eraseLocked(std::prev(lru_.end()));
+    }
+}
+
+void FileCache::eraseLocked(EntryList::iterator it) {
+    if (it->file->inMemory) {
+        memoryBytes_ -= it->file->contents.size();
+    }
+    index_.erase(it->path);
+    lru_.erase(it);
+}
+
+std::size_t FileCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+std::size_t FileCache::memoryBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memoryBytes_;
+}
+
+uint64_t FileCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t FileCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+std::string FileCache::formatHttpDate(int64_t secondsSinceEpoch) {
+    time_t seconds = static_cast<time_t>(secondsSinceEpoch);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    char buf[32];
+    strftime(buf, sizeof buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+int64_t FileCache::parseHttpDate(const std::string& date) {
+    struct tm tm = {};
+    const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == nullptr || *end != '\0') {
+        return -1;
+    }
+    return static_cast<int64_t>(timegm(&tm));
+}
+
+}  // namespace dws::net
@@ -0,0 +1,492 @@
+#include "HttpClient.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+
+#include "Buffer.h"
+#include "Connector.h"
+#include "CountDownLatch.h"
+#include "EventLoop.h"
+#include "Logging.h"
+#include "SocketsOps.h"
+
+namespace dws::net {
+
+struct HttpClient::Call {
+    Pool* pool = nullptr;
+    std::string wire;  // the serialized request, kept for a resend
+    Callback callback;
+    TimerId timer;
+    Connection* connection = nullptr;  // while sent
+    bool head = false;
+    bool idempotent = false;
+    bool retried = false;
+    bool done = false;
+};
+
+struct HttpClient::Connection {
+    Connection(Pool* p, std::size_t maxBodyBytes) : pool(p), parser(maxBodyBytes) {}
+
+    bool usable() const { return tcp && tcp->connected() && reusable; }
+
+    Pool* pool;
+    std::shared_ptr<Connector> connector;  // until connected
+    TimerId connectTimer;
+    TcpConnectionPtr tcp;
+    HttpResponseParser parser;
+    std::deque<CallPtr> inflight;
+    Timestamp idleSince;
+    uint64_t responses = 0;
+    bool http11 = false;   // known after the first response
+    bool reusable = true;  // false once the server or the client is closing it
+};
+
+struct HttpClient::Pool {
+    explicit Pool(const InetAddress& addr) : server(addr), hostPort(addr.toIpPort()) {}
+
+    InetAddress server;
+    std::string hostPort;
+    std::deque<CallPtr> waiting;
+    std::vector<ConnectionPtr> connections;
+    std::size_t connecting = 0;
+};
+
+namespace {
+
+// RFC 7231 section 4.2.2, safe to send again and to pipeline
+bool isIdempotent(HttpRequest::Method method) {
+    switch (method) {
+        case HttpRequest::kGet:
+        case HttpRequest::kHead:
+        case HttpRequest::kPut:
+        case HttpRequest::kDelete:
+        case HttpRequest::kOptions:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void appendHeader(std::string* out, const std::string& field, const std::string& value) {
+    out->append(field);
+    out->append(": ");
+    out->append(value);
+    out->append("\r\n");
+}
+
+}  // namespace
+
+HttpClient::HttpClient(EventLoop* loop, const std::string& name)
+    : HttpClient(loop, name, Options()) {}
+
+HttpClient::HttpClient(EventLoop* loop, const std::string& name, const Options& options)
+    : loop_(CHECK_NOTNULL(loop)),
+      name_(name),
+      options_(options),
+      inFlight_(0),
+      connects_(0),
+      nextConnId_(1) {
+    assert(options_.maxConnectionsPerHost > 0 && options_.maxPipelineDepth > 0);
+    if (options_.idleTimeoutSeconds > 0) {
+        idleTimer_ = loop_->runEvery(options_.idleTimeoutSeconds / 2,
+                                     [this] { closeIdleConnections(); });
+    }
+}
+
+HttpClient::~HttpClient() {
+    // timers and connection callbacks refer to this client
+    auto stopAll = [this] {
+        loop_->cancel(idleTimer_);
+        for (auto& entry : pools_) {
+            Pool* pool = entry.second.get();
+            for (const CallPtr& call : pool->waiting) {
+                loop_->cancel(call->timer);
+            }
+            for (const ConnectionPtr& conn : pool->connections) {
+                loop_->cancel(conn->connectTimer);
+                stopConnector(conn);
+                for (const CallPtr& call : conn->inflight) {
+                    loop_->cancel(call->timer);
+                }
+                if (conn->tcp) {
+                    conn->tcp->setMessageCallback(defaultMessageCallback);
+                    conn->tcp->connectDestroyed();
+                }
+            }
+        }
+        pools_.clear();
+    };
+    if (loop_->isInLoopThread()) {
+        stopAll();
+    } else {
+        CountDownLatch latch(1);
+        loop_->runInLoop([&] {
+            stopAll();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+}
+
+std::size_t HttpClient::numConnections() const {
+    std::size_t n = 0;
+    for (const auto& entry : pools_) {
+        n += entry.second->connections.size();
+    }
+    return n;
+}
+
+void HttpClient::send(const InetAddress& server, Request request, Callback cb) {
+    if (loop_->isInLoopThread()) {
+        sendInLoop(server, std::move(request), std::move(cb));
+    } else {
+        loop_->queueInLoop([this, server, request = std::move(request),
+                            cb = std::move(cb)]() mutable {
+            sendInLoop(server, std::move(request), std::move(cb));
+        });
+    }
+}
+
+void HttpClient::get(const InetAddress& server, const std::string& target, Callback cb) {
+    Request request;
+    request.target = target;
+    send(server, std::move(request), std::move(cb));
+}
+
+void HttpClient::sendInLoop(const InetAddress& server, Request request, Callback cb) {
+    loop_->assertInLoopThread();
+    if (inFlight_ >= options_.maxInFlight) {
+        cb(kOverloaded, HttpClientResponse());
+        return;
+    }
+    Pool* pool = poolOf(server);
+    CallPtr call = std::make_shared<Call>();
+    call->pool = pool;
+    call->head = request.method == HttpRequest::kHead;
+    call->idempotent = isIdempotent(request.method);
+    call->callback = std::move(cb);
+
+    std::string& wire = call->wire;
+    wire.reserve(64 + request.target.size() + request.body.size());
+    wire.append(HttpRequest::methodName(request.method));
+    wire.append(" ");
+    wire.append(request.target);
+    wire.append(" HTTP/1.1\r\n");
+    appendHeader(&wire, "Host", request.host.empty() ? pool->hostPort : request.host);
+    for (const auto& header : request.headers) {
+        appendHeader(&wire, header.first, header.second);
+    }
+    if (!request.body.empty() || request.method == HttpRequest::kPost ||
+        request.method == HttpRequest::kPut || request.method == HttpRequest::kPatch) {
+        appendHeader(&wire, "Content-Length", std::to_string(request.body.size()));
+    }
+    wire.append("\r\n");
+    wire.append(request.body);
+
+    double timeout = request.timeoutSeconds > 0 ? request.timeoutSeconds
+                                                : options_.requestTimeoutSeconds;
+    std::weak_ptr<Call> weak(call);
+    call->timer = loop_->runAfter(timeout, [this, weak] {
+        if (CallPtr c = weak.lock()) {
+            onRequestTimeout(c);
+        }
+    });
+    ++inFlight_;
+    pool->waiting.push_back(std::move(call));
+    pump(pool);
+}
+
+HttpClient::Pool* HttpClient::poolOf(const InetAddress& server) {
+    std::string key = server.toIpPort();
+    auto it = pools_.find(key);
+    if (it == pools_.end()) {
+        it = pools_.emplace(std::move(key), std::make_unique<Pool>(server)).first;
+    }
+    return it->second.get();
+}
+
+void HttpClient::pump(Pool* pool) {
+    while (!pool->waiting.empty()) {
+        Connection* conn = pickConnection(pool, *pool->waiting.front());
+        if (conn == nullptr) {
+            break;
+        }
+        CallPtr call = std::move(pool->waiting.front());
+        pool->waiting.pop_front();
+        writeRequest(conn, call);
+    }
+    while (pool->connections.size() < options_.maxConnectionsPerHost &&
+           pool->connecting < pool->waiting.size()) {
+        openConnection(pool);
+    }
+}
+
+HttpClient::Connection* HttpClient::pickConnection(Pool* pool, const Call& call) {
+    Connection* pipelined = nullptr;
+    for (const ConnectionPtr& conn : pool->connections) {
+        if (!conn->usable()) {
+            continue;
+        }
+        if (conn->inflight.empty()) {
+            return conn.get();
+        }
+        // RFC 7230 section 6.3.2, only idempotent requests behind idempotent ones
+        if (call.idempotent && conn->http11 &&
+            conn->inflight.size() < options_.maxPipelineDepth &&
+            (pipelined == nullptr || conn->inflight.size() < pipelined->inflight.size()) &&
+            std::all_of(conn->inflight.begin(), conn->inflight.end(),
+                        [](const CallPtr& c) { return c->idempotent; })) {
+            pipelined = conn.get();
+        }
+    }
+    // a new connection beats waiting behind other responses
+    return pool->connections.size() < options_.maxConnectionsPerHost ? nullptr : pipelined;
+}
+
+void HttpClient::openConnection(Pool* pool) {
+    ConnectionPtr conn = std::make_shared<Connection>(pool, options_.maxResponseBodyBytes);
+    std::weak_ptr<Connection> weak(conn);
+    conn->connector = std::make_shared<Connector>(loop_, pool->server);
+    conn->connector->setNewConnectionCallback([this, weak](int sockfd) {
+        if (ConnectionPtr c = weak.lock()) {
+            onConnected(c, sockfd);
+        } else {
+            sockets::close(sockfd);
+        }
+    });
+    conn->connector->setErrorCallback([this, weak](int savedErrno) {
+        if (ConnectionPtr c = weak.lock()) {
+            onConnectFailed(c, savedErrno);
+        }
+    });
+    conn->connectTimer = loop_->runAfter(options_.connectTimeoutSeconds, [this, weak] {
+        if (ConnectionPtr c = weak.lock()) {
+            onConnectFailed(c, ETIMEDOUT);
+        }
+    });
+    pool->connections.push_back(conn);
+    ++pool->connecting;
+    ++connects_;
+    conn->connector->start();
+}
+
+void HttpClient::writeRequest(Connection* conn, const CallPtr& call) {
+    call->connection = conn;
+    conn->inflight.push_back(call);
+    // coalesced with the other requests of this loop iteration
+    conn->tcp->outputBuffer()->append(call->wire.data(), call->wire.size());
+    conn->tcp->sendOutputBuffer();
+}
+
+void HttpClient::onConnected(const ConnectionPtr& conn, int sockfd) {
+    loop_->assertInLoopThread();
+    Pool* pool = conn->pool;
+    loop_->cancel(conn->connectTimer);
+    stopConnector(conn);
+    --pool->connecting;
+
+    InetAddress peerAddr(sockets::getPeerAddr(sockfd));
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    char buf[32];
+    snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    TcpConnectionPtr tcp(new TcpConnection(loop_, name_ + buf, sockfd, localAddr, peerAddr));
+    tcp->setTcpNoDelay(true);
+    tcp->setWriteCoalescing(true);
+    tcp->setConnectionCallback(defaultConnectionCallback);
+    std::weak_ptr<Connection> weak(conn);
+    tcp->setMessageCallback([this, weak](const TcpConnectionPtr&, Buffer* input, Timestamp) {
+        if (ConnectionPtr c = weak.lock()) {
+            onMessage(c, input);
+        }
+    });
+    tcp->setCloseCallback([this, weak](const TcpConnectionPtr& closed) {
+        if (ConnectionPtr c = weak.lock()) {
+            onClose(c);
+        } else {
+            loop_->queueInLoop([closed] { closed->connectDestroyed(); });
+        }
+    });
+    conn->tcp = tcp;
+    conn->idleSince = Timestamp::now();
+    tcp->connectEstablished();
+    pump(pool);
+}
+
+void HttpClient::onConnectFailed(const ConnectionPtr& conn, int savedErrno) {
+    Pool* pool = conn->pool;
+    if (conn->tcp || std::find(pool->connections.begin(), pool->connections.end(), conn) ==
+                             pool->connections.end()) {
+        return;
+    }
+    LOG(WARN) << "[HttpClient::onConnectFailed] " << name_ << " - " << pool->hostPort << " "
+              << strerror_tl(savedErrno);
+    loop_->cancel(conn->connectTimer);
+    stopConnector(conn);
+    --pool->connecting;
+    removeConnection(pool, conn);
+    if (pool->connections.empty()) {
+        failWaiting(pool, kConnectFailed);
+    } else {
+        pump(pool);
+    }
+}
+
+void HttpClient::onMessage(const ConnectionPtr& conn, Buffer* buf) {
+    while (buf->readableBytes() > 0) {
+        if (conn->inflight.empty()) {
+            LOG(WARN) << "[HttpClient::onMessage] " << *conn->tcp << " unsolicited data";
+            buf->retrieveAll();
+            conn->reusable = false;
+            break;
+        }
+        CallPtr call = conn->inflight.front();
+        HttpResponseParser::Result result = conn->parser.parse(*buf, call->head);
+        if (result == HttpResponseParser::kNeedMore) {
+            break;
+        }
+        const HttpClientResponse& response = conn->parser.response();
+        // switching protocols is never asked for
+        if (result == HttpResponseParser::kError || response.statusCode() == 101) {
+            LOG(ERROR) << "[HttpClient::onMessage] " << *conn->tcp << " bad response";
+            conn->inflight.pop_front();
+            call->connection = nullptr;
+            conn->reusable = false;
+            conn->tcp->forceClose();
+            complete(call, kBadResponse, HttpClientResponse());
+            buf->retrieveAll();
+            return;
+        }
+        if (response.statusCode() >= 200) {
+            conn->inflight.pop_front();
+            call->connection = nullptr;
+            ++conn->responses;
+            conn->http11 = response.version() == HttpRequest::kHttp11;
+            if (!response.keepAlive()) {
+                conn->reusable = false;
+            }
+            complete(call, kOk, response);
+        }
+        buf->retrieve(conn->parser.messageBytes());
+        conn->parser.reset();
+    }
+    if (!conn->reusable) {
+        // requests behind a "Connection: close" response are sent again or
+        // failed once the connection is gone
+        conn->tcp->forceClose();
+    } else if (conn->inflight.empty()) {
+        conn->idleSince = Timestamp::now();
+    }
+    pump(conn->pool);
+}
+
+void HttpClient::onClose(const ConnectionPtr& conn) {
+    loop_->assertInLoopThread();
+    Pool* pool = conn->pool;
+    TcpConnectionPtr tcp = conn->tcp;
+    removeConnection(pool, conn);
+    loop_->queueInLoop([tcp] { tcp->connectDestroyed(); });
+
+    std::deque<CallPtr> inflight;
+    inflight.swap(conn->inflight);
+    std::vector<CallPtr> failed;
+    if (!inflight.empty() && conn->parser.started()) {
+        CallPtr call = std::move(inflight.front());
+        inflight.pop_front();
+        call->connection = nullptr;
+        if (conn->parser.parseAtClose(*tcp->inputBuffer()) == HttpResponseParser::kComplete) {
+            complete(call, kOk, conn->parser.response());
+        } else {
+            failed.push_back(std::move(call));
+        }
+    }
+    // a reused connection may have been closed by the server as idle just
+    // as the requests went out, they never reached the application
+    const bool reused = conn->responses > 0;
+    std::vector<CallPtr> resend;
+    for (CallPtr& call : inflight) {
+        call->connection = nullptr;
+        if (call->done) {
+            continue;
+        }
+        if (reused && call->idempotent && !call->retried) {
+            call->retried = true;
+            resend.push_back(std::move(call));
+        } else {
+            failed.push_back(std::move(call));
+        }
+    }
+    pool->waiting.insert(pool->waiting.begin(), resend.begin(), resend.end());
+    for (const CallPtr& call : failed) {
+        complete(call, kConnectionClosed, HttpClientResponse());
+    }
+    pump(pool);
+}
+
+void HttpClient::onRequestTimeout(const CallPtr& call) {
+    if (call->done) {
+        return;
+    }
+    if (Connection* conn = call->connection) {
+        // a late response would be taken for the next request's
+        conn->reusable = false;
+        conn->tcp->forceClose();
+    } else {
+        auto& waiting = call->pool->waiting;
+        waiting.erase(std::find(waiting.begin(), waiting.end(), call));
+    }
+    complete(call, kTimeout, HttpClientResponse());
+}
+
+void HttpClient::closeIdleConnections() {
+    Timestamp now = Timestamp::now();
+    for (auto& entry : pools_) {
+        for (const ConnectionPtr& conn : entry.second->connections) {
+            if (conn->usable() && conn->inflight.empty() &&
+                timeDifference(now, conn->idleSince) >= options_.idleTimeoutSeconds) {
+                conn->reusable = false;
+                conn->tcp->forceClose();
+            }
+        }
+    }
+}
+
+void HttpClient::removeConnection(Pool* pool, const ConnectionPtr& conn) {
+    auto it = std::find(pool->connections.begin(), pool->connections.end(), conn);
+    assert(it != pool->connections.end());
+    pool->connections.erase(it);
+}
+
+void HttpClient::failWaiting(Pool* pool, Error error) {
+    std::deque<CallPtr> waiting;
+    waiting.swap(pool->waiting);
+    for (const CallPtr& call : waiting) {
+        complete(call, error, HttpClientResponse());
+    }
+}
+
+void HttpClient::complete(const CallPtr& call, Error error, const HttpClientResponse& response) {
+    if (call->done) {
+        return;
+    }
+    call->done = true;
+    if (error != kTimeout) {
+        loop_->cancel(call->timer);
+    }
+    --inFlight_;
+    Callback cb = std::move(call->callback);
+    cb(error, response);
+}
+
+void HttpClient::stopConnector(const ConnectionPtr& conn) {
+    if (conn->connector) {
+        // stop() finishes in a queued functor that needs the connector
+        conn->connector->stop();
+        loop_->queueInLoop([connector = conn->connector] {});
+        conn->connector.reset();
+    }
+}
+
+}  // namespace dws::net
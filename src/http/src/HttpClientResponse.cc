@@ -0,0 +1,38 @@
+#include "HttpClientResponse.h"
+
+namespace dws::net {
+
+StringPiece HttpClientResponse::getHeader(const StringPiece& field) const {
+    for (const HeaderSpan& h : headers_) {
+        if (h.field.length == static_cast<uint32_t>(field.size()) &&
+            HttpRequest::equalsIgnoreCase(view(h.field), field)) {
+            return view(h.value);
+        }
+    }
+    return StringPiece();
+}
+
+bool HttpClientResponse::keepAlive() const {
+    if (closeDelimited_) {
+        return false;
+    }
+    StringPiece connection = getHeader(StringPiece("Connection"));
+    if (version_ == HttpRequest::kHttp11) {
+        return !HttpRequest::containsToken(connection, StringPiece("close"));
+    }
+    return HttpRequest::containsToken(connection, StringPiece("keep-alive"));
+}
+
+void HttpClientResponse::clear() {
+    base_ = nullptr;
+    statusCode_ = 0;
+    version_ = HttpRequest::kUnknown;
+    chunked_ = false;
+    closeDelimited_ = false;
+    reason_ = Span();
+    body_ = Span();
+    headers_.clear();
+    decodedBody_.clear();
+}
+
+}  // namespace dws::net
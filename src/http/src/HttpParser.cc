@@ -0,0 +1,279 @@
+#include "HttpParser.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "Buffer.h"
+
+namespace dws::net {
+
+namespace {
+
+// chunk-size lines and trailers are short, anything longer is garbage
+const std::size_t kMaxChunkLineBytes = 4096;
+
+bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+HttpRequest::Method parseMethod(const char* begin, const char* end) {
+    StringPiece m(begin, static_cast<int>(end - begin));
+    switch (m.size()) {
+        case 3:
+            if (m == StringPiece("GET")) return HttpRequest::kGet;
+            if (m == StringPiece("PUT")) return HttpRequest::kPut;
+            break;
+        case 4:
+            if (m == StringPiece("POST")) return HttpRequest::kPost;
+            if (m == StringPiece("HEAD")) return HttpRequest::kHead;
+            break;
+        case 5:
+            if (m == StringPiece("PATCH")) return HttpRequest::kPatch;
+            break;
+        case 6:
+            if (m == StringPiece("DELETE")) return HttpRequest::kDelete;
+            break;
+        case 7:
+            if (m == StringPiece("OPTIONS")) return HttpRequest::kOptions;
+            break;
+        default:
+            break;
+    }
+    return HttpRequest::kInvalid;
+}
+
+}  // namespace
+
+const std::size_t HttpParser::kMaxHeaderBytes;
+const std::size_t HttpParser::kMaxHeaders;
+const std::size_t HttpParser::kDefaultMaxBodyBytes;
+
+HttpParser::HttpParser(std::size_t maxBodyBytes)
+    : maxBodyBytes_(maxBodyBytes),
+      state_(kRequestLine),
+      pos_(0),
+      chunkRemaining_(0),
+      errorStatus_(0) {
+    // body spans are 32 bits wide
+    assert(maxBodyBytes_ <= std::numeric_limits<uint32_t>::max());
+}
+
+void HttpParser::reset() {
+    state_ = kRequestLine;
+    pos_ = 0;
+    chunkRemaining_ = 0;
+    errorStatus_ = 0;
+    request_.clear();
+}
+
+HttpParser::Result HttpParser::parse(const Buffer& buf) {
+    const char* base = buf.peek();
+    const char* end = buf.beginWrite();
+    request_.base_ = base;
+    while (true) {
+        const char* cur = base + pos_;
+        switch (state_) {
+            case kRequestLine:
+            case kHeaders:
+            case kChunkSize:
+            case kChunkTrailer: {
+                const bool inHead = state_ == kRequestLine || state_ == kHeaders;
+                const char* eol = static_cast<const char*>(memchr(cur, '\n', end - cur));
+                if (eol == nullptr) {
+                    if (inHead && static_cast<std::size_t>(end - base) > kMaxHeaderBytes) {
+                        return fail(431);
+                    }
+                    if (!inHead && static_cast<std::size_t>(end - cur) > kMaxChunkLineBytes) {
+                        return fail(400);
+                    }
+                    return kNeedMore;
+                }
+                // tolerate a bare LF as line terminator, RFC 7230 section 3.5
+                const char* lineEnd = (eol > cur && eol[-1] == '\r') ? eol - 1 : eol;
+                pos_ = eol + 1 - base;
+                if (inHead && pos_ > kMaxHeaderBytes) {
+                    return fail(431);
+                }
+                if (state_ == kRequestLine) {
+                    // empty lines before the request line are ignored
+                    if (lineEnd != cur && !parseRequestLine(cur, lineEnd)) {
+                        return kError;
+                    }
+                } else if (state_ == kHeaders) {
+                    if (lineEnd == cur) {
+                        if (headersComplete() == kError) {
+                            return kError;
+                        }
+                    } else if (!parseHeader(cur, lineEnd)) {
+                        return kError;
+                    }
+                } else if (state_ == kChunkSize) {
+                    std::size_t size = 0;
+                    const char* p = cur;
+                    for (; p < lineEnd && hexValue(*p) >= 0; ++p) {
+                        if (size > (maxBodyBytes_ >> 4)) {
+                            return fail(413);
+                        }
+                        size = (size << 4) | hexValue(*p);
+                    }
+                    // chunk extensions after ';' are ignored
+                    if (p == cur || (p < lineEnd && *p != ';' && !isSpace(*p))) {
+                        return fail(400);
+                    }
+                    if (size == 0) {
+                        state_ = kChunkTrailer;
+                    } else if (request_.decodedBody_.size() + size > maxBodyBytes_) {
+                        return fail(413);
+                    } else {
+                        chunkRemaining_ = size;
+                        state_ = kChunkData;
+                    }
+                } else if (lineEnd == cur) {  // kChunkTrailer, trailer fields are ignored
+                    state_ = kDone;
+                }
+                break;
+            }
+            case kBody: {
+                std::size_t need = request_.body_.offset + request_.body_.length;
+                if (static_cast<std::size_t>(end - base) < need) {
+                    return kNeedMore;
+                }
+                pos_ = need;
+                state_ = kDone;
+                break;
+            }
+            case kChunkData: {
+                if (static_cast<std::size_t>(end - cur) < chunkRemaining_ + 2) {
+                    return kNeedMore;
+                }
+                if (cur[chunkRemaining_] != '\r' || cur[chunkRemaining_ + 1] != '\n') {
+                    return fail(400);
+                }
+                request_.decodedBody_.append(cur, chunkRemaining_);
+                pos_ += chunkRemaining_ + 2;
+                chunkRemaining_ = 0;
+                state_ = kChunkSize;
+                break;
+            }
+            case kDone:
+                return kComplete;
+            case kFailed:
+                return kError;
+        }
+    }
+}
+
+bool HttpParser::parseRequestLine(const char* begin, const char* end) {
+    const char* space = std::find(begin, end, ' ');
+    if (space == end) {
+        fail(400);
+        return false;
+    }
+    request_.method_ = parseMethod(begin, space);
+    if (request_.method_ == HttpRequest::kInvalid) {
+        fail(501);
+        return false;
+    }
+    const char* target = space + 1;
+    space = std::find(target, end, ' ');
+    if (space == end || space == target) {
+        fail(400);
+        return false;
+    }
+    const char* question = std::find(target, space, '?');
+    const char* base = request_.base_;
+    request_.path_ = {static_cast<uint32_t>(target - base), static_cast<uint32_t>(question - target)};
+    if (question != space) {
+        request_.query_ = {static_cast<uint32_t>(question + 1 - base),
+                           static_cast<uint32_t>(space - question - 1)};
+    }
+
+    StringPiece version(space + 1, static_cast<int>(end - space - 1));
+    if (version == StringPiece("HTTP/1.1")) {
+        request_.version_ = HttpRequest::kHttp11;
+    } else if (version == StringPiece("HTTP/1.0")) {
+        request_.version_ = HttpRequest::kHttp10;
+    } else {
+        fail(version.starts_with(StringPiece("HTTP/")) ? 505 : 400);
+        return false;
+    }
+    state_ = kHeaders;
+    return true;
+}
+
+bool HttpParser::parseHeader(const char* begin, const char* end) {
+    const char* colon = std::find(begin, end, ':');
+    // no obsolete line folding and no whitespace before the colon, RFC 7230 section 3.2.4
+    if (colon == end || colon == begin || isSpace(*begin) || isSpace(colon[-1])) {
+        fail(400);
+        return false;
+    }
+    if (request_.headers_.size() >= kMaxHeaders) {
+        fail(431);
+        return false;
+    }
+    const char* value = colon + 1;
+    while (value < end && isSpace(*value)) {
+        ++value;
+    }
+    const char* valueEnd = end;
+    while (valueEnd > value && isSpace(valueEnd[-1])) {
+        --valueEnd;
+    }
+    const char* base = request_.base_;
+    HttpRequest::HeaderSpan h;
+    h.field = {static_cast<uint32_t>(begin - base), static_cast<uint32_t>(colon - begin)};
+    h.value = {static_cast<uint32_t>(value - base), static_cast<uint32_t>(valueEnd - value)};
+    request_.headers_.push_back(h);
+    return true;
+}
+
+HttpParser::Result HttpParser::headersComplete() {
+    if (request_.version_ == HttpRequest::kHttp11 &&
+        request_.getHeader(StringPiece("Host")).empty()) {
+        return fail(400);
+    }
+    StringPiece transferEncoding = request_.getHeader(StringPiece("Transfer-Encoding"));
+    StringPiece contentLength = request_.getHeader(StringPiece("Content-Length"));
+    if (!transferEncoding.empty()) {
+        // both framings at once is how requests get smuggled, RFC 7230 section 3.3.3
+        if (!contentLength.empty()) {
+            return fail(400);
+        }
+        if (!HttpRequest::equalsIgnoreCase(transferEncoding, StringPiece("chunked"))) {
+            return fail(501);
+        }
+        request_.chunked_ = true;
+        state_ = kChunkSize;
+        return kNeedMore;
+    }
+    if (contentLength.empty()) {
+        state_ = kDone;
+        return kComplete;
+    }
+    std::size_t length = 0;
+    for (char c : contentLength) {
+        if (c < '0' || c > '9') {
+            return fail(400);
+        }
+        if (length > maxBodyBytes_ / 10) {
+            return fail(413);
+        }
+        length = length * 10 + (c - '0');
+    }
+    if (length > maxBodyBytes_) {
+        return fail(413);
+    }
+    request_.body_ = {static_cast<uint32_t>(pos_), static_cast<uint32_t>(length)};
+    state_ = length == 0 ? kDone : kBody;
+    return state_ == kDone ? kComplete : kNeedMore;
+}
+
+}  // namespace dws::net
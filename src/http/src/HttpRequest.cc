@@ -0,0 +1,87 @@
+#include "HttpRequest.h"
+
+#include <strings.h>
+
+namespace dws::net {
+
+const char* HttpRequest::methodName(Method method) {
+    switch (method) {
+        case kGet:
+            return "GET";
+        case kPost:
+            return "POST";
+        case kHead:
+            return "HEAD";
+        case kPut:
+            return "PUT";
+        case kDelete:
+            return "DELETE";
+        case kOptions:
+            return "OPTIONS";
+        case kPatch:
+            return "PATCH";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+StringPiece HttpRequest::getHeader(const StringPiece& field) const {
+    for (const HeaderSpan& h : headers_) {
+        if (h.field.length == static_cast<uint32_t>(field.size()) &&
+            equalsIgnoreCase(view(h.field), field)) {
+            return view(h.value);
+        }
+    }
+    return StringPiece();
+}
+
+bool HttpRequest::keepAlive() const {
+    StringPiece connection = getHeader(StringPiece("Connection"));
+    if (version_ == kHttp11) {
+        return !containsToken(connection, StringPiece("close"));
+    }
+    return containsToken(connection, StringPiece("keep-alive"));
+}
+
+bool HttpRequest::equalsIgnoreCase(const StringPiece& a, const StringPiece& b) {
+    return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+bool HttpRequest::containsToken(const StringPiece& list, const StringPiece& token) {
+    const char* p = list.begin();
+    const char* end = list.end();
+    while (p < end) {
+        const char* comma = p;
+        while (comma < end && *comma != ',') {
+            ++comma;
+        }
+        const char* b = p;
+        const char* e = comma;
+        while (b < e && (*b == ' ' || *b == '\t')) {
+            ++b;
+        }
+        while (e > b && (e[-1] == ' ' || e[-1] == '\t')) {
+            --e;
+        }
+        if (equalsIgnoreCase(StringPiece(b, static_cast<int>(e - b)), token)) {
+            return true;
+        }
+        p = comma + 1;
+    }
+    return false;
+}
+
+void HttpRequest::clear() {
+    base_ = nullptr;
+    method_ = kInvalid;
+    version_ = kUnknown;
+    chunked_ = false;
+    path_ = Span();
+    query_ = Span();
+    body_ = Span();
+    headers_.clear();  // keeps the capacity for the next pipelined request
+    decodedBody_.clear();
+    receiveTime_ = Timestamp();
+}
+
+}  // namespace dws::net
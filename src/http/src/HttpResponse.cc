@@ -0,0 +1,240 @@
+#include "HttpResponse.h"
+
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "Buffer.h"
+#include "HttpRequest.h"
+
+namespace dws::net {
+
+namespace {
+
+// Writes @c n in decimal (base 10) or hex (base 16) at buf's write position.
+void appendNumber(Buffer* buf, std::size_t n, unsigned base) {
+    static const char kDigits[] = "0123456789abcdef";
+    char tmp[24];
+    char* p = tmp + sizeof tmp;
+    do {
+        *--p = kDigits[n % base];
+        n /= base;
+    } while (n != 0);
+    buf->append(p, tmp + sizeof tmp - p);
+}
+
+void appendLiteral(Buffer* buf, const char* s) { buf->append(s, strlen(s)); }
+
+}  // namespace
+
+HttpResponse::HttpResponse(Buffer* output, bool closeConnection)
+    : output_(output),
+      state_(kStatus),
+      statusCode_(k200Ok),
+      closeConnection_(closeConnection),
+      keepAliveHeader_(false),
+      headOnly_(false),
+      http10_(false) {}
+
+HttpResponse::HttpResponse(Buffer* output, const HttpRequest& request)
+    : output_(output),
+      state_(kStatus),
+      statusCode_(k200Ok),
+      closeConnection_(!request.keepAlive()),
+      keepAliveHeader_(request.version() == HttpRequest::kHttp10),
+      headOnly_(request.method() == HttpRequest::kHead),
+      http10_(request.version() == HttpRequest::kHttp10) {}
+
+const char* HttpResponse::reasonPhrase(int code) {
+    switch (code) {
+        case 100:
+            return "Continue";
+        case 101:
+            return "Switching Protocols";
+        case 200:
+            return "OK";
+        case 201:
+            return "Created";
+        case 204:
+            return "No Content";
+        case 206:
+            return "Partial Content";
+        case 301:
+            return "Moved Permanently";
+        case 302:
+            return "Found";
+        case 304:
+            return "Not Modified";
+        case 400:
+            return "Bad Request";
+        case 403:
+            return "Forbidden";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        case 408:
+            return "Request Timeout";
+        case 413:
+            return "Payload Too Large";
+        case 414:
+            return "URI Too Long";
+        case 416:
+            return "Range Not Satisfiable";
+        case 431:
+            return "Request Header Fields Too Large";
+        case 500:
+            return "Internal Server Error";
+        case 501:
+            return "Not Implemented";
+        case 502:
+            return "Bad Gateway";
+        case 503:
+            return "Service Unavailable";
+        case 505:
+            return "HTTP Version Not Supported";
+        default:
+            return "Unknown";
+    }
+}
+
+void HttpResponse::setStatusCode(int code) {
+    setStatusCode(code, StringPiece(reasonPhrase(code)));
+}
+
+void HttpResponse::setStatusCode(int code, const StringPiece& reason) {
+    assert(state_ == kStatus);
+    assert(code >= 100 && code <= 999);
+    statusCode_ = code;
+    writeStatusLine(reason);
+}
+
+void HttpResponse::setCloseConnection(bool on) {
+    assert(state_ == kStatus || state_ == kHeaders);
+    closeConnection_ = on;
+}
+
+void HttpResponse::writeStatusLine() {
+    if (state_ == kStatus) {
+        writeStatusLine(StringPiece("OK"));
+    }
+}
+
+void HttpResponse::writeStatusLine(const StringPiece& reason) {
+    char line[13] = {'H', 'T', 'T', 'P', '/', '1', '.', '1', ' ', 0, 0, 0, ' '};
+    line[9] = static_cast<char>('0' + statusCode_ / 100);
+    line[10] = static_cast<char>('0' + statusCode_ / 10 % 10);
+    line[11] = static_cast<char>('0' + statusCode_ % 10);
+    output_->append(line, sizeof line);
+    output_->append(reason);
+    output_->append("\r\n", 2);
+    state_ = kHeaders;
+}
+
+void HttpResponse::writeConnectionHeader() {
+    if (closeConnection_) {
+        appendLiteral(output_, "Connection: close\r\n");
+    } else if (keepAliveHeader_) {
+        appendLiteral(output_, "Connection: keep-alive\r\n");
+    }
+}
+
+void HttpResponse::setContentType(const StringPiece& contentType) {
+    addHeader(StringPiece("Content-Type"), contentType);
+}
+
+void HttpResponse::addHeader(const StringPiece& field, const StringPiece& value) {
+    writeStatusLine();
+    assert(state_ == kHeaders);
+    output_->append(field);
+    output_->append(": ", 2);
+    output_->append(value);
+    output_->append("\r\n", 2);
+}
+
+bool HttpResponse::writeLengthHeaders(std::size_t length) {
+    writeStatusLine();
+    assert(state_ == kHeaders);
+    writeConnectionHeader();
+    // 1xx, 204 and 304 responses carry neither a body nor its length
+    bool bodyless = statusCode_ < 200 || statusCode_ == k204NoContent ||
+                    statusCode_ == k304NotModified;
+    if (!bodyless) {
+        appendLiteral(output_, "Content-Length: ");
+        appendNumber(output_, length, 10);
+        output_->append("\r\n", 2);
+    }
+    output_->append("\r\n", 2);
+    state_ = kFinished;
+    return !bodyless && !headOnly_;
+}
+
+void HttpResponse::setBody(const StringPiece& body) {
+    if (writeLengthHeaders(body.size())) {
+        output_->append(body);
+    }
+}
+
+void HttpResponse::setFileBody(int fd, int64_t offset, std::size_t length,
+                               std::shared_ptr<const void> owner) {
+    if (writeLengthHeaders(length) && length > 0) {
+        fileBody_.fd = fd;
+        fileBody_.offset = offset;
+        fileBody_.length = length;
+        fileBody_.owner = std::move(owner);
+    }
+}
+
+void HttpResponse::beginChunked() {
+    writeStatusLine();
+    assert(state_ == kHeaders);
+    if (http10_) {
+        // HTTP/1.0 has no chunked coding, the close delimits the body
+        closeConnection_ = true;
+        writeConnectionHeader();
+        output_->append("\r\n", 2);
+    } else {
+        writeConnectionHeader();
+        appendLiteral(output_, "Transfer-Encoding: chunked\r\n\r\n");
+    }
+    state_ = headOnly_ ? kFinished : kChunkedBody;
+}
+
+void HttpResponse::appendChunk(const StringPiece& data) {
+    if (headOnly_) {
+        return;
+    }
+    assert(state_ == kChunkedBody);
+    if (data.empty()) {
+        return;  // an empty chunk would end the body
+    }
+    if (http10_) {
+        output_->append(data);
+        return;
+    }
+    appendNumber(output_, data.size(), 16);
+    output_->append("\r\n", 2);
+    output_->append(data);
+    output_->append("\r\n", 2);
+}
+
+void HttpResponse::endChunked() {
+    if (headOnly_) {
+        return;
+    }
+    assert(state_ == kChunkedBody);
+    if (!http10_) {
+        appendLiteral(output_, "0\r\n\r\n");
+    }
+    state_ = kFinished;
+}
+
+void HttpResponse::finish() {
+    if (state_ == kChunkedBody) {
+        endChunked();
+    } else if (state_ != kFinished) {
+        setBody(StringPiece());
+    }
+}
+
+}  // namespace dws::net
@@ -0,0 +1,255 @@
+#include "HttpResponseParser.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "Buffer.h"
+
+namespace dws::net {
+
+namespace {
+
+const std::size_t kMaxChunkLineBytes = 4096;
+
+bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+}  // namespace
+
+const std::size_t HttpResponseParser::kMaxHeaderBytes;
+const std::size_t HttpResponseParser::kMaxHeaders;
+const std::size_t HttpResponseParser::kDefaultMaxBodyBytes;
+
+HttpResponseParser::HttpResponseParser(std::size_t maxBodyBytes)
+    : maxBodyBytes_(maxBodyBytes), state_(kStatusLine), pos_(0), chunkRemaining_(0) {
+    assert(maxBodyBytes_ <= std::numeric_limits<uint32_t>::max());
+}
+
+void HttpResponseParser::reset() {
+    state_ = kStatusLine;
+    pos_ = 0;
+    chunkRemaining_ = 0;
+    response_.clear();
+}
+
+HttpResponseParser::Result HttpResponseParser::parse(const Buffer& buf, bool headRequest) {
+    const char* base = buf.peek();
+    const char* end = buf.beginWrite();
+    response_.base_ = base;
+    while (true) {
+        const char* cur = base + pos_;
+        switch (state_) {
+            case kStatusLine:
+            case kHeaders:
+            case kChunkSize:
+            case kChunkTrailer: {
+                const bool inHead = state_ == kStatusLine || state_ == kHeaders;
+                const char* eol = static_cast<const char*>(memchr(cur, '\n', end - cur));
+                if (eol == nullptr) {
+                    if (inHead && static_cast<std::size_t>(end - base) > kMaxHeaderBytes) {
+                        return fail();
+                    }
+                    if (!inHead && static_cast<std::size_t>(end - cur) > kMaxChunkLineBytes) {
+                        return fail();
+                    }
+                    return kNeedMore;
+                }
+                const char* lineEnd = (eol > cur && eol[-1] == '\r') ? eol - 1 : eol;
+                pos_ = eol + 1 - base;
+                if (inHead && pos_ > kMaxHeaderBytes) {
+                    return fail();
+                }
+                if (state_ == kStatusLine) {
+                    if (!parseStatusLine(cur, lineEnd)) {
+                        return fail();
+                    }
+                } else if (state_ == kHeaders) {
+                    if (lineEnd == cur) {
+                        if (headersComplete(headRequest) == kError) {
+                            return kError;
+                        }
+                    } else if (!parseHeader(cur, lineEnd)) {
+                        return fail();
+                    }
+                } else if (state_ == kChunkSize) {
+                    std::size_t size = 0;
+                    const char* p = cur;
+                    for (; p < lineEnd && hexValue(*p) >= 0; ++p) {
+                        if (size > (maxBodyBytes_ >> 4)) {
+                            return fail();
+                        }
+                        size = (size << 4) | hexValue(*p);
+                    }
+                    if (p == cur || (p < lineEnd && *p != ';' && !isSpace(*p))) {
+                        return fail();
+                    }
+                    if (size == 0) {
+                        state_ = kChunkTrailer;
+                    } else if (response_.decodedBody_.size() + size > maxBodyBytes_) {
+                        return fail();
+                    } else {
+                        chunkRemaining_ = size;
+                        state_ = kChunkData;
+                    }
+                } else if (lineEnd == cur) {
+                    state_ = kDone;
+                }
+                break;
+            }
+            case kBody: {
+                std::size_t need = response_.body_.offset + response_.body_.length;
+                if (static_cast<std::size_t>(end - base) < need) {
+                    return kNeedMore;
+                }
+                pos_ = need;
+                state_ = kDone;
+                break;
+            }
+            case kBodyUntilClose:
+                if (static_cast<std::size_t>(end - cur) > maxBodyBytes_) {
+                    return fail();
+                }
+                return kNeedMore;
+            case kChunkData: {
+                if (static_cast<std::size_t>(end - cur) < chunkRemaining_ + 2) {
+                    return kNeedMore;
+                }
+                if (cur[chunkRemaining_] != '\r' || cur[chunkRemaining_ + 1] != '\n') {
+                    return fail();
+                }
+                response_.decodedBody_.append(cur, chunkRemaining_);
+                pos_ += chunkRemaining_ + 2;
+                chunkRemaining_ = 0;
+                state_ = kChunkSize;
+                break;
+            }
+            case kDone:
+                return kComplete;
+            case kFailed:
+                return kError;
+        }
+    }
+}
+
+HttpResponseParser::Result HttpResponseParser::parseAtClose(const Buffer& buf) {
+    if (state_ != kBodyUntilClose) {
+        return state_ == kDone ? kComplete : fail();
+    }
+    const char* base = buf.peek();
+    std::size_t total = buf.readableBytes();
+    if (total - pos_ > maxBodyBytes_) {
+        return fail();
+    }
+    response_.base_ = base;
+    response_.body_ = {static_cast<uint32_t>(pos_), static_cast<uint32_t>(total - pos_)};
+    pos_ = total;
+    state_ = kDone;
+    return kComplete;
+}
+
+bool HttpResponseParser::parseStatusLine(const char* begin, const char* end) {
+    // "HTTP/1.1 200 OK", the reason phrase may be empty or missing
+    if (end - begin < 12 || begin[8] != ' ') {
+        return false;
+    }
+    StringPiece version(begin, 8);
+    if (version == StringPiece("HTTP/1.1")) {
+        response_.version_ = HttpRequest::kHttp11;
+    } else if (version == StringPiece("HTTP/1.0")) {
+        response_.version_ = HttpRequest::kHttp10;
+    } else {
+        return false;
+    }
+    int code = 0;
+    for (const char* p = begin + 9; p < begin + 12; ++p) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        code = code * 10 + (*p - '0');
+    }
+    if (code < 100 || (end - begin > 12 && begin[12] != ' ')) {
+        return false;
+    }
+    response_.statusCode_ = code;
+    if (end - begin > 13) {
+        response_.reason_ = {static_cast<uint32_t>(begin + 13 - response_.base_),
+                            static_cast<uint32_t>(end - begin - 13)};
+    }
+    state_ = kHeaders;
+    return true;
+}
+
+bool HttpResponseParser::parseHeader(const char* begin, const char* end) {
+    const char* colon = std::find(begin, end, ':');
+    if (colon == end || colon == begin || isSpace(*begin) || isSpace(colon[-1])) {
+        return false;
+    }
+    if (response_.headers_.size() >= kMaxHeaders) {
+        return false;
+    }
+    const char* value = colon + 1;
+    while (value < end && isSpace(*value)) {
+        ++value;
+    }
+    const char* valueEnd = end;
+    while (valueEnd > value && isSpace(valueEnd[-1])) {
+        --valueEnd;
+    }
+    const char* base = response_.base_;
+    HttpClientResponse::HeaderSpan h;
+    h.field = {static_cast<uint32_t>(begin - base), static_cast<uint32_t>(colon - begin)};
+    h.value = {static_cast<uint32_t>(value - base), static_cast<uint32_t>(valueEnd - value)};
+    response_.headers_.push_back(h);
+    return true;
+}
+
+HttpResponseParser::Result HttpResponseParser::headersComplete(bool headRequest) {
+    int code = response_.statusCode_;
+    if (headRequest || code < 200 || code == 204 || code == 304) {
+        state_ = kDone;
+        return kComplete;
+    }
+    StringPiece transferEncoding = response_.getHeader(StringPiece("Transfer-Encoding"));
+    if (!transferEncoding.empty()) {
+        // chunked must be the last coding, other codings run until the close
+        if (HttpRequest::containsToken(transferEncoding, StringPiece("chunked"))) {
+            response_.chunked_ = true;
+            state_ = kChunkSize;
+        } else {
+            response_.closeDelimited_ = true;
+            response_.body_.offset = static_cast<uint32_t>(pos_);
+            state_ = kBodyUntilClose;
+        }
+        return kNeedMore;
+    }
+    StringPiece contentLength = response_.getHeader(StringPiece("Content-Length"));
+    if (contentLength.empty()) {
+        response_.closeDelimited_ = true;
+        response_.body_.offset = static_cast<uint32_t>(pos_);
+        state_ = kBodyUntilClose;
+        return kNeedMore;
+    }
+    std::size_t length = 0;
+    for (char c : contentLength) {
+        if (c < '0' || c > '9' || length > maxBodyBytes_ / 10) {
+            return fail();
+        }
+        length = length * 10 + (c - '0');
+    }
+    if (length > maxBodyBytes_) {
+        return fail();
+    }
+    response_.body_ = {static_cast<uint32_t>(pos_), static_cast<uint32_t>(length)};
+    state_ = length == 0 ? kDone : kBody;
+    return state_ == kDone ? kComplete : kNeedMore;
+}
+
+}  // namespace dws::net
@@ -0,0 +1,102 @@
+#include "HttpServer.h"
+
+#include <utility>
+
+#include "Logging.h"
+
+namespace dws::net {
+
+namespace {
+
+void defaultHttpCallback(const HttpRequest&, HttpResponse* resp) {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setCloseConnection(true);
+}
+
+}  // namespace
+
+const std::size_t HttpServer::kMaxPendingOutput;
+
+HttpServer::HttpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+                       TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      httpCallback_(defaultHttpCallback),
+      maxBodyBytes_(HttpParser::kDefaultMaxBodyBytes) {
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf,
+                                      Timestamp receiveTime) { onMessage(conn, buf, receiveTime); });
+    server_.setWriteCompleteCallback(
+            [this](const TcpConnectionPtr& conn) { onWriteComplete(conn); });
+}
+
+void HttpServer::start() {
+    LOG(INFO) << "[HttpServer::start] HttpServer[" << server_.name() << "] starts listening on "
+              << server_.ipPort();
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->setContext(HttpParser(maxBodyBytes_));
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime) {
+    if (!conn->connected()) {
+        buf->retrieveAll();  // already answered with Connection: close
+        return;
+    }
+    HttpParser* parser = std::any_cast<HttpParser>(conn->getMutableContext());
+    Buffer* output = conn->outputBuffer();
+    bool close = false;
+    while (!close && buf->readableBytes() > 0) {
+        if (output->readableBytes() >= kMaxPendingOutput || conn->fileBytes() > 0) {
+            // resumed by onWriteComplete()
+            conn->stopRead();
+            break;
+        }
+        HttpParser::Result result = parser->parse(*buf);
+        if (result == HttpParser::kNeedMore) {
+            break;
+        }
+        if (result == HttpParser::kError) {
+            LOG(DEBUG) << "[HttpServer::onMessage] " << *conn << " bad request, answering "
+                       << parser->errorStatus();
+            HttpResponse response(output, true);
+            response.setStatusCode(parser->errorStatus());
+            response.finish();
+            buf->retrieveAll();
+            close = true;
+            break;
+        }
+        HttpRequest& request = parser->request();
+        request.setReceiveTime(receiveTime);
+        HttpResponse response(output, request);
+        httpCallback_(request, &response);
+        response.finish();
+        close = response.closeConnection();
+        buf->retrieve(parser->messageBytes());
+        parser->reset();
+        HttpResponse::FileBody* file = response.fileBody();
+        if (file->length > 0) {
+            // flushes the output first, later responses wait for the file
+            conn->sendFile(file->fd, file->offset, file->length, std::move(file->owner));
+        }
+    }
+    if (conn->fileBytes() == 0) {
+        conn->sendOutputBuffer();
+    }
+    if (close) {
+        conn->shutdown();
+    }
+}
+
+void HttpServer::onWriteComplete(const TcpConnectionPtr& conn) {
+    if (!conn->isReading() && conn->connected()) {
+        conn->startRead();
+        // pipelined requests may be waiting in the buffer without new input arriving
+        onMessage(conn, conn->inputBuffer(), Timestamp::now());
+    }
+}
+
+}  // namespace dws::net
@@ -0,0 +1,288 @@
+#include "StaticFileHandler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+namespace {
+
+struct ContentType {
+    const char* extension;
+    const char* type;
+};
+
+const ContentType kContentTypes[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "text/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"webp", "image/webp"},
+        {"ico", "image/x-icon"},
+        {"woff2", "font/woff2"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+        {"mp4", "video/mp4"},
+};
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+StringPiece trim(StringPiece s) {
+    while (!s.empty() && (s[0] == ' ' || s[0] == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s[s.size() - 1] == ' ' || s[s.size() - 1] == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// Whether the If-None-Match @c list names @c etag, by weak comparison.
+bool etagMatches(const StringPiece& list, const std::string& etag) {
+    const char* p = list.begin();
+    while (p <= list.end()) {
+        const char* comma = std::find(p, list.end(), ',');
+        StringPiece tag = trim(StringPiece(p, static_cast<int>(comma - p)));
+        if (tag.starts_with(StringPiece("W/"))) {
+            tag.remove_prefix(2);
+        }
+        if (tag == StringPiece("*") || tag == StringPiece(etag)) {
+            return true;
+        }
+        p = comma + 1;
+    }
+    return false;
+}
+
+// Non-empty digits only, small enough for any file size.
+bool parseOffset(StringPiece s, int64_t* out) {
+    if (s.empty() || s.size() > 18) {
+        return false;
+    }
+    int64_t n = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        n = n * 10 + (c - '0');
+    }
+    *out = n;
+    return true;
+}
+
+enum RangeResult { kWholeFile, kPartial, kUnsatisfiable };
+
+// One "bytes=first-last", "bytes=first-" or "bytes=-suffix" range of a
+// file of @c size bytes.  Syntax errors and multiple ranges are ignored,
+// as RFC 9110 allows.
+RangeResult parseRange(StringPiece value, int64_t size, int64_t* first, int64_t* last) {
+    value = trim(value);
+    if (!value.starts_with(StringPiece("bytes="))) {
+        return kWholeFile;
+    }
+    value.remove_prefix(6);
+    if (std::find(value.begin(), value.end(), ',') != value.end()) {
+        return kWholeFile;
+    }
+    const char* dash = std::find(value.begin(), value.end(), '-');
+    if (dash == value.end()) {
+        return kWholeFile;
+    }
+    StringPiece from = trim(StringPiece(value.begin(), static_cast<int>(dash - value.begin())));
+    StringPiece to = trim(StringPiece(dash + 1, static_cast<int>(value.end() - dash - 1)));
+    if (from.empty()) {
+        int64_t suffix = 0;
+        if (!parseOffset(to, &suffix)) {
+            return kWholeFile;
+        }
+        if (suffix == 0 || size == 0) {
+            return kUnsatisfiable;
+        }
+        *first = std::max<int64_t>(0, size - suffix);
+        *last = size - 1;
+        return kPartial;
+    }
+    int64_t begin = 0;
+    int64_t end = size - 1;
+    if (!parseOffset(from, &begin) || (!to.empty() && (!parseOffset(to, &end) || end < begin))) {
+        return kWholeFile;
+    }
+    if (begin >= size) {
+        return kUnsatisfiable;
+    }
+    *first = begin;
+    *last = std::min(end, size - 1);
+    return kPartial;
+}
+
+}  // namespace
+
+StaticFileHandler::StaticFileHandler(const std::string& root, const FileCache::Options& options)
+    : cache_(root, options) {}
+
+void StaticFileHandler::handle(const HttpRequest& req, HttpResponse* resp) {
+    if (req.method() != HttpRequest::kGet && req.method() != HttpRequest::kHead) {
+        resp->setStatusCode(HttpResponse::k405MethodNotAllowed);
+        resp->addHeader(StringPiece("Allow"), StringPiece("GET, HEAD"));
+        resp->finish();
+        return;
+    }
+    std::string path;
+    if (!decodePath(req.path(), &path) || path.empty() || path[0] != '/') {
+        resp->setStatusCode(HttpResponse::k400BadRequest);
+        resp->finish();
+        return;
+    }
+    if (path.back() == '/') {
+        path += "index.html";
+    }
+    int savedErrno = 0;
+    FileCache::FilePtr file = cache_.open(path, &savedErrno);
+    if (!file) {
+        if (savedErrno == EISDIR) {
+            resp->setStatusCode(HttpResponse::k301MovedPermanently);
+            resp->addHeader(StringPiece("Location"), StringPiece(req.path().as_string() + "/"));
+        } else if (savedErrno == ENOENT || savedErrno == ENOTDIR) {
+            resp->setStatusCode(HttpResponse::k404NotFound);
+        } else if (savedErrno == EACCES || savedErrno == EPERM) {
+            resp->setStatusCode(HttpResponse::k403Forbidden);
+        } else {
+            LOG(ERROR) << "[StaticFileHandler::handle] " << path << " " << strerror_tl(savedErrno);
+            resp->setStatusCode(HttpResponse::k500InternalServerError);
+        }
+        resp->finish();
+        return;
+    }
+
+    // If-Modified-Since only counts without If-None-Match
+    bool notModified = false;
+    StringPiece ifNoneMatch = req.getHeader(StringPiece("If-None-Match"));
+    if (!ifNoneMatch.empty()) {
+        notModified = etagMatches(ifNoneMatch, file->etag);
+    } else {
+        StringPiece ifModifiedSince = req.getHeader(StringPiece("If-Modified-Since"));
+        if (!ifModifiedSince.empty()) {
+            int64_t since = FileCache::parseHttpDate(ifModifiedSince.as_string());
+            notModified = since >= 0 && file->mtimeNs / 1000000000 <= since;
+        }
+    }
+    if (notModified) {
+        resp->setStatusCode(HttpResponse::k304NotModified);
+        resp->addHeader(StringPiece("ETag"), StringPiece(file->etag));
+        resp->addHeader(StringPiece("Last-Modified"), StringPiece(file->lastModified));
+        resp->finish();
+        return;
+    }
+
+    int64_t first = 0;
+    int64_t last = file->size - 1;
+    RangeResult range = kWholeFile;
+    StringPiece rangeHeader = req.getHeader(StringPiece("Range"));
+    if (!rangeHeader.empty() && req.method() == HttpRequest::kGet) {
+        // a range of another version of the file would be garbage
+        StringPiece ifRange = trim(req.getHeader(StringPiece("If-Range")));
+        if (ifRange.empty() || ifRange == StringPiece(file->etag) ||
+            ifRange == StringPiece(file->lastModified)) {
+            range = parseRange(rangeHeader, file->size, &first, &last);
+        }
+    }
+    char contentRange[64];
+    if (range == kUnsatisfiable) {
+        snprintf(contentRange, sizeof contentRange, "bytes */%lld",
+                 static_cast<long long>(file->size));
+        resp->setStatusCode(HttpResponse::k416RangeNotSatisfiable);
+        resp->addHeader(StringPiece("Content-Range"), StringPiece(contentRange));
+        resp->finish();
+        return;
+    }
+    if (range == kPartial) {
+        snprintf(contentRange, sizeof contentRange, "bytes %lld-%lld/%lld",
+                 static_cast<long long>(first), static_cast<long long>(last),
+                 static_cast<long long>(file->size));
+        resp->setStatusCode(HttpResponse::k206PartialContent);
+        resp->addHeader(StringPiece("Content-Range"), StringPiece(contentRange));
+    }
+    resp->setContentType(StringPiece(contentType(StringPiece(path))));
+    resp->addHeader(StringPiece("ETag"), StringPiece(file->etag));
+    resp->addHeader(StringPiece("Last-Modified"), StringPiece(file->lastModified));
+    resp->addHeader(StringPiece("Accept-Ranges"), StringPiece("bytes"));
+    std::size_t length = static_cast<std::size_t>(last - first + 1);
+    if (file->inMemory) {
+        resp->setBody(StringPiece(file->contents.data() + first, static_cast<int>(length)));
+    } else {
+        resp->setFileBody(file->fd, first, length, file);
+    }
+}
+
+const char* StaticFileHandler::contentType(const StringPiece& path) {
+    const char* dot = path.end();
+    while (dot != path.begin() && dot[-1] != '.' && dot[-1] != '/') {
+        --dot;
+    }
+    if (dot != path.begin() && dot[-1] == '.') {
+        StringPiece extension(dot, static_cast<int>(path.end() - dot));
+        for (const ContentType& type : kContentTypes) {
+            if (HttpRequest::equalsIgnoreCase(extension, StringPiece(type.extension))) {
+                return type.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+bool StaticFileHandler::decodePath(const StringPiece& path, std::string* out) {
+    out->clear();
+    out->reserve(path.size());
+    for (int i = 0; i < path.size(); ++i) {
+        char c = path[i];
+        if (c == '%') {
+            int high = i + 2 < path.size() ? hexValue(path[i + 1]) : -1;
+            int low = i + 2 < path.size() ? hexValue(path[i + 2]) : -1;
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            c = static_cast<char>(high * 16 + low);
+            i += 2;
+        }
+        if (c == '\0') {
+            return false;
+        }
+        out->push_back(c);
+    }
+    // decoded first, so "%2e%2e" is caught as well
+    std::size_t start = 0;
+    while (start <= out->size()) {
+        std::size_t end = std::min(out->find('/', start), out->size());
+        if (end - start == 2 && out->compare(start, 2, "..") == 0) {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+}  // namespace dws::net
@@ -0,0 +1,229 @@
+#include "WebSocketCodec.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+#include "Buffer.h"
+#include "Endian.h"
+
+namespace dws::net::websocket {
+
+namespace {
+
+const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+// SHA-1 (RFC 3174) of a short message, only used by the handshake.
+void sha1(const std::string& message, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = message;
+    uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56) {
+        data.push_back('\0');
+    }
+    for (int i = 7; i >= 0; --i) {
+        data.push_back(static_cast<char>(bitLength >> (i * 8)));
+    }
+    for (std::size_t chunk = 0; chunk < data.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            uint32_t be = 0;
+            memcpy(&be, data.data() + chunk + i * 4, sizeof be);
+            w[i] = sockets::networkToHost32(be);
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f = 0;
+            uint32_t k = 0;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i) {
+        uint32_t be = sockets::hostToNetwork32(h[i]);
+        memcpy(digest + i * 4, &be, sizeof be);
+    }
+}
+
+std::string base64(const unsigned char* data, std::size_t len) {
+    static const char kTable[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    result.reserve((len + 2) / 3 * 4);
+    for (std::size_t i = 0; i < len; i += 3) {
+        uint32_t n = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < len) n |= static_cast<uint32_t>(data[i + 1]) << 8;
+        if (i + 2 < len) n |= data[i + 2];
+        result.push_back(kTable[(n >> 18) & 63]);
+        result.push_back(kTable[(n >> 12) & 63]);
+        result.push_back(i + 1 < len ? kTable[(n >> 6) & 63] : '=');
+        result.push_back(i + 2 < len ? kTable[n & 63] : '=');
+    }
+    return result;
+}
+
+}  // namespace
+
+ParseResult parseFrameHeader(const char* data, std::size_t len, FrameHeader* header) {
+    if (len < 2) {
+        return kNeedMore;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    if (p[0] & 0x70) {
+        return kBadFrame;  // RSV bits without a negotiated extension
+    }
+    header->fin = (p[0] & 0x80) != 0;
+    unsigned opcode = p[0] & 0x0F;
+    header->masked = (p[1] & 0x80) != 0;
+    uint64_t length = p[1] & 0x7F;
+    std::size_t offset = 2;
+    if (length == 126) {
+        if (len < offset + 2) {
+            return kNeedMore;
+        }
+        length = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+        offset += 2;
+    } else if (length == 127) {
+        if (len < offset + 8) {
+            return kNeedMore;
+        }
+        uint64_t be = 0;
+        memcpy(&be, data + offset, sizeof be);
+        length = sockets::networkToHost64(be);
+        if (length >> 63) {
+            return kBadFrame;  // the most significant bit must be 0, section 5.2
+        }
+        offset += 8;
+    }
+    if (header->masked) {
+        if (len < offset + 4) {
+            return kNeedMore;
+        }
+        memcpy(header->maskKey, data + offset, 4);
+        offset += 4;
+    }
+    switch (opcode) {
+        case kContinuation:
+        case kText:
+        case kBinary:
+            break;
+        case kClose:
+        case kPing:
+        case kPong:
+            // control frames are never fragmented and carry at most 125 bytes
+            if (!header->fin || length > 125) {
+                return kBadFrame;
+            }
+            break;
+        default:
+            return kBadFrame;
+    }
+    header->opcode = static_cast<Opcode>(opcode);
+    header->payloadLength = length;
+    header->headerBytes = offset;
+    return kOk;
+}
+
+void unmask(char* data, std::size_t len, const char key[4]) {
+    uint32_t key32 = 0;
+    memcpy(&key32, key, sizeof key32);
+    std::size_t i = 0;
+    // every block is a multiple of 4 bytes, so the key stays in phase
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(key32));
+    for (; i + 32 <= len; i += 32) {
+        __m256i* p = reinterpret_cast<__m256i*>(data + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), mask256));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i mask128 = _mm_set1_epi32(static_cast<int>(key32));
+    for (; i + 16 <= len; i += 16) {
+        __m128i* p = reinterpret_cast<__m128i*>(data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask128));
+    }
+#endif
+    const uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, data + i, sizeof word);
+        word ^= key64;
+        memcpy(data + i, &word, sizeof word);
+    }
+    for (; i < len; ++i) {
+        data[i] = static_cast<char>(data[i] ^ key[i & 3]);
+    }
+}
+
+std::size_t encodeFrameHeader(char* out, Opcode opcode, std::size_t payloadLength, bool fin) {
+    unsigned char* p = reinterpret_cast<unsigned char*>(out);
+    p[0] = static_cast<unsigned char>((fin ? 0x80 : 0) | opcode);
+    if (payloadLength < 126) {
+        p[1] = static_cast<unsigned char>(payloadLength);
+        return 2;
+    }
+    if (payloadLength <= 0xFFFF) {
+        p[1] = 126;
+        p[2] = static_cast<unsigned char>(payloadLength >> 8);
+        p[3] = static_cast<unsigned char>(payloadLength);
+        return 4;
+    }
+    p[1] = 127;
+    uint64_t be = sockets::hostToNetwork64(payloadLength);
+    memcpy(out + 2, &be, sizeof be);
+    return 10;
+}
+
+void appendFrame(Buffer* out, Opcode opcode, const StringPiece& payload, bool fin) {
+    char header[kMaxHeaderBytes];
+    out->append(header, encodeFrameHeader(header, opcode, payload.size(), fin));
+    out->append(payload);
+}
+
+std::string encodeFrame(Opcode opcode, const StringPiece& payload, bool fin) {
+    char header[kMaxHeaderBytes];
+    std::size_t headerBytes = encodeFrameHeader(header, opcode, payload.size(), fin);
+    std::string frame;
+    frame.reserve(headerBytes + payload.size());
+    frame.append(header, headerBytes);
+    frame.append(payload.data(), payload.size());
+    return frame;
+}
+
+std::string acceptKey(const StringPiece& clientKey) {
+    unsigned char digest[20];
+    sha1(clientKey.as_string() + kGuid, digest);
+    return base64(digest, sizeof digest);
+}
+
+}  // namespace dws::net::websocket
@@ -0,0 +1,261 @@
+#include "WebSocketServer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ConnectionRegistry.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "HttpParser.h"
+#include "HttpResponse.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+struct WebSocketServer::Session {
+    HttpParser parser;
+    bool upgraded = false;
+    bool closing = false;  // our close frame has been sent
+    bool fragmented = false;
+    websocket::Opcode messageOpcode = websocket::kText;
+    std::string message;  // reassembled fragments
+};
+
+const std::size_t WebSocketServer::kDefaultMaxMessageBytes;
+
+WebSocketServer::WebSocketServer(EventLoop* loop, const InetAddress& listenAddr,
+                                 const std::string& name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      maxMessageBytes_(kDefaultMaxMessageBytes),
+      numSessions_(0) {
+    // sessions are kept per loop, keyed by the loop index in the id
+    server_.disableMigration();
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf,
+                                      Timestamp receiveTime) { onMessage(conn, buf, receiveTime); });
+}
+
+void WebSocketServer::start() {
+    LOG(INFO) << "[WebSocketServer::start] WebSocketServer[" << server_.name()
+              << "] starts listening on " << server_.ipPort();
+    server_.start();
+    loops_ = server_.threadPool()->getAllLoops();
+    sessions_.resize(loops_.size());
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->setContext(std::make_shared<Session>());
+        return;
+    }
+    auto session = std::any_cast<std::shared_ptr<Session>>(conn->getContext());
+    if (session->upgraded) {
+        sessions_[ConnectionRegistry::loopIndexOf(conn->id())].erase(conn->id());
+        numSessions_.fetch_sub(1, std::memory_order_relaxed);
+        if (closeCallback_) {
+            closeCallback_(conn);
+        }
+    }
+}
+
+void WebSocketServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getContext()).get();
+    if (!conn->connected()) {
+        buf->retrieveAll();
+        return;
+    }
+    if (!session->upgraded && !handshake(conn, session, buf)) {
+        return;
+    }
+    // frames may follow the handshake in the same read
+    if (buf->readableBytes() > 0) {
+        onFrames(conn, session, buf);
+    }
+}
+
+bool WebSocketServer::handshake(const TcpConnectionPtr& conn, Session* session, Buffer* buf) {
+    HttpParser::Result result = session->parser.parse(*buf);
+    if (result == HttpParser::kNeedMore) {
+        return false;
+    }
+    Buffer* output = conn->outputBuffer();
+    if (result == HttpParser::kError) {
+        HttpResponse response(output, true);
+        response.setStatusCode(session->parser.errorStatus());
+        response.finish();
+        buf->retrieveAll();
+        conn->sendOutputBuffer();
+        conn->shutdown();
+        return false;
+    }
+    const HttpRequest& request = session->parser.request();
+    StringPiece key = request.getHeader(StringPiece("Sec-WebSocket-Key"));
+    if (request.method() != HttpRequest::kGet || request.version() != HttpRequest::kHttp11 ||
+        !HttpRequest::containsToken(request.getHeader(StringPiece("Upgrade")),
+                                    StringPiece("websocket")) ||
+        !HttpRequest::containsToken(request.getHeader(StringPiece("Connection")),
+                                    StringPiece("Upgrade")) ||
+        request.getHeader(StringPiece("Sec-WebSocket-Version")) != StringPiece("13") ||
+        key.empty()) {
+        HttpResponse response(output, true);
+        response.setStatusCode(400);
+        response.addHeader(StringPiece("Sec-WebSocket-Version"), StringPiece("13"));
+        response.finish();
+        buf->retrieveAll();
+        conn->sendOutputBuffer();
+        conn->shutdown();
+        return false;
+    }
+
+    HttpResponse response(output, false);
+    response.setStatusCode(101);
+    response.addHeader(StringPiece("Upgrade"), StringPiece("websocket"));
+    response.addHeader(StringPiece("Connection"), StringPiece("Upgrade"));
+    std::string accept = websocket::acceptKey(key);
+    response.addHeader(StringPiece("Sec-WebSocket-Accept"), StringPiece(accept));
+    response.finish();
+    conn->sendOutputBuffer();
+
+    session->upgraded = true;
+    sessions_[ConnectionRegistry::loopIndexOf(conn->id())].emplace(conn->id(), conn);
+    numSessions_.fetch_add(1, std::memory_order_relaxed);
+    if (openCallback_) {
+        openCallback_(conn, request);
+    }
+    buf->retrieve(session->parser.messageBytes());
+    session->parser.reset();
+    return true;
+}
+
+void WebSocketServer::onFrames(const TcpConnectionPtr& conn, Session* session, Buffer* buf) {
+    while (conn->connected()) {
+        websocket::FrameHeader header;
+        websocket::ParseResult result =
+                websocket::parseFrameHeader(buf->peek(), buf->readableBytes(), &header);
+        if (result == websocket::kNeedMore) {
+            break;
+        }
+        // client frames must be masked, RFC 6455 section 5.1
+        if (result == websocket::kBadFrame || !header.masked) {
+            failConnection(conn, session, websocket::kProtocolError);
+            return;
+        }
+        uint64_t pending = session->fragmented ? session->message.size() : 0;
+        // no sums, a huge length must not wrap around the limit
+        if (pending > maxMessageBytes_ || header.payloadLength > maxMessageBytes_ - pending) {
+            failConnection(conn, session, websocket::kMessageTooBig);
+            return;
+        }
+        std::size_t frameBytes = header.headerBytes + header.payloadLength;
+        if (buf->readableBytes() < frameBytes) {
+            break;
+        }
+        char* payload = buf->beginRead() + header.headerBytes;
+        std::size_t length = header.payloadLength;
+        websocket::unmask(payload, length, header.maskKey);
+        StringPiece data(payload, static_cast<int>(length));
+
+        switch (header.opcode) {
+            case websocket::kPing:
+                send(conn, data, websocket::kPong);
+                break;
+            case websocket::kPong:
+                break;
+            case websocket::kClose:
+                // a body holds at least the status code, RFC 6455 section 5.5.1
+                if (length == 1) {
+                    failConnection(conn, session, websocket::kProtocolError);
+                    return;
+                }
+                if (!session->closing) {
+                    // echo the status code, RFC 6455 section 5.5.1
+                    send(conn, StringPiece(payload, static_cast<int>(length < 2 ? length : 2)),
+                         websocket::kClose);
+                    session->closing = true;
+                }
+                buf->retrieveAll();
+                conn->shutdown();
+                return;
+            case websocket::kContinuation:
+                if (!session->fragmented) {
+                    failConnection(conn, session, websocket::kProtocolError);
+                    return;
+                }
+                session->message.append(payload, length);
+                if (header.fin) {
+                    session->fragmented = false;
+                    if (messageCallback_) {
+                        messageCallback_(conn, StringPiece(session->message),
+                                         session->messageOpcode);
+                    }
+                    session->message.clear();
+                }
+                break;
+            default:  // kText, kBinary
+                if (session->fragmented) {
+                    failConnection(conn, session, websocket::kProtocolError);
+                    return;
+                }
+                if (header.fin) {
+                    if (messageCallback_) {
+                        messageCallback_(conn, data, header.opcode);
+                    }
+                } else {
+                    session->fragmented = true;
+                    session->messageOpcode = header.opcode;
+                    session->message.assign(payload, length);
+                }
+                break;
+        }
+        buf->retrieve(frameBytes);
+    }
+}
+
+void WebSocketServer::failConnection(const TcpConnectionPtr& conn, Session* session,
+                                     uint16_t code) {
+    LOG(DEBUG) << "[WebSocketServer::failConnection] " << *conn << " closing with "
+               << code;
+    conn->inputBuffer()->retrieveAll();
+    if (!session->closing) {
+        session->closing = true;
+        close(conn, code);
+    }
+    conn->shutdown();
+}
+
+void WebSocketServer::send(const TcpConnectionPtr& conn, const StringPiece& message,
+                           websocket::Opcode opcode) {
+    Buffer frame;
+    websocket::appendFrame(&frame, opcode, message);
+    conn->send(&frame);
+}
+
+void WebSocketServer::close(const TcpConnectionPtr& conn, uint16_t code,
+                            const StringPiece& reason) {
+    char payload[125];
+    payload[0] = static_cast<char>(code >> 8);
+    payload[1] = static_cast<char>(code);
+    int reasonLength = std::min(reason.size(), static_cast<int>(sizeof payload) - 2);
+    if (reasonLength > 0) {
+        memcpy(payload + 2, reason.data(), reasonLength);
+    }
+    send(conn, StringPiece(payload, 2 + reasonLength), websocket::kClose);
+}
+
+void WebSocketServer::broadcast(const StringPiece& message, websocket::Opcode opcode) {
+    auto frame = std::make_shared<const std::string>(websocket::encodeFrame(opcode, message));
+    for (std::size_t i = 0; i < loops_.size(); ++i) {
+        loops_[i]->runInLoop([this, i, frame] { broadcastInLoop(i, frame); });
+    }
+}
+
+void WebSocketServer::broadcastInLoop(std::size_t loopIndex,
+                                      const std::shared_ptr<const std::string>& frame) {
+    loops_[loopIndex]->assertInLoopThread();
+    StringPiece data(*frame);
+    for (const auto& entry : sessions_[loopIndex]) {
+        entry.second->send(data);
+    }
+}
+
+}  // namespace dws::net
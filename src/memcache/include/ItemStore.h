@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "StringPiece.h"
+#include "noncopyable.h"
+
+namespace dws::net::memcache {
+
+/// Items of a memcached server in slab-allocated memory, the way memcached
+/// lays them out, for use by a single thread without any locking.
+///
+/// Memory is taken in pages of kPageBytes and carved into chunks of one
+/// size class, the classes growing by a factor from kMinChunkBytes up to a
+/// whole page.  An item lives in the smallest chunk it fits, key and value
+/// right behind its header; the value is followed by "\r\n" so that the
+/// text protocol can send it as is.  Once the memory limit is reached a new
+/// item evicts the least recently used one of its class; every class gets
+/// its first page regardless, so the limit may be exceeded by as many pages
+/// as there are classes in use.
+///
+/// An item may be pinned, e.g. while a writev() refers to its value: it is
+/// then neither evicted nor freed when replaced or deleted, the chunk is
+/// reclaimed by the last release().
+///
+/// Expiration times are absolute seconds since the epoch, 0 for never, see
+/// absoluteExptime() for the protocol's convention; expired items are
+/// dropped lazily when looked up or evicted.
+class ItemStore : noncopyable {
+ public:
+    struct Item {
+        Item* prev;  // LRU of the size class, most recent first
+        Item* next;
+        Item* hashNext;
+        uint64_t cas;
+        int64_t exptime;
+        uint32_t flags;
+        uint32_t valueBytes;  // without the "\r\n"
+        uint32_t refcount;
+        uint8_t keyBytes;
+        uint8_t slabClass;
+        bool linked;  // reachable by key
+
+        const char* key() const { return reinterpret_cast<const char*>(this + 1); }
+        const char* value() const { return key() + keyBytes; }
+        char* value() { return reinterpret_cast<char*>(this + 1) + keyBytes; }
+    };
+
+    enum StoreMode { kSet, kAdd, kReplace, kAppend, kPrepend, kCas };
+    enum Result { kStored, kNotStored, kExists, kNotFound, kDeleted, kTooLarge, kNoMemory };
+    enum ArithResult { kArithOk, kArithNotFound, kNonNumeric, kArithNoMemory };
+
+    static const std::size_t kPageBytes = 1024 * 1024;
+    static const std::size_t kMinChunkBytes = 96;
+    static const std::size_t kMaxKeyBytes = 250;
+    /// Relative expiration times are limited to 30 days.
+    static const int64_t kMaxRelativeExptime = 60 * 60 * 24 * 30;
+
+    /// @c memoryLimit is rounded up to whole pages.
+    explicit ItemStore(std::size_t memoryLimit, double growthFactor = 1.25);
+    ~ItemStore();
+
+    /// Makes a protocol expiration time absolute: 0 stays 0, negative ones
+    /// are already expired, up to kMaxRelativeExptime counts from @c now.
+    static int64_t absoluteExptime(int64_t exptime, int64_t now);
+    /// The largest value that fits a page along with @c keyBytes.
+    static std::size_t maxValueBytes(std::size_t keyBytes);
+
+    /// Returns the live item, most recently used from now on, or nullptr.
+    /// Valid until the next call changing the store unless pinned.
+    Item* get(const StringPiece& key, int64_t now);
+    void pin(Item* item) { ++item->refcount; }
+    void release(Item* item);
+
+    /// With kCas the item is stored only if its CAS value is still @c cas;
+    /// kSet, kAdd and kReplace check it too when it is not 0.  On kStored
+    /// @c newCas receives the stored item's CAS value.
+    Result store(StoreMode mode, const StringPiece& key, const StringPiece& value,
+                 uint32_t flags, int64_t exptime, uint64_t cas, int64_t now,
+                 uint64_t* newCas = nullptr);
+    /// kDeleted, kNotFound, or kExists when @c cas is given and differs.
+    Result remove(const StringPiece& key, uint64_t cas, int64_t now);
+    /// Adds to or subtracts from a decimal value, incrementing wraps at 2^64
+    /// and decrementing stops at 0.
+    ArithResult arithmetic(const StringPiece& key, bool increment, uint64_t delta, int64_t now,
+                           uint64_t* value, uint64_t* newCas = nullptr);
+    bool touch(const StringPiece& key, int64_t exptime, int64_t now);
+    void flushAll();
+
+    std::size_t numItems() const { return numItems_; }
+    std::size_t memoryUsed() const { return numPages_ * kPageBytes; }
+    std::size_t memoryLimit() const { return maxPages_ * kPageBytes; }
+    uint64_t evictions() const { return evictions_; }
+    std::size_t numSlabClasses() const { return classes_.size(); }
+    std::size_t chunkBytes(std::size_t slabClass) const { return classes_[slabClass].chunkBytes; }
+
+ private:
+    struct SlabClass {
+        std::size_t chunkBytes = 0;
+        Item* freeList = nullptr;  // linked by next
+        Item* head = nullptr;      // LRU
+        Item* tail = nullptr;
+        std::size_t pages = 0;
+    };
+
+    /// Eviction looks at this many items from the LRU tail for one that is
+    /// not pinned.
+    static const int kEvictionTries = 5;
+
+    /// A chunk of the size class fitting @c bytes, evicting if needed.
+    Item* allocate(std::size_t bytes, int64_t now);
+    bool growClass(SlabClass* slabClass);
+    void freeChunk(Item* item);
+    Item* newItem(const StringPiece& key, std::size_t valueBytes, uint32_t flags,
+                  int64_t exptime, int64_t now);
+    Item** findSlot(const StringPiece& key, std::size_t hash);
+    /// Makes @c item reachable, replacing @c old if given.
+    void link(Item* item, Item* old);
+    void unlink(Item* item);
+    void lruRemove(Item* item);
+    void lruPushFront(Item* item);
+    void growHashTable();
+    bool expired(const Item* item, int64_t now) const {
+        return item->exptime != 0 && item->exptime <= now;
+    }
+
+    std::vector<SlabClass> classes_;
+    std::vector<char*> pages_;
+    std::size_t numPages_;
+    std::size_t maxPages_;
+    std::vector<Item*> buckets_;
+    std::size_t numItems_;
+    uint64_t nextCas_;
+    uint64_t evictions_;
+};
+
+}  // namespace dws::net::memcache
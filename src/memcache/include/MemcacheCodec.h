@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "StringPiece.h"
+
+namespace dws::net {
+
+class Buffer;
+
+/// The memcached text and binary protocols.
+///
+/// Parsing never copies: keys and values are views into the parsed bytes,
+/// which stay valid until they are retrieved from the Buffer.  A request
+/// starting with the binary magic byte 0x80 is binary, any other is text.
+namespace memcache {
+
+enum Command {
+    kGet,
+    kGets,
+    kSet,
+    kAdd,
+    kReplace,
+    kAppend,
+    kPrepend,
+    kCas,
+    kDelete,
+    kIncr,
+    kDecr,
+    kTouch,
+    kFlushAll,
+    kVersion,
+    kStats,
+    kVerbosity,
+    kNoop,
+    kQuit,
+    kUnknown,
+};
+
+/// kClientError consumed a request that gets an error reply, the connection
+/// stays usable; kProtocolError leaves the stream unparsable.
+enum ParseResult { kNeedMore, kOk, kClientError, kProtocolError };
+
+const std::size_t kMaxLineBytes = 64 * 1024;
+/// A larger text data block is refused without being buffered.
+const std::size_t kMaxDataBytes = 64 * 1024 * 1024;
+
+namespace binary {
+
+const std::size_t kHeaderBytes = 24;
+const uint8_t kRequestMagic = 0x80;
+const uint8_t kResponseMagic = 0x81;
+
+enum Opcode : uint8_t {
+    kOpGet = 0x00,
+    kOpSet = 0x01,
+    kOpAdd = 0x02,
+    kOpReplace = 0x03,
+    kOpDelete = 0x04,
+    kOpIncrement = 0x05,
+    kOpDecrement = 0x06,
+    kOpQuit = 0x07,
+    kOpFlush = 0x08,
+    kOpGetQ = 0x09,
+    kOpNoop = 0x0a,
+    kOpVersion = 0x0b,
+    kOpGetK = 0x0c,
+    kOpGetKQ = 0x0d,
+    kOpAppend = 0x0e,
+    kOpPrepend = 0x0f,
+    kOpStat = 0x10,
+    kOpSetQ = 0x11,
+    kOpAddQ = 0x12,
+    kOpReplaceQ = 0x13,
+    kOpDeleteQ = 0x14,
+    kOpIncrementQ = 0x15,
+    kOpDecrementQ = 0x16,
+    kOpQuitQ = 0x17,
+    kOpFlushQ = 0x18,
+    kOpAppendQ = 0x19,
+    kOpPrependQ = 0x1a,
+    kOpTouch = 0x1c,
+};
+
+enum Status : uint16_t {
+    kNoError = 0x0000,
+    kKeyNotFound = 0x0001,
+    kKeyExists = 0x0002,
+    kValueTooLarge = 0x0003,
+    kInvalidArguments = 0x0004,
+    kItemNotStored = 0x0005,
+    kNonNumericValue = 0x0006,
+    kUnknownCommand = 0x0081,
+    kOutOfMemory = 0x0082,
+};
+
+/// Incrementing a missing key with this expiration fails instead of
+/// creating it.
+const uint32_t kNoAutoCreate = 0xffffffff;
+
+void appendResponseHeader(Buffer* out, uint8_t opcode, Status status, uint16_t keyBytes,
+                          uint8_t extrasBytes, uint32_t bodyBytes, uint32_t opaque, uint64_t cas);
+
+}  // namespace binary
+
+struct Request {
+    Command command = kUnknown;
+    bool binary = false;
+    /// "noreply" in text, a quiet opcode in binary: only failures are
+    /// answered, and GetQ/GetKQ misses not even those.
+    bool noreply = false;
+    bool returnKey = false;  // GetK and GetKQ
+    uint8_t opcode = 0;
+    uint32_t opaque = 0;
+    StringPiece key;
+    StringPiece value;
+    /// Every key of a text get or gets, the first one also in @c key.
+    std::vector<StringPiece> keys;
+    uint32_t flags = 0;
+    int64_t exptime = 0;
+    uint64_t cas = 0;
+    uint64_t delta = 0;
+    uint64_t initial = 0;  // binary increment and decrement
+    /// The text reply line of kClientError, e.g. "CLIENT_ERROR bad data chunk".
+    const char* error = nullptr;
+};
+
+/// Parses the request at the start of @c buf; @c bytes is its length on
+/// kOk and kClientError.
+ParseResult parseRequest(const Buffer& buf, Request* request, std::size_t* bytes);
+
+}  // namespace memcache
+
+}  // namespace dws::net
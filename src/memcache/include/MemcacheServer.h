@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ItemStore.h"
+#include "MemcacheCodec.h"
+#include "TcpServer.h"
+
+namespace dws::net {
+
+/// Cache server speaking the memcached text and binary protocols, an
+/// example of building a memcached service on dws.
+///
+/// Keys are sharded across the IO loops by hash like ShardedKvServer does,
+/// every shard is a memcache::ItemStore owned by exactly one loop and needs
+/// no lock.  Requests on keys of the connection's own loop run inline;
+/// the others of one read are batched per shard and answered with a single
+/// batch back, replies going out in request order.  Values of inline hits
+/// are not copied: the replies of one read are gathered into a single
+/// writev() straight from the pinned items, which is what makes large
+/// multi-gets cheap.  Supports get, gets, set, add, replace, append,
+/// prepend, cas, delete, incr, decr, touch, flush_all (without delay),
+/// version, stats, verbosity and quit, and the binary counterparts including
+/// the quiet opcodes.  Connections must not be migrated to other loops.
+class MemcacheServer : noncopyable {
+ public:
+    MemcacheServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+                   TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+    TcpServer* tcpServer() { return &server_; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    /// Memory for items over all shards, 64 MiB by default.  Before start().
+    void setMemoryLimit(std::size_t bytes) { memoryLimit_ = bytes; }
+    void start();
+
+    /// Items over all shards, thread safe.
+    std::size_t numItems() const;
+    /// Items evicted to make room over all shards, thread safe.
+    uint64_t evictions() const;
+
+ private:
+    struct Shard {
+        EventLoop* loop = nullptr;
+        std::unique_ptr<memcache::ItemStore> store;
+        std::atomic<std::size_t> items{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+    struct Session;
+    struct Batch;
+    class Output;
+
+    static const std::size_t kMaxPendingOutput = 1024 * 1024;
+    /// Requests read but not answered yet, per connection.
+    static const std::size_t kMaxPendingReplies = 64 * 1024;
+    static const char kVersion[];
+
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void resumeReading(const TcpConnectionPtr& conn);
+    std::size_t shardOf(const StringPiece& key) const;
+    /// Runs a request on one key inline or adds it to its shard's batch.
+    void dispatch(const TcpConnectionPtr& conn, Session* session, std::size_t self,
+                  const memcache::Request& request, int64_t now);
+    void dispatchBatches(Session* session);
+    void runBatch(Shard* shard, const std::shared_ptr<Batch>& batch);
+    void completeBatch(const TcpConnectionPtr& conn, const Batch& batch);
+    /// Writes the replies gathered by the current read.
+    void flushReplies(const TcpConnectionPtr& conn, Session* session, std::size_t self);
+    /// Requests without a key and invalid ones, in the connection's loop.
+    void executeLocal(Session* session, const memcache::Request& request,
+                      memcache::ParseResult result, std::size_t self, Output* out);
+    static void execute(Shard* shard, const memcache::Request& request, int64_t now,
+                        Output* out);
+
+    TcpServer server_;
+    std::size_t memoryLimit_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,384 @@
+#include "ItemStore.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace dws::net::memcache {
+
+namespace {
+
+const std::size_t kInitialBuckets = 4096;
+
+std::size_t hashOf(const char* key, std::size_t bytes) {
+    return std::hash<std::string_view>()(std::string_view(key, bytes));
+}
+
+bool parseCounter(const char* p, std::size_t bytes, uint64_t* value) {
+    if (bytes == 0 || bytes > 20) {
+        return false;
+    }
+    uint64_t n = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        uint64_t digit = static_cast<uint64_t>(p[i] - '0');
+        if (n > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        n = n * 10 + digit;
+    }
+    *value = n;
+    return true;
+}
+
+}  // namespace
+
+const std::size_t ItemStore::kPageBytes;
+const std::size_t ItemStore::kMinChunkBytes;
+const std::size_t ItemStore::kMaxKeyBytes;
+const int64_t ItemStore::kMaxRelativeExptime;
+const int ItemStore::kEvictionTries;
+
+ItemStore::ItemStore(std::size_t memoryLimit, double growthFactor)
+    : numPages_(0),
+      maxPages_(std::max<std::size_t>(1, (memoryLimit + kPageBytes - 1) / kPageBytes)),
+      buckets_(kInitialBuckets, nullptr),
+      numItems_(0),
+      nextCas_(0),
+      evictions_(0) {
+    assert(growthFactor > 1.0);
+    double size = kMinChunkBytes;
+    while (size < kPageBytes / growthFactor) {
+        // chunks stay 8-byte aligned for the item header
+        std::size_t chunk = (static_cast<std::size_t>(size) + 7) & ~static_cast<std::size_t>(7);
+        if (classes_.empty() || chunk > classes_.back().chunkBytes) {
+            classes_.emplace_back();
+            classes_.back().chunkBytes = chunk;
+        }
+        size *= growthFactor;
+    }
+    classes_.emplace_back();
+    classes_.back().chunkBytes = kPageBytes;
+}
+
+ItemStore::~ItemStore() {
+    for (char* page : pages_) {
+        free(page);
+    }
+}
+
+int64_t ItemStore::absoluteExptime(int64_t exptime, int64_t now) {
+    if (exptime == 0) {
+        return 0;
+    }
+    if (exptime < 0) {
+        return -1;
+    }
+    return exptime <= kMaxRelativeExptime ? now + exptime : exptime;
+}
+
+std::size_t ItemStore::maxValueBytes(std::size_t keyBytes) {
+    return kPageBytes - sizeof(Item) - keyBytes - 2;
+}
+
+ItemStore::Item* ItemStore::get(const StringPiece& key, int64_t now) {
+    Item* item = *findSlot(key, hashOf(key.data(), key.size()));
+    if (item == nullptr) {
+        return nullptr;
+    }
+    if (expired(item, now)) {
+        unlink(item);
+        return nullptr;
+    }
+    lruRemove(item);
+    lruPushFront(item);
+    return item;
+}
+
+void ItemStore::release(Item* item) {
+    assert(item->refcount > 0);
+    if (--item->refcount == 0 && !item->linked) {
+        freeChunk(item);
+    }
+}
+
+ItemStore::Result ItemStore::store(StoreMode mode, const StringPiece& key,
+                                   const StringPiece& value, uint32_t flags, int64_t exptime,
+                                   uint64_t cas, int64_t now, uint64_t* newCas) {
+    assert(!key.empty() && static_cast<std::size_t>(key.size()) <= kMaxKeyBytes);
+    Item* old = get(key, now);
+    switch (mode) {
+        case kAdd:
+            if (old != nullptr) {
+                return kNotStored;
+            }
+            break;
+        case kReplace:
+        case kAppend:
+        case kPrepend:
+            if (old == nullptr) {
+                return kNotStored;
+            }
+            break;
+        case kCas:
+        case kSet:
+            break;
+    }
+    if (mode == kCas || cas != 0) {
+        if (old == nullptr) {
+            return kNotFound;
+        }
+        if (old->cas != cas) {
+            return kExists;
+        }
+    }
+    bool concat = mode == kAppend || mode == kPrepend;
+    std::size_t valueBytes = value.size() + (concat ? old->valueBytes : 0);
+    if (valueBytes > maxValueBytes(key.size())) {
+        return kTooLarge;
+    }
+    if (old != nullptr) {
+        // neither evicted to make room nor freed before its value is copied
+        pin(old);
+    }
+    Item* item = concat ? newItem(key, valueBytes, old->flags, old->exptime, now)
+                        : newItem(key, valueBytes, flags, exptime, now);
+    if (item == nullptr) {
+        if (old != nullptr) {
+            release(old);
+        }
+        return kNoMemory;
+    }
+    char* p = item->value();
+    if (mode == kPrepend) {
+        memcpy(p, value.data(), value.size());
+        memcpy(p + value.size(), old->value(), old->valueBytes);
+    } else if (mode == kAppend) {
+        memcpy(p, old->value(), old->valueBytes);
+        memcpy(p + old->valueBytes, value.data(), value.size());
+    } else {
+        memcpy(p, value.data(), value.size());
+    }
+    link(item, old != nullptr && old->linked ? old : nullptr);
+    if (old != nullptr) {
+        release(old);
+    }
+    if (newCas != nullptr) {
+        *newCas = item->cas;
+    }
+    return kStored;
+}
+
+ItemStore::Result ItemStore::remove(const StringPiece& key, uint64_t cas, int64_t now) {
+    Item* item = get(key, now);
+    if (item == nullptr) {
+        return kNotFound;
+    }
+    if (cas != 0 && item->cas != cas) {
+        return kExists;
+    }
+    unlink(item);
+    return kDeleted;
+}
+
+ItemStore::ArithResult ItemStore::arithmetic(const StringPiece& key, bool increment,
+                                             uint64_t delta, int64_t now, uint64_t* value,
+                                             uint64_t* newCas) {
+    Item* old = get(key, now);
+    if (old == nullptr) {
+        return kArithNotFound;
+    }
+    uint64_t n = 0;
+    if (!parseCounter(old->value(), old->valueBytes, &n)) {
+        return kNonNumeric;
+    }
+    if (increment) {
+        n += delta;
+    } else {
+        n = delta > n ? 0 : n - delta;
+    }
+    char digits[24];
+    int length = 0;
+    for (uint64_t rest = n; length == 0 || rest != 0; rest /= 10) {
+        digits[sizeof digits - 1 - length++] = static_cast<char>('0' + rest % 10);
+    }
+    StringPiece number(digits + sizeof digits - length, length);
+    if (store(kSet, key, number, old->flags, old->exptime, 0, now, newCas) != kStored) {
+        return kArithNoMemory;
+    }
+    *value = n;
+    return kArithOk;
+}
+
+bool ItemStore::touch(const StringPiece& key, int64_t exptime, int64_t now) {
+    Item* item = get(key, now);
+    if (item == nullptr) {
+        return false;
+    }
+    item->exptime = exptime;
+    return true;
+}
+
+void ItemStore::flushAll() {
+    for (Item*& bucket : buckets_) {
+        while (bucket != nullptr) {
+            unlink(bucket);
+        }
+    }
+}
+
+ItemStore::Item* ItemStore::allocate(std::size_t bytes, int64_t now) {
+    auto it = std::lower_bound(
+            classes_.begin(), classes_.end(), bytes,
+            [](const SlabClass& slabClass, std::size_t n) { return slabClass.chunkBytes < n; });
+    if (it == classes_.end()) {
+        return nullptr;
+    }
+    SlabClass* slabClass = &*it;
+    if (slabClass->freeList == nullptr && !growClass(slabClass)) {
+        Item* victim = slabClass->tail;
+        for (int tries = 0; victim != nullptr && tries < kEvictionTries;
+             ++tries, victim = victim->prev) {
+            if (victim->refcount == 0) {
+                if (!expired(victim, now)) {
+                    ++evictions_;
+                }
+                unlink(victim);
+                break;
+            }
+        }
+    }
+    Item* item = slabClass->freeList;
+    if (item != nullptr) {
+        slabClass->freeList = item->next;
+        item->slabClass = static_cast<uint8_t>(it - classes_.begin());
+    }
+    return item;
+}
+
+bool ItemStore::growClass(SlabClass* slabClass) {
+    // every class gets its first page, so that a limit filled up by one
+    // class does not turn away all other sizes
+    if (numPages_ >= maxPages_ && slabClass->pages > 0) {
+        return false;
+    }
+    char* page = static_cast<char*>(malloc(kPageBytes));
+    if (page == nullptr) {
+        return false;
+    }
+    pages_.push_back(page);
+    ++numPages_;
+    ++slabClass->pages;
+    std::size_t chunks = kPageBytes / slabClass->chunkBytes;
+    for (std::size_t i = chunks; i > 0; --i) {
+        Item* chunk = reinterpret_cast<Item*>(page + (i - 1) * slabClass->chunkBytes);
+        chunk->next = slabClass->freeList;
+        slabClass->freeList = chunk;
+    }
+    return true;
+}
+
+void ItemStore::freeChunk(Item* item) {
+    SlabClass* slabClass = &classes_[item->slabClass];
+    item->next = slabClass->freeList;
+    slabClass->freeList = item;
+}
+
+ItemStore::Item* ItemStore::newItem(const StringPiece& key, std::size_t valueBytes,
+                                    uint32_t flags, int64_t exptime, int64_t now) {
+    Item* item = allocate(sizeof(Item) + key.size() + valueBytes + 2, now);
+    if (item == nullptr) {
+        return nullptr;
+    }
+    item->prev = nullptr;
+    item->next = nullptr;
+    item->hashNext = nullptr;
+    item->cas = 0;
+    item->exptime = exptime;
+    item->flags = flags;
+    item->valueBytes = static_cast<uint32_t>(valueBytes);
+    item->refcount = 0;
+    item->keyBytes = static_cast<uint8_t>(key.size());
+    item->linked = false;
+    memcpy(reinterpret_cast<char*>(item + 1), key.data(), key.size());
+    item->value()[valueBytes] = '\r';
+    item->value()[valueBytes + 1] = '\n';
+    return item;
+}
+
+ItemStore::Item** ItemStore::findSlot(const StringPiece& key, std::size_t hash) {
+    Item** slot = &buckets_[hash & (buckets_.size() - 1)];
+    while (*slot != nullptr &&
+           ((*slot)->keyBytes != static_cast<std::size_t>(key.size()) ||
+            memcmp((*slot)->key(), key.data(), key.size()) != 0)) {
+        slot = &(*slot)->hashNext;
+    }
+    return slot;
+}
+
+void ItemStore::link(Item* item, Item* old) {
+    if (old != nullptr) {
+        unlink(old);
+    }
+    Item*& bucket = buckets_[hashOf(item->key(), item->keyBytes) & (buckets_.size() - 1)];
+    item->hashNext = bucket;
+    bucket = item;
+    item->linked = true;
+    item->cas = ++nextCas_;
+    lruPushFront(item);
+    if (++numItems_ > buckets_.size() + buckets_.size() / 2) {
+        growHashTable();
+    }
+}
+
+void ItemStore::unlink(Item* item) {
+    assert(item->linked);
+    Item** slot = &buckets_[hashOf(item->key(), item->keyBytes) & (buckets_.size() - 1)];
+    while (*slot != item) {
+        slot = &(*slot)->hashNext;
+    }
+    *slot = item->hashNext;
+    lruRemove(item);
+    item->linked = false;
+    --numItems_;
+    if (item->refcount == 0) {
+        freeChunk(item);
+    }
+}
+
+void ItemStore::lruRemove(Item* item) {
+    SlabClass* slabClass = &classes_[item->slabClass];
+    (item->prev != nullptr ? item->prev->next : slabClass->head) = item->next;
+    (item->next != nullptr ? item->next->prev : slabClass->tail) = item->prev;
+    item->prev = nullptr;
+    item->next = nullptr;
+}
+
+void ItemStore::lruPushFront(Item* item) {
+    SlabClass* slabClass = &classes_[item->slabClass];
+    item->prev = nullptr;
+    item->next = slabClass->head;
+    (slabClass->head != nullptr ? slabClass->head->prev : slabClass->tail) = item;
+    slabClass->head = item;
+}
+
+void ItemStore::growHashTable() {
+    std::vector<Item*> buckets(buckets_.size() * 2, nullptr);
+    for (Item* bucket : buckets_) {
+        while (bucket != nullptr) {
+            Item* next = bucket->hashNext;
+            Item*& slot = buckets[hashOf(bucket->key(), bucket->keyBytes) & (buckets.size() - 1)];
+            bucket->hashNext = slot;
+            slot = bucket;
+            bucket = next;
+        }
+    }
+    buckets_.swap(buckets);
+}
+
+}  // namespace dws::net::memcache
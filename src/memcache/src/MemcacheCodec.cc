@@ -0,0 +1,375 @@
+#include "MemcacheCodec.h"
+
+#include <cstring>
+
+#include "Buffer.h"
+#include "Endian.h"
+
+namespace dws::net::memcache {
+
+namespace {
+
+const std::size_t kMaxKeyBytes = 250;
+
+const char kBadFormat[] = "CLIENT_ERROR bad command line format";
+
+struct TextCommand {
+    const char* name;
+    Command command;
+};
+
+const TextCommand kTextCommands[] = {
+        {"get", kGet},           {"gets", kGets},       {"set", kSet},
+        {"add", kAdd},           {"replace", kReplace}, {"append", kAppend},
+        {"prepend", kPrepend},   {"cas", kCas},         {"delete", kDelete},
+        {"incr", kIncr},         {"decr", kDecr},       {"touch", kTouch},
+        {"flush_all", kFlushAll}, {"version", kVersion}, {"stats", kStats},
+        {"verbosity", kVerbosity}, {"quit", kQuit},
+};
+
+void reset(Request* request) {
+    request->command = kUnknown;
+    request->binary = false;
+    request->noreply = false;
+    request->returnKey = false;
+    request->opcode = 0;
+    request->opaque = 0;
+    request->key = StringPiece();
+    request->value = StringPiece();
+    request->keys.clear();
+    request->flags = 0;
+    request->exptime = 0;
+    request->cas = 0;
+    request->delta = 0;
+    request->initial = 0;
+    request->error = nullptr;
+}
+
+bool parseUint64(const StringPiece& str, uint64_t* value) {
+    if (str.empty() || str.size() > 20) {
+        return false;
+    }
+    uint64_t n = 0;
+    for (char c : std::string_view(str.data(), str.size())) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (n > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        n = n * 10 + digit;
+    }
+    *value = n;
+    return true;
+}
+
+bool parseInt64(const StringPiece& str, int64_t* value) {
+    bool negative = !str.empty() && str[0] == '-';
+    uint64_t n = 0;
+    if (!parseUint64(negative ? StringPiece(str.data() + 1, str.size() - 1) : str, &n) ||
+        n > static_cast<uint64_t>(INT64_MAX)) {
+        return false;
+    }
+    *value = negative ? -static_cast<int64_t>(n) : static_cast<int64_t>(n);
+    return true;
+}
+
+bool validKey(const StringPiece& key) {
+    return !key.empty() && static_cast<std::size_t>(key.size()) <= kMaxKeyBytes;
+}
+
+ParseResult clientError(Request* request, const char* error) {
+    request->error = error;
+    return kClientError;
+}
+
+ParseResult parseText(const Buffer& buf, Request* request, std::size_t* bytes) {
+    const char* begin = buf.peek();
+    const char* eol = buf.findEOL();
+    if (eol == nullptr) {
+        return buf.readableBytes() > kMaxLineBytes ? kProtocolError : kNeedMore;
+    }
+    if (static_cast<std::size_t>(eol - begin) > kMaxLineBytes) {
+        return kProtocolError;
+    }
+    const char* lineEnd = eol > begin && eol[-1] == '\r' ? eol - 1 : eol;
+    std::vector<StringPiece>& tokens = request->keys;
+    for (const char* p = begin; p < lineEnd;) {
+        while (p < lineEnd && *p == ' ') {
+            ++p;
+        }
+        const char* word = p;
+        while (p < lineEnd && *p != ' ') {
+            ++p;
+        }
+        if (p > word) {
+            tokens.push_back(StringPiece(word, static_cast<int>(p - word)));
+        }
+    }
+    *bytes = eol + 1 - begin;
+    if (tokens.empty()) {
+        return clientError(request, "ERROR");
+    }
+    for (const TextCommand& command : kTextCommands) {
+        if (strlen(command.name) == static_cast<std::size_t>(tokens[0].size()) &&
+            memcmp(command.name, tokens[0].data(), tokens[0].size()) == 0) {
+            request->command = command.command;
+            break;
+        }
+    }
+    if (request->command == kGet || request->command == kGets) {
+        tokens.erase(tokens.begin());
+        if (tokens.empty()) {
+            return clientError(request, "ERROR");
+        }
+        for (const StringPiece& key : tokens) {
+            if (!validKey(key)) {
+                return clientError(request, kBadFormat);
+            }
+        }
+        request->key = tokens[0];
+        return kOk;
+    }
+
+    request->noreply = tokens.size() > 1 && tokens.back() == StringPiece("noreply");
+    std::size_t argc = tokens.size() - (request->noreply ? 1 : 0);
+    if (argc > 1) {
+        request->key = tokens[1];
+    }
+    uint64_t number = 0;
+    switch (request->command) {
+        case kSet:
+        case kAdd:
+        case kReplace:
+        case kAppend:
+        case kPrepend:
+        case kCas: {
+            std::size_t expected = request->command == kCas ? 6 : 5;
+            if (argc != expected || !validKey(request->key) || !parseUint64(tokens[2], &number) ||
+                number > UINT32_MAX || !parseInt64(tokens[3], &request->exptime) ||
+                (request->command == kCas && !parseUint64(tokens[5], &request->cas))) {
+                return clientError(request, kBadFormat);
+            }
+            request->flags = static_cast<uint32_t>(number);
+            uint64_t dataBytes = 0;
+            if (!parseUint64(tokens[4], &dataBytes) || dataBytes > kMaxDataBytes) {
+                // the data block cannot be skipped without its length
+                return kProtocolError;
+            }
+            if (buf.readableBytes() < *bytes + dataBytes + 2) {
+                return kNeedMore;
+            }
+            const char* data = eol + 1;
+            *bytes += dataBytes + 2;
+            if (data[dataBytes] != '\r' || data[dataBytes + 1] != '\n') {
+                return clientError(request, "CLIENT_ERROR bad data chunk");
+            }
+            request->value = StringPiece(data, static_cast<int>(dataBytes));
+            break;
+        }
+        case kDelete:
+            // "delete <key> 0" is what old clients send
+            if (!validKey(request->key) ||
+                (argc != 2 && !(argc == 3 && tokens[2] == StringPiece("0")))) {
+                return clientError(request, kBadFormat);
+            }
+            break;
+        case kIncr:
+        case kDecr:
+            if (argc != 3 || !validKey(request->key)) {
+                return clientError(request, kBadFormat);
+            }
+            if (!parseUint64(tokens[2], &request->delta)) {
+                return clientError(request, "CLIENT_ERROR invalid numeric delta argument");
+            }
+            break;
+        case kTouch:
+            if (argc != 3 || !validKey(request->key) ||
+                !parseInt64(tokens[2], &request->exptime)) {
+                return clientError(request, kBadFormat);
+            }
+            break;
+        case kFlushAll:
+            if (argc > 2 || (argc == 2 && !parseInt64(tokens[1], &request->exptime))) {
+                return clientError(request, kBadFormat);
+            }
+            request->key = StringPiece();
+            break;
+        case kVerbosity:
+            if (argc != 2) {
+                return clientError(request, "ERROR");
+            }
+            request->key = StringPiece();
+            break;
+        case kVersion:
+        case kQuit:
+            if (argc != 1) {
+                return clientError(request, "ERROR");
+            }
+            break;
+        case kStats:
+            request->key = StringPiece();
+            break;
+        default:
+            return clientError(request, "ERROR");
+    }
+    tokens.clear();
+    return kOk;
+}
+
+struct BinaryCommand {
+    Command command;
+    bool noreply;
+    bool returnKey;
+    bool keyed;
+    int8_t extras;  // expected length, -1 for 0 or 4
+};
+
+bool lookupOpcode(uint8_t opcode, BinaryCommand* out) {
+    using namespace binary;
+    switch (opcode) {
+        case kOpGet: *out = {kGet, false, false, true, 0}; break;
+        case kOpGetQ: *out = {kGet, true, false, true, 0}; break;
+        case kOpGetK: *out = {kGet, false, true, true, 0}; break;
+        case kOpGetKQ: *out = {kGet, true, true, true, 0}; break;
+        case kOpSet: *out = {kSet, false, false, true, 8}; break;
+        case kOpSetQ: *out = {kSet, true, false, true, 8}; break;
+        case kOpAdd: *out = {kAdd, false, false, true, 8}; break;
+        case kOpAddQ: *out = {kAdd, true, false, true, 8}; break;
+        case kOpReplace: *out = {kReplace, false, false, true, 8}; break;
+        case kOpReplaceQ: *out = {kReplace, true, false, true, 8}; break;
+        case kOpAppend: *out = {kAppend, false, false, true, 0}; break;
+        case kOpAppendQ: *out = {kAppend, true, false, true, 0}; break;
+        case kOpPrepend: *out = {kPrepend, false, false, true, 0}; break;
+        case kOpPrependQ: *out = {kPrepend, true, false, true, 0}; break;
+        case kOpDelete: *out = {kDelete, false, false, true, 0}; break;
+        case kOpDeleteQ: *out = {kDelete, true, false, true, 0}; break;
+        case kOpIncrement: *out = {kIncr, false, false, true, 20}; break;
+        case kOpIncrementQ: *out = {kIncr, true, false, true, 20}; break;
+        case kOpDecrement: *out = {kDecr, false, false, true, 20}; break;
+        case kOpDecrementQ: *out = {kDecr, true, false, true, 20}; break;
+        case kOpTouch: *out = {kTouch, false, false, true, 4}; break;
+        case kOpFlush: *out = {kFlushAll, false, false, false, -1}; break;
+        case kOpFlushQ: *out = {kFlushAll, true, false, false, -1}; break;
+        case kOpQuit: *out = {kQuit, false, false, false, 0}; break;
+        case kOpQuitQ: *out = {kQuit, true, false, false, 0}; break;
+        case kOpNoop: *out = {kNoop, false, false, false, 0}; break;
+        case kOpVersion: *out = {kVersion, false, false, false, 0}; break;
+        case kOpStat: *out = {kStats, false, false, false, 0}; break;
+        default: return false;
+    }
+    return true;
+}
+
+uint32_t readUint32(const char* p) {
+    uint32_t n = 0;
+    memcpy(&n, p, sizeof n);
+    return sockets::networkToHost32(n);
+}
+
+uint64_t readUint64(const char* p) {
+    uint64_t n = 0;
+    memcpy(&n, p, sizeof n);
+    return sockets::networkToHost64(n);
+}
+
+ParseResult parseBinary(const Buffer& buf, Request* request, std::size_t* bytes) {
+    if (buf.readableBytes() < binary::kHeaderBytes) {
+        return kNeedMore;
+    }
+    const char* header = buf.peek();
+    uint16_t keyBytes = 0;
+    memcpy(&keyBytes, header + 2, sizeof keyBytes);
+    keyBytes = sockets::networkToHost16(keyBytes);
+    uint8_t extrasBytes = static_cast<uint8_t>(header[4]);
+    uint32_t bodyBytes = readUint32(header + 8);
+    if (bodyBytes > kMaxDataBytes || keyBytes + extrasBytes > bodyBytes) {
+        return kProtocolError;
+    }
+    if (buf.readableBytes() < binary::kHeaderBytes + bodyBytes) {
+        return kNeedMore;
+    }
+    *bytes = binary::kHeaderBytes + bodyBytes;
+    request->binary = true;
+    request->opcode = static_cast<uint8_t>(header[1]);
+    memcpy(&request->opaque, header + 12, sizeof request->opaque);
+    request->opaque = sockets::networkToHost32(request->opaque);
+    request->cas = readUint64(header + 16);
+    const char* extras = header + binary::kHeaderBytes;
+    request->key = StringPiece(extras + extrasBytes, keyBytes);
+    request->value = StringPiece(extras + extrasBytes + keyBytes,
+                                 static_cast<int>(bodyBytes - extrasBytes - keyBytes));
+
+    BinaryCommand command;
+    if (!lookupOpcode(request->opcode, &command)) {
+        return clientError(request, "ERROR");
+    }
+    request->command = command.command;
+    request->noreply = command.noreply;
+    request->returnKey = command.returnKey;
+    bool extrasOk = command.extras >= 0 ? extrasBytes == command.extras
+                                        : extrasBytes == 0 || extrasBytes == 4;
+    bool keyOk = command.keyed ? validKey(request->key) : keyBytes == 0;
+    bool valueOk = request->value.empty() || command.command == kSet ||
+                   command.command == kAdd || command.command == kReplace ||
+                   command.command == kAppend || command.command == kPrepend;
+    if (!extrasOk || !keyOk || !valueOk) {
+        return clientError(request, "CLIENT_ERROR invalid arguments");
+    }
+    switch (command.command) {
+        case kSet:
+        case kAdd:
+        case kReplace:
+            request->flags = readUint32(extras);
+            request->exptime = readUint32(extras + 4);
+            break;
+        case kIncr:
+        case kDecr:
+            request->delta = readUint64(extras);
+            request->initial = readUint64(extras + 8);
+            request->exptime = readUint32(extras + 16);
+            break;
+        case kTouch:
+            request->exptime = readUint32(extras);
+            break;
+        case kFlushAll:
+            request->exptime = extrasBytes == 4 ? readUint32(extras) : 0;
+            break;
+        default:
+            break;
+    }
+    return kOk;
+}
+
+}  // namespace
+
+namespace binary {
+
+void appendResponseHeader(Buffer* out, uint8_t opcode, Status status, uint16_t keyBytes,
+                          uint8_t extrasBytes, uint32_t bodyBytes, uint32_t opaque, uint64_t cas) {
+    out->appendInt8(static_cast<int8_t>(kResponseMagic));
+    out->appendInt8(static_cast<int8_t>(opcode));
+    out->appendInt16(static_cast<int16_t>(keyBytes));
+    out->appendInt8(static_cast<int8_t>(extrasBytes));
+    out->appendInt8(0);  // data type
+    out->appendInt16(static_cast<int16_t>(status));
+    out->appendInt32(static_cast<int32_t>(bodyBytes));
+    out->appendInt32(static_cast<int32_t>(opaque));
+    out->appendInt64(static_cast<int64_t>(cas));
+}
+
+}  // namespace binary
+
+ParseResult parseRequest(const Buffer& buf, Request* request, std::size_t* bytes) {
+    reset(request);
+    if (buf.readableBytes() == 0) {
+        return kNeedMore;
+    }
+    if (static_cast<uint8_t>(*buf.peek()) == binary::kRequestMagic) {
+        return parseBinary(buf, request, bytes);
+    }
+    return parseText(buf, request, bytes);
+}
+
+}  // namespace dws::net::memcache
@@ -0,0 +1,744 @@
+#include "MemcacheServer.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+#include "ConnectionRegistry.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+using memcache::ItemStore;
+using memcache::Request;
+namespace binary = memcache::binary;
+
+namespace {
+
+const std::size_t kDefaultMemoryLimit = 64 * 1024 * 1024;
+
+void appendDecimal(Buffer* out, uint64_t n) {
+    char digits[20];
+    int i = 0;
+    do {
+        digits[i++] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    out->ensureWritableBytes(i);
+    char* p = out->beginWrite();
+    for (int j = 0; j < i; ++j) {
+        p[j] = digits[i - 1 - j];
+    }
+    out->hasWritten(i);
+}
+
+void appendLine(Buffer* out, const char* line) {
+    out->append(line, strlen(line));
+    out->append("\r\n", 2);
+}
+
+/// A text reply line, unless the request asked for none.
+void reply(Buffer* out, const Request& request, const char* line) {
+    if (!request.noreply) {
+        appendLine(out, line);
+    }
+}
+
+const char* statusMessage(binary::Status status) {
+    switch (status) {
+        case binary::kKeyNotFound:
+            return "Not found";
+        case binary::kKeyExists:
+            return "Data exists for key";
+        case binary::kValueTooLarge:
+            return "Too large";
+        case binary::kInvalidArguments:
+            return "Invalid arguments";
+        case binary::kItemNotStored:
+            return "Not stored";
+        case binary::kNonNumericValue:
+            return "Non-numeric server-side value for incr or decr";
+        case binary::kUnknownCommand:
+            return "Unknown command";
+        case binary::kOutOfMemory:
+            return "Out of memory";
+        default:
+            return "";
+    }
+}
+
+/// A binary reply without body, unless quiet.
+void replyOk(Buffer* out, const Request& request, uint64_t cas) {
+    if (!request.noreply) {
+        binary::appendResponseHeader(out, request.opcode, binary::kNoError, 0, 0, 0,
+                                     request.opaque, cas);
+    }
+}
+
+/// Failures are answered even to quiet requests.
+void replyStatus(Buffer* out, const Request& request, binary::Status status) {
+    const char* message = statusMessage(status);
+    uint32_t bytes = static_cast<uint32_t>(strlen(message));
+    binary::appendResponseHeader(out, request.opcode, status, 0, 0, bytes, request.opaque, 0);
+    out->append(message, bytes);
+}
+
+ItemStore::StoreMode storeMode(memcache::Command command) {
+    switch (command) {
+        case memcache::kAdd:
+            return ItemStore::kAdd;
+        case memcache::kReplace:
+            return ItemStore::kReplace;
+        case memcache::kAppend:
+            return ItemStore::kAppend;
+        case memcache::kPrepend:
+            return ItemStore::kPrepend;
+        case memcache::kCas:
+            return ItemStore::kCas;
+        default:
+            return ItemStore::kSet;
+    }
+}
+
+bool keyed(memcache::Command command) {
+    return command <= memcache::kTouch;
+}
+
+}  // namespace
+
+struct MemcacheServer::Session {
+    struct Reply {
+        std::string data;
+        bool ready = false;
+    };
+    /// Part of the replies gathered for writev(): a value in a pinned item,
+    /// or when @c item is null a range of scratch.
+    struct Piece {
+        ItemStore::Item* item;
+        std::size_t offset;
+        std::size_t bytes;
+    };
+
+    bool closing = false;  // quit or a protocol error, close once answered
+    Request request;
+    // Replies held back behind one still computed by another shard, front()
+    // answers request number firstPending.
+    std::deque<Reply> pending;
+    uint64_t firstPending = 0;
+    // Replies of the current read while nothing is pending, written by
+    // flushReplies().
+    Buffer scratch;
+    std::vector<Piece> pieces;
+    std::size_t scratchInPieces = 0;
+    std::vector<struct iovec> iov;
+    Buffer slot;  // a reply going to pending
+    // Requests of the current read for other shards, by shard index.
+    std::vector<std::shared_ptr<Batch>> batches;
+};
+
+/// Requests handed to another shard and their replies.
+struct MemcacheServer::Batch {
+    std::weak_ptr<TcpConnection> conn;
+    EventLoop* connLoop = nullptr;
+    // keys and values point into data once the shard runs the batch
+    std::vector<Request> requests;
+    std::vector<uint64_t> seqs;
+    std::string data;  // all keys and values back to back
+    Buffer replies;    // filled by the shard
+    std::vector<uint32_t> replyBytes;
+};
+
+/// Where the replies to a request go.  Values are either copied to the
+/// buffer or, for the connection's own shard, pinned and referred to.
+class MemcacheServer::Output {
+ public:
+    explicit Output(Buffer* buf) : buf_(buf), session_(nullptr), store_(nullptr) {}
+    Output(Session* session, ItemStore* store)
+        : buf_(&session->scratch), session_(session), store_(store) {}
+
+    Buffer* buffer() { return buf_; }
+
+    /// The first @c bytes of the item's value and the "\r\n" behind it.
+    void appendValue(ItemStore::Item* item, std::size_t bytes) {
+        if (session_ == nullptr) {
+            buf_->append(item->value(), bytes);
+            return;
+        }
+        std::size_t text = buf_->readableBytes() - session_->scratchInPieces;
+        if (text > 0) {
+            session_->pieces.push_back({nullptr, session_->scratchInPieces, text});
+            session_->scratchInPieces += text;
+        }
+        store_->pin(item);
+        session_->pieces.push_back({item, 0, bytes});
+    }
+
+ private:
+    Buffer* buf_;
+    Session* session_;
+    ItemStore* store_;
+};
+
+const std::size_t MemcacheServer::kMaxPendingOutput;
+const std::size_t MemcacheServer::kMaxPendingReplies;
+const char MemcacheServer::kVersion[] = "1.6.0";
+
+MemcacheServer::MemcacheServer(EventLoop* loop, const InetAddress& listenAddr,
+                               const std::string& name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option), memoryLimit_(kDefaultMemoryLimit) {
+    // a connection's own shard is the one of the loop index in its id
+    server_.disableMigration();
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf,
+                                      Timestamp receiveTime) { onMessage(conn, buf, receiveTime); });
+    server_.setWriteCompleteCallback([this](const TcpConnectionPtr& conn) { resumeReading(conn); });
+}
+
+void MemcacheServer::start() {
+    server_.start();
+    std::vector<EventLoop*> loops = server_.threadPool()->getAllLoops();
+    for (EventLoop* loop : loops) {
+        shards_.emplace_back(new Shard);
+        shards_.back()->loop = loop;
+        shards_.back()->store.reset(new ItemStore(memoryLimit_ / loops.size()));
+    }
+    LOG(INFO) << "[MemcacheServer::start] MemcacheServer[" << server_.name()
+              << "] starts listening on " << server_.ipPort() << " with " << shards_.size()
+              << " shards";
+}
+
+std::size_t MemcacheServer::numItems() const {
+    std::size_t n = 0;
+    for (const auto& shard : shards_) {
+        n += shard->items.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+uint64_t MemcacheServer::evictions() const {
+    uint64_t n = 0;
+    for (const auto& shard : shards_) {
+        n += shard->evictions.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+std::size_t MemcacheServer::shardOf(const StringPiece& key) const {
+    // the same mapping as EventLoopThreadPool::getLoopForHash()
+    return std::hash<std::string_view>()(std::string_view(key.data(), key.size())) %
+           shards_.size();
+}
+
+void MemcacheServer::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->setTcpNoDelay(true);
+        // replies of several shards finishing in one iteration share a write
+        conn->setWriteCoalescing(true);
+        auto session = std::make_shared<Session>();
+        session->batches.resize(shards_.size());
+        conn->setContext(session);
+    }
+}
+
+void MemcacheServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf,
+                               Timestamp receiveTime) {
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getMutableContext())->get();
+    if (session->closing) {
+        buf->retrieveAll();
+        return;
+    }
+    int64_t now = receiveTime.secondsSinceEpoch();
+    std::size_t self = ConnectionRegistry::loopIndexOf(conn->id());
+    Request& request = session->request;
+    while (buf->readableBytes() > 0) {
+        if (conn->outputBuffer()->readableBytes() + session->scratch.readableBytes() >=
+                    kMaxPendingOutput ||
+            session->pending.size() >= kMaxPendingReplies) {
+            // resumed by resumeReading()
+            conn->stopRead();
+            break;
+        }
+        std::size_t bytes = 0;
+        memcache::ParseResult result = memcache::parseRequest(*buf, &request, &bytes);
+        if (result == memcache::kNeedMore) {
+            break;
+        }
+        if (result == memcache::kProtocolError) {
+            LOG(WARN) << "[MemcacheServer::onMessage] " << *conn
+                      << " sent an unparsable request, closing";
+            session->closing = true;
+            buf->retrieveAll();
+            break;
+        }
+        if (result == memcache::kOk && keyed(request.command)) {
+            if (request.keys.size() > 1) {
+                std::vector<StringPiece> keys;
+                keys.swap(request.keys);
+                for (const StringPiece& key : keys) {
+                    request.key = key;
+                    dispatch(conn, session, self, request, now);
+                }
+                keys.swap(request.keys);
+            } else {
+                request.keys.clear();
+                dispatch(conn, session, self, request, now);
+            }
+        }
+        bool local = result != memcache::kOk || !keyed(request.command);
+        bool textGet = !local && !request.binary &&
+                       (request.command == memcache::kGet || request.command == memcache::kGets);
+        if (local || textGet) {
+            bool direct = session->pending.empty();
+            Output out = direct ? Output(session, shards_[self]->store.get())
+                                : Output(&session->slot);
+            if (local) {
+                executeLocal(session, request, result, self, &out);
+            } else {
+                out.buffer()->append("END\r\n", 5);
+            }
+            if (!direct) {
+                session->pending.emplace_back();
+                session->pending.back().data = session->slot.retrieveAllAsString();
+                session->pending.back().ready = true;
+            }
+        }
+        buf->retrieve(bytes);
+        if (session->closing) {
+            buf->retrieveAll();
+            break;
+        }
+    }
+    dispatchBatches(session);
+    flushReplies(conn, session, self);
+    if (session->closing && session->pending.empty()) {
+        conn->shutdown();
+    }
+}
+
+void MemcacheServer::dispatch(const TcpConnectionPtr& conn, Session* session, std::size_t self,
+                              const Request& request, int64_t now) {
+    std::size_t shard = shardOf(request.key);
+    if (shard != self) {
+        std::shared_ptr<Batch>& batch = session->batches[shard];
+        if (!batch) {
+            batch = std::make_shared<Batch>();
+            batch->conn = conn;
+            batch->connLoop = conn->getLoop();
+        }
+        batch->requests.push_back(request);
+        batch->seqs.push_back(session->firstPending + session->pending.size());
+        batch->data.append(request.key.data(), request.key.size());
+        batch->data.append(request.value.data(), request.value.size());
+        session->pending.emplace_back();
+    } else if (session->pending.empty()) {
+        Output out(session, shards_[self]->store.get());
+        execute(shards_[self].get(), request, now, &out);
+    } else {
+        Output out(&session->slot);
+        execute(shards_[self].get(), request, now, &out);
+        session->pending.emplace_back();
+        session->pending.back().data = session->slot.retrieveAllAsString();
+        session->pending.back().ready = true;
+    }
+}
+
+void MemcacheServer::flushReplies(const TcpConnectionPtr& conn, Session* session,
+                                  std::size_t self) {
+    Buffer& scratch = session->scratch;
+    std::size_t text = scratch.readableBytes() - session->scratchInPieces;
+    if (text > 0) {
+        session->pieces.push_back({nullptr, session->scratchInPieces, text});
+    }
+    if (session->pieces.empty()) {
+        return;
+    }
+    session->iov.resize(session->pieces.size());
+    for (std::size_t i = 0; i < session->pieces.size(); ++i) {
+        const Session::Piece& piece = session->pieces[i];
+        const char* base = piece.item != nullptr ? piece.item->value() : scratch.peek() + piece.offset;
+        session->iov[i].iov_base = const_cast<char*>(base);
+        session->iov[i].iov_len = piece.bytes;
+    }
+    conn->sendVectored(session->iov.data(), static_cast<int>(session->iov.size()));
+    ItemStore* store = shards_[self]->store.get();
+    for (const Session::Piece& piece : session->pieces) {
+        if (piece.item != nullptr) {
+            store->release(piece.item);
+        }
+    }
+    session->pieces.clear();
+    session->scratchInPieces = 0;
+    scratch.retrieveAll();
+}
+
+void MemcacheServer::dispatchBatches(Session* session) {
+    for (std::size_t i = 0; i < session->batches.size(); ++i) {
+        if (session->batches[i]) {
+            Shard* shard = shards_[i].get();
+            shard->loop->queueInLoop(
+                    [this, shard, batch = std::move(session->batches[i])] { runBatch(shard, batch); });
+        }
+    }
+}
+
+void MemcacheServer::runBatch(Shard* shard, const std::shared_ptr<Batch>& batch) {
+    int64_t now = Timestamp::now().secondsSinceEpoch();
+    const char* p = batch->data.data();
+    Output out(&batch->replies);
+    for (Request& request : batch->requests) {
+        request.key = StringPiece(p, request.key.size());
+        p += request.key.size();
+        request.value = StringPiece(p, request.value.size());
+        p += request.value.size();
+        std::size_t before = batch->replies.readableBytes();
+        execute(shard, request, now, &out);
+        batch->replyBytes.push_back(
+                static_cast<uint32_t>(batch->replies.readableBytes() - before));
+    }
+    batch->connLoop->queueInLoop([this, batch] {
+        TcpConnectionPtr conn = batch->conn.lock();
+        if (conn && conn->connected()) {
+            completeBatch(conn, *batch);
+        }
+    });
+}
+
+void MemcacheServer::completeBatch(const TcpConnectionPtr& conn, const Batch& batch) {
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getMutableContext())->get();
+    Buffer* output = conn->outputBuffer();
+    const char* p = batch.replies.peek();
+    for (std::size_t i = 0; i < batch.seqs.size(); ++i) {
+        Session::Reply& pendingReply = session->pending[batch.seqs[i] - session->firstPending];
+        pendingReply.data.assign(p, batch.replyBytes[i]);
+        pendingReply.ready = true;
+        p += batch.replyBytes[i];
+        while (!session->pending.empty() && session->pending.front().ready) {
+            output->append(StringPiece(session->pending.front().data));
+            session->pending.pop_front();
+            ++session->firstPending;
+        }
+    }
+    conn->sendOutputBuffer();
+    if (session->closing && session->pending.empty()) {
+        conn->shutdown();
+    } else {
+        resumeReading(conn);
+    }
+}
+
+void MemcacheServer::resumeReading(const TcpConnectionPtr& conn) {
+    if (conn->isReading() || !conn->connected()) {
+        return;
+    }
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getMutableContext())->get();
+    if (conn->outputBuffer()->readableBytes() < kMaxPendingOutput &&
+        session->pending.size() < kMaxPendingReplies) {
+        conn->startRead();
+        // pipelined requests may be waiting in the buffer without new input arriving
+        onMessage(conn, conn->inputBuffer(), Timestamp::now());
+    }
+}
+
+void MemcacheServer::executeLocal(Session* session, const Request& request,
+                                  memcache::ParseResult result, std::size_t self, Output* out) {
+    Buffer* buf = out->buffer();
+    if (result == memcache::kClientError) {
+        if (request.binary) {
+            replyStatus(buf, request,
+                        request.command == memcache::kUnknown ? binary::kUnknownCommand
+                                                              : binary::kInvalidArguments);
+        } else {
+            appendLine(buf, request.error);
+        }
+        return;
+    }
+    switch (request.command) {
+        case memcache::kFlushAll:
+            // requests of this read queued for other shards come first
+            dispatchBatches(session);
+            for (std::size_t i = 0; i < shards_.size(); ++i) {
+                Shard* shard = shards_[i].get();
+                auto flush = [shard] {
+                    shard->store->flushAll();
+                    shard->items.store(0, std::memory_order_relaxed);
+                };
+                if (i == self) {
+                    flush();
+                } else {
+                    shard->loop->queueInLoop(flush);
+                }
+            }
+            if (request.binary) {
+                replyOk(buf, request, 0);
+            } else {
+                reply(buf, request, "OK");
+            }
+            break;
+        case memcache::kVersion:
+            if (request.binary) {
+                binary::appendResponseHeader(buf, request.opcode, binary::kNoError, 0, 0,
+                                             sizeof kVersion - 1, request.opaque, 0);
+                buf->append(kVersion, sizeof kVersion - 1);
+            } else {
+                buf->append("VERSION ", 8);
+                appendLine(buf, kVersion);
+            }
+            break;
+        case memcache::kStats: {
+            const std::pair<const char*, uint64_t> stats[] = {
+                    {"pid", static_cast<uint64_t>(::getpid())},
+                    {"time", static_cast<uint64_t>(Timestamp::now().secondsSinceEpoch())},
+                    {"threads", shards_.size()},
+                    {"curr_items", numItems()},
+                    {"evictions", evictions()},
+                    {"limit_maxbytes", memoryLimit_},
+            };
+            Buffer value;
+            for (const auto& stat : stats) {
+                appendDecimal(&value, stat.second);
+                if (request.binary) {
+                    uint16_t keyBytes = static_cast<uint16_t>(strlen(stat.first));
+                    uint32_t valueBytes = static_cast<uint32_t>(value.readableBytes());
+                    binary::appendResponseHeader(buf, request.opcode, binary::kNoError, keyBytes,
+                                                 0, keyBytes + valueBytes, request.opaque, 0);
+                    buf->append(stat.first, keyBytes);
+                    buf->append(value.peek(), valueBytes);
+                } else {
+                    buf->append("STAT ", 5);
+                    buf->append(stat.first, strlen(stat.first));
+                    buf->append(" ", 1);
+                    buf->append(value.peek(), value.readableBytes());
+                    buf->append("\r\n", 2);
+                }
+                value.retrieveAll();
+            }
+            if (request.binary) {
+                // an empty stat ends the list
+                binary::appendResponseHeader(buf, request.opcode, binary::kNoError, 0, 0, 0,
+                                             request.opaque, 0);
+            } else {
+                buf->append("END\r\n", 5);
+            }
+            break;
+        }
+        case memcache::kVerbosity:
+            reply(buf, request, "OK");
+            break;
+        case memcache::kNoop:
+            replyOk(buf, request, 0);
+            break;
+        case memcache::kQuit:
+            if (request.binary) {
+                replyOk(buf, request, 0);
+            }
+            session->closing = true;
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+void MemcacheServer::execute(Shard* shard, const Request& request, int64_t now, Output* out) {
+    ItemStore* store = shard->store.get();
+    Buffer* buf = out->buffer();
+    switch (request.command) {
+        case memcache::kGet:
+        case memcache::kGets: {
+            ItemStore::Item* item = store->get(request.key, now);
+            if (request.binary) {
+                if (item == nullptr) {
+                    if (!request.noreply) {
+                        replyStatus(buf, request, binary::kKeyNotFound);
+                    }
+                    break;
+                }
+                uint16_t keyBytes = request.returnKey ? item->keyBytes : 0;
+                binary::appendResponseHeader(buf, request.opcode, binary::kNoError, keyBytes, 4,
+                                             4 + keyBytes + item->valueBytes, request.opaque,
+                                             item->cas);
+                buf->appendInt32(static_cast<int32_t>(item->flags));
+                buf->append(item->key(), keyBytes);
+                out->appendValue(item, item->valueBytes);
+            } else if (item != nullptr) {
+                buf->append("VALUE ", 6);
+                buf->append(item->key(), item->keyBytes);
+                buf->append(" ", 1);
+                appendDecimal(buf, item->flags);
+                buf->append(" ", 1);
+                appendDecimal(buf, item->valueBytes);
+                if (request.command == memcache::kGets) {
+                    buf->append(" ", 1);
+                    appendDecimal(buf, item->cas);
+                }
+                buf->append("\r\n", 2);
+                out->appendValue(item, item->valueBytes + 2);
+            }
+            break;
+        }
+        case memcache::kSet:
+        case memcache::kAdd:
+        case memcache::kReplace:
+        case memcache::kAppend:
+        case memcache::kPrepend:
+        case memcache::kCas: {
+            uint64_t cas = 0;
+            ItemStore::Result result =
+                    store->store(storeMode(request.command), request.key, request.value,
+                                 request.flags, ItemStore::absoluteExptime(request.exptime, now),
+                                 request.cas, now, &cas);
+            if (request.binary) {
+                switch (result) {
+                    case ItemStore::kStored:
+                        replyOk(buf, request, cas);
+                        break;
+                    case ItemStore::kNotStored:
+                        replyStatus(buf, request,
+                                    request.command == memcache::kAdd       ? binary::kKeyExists
+                                    : request.command == memcache::kReplace ? binary::kKeyNotFound
+                                                                            : binary::kItemNotStored);
+                        break;
+                    case ItemStore::kExists:
+                        replyStatus(buf, request, binary::kKeyExists);
+                        break;
+                    case ItemStore::kNotFound:
+                        replyStatus(buf, request, binary::kKeyNotFound);
+                        break;
+                    case ItemStore::kTooLarge:
+                        replyStatus(buf, request, binary::kValueTooLarge);
+                        break;
+                    default:
+                        replyStatus(buf, request, binary::kOutOfMemory);
+                        break;
+                }
+            } else {
+                switch (result) {
+                    case ItemStore::kStored:
+                        reply(buf, request, "STORED");
+                        break;
+                    case ItemStore::kNotStored:
+                        reply(buf, request, "NOT_STORED");
+                        break;
+                    case ItemStore::kExists:
+                        reply(buf, request, "EXISTS");
+                        break;
+                    case ItemStore::kNotFound:
+                        reply(buf, request, "NOT_FOUND");
+                        break;
+                    case ItemStore::kTooLarge:
+                        reply(buf, request, "SERVER_ERROR object too large for cache");
+                        break;
+                    default:
+                        reply(buf, request, "SERVER_ERROR out of memory storing object");
+                        break;
+                }
+            }
+            break;
+        }
+        case memcache::kDelete: {
+            ItemStore::Result result = store->remove(request.key, request.cas, now);
+            if (request.binary) {
+                if (result == ItemStore::kDeleted) {
+                    replyOk(buf, request, 0);
+                } else {
+                    replyStatus(buf, request,
+                                result == ItemStore::kExists ? binary::kKeyExists
+                                                             : binary::kKeyNotFound);
+                }
+            } else {
+                reply(buf, request, result == ItemStore::kDeleted ? "DELETED" : "NOT_FOUND");
+            }
+            break;
+        }
+        case memcache::kIncr:
+        case memcache::kDecr: {
+            uint64_t value = 0;
+            uint64_t cas = 0;
+            ItemStore::ArithResult result = store->arithmetic(
+                    request.key, request.command == memcache::kIncr, request.delta, now, &value,
+                    &cas);
+            if (request.binary && result == ItemStore::kArithNotFound &&
+                request.exptime != binary::kNoAutoCreate) {
+                Buffer initial;
+                appendDecimal(&initial, request.initial);
+                ItemStore::Result stored = store->store(
+                        ItemStore::kAdd, request.key,
+                        StringPiece(initial.peek(), static_cast<int>(initial.readableBytes())), 0,
+                        ItemStore::absoluteExptime(request.exptime, now), 0, now, &cas);
+                if (stored == ItemStore::kStored) {
+                    result = ItemStore::kArithOk;
+                    value = request.initial;
+                } else {
+                    result = ItemStore::kArithNoMemory;
+                }
+            }
+            if (request.binary) {
+                switch (result) {
+                    case ItemStore::kArithOk:
+                        if (!request.noreply) {
+                            binary::appendResponseHeader(buf, request.opcode, binary::kNoError, 0,
+                                                         0, 8, request.opaque, cas);
+                            buf->appendInt64(static_cast<int64_t>(value));
+                        }
+                        break;
+                    case ItemStore::kArithNotFound:
+                        replyStatus(buf, request, binary::kKeyNotFound);
+                        break;
+                    case ItemStore::kNonNumeric:
+                        replyStatus(buf, request, binary::kNonNumericValue);
+                        break;
+                    default:
+                        replyStatus(buf, request, binary::kOutOfMemory);
+                        break;
+                }
+            } else if (!request.noreply) {
+                switch (result) {
+                    case ItemStore::kArithOk:
+                        appendDecimal(buf, value);
+                        buf->append("\r\n", 2);
+                        break;
+                    case ItemStore::kArithNotFound:
+                        appendLine(buf, "NOT_FOUND");
+                        break;
+                    case ItemStore::kNonNumeric:
+                        appendLine(buf,
+                                   "CLIENT_ERROR cannot increment or decrement non-numeric value");
+                        break;
+                    default:
+                        appendLine(buf, "SERVER_ERROR out of memory");
+                        break;
+                }
+            }
+            break;
+        }
+        case memcache::kTouch: {
+            bool touched = store->touch(request.key,
+                                        ItemStore::absoluteExptime(request.exptime, now), now);
+            if (request.binary) {
+                if (touched) {
+                    replyOk(buf, request, 0);
+                } else {
+                    replyStatus(buf, request, binary::kKeyNotFound);
+                }
+            } else {
+                reply(buf, request, touched ? "TOUCHED" : "NOT_FOUND");
+            }
+            break;
+        }
+        default:
+            assert(false);
+            break;
+    }
+    shard->items.store(store->numItems(), std::memory_order_relaxed);
+    shard->evictions.store(store->evictions(), std::memory_order_relaxed);
+}
+
+}  // namespace dws::net
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <string>
 
 #include "Channel.h"
 #include "Socket.h"
@@ -11,6 +12,8 @@ namespace dws::net {
 class EventLoop;
 class InetAddress;
 
+/// Listens on a TCP or Unix domain address.  A socket file left behind at
+/// a Unix domain path is replaced, and removed again on destruction.
 class Acceptor : noncopyable {
  public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
@@ -19,6 +22,9 @@ class Acceptor : noncopyable {
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback& cb) { newConnectionCallback_ = cb; }
+    /// Accepts data in the SYN (TCP Fast Open) for up to @c queueLength
+    /// pending connections, applied by listen().  TCP only.
+    void setFastOpen(int queueLength) { fastOpenQueueLength_ = queueLength; }
 
     void listen();
     bool listenning() const { return listening_; }
@@ -30,6 +36,9 @@ class Acceptor : noncopyable {
     NewConnectionCallback newConnectionCallback_;
     bool listening_;
     int idleFd_;
+    int fastOpenQueueLength_;
+    const bool isUnix_;
+    std::string unixPath_;  // file system path of a Unix domain socket
 
     void handleRead();
 };
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+class EventLoop;
+
+/// Picks endpoints for requests over a set of client connections, say one
+/// PipelinedClient or TcpClient per endpoint, and keeps slow or failing
+/// ones from dragging the tail latency of everyone else.
+///
+/// Each endpoint has an adaptive limit on the requests in flight to it.
+/// The limit follows the gradient between a long term latency average,
+/// standing for the unloaded latency, and a short term one: it grows by
+/// about the square root of itself while the two agree and shrinks when
+/// the recent latency rises above Options::tolerance times the long term
+/// one, so requests wait in the caller's queue rather than in a backend's.
+/// Failures cut it by Options::backoffRatio.  acquire() returns the
+/// endpoint with the lowest load relative to its limit, or -1 when all are
+/// full and the caller should queue or shed the request.
+///
+/// An endpoint is ejected for a cooldown after Options::consecutiveErrors
+/// failures in a row, and at every Options::intervalSeconds when its error
+/// rate or mean latency over the interval stands out against the others.
+/// The cooldown grows with each repeated ejection, the count drops by one
+/// per interval without failures.  At most Options::maxEjectedFraction of
+/// the endpoints are out at a time, a single endpoint is never ejected.
+///
+/// Everything runs in the loop thread, no locking.
+class AdaptiveBalancer : noncopyable {
+ public:
+    struct Options {
+        // outlier ejection
+        int consecutiveErrors = 5;
+        double intervalSeconds = 1.0;
+        int minSamples = 20;               // in an interval, before rate or latency count
+        double maxErrorRate = 0.5;
+        double latencyFactor = 3.0;        // times the median of the other endpoints
+        double minOutlierSeconds = 0.001;  // latencies below are never outliers
+        double baseEjectionSeconds = 5.0;  // times the number of repeated ejections
+        double maxEjectionSeconds = 60.0;
+        double maxEjectedFraction = 0.5;
+        // concurrency limit
+        int initialLimit = 16;
+        int minLimit = 1;
+        int maxLimit = 1024;
+        double tolerance = 1.5;  // recent latency over long term before shrinking
+        double smoothing = 0.2;
+        double backoffRatio = 0.9;
+    };
+
+    AdaptiveBalancer(EventLoop* loop, const std::vector<InetAddress>& endpoints);
+    AdaptiveBalancer(EventLoop* loop, const std::vector<InetAddress>& endpoints,
+                     const Options& options);
+    ~AdaptiveBalancer();
+
+    /// Schedules the periodic outlier check.
+    void start();
+
+    /// The endpoint for the next request, -1 if every endpoint is ejected
+    /// or at its limit.  Each index returned must be given back to
+    /// release().
+    int acquire();
+    /// Ends a request to @c index that took @c latencySeconds, @c ok false
+    /// for errors and timeouts.
+    void release(int index, double latencySeconds, bool ok);
+
+    int size() const { return static_cast<int>(endpoints_.size()); }
+    const InetAddress& address(int index) const { return endpoints_[index].address; }
+    int limit(int index) const;
+    int inFlight(int index) const { return endpoints_[index].inFlight; }
+    bool ejected(int index) const { return endpoints_[index].ejected; }
+    int numEjected() const { return numEjected_; }
+    int totalEjections() const { return totalEjections_; }
+
+ private:
+    struct Endpoint {
+        Endpoint(const InetAddress& addr, double initialLimit)
+            : address(addr), limit(initialLimit) {}
+
+        InetAddress address;
+        int inFlight = 0;
+        double limit;
+        double longLatency = 0;   // slow average, the unloaded latency
+        double shortLatency = 0;  // fast average
+        int consecutiveFailures = 0;
+        // over the current interval
+        int samples = 0;
+        int failures = 0;
+        double latencySum = 0;
+        // ejection
+        bool ejected = false;
+        Timestamp ejectedUntil;
+        int ejections = 0;  // repeated ones, decays while healthy
+    };
+
+    EventLoop* loop_;
+    const Options options_;
+    std::vector<Endpoint> endpoints_;
+    TimerId checkTimer_;
+    int next_;
+    int numEjected_;
+    int totalEjections_;
+
+    void updateLimit(Endpoint* endpoint, double latency, int inFlight);
+    void checkOutliers();
+    void eject(int index, const char* reason);
+    void restoreExpired(Timestamp now);
+};
+
+}  // namespace dws::net
@@ -60,6 +60,9 @@ class Buffer : public copyable {
 
     const char *peek() const { return begin() + readerIndex_; }
 
+    /// Same as peek(), for decoders that transform the readable bytes in place.
+    char *beginRead() { return begin() + readerIndex_; }
+
     const char *findCRLF() const {
         const char *crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
         return crlf == beginWrite() ? nullptr : crlf;
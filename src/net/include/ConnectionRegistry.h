@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Callbacks.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+/// Slot map of live connections keyed by ConnectionId.
+///
+/// @code
+///  63        48 47            24 23             0
+/// +------------+----------------+---------------+
+/// | loop index |   generation   |     slot      |
+/// +------------+----------------+---------------+
+/// @endcode
+///
+/// Lookup and removal are O(1) and never hash or allocate once the slot
+/// vector has grown to the peak number of concurrent connections.  The
+/// generation is bumped every time a slot is released, so a stale id never
+/// matches the connection that reuses its slot.  Generations start at 1,
+/// hence 0 is never a valid id.
+///
+/// Not thread safe, owned by the acceptor loop of TcpServer.
+class ConnectionRegistry : noncopyable {
+ public:
+    static const int kSlotBits = 24;
+    static const int kGenerationBits = 24;
+    static const int kLoopIndexBits = 16;
+    static const uint32_t kMaxSlots = 1u << kSlotBits;
+
+    static uint32_t slotOf(ConnectionId id) { return static_cast<uint32_t>(id & (kMaxSlots - 1)); }
+
+    static uint32_t generationOf(ConnectionId id) {
+        return static_cast<uint32_t>((id >> kSlotBits) & ((1u << kGenerationBits) - 1));
+    }
+
+    static int loopIndexOf(ConnectionId id) {
+        return static_cast<int>(id >> (kSlotBits + kGenerationBits));
+    }
+
+    static ConnectionId makeId(int loopIndex, uint32_t generation, uint32_t slot) {
+        return (static_cast<ConnectionId>(loopIndex) << (kSlotBits + kGenerationBits)) |
+               (static_cast<ConnectionId>(generation) << kSlotBits) | slot;
+    }
+
+    ConnectionRegistry() = default;
+
+    /// Reserves a slot and returns the id the new connection will carry.
+    /// The slot stays empty until attach().
+    ConnectionId allocate(int loopIndex);
+    void attach(ConnectionId id, TcpConnectionPtr conn);
+    /// Releases the slot of @c id, returns false for unknown or stale ids.
+    bool remove(ConnectionId id);
+    TcpConnectionPtr find(ConnectionId id) const;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    template <typename Func>
+    void forEach(Func&& func) const {
+        for (const Slot& slot : slots_) {
+            if (slot.conn) {
+                func(slot.conn);
+            }
+        }
+    }
+
+    /// Empties the registry, handing every live connection to @c func.
+    template <typename Func>
+    void releaseAll(Func&& func) {
+        for (uint32_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].used) {
+                TcpConnectionPtr conn(std::move(slots_[i].conn));
+                release(i);
+                if (conn) {
+                    func(conn);
+                }
+            }
+        }
+    }
+
+ private:
+    struct Slot {
+        TcpConnectionPtr conn;
+        uint32_t generation = 1;
+        bool used = false;
+    };
+
+    const Slot* lookup(ConnectionId id) const;
+    void release(uint32_t slot);
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+    std::size_t size_ = 0;
+};
+
+}  // namespace dws::net
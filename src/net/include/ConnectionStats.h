@@ -0,0 +1,94 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "noncopyable.h"
+
+namespace dws::net {
+
+/// Traffic and latency counters of one TcpConnection.
+///
+/// Only the connection's loop thread writes, so an update is a relaxed
+/// load plus store (plain movs on x86) instead of a locked add, while other
+/// threads such as the acceptor loop can still take a consistent-enough
+/// snapshot of each counter.
+class ConnectionStats : noncopyable {
+ public:
+    struct Snapshot {
+        uint64_t bytesReceived = 0;
+        uint64_t bytesSent = 0;
+        uint64_t messagesReceived = 0;  // message callback invocations
+        uint64_t messagesSent = 0;      // send() calls
+        uint64_t readCalls = 0;
+        uint64_t writeCalls = 0;
+        uint64_t callbackMicroSeconds = 0;  // time spent in the message callback
+        uint64_t maxOutputBufferBytes = 0;
+        uint32_t rttMicroSeconds = 0;  // latest tcp_info sample
+        uint32_t rttVarMicroSeconds = 0;
+
+        /// Sums the counters, keeps the maximum of output buffer depth and RTT.
+        Snapshot& operator+=(const Snapshot& rhs);
+        uint64_t totalBytes() const { return bytesReceived + bytesSent; }
+        std::string toString() const;
+    };
+
+    ConnectionStats() = default;
+
+    void onRead(ssize_t n) {
+        increase(&readCalls_, 1);
+        if (n > 0) {
+            increase(&bytesReceived_, static_cast<uint64_t>(n));
+        }
+    }
+
+    void onWrite(ssize_t n) {
+        increase(&writeCalls_, 1);
+        if (n > 0) {
+            increase(&bytesSent_, static_cast<uint64_t>(n));
+        }
+    }
+
+    void onSend() { increase(&messagesSent_, 1); }
+
+    void onMessage(int64_t elapsedMicroSeconds) {
+        increase(&messagesReceived_, 1);
+        increase(&callbackMicroSeconds_,
+                 static_cast<uint64_t>(std::max<int64_t>(0, elapsedMicroSeconds)));
+    }
+
+    void onOutputBuffer(size_t bytes) {
+        if (bytes > maxOutputBufferBytes_.load(std::memory_order_relaxed)) {
+            maxOutputBufferBytes_.store(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void onRttSample(uint32_t rtt, uint32_t rttVar) {
+        rttMicroSeconds_.store(rtt, std::memory_order_relaxed);
+        rttVarMicroSeconds_.store(rttVar, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const;
+
+ private:
+    static void increase(std::atomic<uint64_t>* counter, uint64_t n) {
+        counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> bytesReceived_{0};
+    std::atomic<uint64_t> bytesSent_{0};
+    std::atomic<uint64_t> messagesReceived_{0};
+    std::atomic<uint64_t> messagesSent_{0};
+    std::atomic<uint64_t> readCalls_{0};
+    std::atomic<uint64_t> writeCalls_{0};
+    std::atomic<uint64_t> callbackMicroSeconds_{0};
+    std::atomic<uint64_t> maxOutputBufferBytes_{0};
+    std::atomic<uint32_t> rttMicroSeconds_{0};
+    std::atomic<uint32_t> rttVarMicroSeconds_{0};
+};
+
+}  // namespace dws::net
@@ -3,8 +3,12 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "InetAddress.h"
+#include "Resolver.h"
+#include "TimerId.h"
 #include "noncopyable.h"
 
 namespace dws::net {
@@ -12,43 +16,102 @@ namespace dws::net {
 class Channel;
 class EventLoop;
 
+/// Connects to one of several addresses of a server, racing them in the
+/// style of RFC 8305 (Happy Eyeballs): the families are interleaved,
+/// starting with the first one given, and the next address is tried when
+/// the previous attempt failed or has not completed within the connection
+/// attempt delay.  The first attempt to complete wins and the others are
+/// closed.  When every address failed the whole round is retried after an
+/// exponential, jittered backoff.
 class Connector : noncopyable, public std::enable_shared_from_this<Connector> {
  public:
     using NewConnectionCallback = std::function<void(int sockfd)>;
+    using ErrorCallback = std::function<void(int savedErrno)>;
+    static const std::size_t kMaxFastOpenBytes = 16 * 1024;
 
     Connector(EventLoop* loop, const InetAddress& serverAddr);
+    /// @c addresses must not be empty.
+    Connector(EventLoop* loop, std::vector<InetAddress> addresses);
+    /// Connects to @c host, resolved by @c resolver on every attempt, which
+    /// must outlive the Connector.
+    Connector(EventLoop* loop, Resolver* resolver, std::string host, uint16_t port);
     ~Connector();
 
     void setNewConnectionCallback(const NewConnectionCallback& cb) { newConnectionCallback_ = cb; }
+    /// Reports a failed round instead of retrying with backoff, for callers
+    /// with their own policy.  Runs in the loop thread, never from within
+    /// start(), and not after stop().
+    void setErrorCallback(const ErrorCallback& cb) { errorCallback_ = cb; }
+    /// How long an attempt runs alone before the next address is tried as
+    /// well, 250 ms by default as RFC 8305 recommends.  Before start().
+    void setAttemptDelay(double seconds) { attemptDelay_ = seconds; }
+    /// The first bytes of every connection, sent with the SYN through TCP
+    /// Fast Open when the server's cookie is known and after the handshake
+    /// otherwise; they are in the kernel by the time the new connection
+    /// callback runs.  Racing attempts may each deliver them, so the first
+    /// request must be idempotent.  At most kMaxFastOpenBytes, before
+    /// start().
+    void setFastOpenData(std::string data);
 
     void start();
     void restart();
     void stop();
 
+    /// The address connected to, or the first one to try.  Loop thread only
+    /// with more than one address.
     const InetAddress& serverAddress() const { return serverAddr_; }
+    /// "host:port", or the address when there is no host name.
+    std::string serverName() const;
 
  private:
-    enum State { kDisconnected, kConnecting, kConnected };
+    enum State { kDisconnected, kResolving, kConnecting, kConnected };
     static const int kMaxRetryDelayMs = 30 * 1000;
     static const int kInitRetryDelayMs = 500;
 
+    struct Attempt {
+        InetAddress address;
+        std::shared_ptr<Channel> channel;
+        std::size_t fastOpenSent = 0;  // bytes of fastOpenData_ given to the kernel
+    };
+
     void setState(State s) { state_ = s; }
     void startInLoop();
     void stopInLoop();
-    void connect();
-    void connecting(int sockfd);
-    void handleWrite();
-    void handleError();
-    void retry(int sockfd);
-    int removeAndResetChannel();
-    void resetChannel();
+    void resolve();
+    void onResolved(Resolver::Error error, const std::vector<InetAddress>& addresses);
+    void startRound();
+    void startNextAttempt();
+    void onAttemptDelay();
+    void cancelAttemptDelay();
+    void handleWrite(Channel* channel);
+    void handleError(Channel* channel);
+    int connect(int sockfd, const InetAddress& address, std::size_t* fastOpenSent);
+    bool sendFastOpenRest(int sockfd, std::size_t fastOpenSent);
+    bool removeAttempt(Channel* channel, Attempt* attempt);
+    void closeAttempts();
+    void attemptFailed(int savedErrno);
+    void roundFailed();
+    void report(int savedErrno);
+    void backoff();
 
     EventLoop* loop_;
     InetAddress serverAddr_;
+    Resolver* resolver_;
+    const std::string host_;
+    const uint16_t port_;
+    std::vector<InetAddress> addresses_;  // families interleaved
+    std::size_t nextAddress_;
+    std::vector<Attempt> attempts_;  // in flight
+    TimerId attemptTimer_;
+    bool attemptTimerArmed_;
+    bool retryable_;  // some attempt of this round may succeed later
+    int lastErrno_;
+    double attemptDelay_;
+    std::string fastOpenData_;
     std::atomic<bool> connect_;
     State state_;
-    std::unique_ptr<Channel> channel_;
     NewConnectionCallback newConnectionCallback_;
+    ErrorCallback errorCallback_;
     int retryDelayMs_;
 };
 
@@ -30,7 +30,9 @@ class EventLoop : noncopyable {
     std::atomic<bool> quit_;
     std::atomic<bool> eventHandling_;
     std::atomic<bool> callingPendingFunctors_;
+    std::atomic<bool> callingIterationEndCallbacks_;
     int64_t iteration_;
+    std::atomic<int64_t> busyMicroSeconds_;
     const pid_t threadId_;
     Timestamp pollReturnTime_;
     std::unique_ptr<Poller> poller_;
@@ -42,19 +44,25 @@ class EventLoop : noncopyable {
     Channel* currentActiveChannel_;
     mutable std::mutex mutex_;
     std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);
+    std::vector<Functor> iterationEndCallbacks_;
 
     void abortNotInLoopThread();
     void handleRead();
     void doPendingFunctors();
+    void doIterationEndCallbacks();
     void printActiveChannels() const;
 
  public:
     EventLoop();
     ~EventLoop();
     void loop();
+    /// Functors queued before quit() still run before loop() returns.
     void quit();
     Timestamp pollReturnTime() const { return pollReturnTime_; }
     int64_t iteration() const { return iteration_; }
+    /// Total time spent handling events, functors and their follow-ups, i.e. not
+    /// waiting in poll.  Readable from any thread, used as the loop's load.
+    int64_t busyMicroSeconds() const { return busyMicroSeconds_.load(std::memory_order_relaxed); }
     void runInLoop(Functor cb);
     void queueInLoop(Functor cb);
     size_t queueSize() const;
@@ -66,6 +74,10 @@ class EventLoop : noncopyable {
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
     bool hasChannel(Channel* channel);
+    /// Runs @c cb once the current iteration has handled its events and
+    /// pending functors, e.g. to write what was sent during the iteration
+    /// in one go.  Loop thread only.
+    void runAtIterationEnd(Functor cb);
 
     void assertInLoopThread() {
         if (!isInLoopThread()) {
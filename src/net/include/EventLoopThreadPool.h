@@ -22,6 +22,9 @@ class EventLoopThreadPool : noncopyable {
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
     EventLoop* getNextLoop();
+    /// Same round robin as getNextLoop(), also reports the loop's index
+    /// (0 is the base loop when there are no IO threads).
+    EventLoop* getNextLoop(int* loopIndex);
     EventLoop* getLoopForHash(size_t hashCode);
     std::vector<EventLoop*> getAllLoops();
     bool started() const { return started_; }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <string>
 
@@ -12,11 +14,13 @@ namespace sockets {
 const struct sockaddr *sockaddr_cast(const struct sockaddr_in6 *addr);
 }  // namespace sockets
 
+/// An IPv4, IPv6 or Unix domain (AF_UNIX) socket address.
 class InetAddress : public copyable {
  private:
     union {
         struct sockaddr_in addr_;
         struct sockaddr_in6 addr6_;
+        struct sockaddr_un addrUn_;
     };
 
  public:
@@ -24,11 +28,25 @@ class InetAddress : public copyable {
     InetAddress(StringArg ip, uint16_t port, bool ipv6 = false);
     explicit InetAddress(const struct sockaddr_in &addr) : addr_(addr) {}
     explicit InetAddress(const struct sockaddr_in6 &addr) : addr6_(addr) {}
+    explicit InetAddress(const struct sockaddr_un &addr) : addrUn_(addr) {}
+    /// Takes as much of @c addr as its family needs.
+    explicit InetAddress(const struct sockaddr_storage &addr);
+
+    /// A Unix domain socket at the file system @c path, or in the abstract
+    /// namespace if @c path starts with '@'.  Paths too long for sun_path
+    /// are logged and cut.
+    static InetAddress fromUnixPath(StringArg path);
 
     sa_family_t family() const { return addr_.sin_family; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    /// The address, or the path of a Unix domain socket.
     std::string toIp() const;
+    /// "ip:port", or "unix:path" for a Unix domain socket.
     std::string toIpPort() const;
+    /// 0 for a Unix domain socket.
     uint16_t port() const;
+    /// For bind(2) and connect(2).
+    socklen_t length() const;
 
     const struct sockaddr *getSockAddr() const { return sockets::sockaddr_cast(&addr6_); }
 
@@ -38,6 +56,7 @@ class InetAddress : public copyable {
     uint16_t portNetEndian() const { return addr_.sin_port; }
     void setScopeId(uint32_t scope_id);
 
+    /// Blocking and IPv4 only, IO threads should use Resolver instead.
     static bool resolve(StringArg hostname, InetAddress *result);
 };
 
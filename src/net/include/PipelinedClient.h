@@ -0,0 +1,127 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Buffer.h"
+#include "InetAddress.h"
+#include "StringPiece.h"
+#include "TcpClient.h"
+#include "TimerId.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+/// Pipelines requests of a request/response protocol over one TcpClient
+/// connection.
+///
+/// Up to Options::maxInFlight requests are sent ahead of their responses,
+/// the rest wait in order.  Requests queued during one loop iteration, and
+/// those let through when responses open the window, leave in a single
+/// write.  The protocol comes in as a Framer which finds the first
+/// complete response in the input; responses are matched to requests in
+/// order (kFifo) or by the id the framer reports (kById), in which case
+/// the server may answer out of order.  Every request has a deadline on
+/// the loop's TimerQueue from the moment it is sent() and fails with
+/// kTimeout when it passes.  A request timed out in flight still holds its
+/// place in the window until its response arrives or the connection
+/// closes, since the server is still working on it.
+///
+/// The connection is reopened with the Connector's backoff when it
+/// closes; requests in flight then fail with kConnectionClosed, queued
+/// ones wait for the new connection or their deadline.  send() is thread
+/// safe, callbacks run in the loop thread.  Destroy the client in its
+/// loop thread; outstanding requests are dropped without callbacks.
+class PipelinedClient : noncopyable {
+ public:
+    enum Error {
+        kOk,
+        kTimeout,
+        kConnectionClosed,
+        kBadResponse,  // the framer failed, the connection is closed
+        kOverloaded,   // Options::maxQueued requests waiting already
+        kDuplicateId,  // kById, another request with the id is in flight
+    };
+    enum Matching { kFifo, kById };
+
+    struct Options {
+        Matching matching = kFifo;
+        std::size_t maxInFlight = 64;
+        std::size_t maxQueued = 64 * 1024;
+        double timeoutSeconds = 5.0;
+    };
+
+    /// The length of the first complete response in @c buf, 0 if it is not
+    /// complete yet, -1 if the input is garbage.  Sets @c *id with kById.
+    using Framer = std::function<ssize_t(const Buffer& buf, uint64_t* id)>;
+    /// @c response is the complete framed response, empty unless kOk and
+    /// only valid during the call.
+    using Callback = std::function<void(Error error, StringPiece response)>;
+
+    PipelinedClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name,
+                    Framer framer);
+    PipelinedClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name,
+                    Framer framer, const Options& options);
+    ~PipelinedClient();
+
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+
+    void connect();
+    /// Shuts the connection down for good, queued requests run into their
+    /// deadlines.
+    void disconnect();
+
+    /// Queues @c request, which carries @c id with kById.  Ids must be
+    /// unique among the requests in flight, a request reusing one fails
+    /// with kDuplicateId when its turn to be sent comes.
+    void send(std::string request, Callback cb);
+    void send(std::string request, uint64_t id, Callback cb);
+
+    static const char* errorString(Error error);
+
+    /// Loop thread only, for tests and metrics.
+    bool connected() const { return connection_ != nullptr; }
+    std::size_t numQueued() const { return queued_.size(); }
+    std::size_t numInFlight() const { return inFlight_; }
+    uint64_t numWrites() const { return writes_; }
+
+ private:
+    struct Call {
+        std::string request;
+        uint64_t id;
+        Callback cb;  // empty once completed, e.g. timed out in flight
+        TimerId timer;
+        bool sent = false;
+    };
+    using CallPtr = std::shared_ptr<Call>;
+
+    EventLoop* loop_;
+    std::shared_ptr<bool> alive_;  // for functors queued in the loop
+    TcpClient client_;
+    const Framer framer_;
+    const Options options_;
+    ConnectionCallback connectionCallback_;
+    TcpConnectionPtr connection_;
+    std::deque<CallPtr> queued_;
+    std::deque<CallPtr> sentInOrder_;               // kFifo
+    std::unordered_map<uint64_t, CallPtr> sentById_;  // kById
+    std::size_t inFlight_;
+    uint64_t writes_;
+    bool pumpQueued_;
+
+    void sendInLoop(const CallPtr& call);
+    void pump();
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf);
+    void onTimeout(const CallPtr& call);
+    void failInFlight(Error error);
+    void complete(const CallPtr& call, Error error, StringPiece response);
+};
+
+}  // namespace dws::net
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+class EventLoop;
+class UdpSocket;
+
+/// A non-blocking DNS stub resolver driven by an EventLoop.
+///
+/// Queries go to one nameserver over UDP through a UdpSocket, are retried
+/// after Options::timeoutSeconds and answered from a cache that honours
+/// the records' TTL (clamped to [minTtlSeconds, maxTtlSeconds]); names
+/// that do not exist are cached for negativeTtlSeconds.  Concurrent
+/// lookups of the same name and type share one query.  IP literals and
+/// "localhost" are answered without a query.  Truncated answers are used
+/// as far as they go, there is no TCP fallback.
+///
+/// resolve() is thread safe, the callback runs in the resolver's loop and
+/// never from within resolve().  Lookups still pending when the resolver
+/// is destroyed, which must happen in its loop, are not called back.
+class Resolver : noncopyable {
+ public:
+    enum Family {
+        kIPv4,  // A
+        kIPv6,  // AAAA
+        kAny,   // AAAA and A, IPv6 addresses first
+    };
+    enum Error {
+        kOk,
+        kNotFound,  // NXDOMAIN, or no record of the type
+        kTimeout,
+        kServerFailure,
+        kBadName,
+    };
+    struct Options {
+        double timeoutSeconds = 1.0;
+        /// Sends per query, the first one included.
+        int attempts = 3;
+        double minTtlSeconds = 1.0;
+        double maxTtlSeconds = 3600.0;
+        double negativeTtlSeconds = 5.0;
+        std::size_t maxCacheEntries = 4096;
+    };
+    /// The addresses carry the port passed to resolve().
+    using Callback = std::function<void(Error, const std::vector<InetAddress>&)>;
+
+    /// Uses systemNameserver().
+    explicit Resolver(EventLoop* loop);
+    Resolver(EventLoop* loop, const InetAddress& nameserver);
+    Resolver(EventLoop* loop, const InetAddress& nameserver, const Options& options);
+    ~Resolver();
+
+    void resolve(const std::string& host, uint16_t port, Family family, Callback cb);
+
+    EventLoop* getLoop() const { return loop_; }
+    const InetAddress& nameserver() const { return nameserver_; }
+    /// Counters for tests and metrics, loop thread only.
+    uint64_t queriesSent() const { return queriesSent_; }
+    uint64_t cacheHits() const { return cacheHits_; }
+    uint64_t coalesced() const { return coalesced_; }
+    std::size_t cacheSize() const { return cache_.size(); }
+
+    /// The first nameserver of /etc/resolv.conf, 127.0.0.1:53 without one.
+    static InetAddress systemNameserver();
+    static const char* errorString(Error error);
+
+ private:
+    using LookupCallback = std::function<void(Error, const std::vector<InetAddress>&)>;
+
+    struct CacheEntry {
+        Error error;
+        std::vector<InetAddress> addresses;  // port 0
+        Timestamp expires;
+    };
+
+    // one question in flight, shared by everyone asking it meanwhile
+    struct Query {
+        uint16_t id;
+        uint16_t type;
+        std::string name;
+        std::string packet;
+        int attemptsLeft;
+        TimerId timer;
+        std::vector<LookupCallback> waiters;
+    };
+
+    EventLoop* loop_;
+    const InetAddress nameserver_;
+    const Options options_;
+    std::shared_ptr<UdpSocket> socket_;
+    std::unordered_map<std::string, CacheEntry> cache_;  // by name and type
+    std::unordered_map<uint16_t, std::unique_ptr<Query>> queries_;  // by id
+    std::unordered_map<std::string, uint16_t> pending_;             // name and type to id
+    std::mt19937 random_;  // query ids
+    uint64_t queriesSent_;
+    uint64_t cacheHits_;
+    uint64_t coalesced_;
+
+    void resolveInLoop(const std::string& host, uint16_t port, Family family, Callback cb);
+    void lookup(const std::string& name, uint16_t type, LookupCallback cb);
+    void send(Query* query);
+    void onTimeout(uint16_t id);
+    void onResponse(const char* data, std::size_t len, const InetAddress& peer);
+    void finish(uint16_t id, Error error, const std::vector<InetAddress>& addresses,
+                double ttlSeconds);
+    uint16_t nextId();
+};
+
+}  // namespace dws::net
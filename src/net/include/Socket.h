@@ -3,6 +3,7 @@
 #include "noncopyable.h"
 
 struct tcp_info;
+struct ucred;
 
 namespace dws::net {
 
@@ -19,6 +20,9 @@ class Socket : noncopyable {
     int fd() const { return sockfd_; }
     bool getTcpInfo(struct tcp_info *) const;
     bool getTcpInfoString(char *buf, int len) const;
+    /// pid, uid and gid of the process at the other end of a Unix domain
+    /// socket, as of connect(2).
+    bool getPeerCredentials(struct ucred *) const;
     void bindAddress(const InetAddress &localaddr);
     void listen();
     int accept(InetAddress *peeraddr);
@@ -27,6 +31,10 @@ class Socket : noncopyable {
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    /// TCP_FASTOPEN on a listening socket: up to @c queueLength connections
+    /// may carry data in their SYN before the handshake completes, 0 turns
+    /// it off.  The kernel also needs net.ipv4.tcp_fastopen & 2.
+    bool setTcpFastOpen(int queueLength);
 };
 
 }  // namespace dws::net
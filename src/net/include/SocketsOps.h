@@ -1,21 +1,32 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <sys/socket.h>
 
 #include <cstddef>
+#include <cstdint>
 
 namespace dws::net::sockets {
 
-/// Creates a non-blocking socket file descriptor,
-/// abort if any error.
+/// Creates a non-blocking stream socket file descriptor, TCP for
+/// AF_INET and AF_INET6, abort if any error.
 int createNonblockingOrDie(sa_family_t family);
+/// Same for a UDP socket.
+int createUdpNonblockingOrDie(sa_family_t family);
 int connect(int sockfd, const struct sockaddr *addr);
 void bindOrDie(int sockfd, const struct sockaddr *addr);
 void listenOrDie(int sockfd);
-int accept(int sockfd, struct sockaddr_in6 *addr);
+int accept(int sockfd, struct sockaddr_storage *addr);
 ssize_t read(int sockfd, void *buf, std::size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, std::size_t count);
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+/// Moves up to @c len bytes between a socket and a pipe without copying
+/// them to user space, non-blocking.
+ssize_t splice(int fdIn, int fdOut, std::size_t len);
+/// Writes up to @c count bytes of the file @c fileFd from *offset to the
+/// socket and advances *offset, the file never enters user space.
+ssize_t sendfile(int sockfd, int fileFd, int64_t *offset, std::size_t count);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 void toIpPort(char *buf, std::size_t size, const struct sockaddr *addr);
@@ -23,14 +34,18 @@ void toIp(char *buf, std::size_t size, const struct sockaddr *addr);
 void fromIpPort(const char *ip, uint16_t port, struct sockaddr_in *addr);
 void fromIpPort(const char *ip, uint16_t port, struct sockaddr_in6 *addr);
 int getSocketError(int sockfd);
+/// The length to pass with @c addr to bind(2) and connect(2), by family;
+/// for AF_UNIX it depends on the path.
+socklen_t sockaddrLength(const struct sockaddr *addr);
 const struct sockaddr *sockaddr_cast(const struct sockaddr_in *addr);
 struct sockaddr *sockaddr_cast(struct sockaddr_in *addr);
 const struct sockaddr *sockaddr_cast(const struct sockaddr_in6 *addr);
 struct sockaddr *sockaddr_cast(struct sockaddr_in6 *addr);
+struct sockaddr *sockaddr_cast(struct sockaddr_storage *addr);
 const struct sockaddr_in *sockaddr_in_cast(const struct sockaddr *addr);
 const struct sockaddr_in6 *sockaddr_in6_cast(const struct sockaddr *addr);
-struct sockaddr_in6 getLocalAddr(int sockfd);
-struct sockaddr_in6 getPeerAddr(int sockfd);
+struct sockaddr_storage getLocalAddr(int sockfd);
+struct sockaddr_storage getPeerAddr(int sockfd);
 bool isSelfConnect(int sockfd);
 
 }  // namespace dws::net::sockets
@@ -13,11 +13,16 @@
 namespace dws::net {
 
 class Connector;
+class Resolver;
 using ConnectorPtr = std::shared_ptr<Connector>;
 
 class TcpClient : noncopyable {
  public:
     TcpClient(EventLoop* loop, const InetAddress& serverAddr, std::string name);
+    /// Resolves @c host with @c resolver, which must outlive the client,
+    /// on every connection attempt.
+    TcpClient(EventLoop* loop, Resolver* resolver, const std::string& host, uint16_t port,
+              std::string name);
     ~TcpClient();
 
     void connect();
@@ -32,6 +37,10 @@ class TcpClient : noncopyable {
     EventLoop* getLoop() const { return loop_; }
     bool retry() const { return retry_; }
     void enableRetry() { retry_ = true; }
+    /// The first bytes of every connection, carried by the SYN with TCP
+    /// Fast Open where possible, see Connector::setFastOpenData().  Sent
+    /// before anything the connection callback sends.  Before connect().
+    void setFastOpenData(std::string data);
     const std::string& name() const { return name_; }
 
     void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
@@ -55,6 +64,7 @@ class TcpClient : noncopyable {
     mutable std::mutex mutex_;
     TcpConnectionPtr connection_ GUARDED_BY(mutex_);
 
+    void init();
     void newConnection(int sockfd);
     void removeConnection(const TcpConnectionPtr& conn);
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "InetAddress.h"
+#include "TcpConnection.h"
+#include "ThreadAnnotations.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+class Connector;
+class EventLoop;
+class EventLoopThreadPool;
+
+/// Keeps several connections to one server, spread round robin over its
+/// own IO loops (or the base loop without IO threads), and hands out the
+/// one with the fewest bytes in flight.
+///
+/// Bytes count as in flight from send() until the caller reports the reply
+/// with complete(); a connection's count is reset when it closes.  start()
+/// opens Options::minConnections ahead of demand.  When even the least
+/// loaded connection has Options::growInFlightBytes in flight, pick() opens
+/// another one in the background, up to Options::maxConnections, and keeps
+/// using the established ones meanwhile.  A connection that fails or
+/// closes is replaced: its slot reconnects with the Connector's backoff.
+///
+/// pick(), send(), complete() and the stats are thread safe; the callbacks
+/// run in the connection's loop.  Destroy the pool in the base loop.
+class TcpClientPool : noncopyable {
+ public:
+    struct Options {
+        int minConnections = 2;
+        int maxConnections = 8;
+        /// IO threads owned by the pool, 0 keeps everything in the base loop.
+        int numThreads = 0;
+        std::size_t growInFlightBytes = 64 * 1024;
+        bool tcpNoDelay = true;
+    };
+
+    TcpClientPool(EventLoop* baseLoop, const InetAddress& serverAddr, const std::string& name);
+    TcpClientPool(EventLoop* baseLoop, const InetAddress& serverAddr, const std::string& name,
+                  const Options& options);
+    ~TcpClientPool();
+
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+
+    /// Starts the IO threads and the first Options::minConnections
+    /// connections.  Must be called in the base loop.
+    void start();
+
+    /// The established connection with the fewest bytes in flight, nullptr
+    /// while there is none.
+    TcpConnectionPtr pick();
+    /// Sends @c message over pick() and counts it as in flight there.
+    /// Returns the connection used, nullptr if none is established.
+    TcpConnectionPtr send(const StringPiece& message);
+    /// The reply to @c bytes sent over @c conn has arrived.
+    void complete(const TcpConnectionPtr& conn, std::size_t bytes);
+
+    const std::string& name() const { return name_; }
+    /// Slots opened so far, established or still connecting.
+    int numSlots() const;
+    int numConnected() const;
+    /// Connections that went away and were reconnected in the background.
+    int64_t numReplaced() const { return replaced_.load(std::memory_order_relaxed); }
+    /// The sum of all in-flight bytes, for tests and metrics.
+    int64_t inFlightBytes() const;
+
+ private:
+    struct Slot {
+        int index = 0;
+        EventLoop* loop = nullptr;
+        std::shared_ptr<Connector> connector;
+        // guarded by the pool's mutex_
+        TcpConnectionPtr connection;
+        int64_t inFlight = 0;
+        bool everConnected = false;  // loop thread only
+        bool retired = false;        // loop thread only
+    };
+    using SlotPtr = std::shared_ptr<Slot>;
+
+    EventLoop* baseLoop_;
+    const InetAddress serverAddr_;
+    const std::string name_;
+    const Options options_;
+    std::unique_ptr<EventLoopThreadPool> threadPool_;
+    std::vector<EventLoop*> loops_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    std::atomic<bool> started_;
+    std::atomic<bool> stopping_;
+    std::atomic<int64_t> replaced_;
+    mutable std::mutex mutex_;
+    std::vector<SlotPtr> slots_ GUARDED_BY(mutex_);
+
+    /// The Connector of the new slot is left to startSlot(), called
+    /// without mutex_.
+    SlotPtr addSlotLocked() REQUIRES(mutex_);
+    void startSlot(const SlotPtr& slot);
+    /// Stores a slot it opened in @c added, to be started after unlocking.
+    SlotPtr pickLocked(SlotPtr* added) REQUIRES(mutex_);
+    void newConnection(const SlotPtr& slot, int sockfd);
+    void removeConnection(const SlotPtr& slot, const TcpConnectionPtr& conn);
+    SlotPtr findSlotLocked(const TcpConnectionPtr& conn) const REQUIRES(mutex_);
+};
+
+}  // namespace dws::net
@@ -1,18 +1,24 @@
 #pragma once
 
 #include <any>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
 
 #include "Buffer.h"
 #include "Callbacks.h"
+#include "ConnectionStats.h"
 #include "InetAddress.h"
+#include "LogStream.h"
 #include "StringPiece.h"
 #include "Types.h"
 #include "noncopyable.h"
 
+struct iovec;
 struct tcp_info;
+struct ucred;
 
 namespace dws::net {
 
@@ -22,26 +28,93 @@ class Socket;
 
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection> {
  public:
+    using MigrateCallback = std::function<void(const TcpConnectionPtr&)>;
+    /// Reads from @c sockfd and returns what read(2) would: a positive
+    /// count, 0 at end of stream, or -1 with *savedErrno set.
+    using ReadHandler = std::function<ssize_t(int sockfd, int* savedErrno)>;
+
     TcpConnection(EventLoop* loop, const std::string& name, int sockfd,
                   const InetAddress& localAddr, const InetAddress& peerAddr);
+    /// Name is formatted on demand as "<namePrefix>#<id>", so accepting a
+    /// connection never builds a string; log it with operator<<, which
+    /// does not build one either.
+    TcpConnection(EventLoop* loop, ConnectionId id, std::shared_ptr<const std::string> namePrefix,
+                  int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr);
     ~TcpConnection();
 
-    EventLoop* getLoop() const { return loop_; }
-    const std::string& name() const { return name_; }
+    /// The owner loop changes when the connection migrates, see migrate().
+    EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
+    ConnectionId id() const { return id_; }
+    std::string name() const;
+    const std::string& namePrefix() const { return *namePrefix_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
     bool connected() const { return state_ == kConnected; }
     bool disconnected() const { return state_ == kDisconnected; }
     bool getTcpInfo(struct tcp_info*) const;
     std::string getTcpInfoString() const;
+    /// Unix domain sockets only, see Socket::getPeerCredentials().
+    bool getPeerCredentials(struct ucred*) const;
+    /// Counters are written by the loop thread only and may be read from
+    /// any thread, e.g. TcpServer aggregates them in the acceptor loop.
+    const ConnectionStats& stats() const { return stats_; }
 
     void send(const void* message, int len);
     void send(const StringPiece& message);
     void send(Buffer* buf);
     void shutdown();
+    /// Stops handing input to the message callback and, once no response
+    /// is pending, shuts down the write side after the output buffer is
+    /// flushed.  Until then send() keeps working.  Input is still read so
+    /// that the peer's close is noticed.  Thread safe.
+    void drain();
+    bool draining() const { return draining_; }
+    /// Marks a response the application still owes, e.g. for a request
+    /// handed to a worker thread; drain() waits for it.  Thread safe.
+    void beginResponse();
+    /// Call once the response has been sent.  Thread safe.
+    void endResponse();
     void forceClose();
+    /// Moves the connection to @c target, keeping its buffers, context,
+    /// callbacks and stats.  The Channel is removed from the current poller
+    /// after the ongoing iteration and re-registered on @c target, where
+    /// @c cb runs once it is done.  Thread safe.
+    void migrate(EventLoop* target, MigrateCallback cb = MigrateCallback());
     void forceCloseWithDelay(double seconds);
     void setTcpNoDelay(bool on);
+    /// Opt-in write coalescing.  Sends issued in the same EventLoop iteration
+    /// are appended to the output buffer and written with one syscall after
+    /// the iteration's events and functors ran, or right away once
+    /// @c maxPendingBytes are buffered or a send finds the oldest buffered
+    /// byte waiting for @c maxDelayUs, so a long iteration does not hold
+    /// back what was sent early in it.
+    void setWriteCoalescing(bool on, size_t maxPendingBytes = kDefaultMaxCoalesceBytes,
+                            int64_t maxDelayUs = kDefaultMaxCoalesceDelayUs);
+    bool writeCoalescing() const { return coalescing_; }
+    /// Writes what the caller appended to outputBuffer() itself, e.g. a
+    /// protocol encoder serializing straight into it.  Honours write
+    /// coalescing.  Loop thread only.
+    void sendOutputBuffer();
+    /// Gathers @c iovcnt pieces into one writev() when nothing is queued
+    /// ahead of them, so large values go out without being copied.  What the
+    /// socket does not take is copied to the output buffer, the caller may
+    /// reuse the memory on return.  Loop thread only.
+    void sendVectored(const struct iovec* iov, int iovcnt);
+    /// Splices @c bytes the caller put into the pipe @c pipeFd to the
+    /// socket, so they never enter user space.  What the socket does not
+    /// take stays in the pipe and follows once it is writable, the write
+    /// complete callback tells when pipeBytes() is back to zero.  Nothing
+    /// else may be sent before.  Loop thread only.
+    void sendPipe(int pipeFd, size_t bytes);
+    size_t pipeBytes() const { return pipeBytes_; }
+    /// Writes @c count bytes of the file @c fd from @c offset with
+    /// sendfile(2) once what is in the output buffer is written, e.g. after
+    /// the header of a response.  @c owner is held until then, so that the
+    /// descriptor stays open; the write complete callback tells when
+    /// fileBytes() is back to zero.  Nothing else may be sent before.  Loop
+    /// thread only.
+    void sendFile(int fd, int64_t offset, size_t count, std::shared_ptr<const void> owner);
+    size_t fileBytes() const { return fileBytes_; }
     void startRead();
     void stopRead();
     bool isReading() const { return reading_; }
@@ -60,15 +133,32 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
     Buffer* inputBuffer() { return &inputBuffer_; }
     Buffer* outputBuffer() { return &outputBuffer_; }
     void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
+    /// With this callback the peer shutting down its sending side no longer
+    /// closes the connection: reading stops, @c cb runs, and the connection
+    /// closes once shutdown() has completed on this side as well.
+    void setHalfCloseCallback(const HalfCloseCallback& cb) { halfCloseCallback_ = cb; }
+    /// Takes over reading, e.g. to splice(2) the socket into a pipe: on
+    /// readable events @c handler runs instead of reading into the input
+    /// buffer and the message callback.  EAGAIN from it is ignored.  Loop
+    /// thread only, an empty handler restores the default.
+    void setReadHandler(ReadHandler handler) { readHandler_ = std::move(handler); }
     void connectEstablished();
     void connectDestroyed();
 
  private:
     enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
-    EventLoop* loop_;
-    const std::string name_;
+    static const size_t kDefaultMaxCoalesceBytes = 64 * 1024;
+    static const int64_t kDefaultMaxCoalesceDelayUs = 1000;
+    // tcp_info RTT is sampled on reads, at most once per interval
+    static const int64_t kRttSampleIntervalUs = 1000 * 1000;
+
+    std::atomic<EventLoop*> loop_;
+    const ConnectionId id_;
+    const std::shared_ptr<const std::string> namePrefix_;
     StateE state_;
     bool reading_;
+    std::atomic<bool> draining_;
+    std::atomic<int> pendingResponses_;
     std::unique_ptr<Socket> socket_;
     std::unique_ptr<Channel> channel_;
     const InetAddress localAddr_;
@@ -78,18 +168,51 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
     WriteCompleteCallback writeCompleteCallback_;
     HighWaterMarkCallback highWaterMarkCallback_;
     CloseCallback closeCallback_;
+    HalfCloseCallback halfCloseCallback_;
+    ReadHandler readHandler_;
     size_t highWaterMark_;
+    bool coalescing_;
+    bool flushQueued_;
+    size_t maxCoalesceBytes_;
+    int64_t maxCoalesceDelayUs_;
+    int64_t coalescingSince_;  // when the queued flush was queued
+    size_t flushBase_;         // buffered before the sends the flush writes
     Buffer inputBuffer_;
     Buffer outputBuffer_;
+    int pipeFd_;
+    size_t pipeBytes_;
+    int fileFd_;
+    int64_t fileOffset_;
+    size_t fileBytes_;
+    std::shared_ptr<const void> fileOwner_;
+    bool peerShutdown_;  // FIN received, with a half-close callback
+    bool writeShutdown_;
     std::any context_;
+    ConnectionStats stats_;
+    int64_t lastRttSample_;
 
     void handleRead(Timestamp receiveTime);
     void handleWrite();
+    void handlePeerShutdown();
+    /// Splices what it can of pipeBytes_, false on errors other than EAGAIN.
+    bool writePipe();
+    /// Sends what it can of fileBytes_, false on errors other than EAGAIN or
+    /// if the file turns out shorter.
+    bool writeFile();
     void handleClose();
     void handleError();
+    void setupChannel();
+    void sampleRtt(Timestamp now);
+    void runInOwnerLoop(std::function<void()> cb);
+    void migrateInLoop(EventLoop* target, MigrateCallback cb);
+    void attachAfterMigration(const MigrateCallback& cb);
     void sendInLoop(const StringPiece& message);
+    void sendInLoop(const std::string& message);
     void sendInLoop(const void* message, size_t len);
     void shutdownInLoop();
+    void coalesce(size_t oldLen);
+    void flushCoalescedWrites();
+    void drainInLoop();
     void forceCloseInLoop();
     void setState(StateE s) { state_ = s; }
     const char* stateToString() const;
@@ -97,4 +220,7 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
     void stopReadInLoop();
 };
 
+/// Streams name() without building it.
+LogStream& operator<<(LogStream& s, const TcpConnection& conn);
+
 }  // namespace dws::net
@@ -4,8 +4,12 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "ConnectionRegistry.h"
 #include "TcpConnection.h"
+#include "TimerId.h"
 #include "Types.h"
 
 namespace dws::net {
@@ -17,6 +21,10 @@ class EventLoopThreadPool;
 class TcpServer : noncopyable {
  public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    /// Reports stop() progress in the acceptor loop: @c remaining connections
+    /// still draining and how many were @c forced closed at the deadline.
+    /// The last call has remaining == 0.
+    using StopCallback = std::function<void(std::size_t remaining, std::size_t forced)>;
     enum Option {
         kNoReusePort,
         kReusePort,
@@ -31,18 +39,56 @@ class TcpServer : noncopyable {
     EventLoop* getLoop() const { return loop_; }
     void setThreadNum(int numThreads);
     void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    /// TCP Fast Open: clients holding a cookie may send their first bytes
+    /// with the SYN, up to @c queueLength such connections pending.  The
+    /// request must be safe to see twice, a SYN can be retransmitted.
+    /// Before start().
+    void setFastOpen(int queueLength);
     std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
     void start();
+    /// Graceful shutdown, thread safe.  Closes the listening socket, stops
+    /// handing input to the message callback, shuts down the write side of
+    /// every connection once its output buffer is flushed and force-closes
+    /// whatever is still open after @c timeoutSeconds.
+    void stop(double timeoutSeconds, StopCallback cb = StopCallback());
+    /// Every @c intervalSeconds, if the busiest IO loop spent more than
+    /// @c busyThreshold of the interval outside poll and at least twice as
+    /// long as the idlest one, migrates one connection between them.  The
+    /// connection is chosen by time spent in its message callback so that
+    /// the move narrows the gap instead of flipping it.  Thread safe.
+    void enableRebalancing(double intervalSeconds, double busyThreshold = 0.5);
+    /// For servers keeping state per IO loop of their connections, e.g.
+    /// keyed by ConnectionRegistry::loopIndexOf(): enableRebalancing() is
+    /// refused from now on.  Before start().
+    void disableMigration() { migratable_ = false; }
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
 
- private:
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    /// Number of live connections, must be called in the acceptor loop.
+    std::size_t numConnections() const;
+    /// Returns the connection carrying @c id or nullptr if it has gone,
+    /// must be called in the acceptor loop.
+    TcpConnectionPtr findConnection(ConnectionId id) const;
+
+    using StatsSnapshot = ConnectionStats::Snapshot;
+    /// Traffic of live and already closed connections, indexed by the
+    /// current IO loop (see loopIndexOf()).  Acceptor loop only.
+    std::vector<StatsSnapshot> statsPerLoop() const;
+    /// Sum of statsPerLoop().  Acceptor loop only.
+    StatsSnapshot stats() const;
+    /// The @c n live connections that moved the most bytes, busiest first.
+    /// Acceptor loop only.
+    std::vector<std::pair<ConnectionId, StatsSnapshot>> busiestConnections(std::size_t n) const;
+    /// Index of @c ioLoop in threadPool(), the number of loops for a loop
+    /// outside of it, which migrate() accepts.  After start(), thread safe.
+    std::size_t loopIndexOf(EventLoop* ioLoop) const;
 
+ private:
     EventLoop* loop_;  // acceptor loop
     const std::string ipPort_;
     const std::string name_;
+    const std::shared_ptr<const std::string> connNamePrefix_;
     std::unique_ptr<Acceptor> acceptor_;
     std::shared_ptr<EventLoopThreadPool> threadPool_;
     ConnectionCallback connectionCallback_;
@@ -50,12 +96,28 @@ class TcpServer : noncopyable {
     WriteCompleteCallback writeCompleteCallback_;
     ThreadInitCallback threadInitCallback_;
     std::atomic<int> started_;
-    int nextConnId_;
-    ConnectionMap connections_;
+    bool migratable_;
+    std::vector<EventLoop*> loops_;  // of threadPool_, set by start()
+    std::unordered_map<EventLoop*, std::size_t> loopIndex_;
+    ConnectionRegistry connections_;
+    std::vector<StatsSnapshot> closedStats_;  // per loop index
+    bool stopping_;
+    std::size_t forcedClosed_;
+    TimerId stopTimer_;
+    StopCallback stopCallback_;
+    TimerId rebalanceTimer_;
+    double rebalanceInterval_;
+    double rebalanceThreshold_;
+    std::vector<int64_t> lastLoopBusy_;
+    std::unordered_map<ConnectionId, uint64_t> lastCallbackTime_;
 
     void newConnection(int sockfd, const InetAddress& peerAddr);
     void removeConnection(const TcpConnectionPtr& conn);
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    void stopInLoop(double timeoutSeconds, StopCallback cb);
+    void forceCloseRemaining();
+    void reportStopProgress();
+    void rebalance();
 };
 
 }  // namespace dws::net
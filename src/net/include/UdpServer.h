@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "UdpSocket.h"
+
+namespace dws::net {
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/// Serves one UDP address from every IO loop: each loop gets its own
+/// UdpSocket bound with SO_REUSEPORT and the kernel spreads the datagrams
+/// over them by peer address, so the loops share nothing.  Without IO
+/// threads there is a single socket in the base loop.  The port must not
+/// be 0 for more than one loop.
+class UdpServer : noncopyable {
+ public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name);
+    UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+              const UdpSocket::Options& options);
+    ~UdpServer();
+
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+    void setThreadNum(int numThreads);
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    /// Runs in the socket's loop, reply through the UdpSocketPtr passed in.
+    void setMessageCallback(const UdpSocket::MessageCallback& cb) { messageCallback_ = cb; }
+    /// Must be called in the base loop.
+    void start();
+
+    /// One per IO loop, valid after start().
+    const std::vector<UdpSocketPtr>& sockets() const { return sockets_; }
+    /// Sum over sockets(), thread safe after start().
+    UdpSocket::Stats stats() const;
+
+ private:
+    EventLoop* loop_;  // base loop
+    const InetAddress listenAddr_;
+    const std::string name_;
+    UdpSocket::Options options_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpSocket::MessageCallback messageCallback_;
+    std::vector<UdpSocketPtr> sockets_;
+    bool started_;
+};
+
+}  // namespace dws::net
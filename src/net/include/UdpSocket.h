@@ -0,0 +1,143 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Channel.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+class EventLoop;
+class UdpSocket;
+
+using UdpSocketPtr = std::shared_ptr<UdpSocket>;
+
+/// A non-blocking UDP socket driven by an EventLoop, create it with
+/// std::make_shared.
+///
+/// Datagrams are received with recvmmsg(2) into one preallocated batch of
+/// buffers, up to Options::batchSize per system call, and handed to the
+/// message callback one by one; the data is only valid during the call.
+/// send() queues datagrams and they leave together with sendmmsg(2) once
+/// the batch is full or the loop finishes the current iteration, so the
+/// replies to a batch of requests cost one system call.  With
+/// Options::gso consecutive datagrams of the same size to the same peer are
+/// merged into one UDP_SEGMENT message the kernel splits late, with
+/// Options::gro the kernel may deliver such trains as one buffer which is
+/// split again here.  Both are silently off where the kernel lacks them.
+///
+/// Everything but stats() must be called in the loop thread, which must
+/// also be the one to drop the last reference.
+class UdpSocket : noncopyable, public std::enable_shared_from_this<UdpSocket> {
+ public:
+    struct Options {
+        /// Datagrams per recvmmsg and sendmmsg call.
+        int batchSize = 64;
+        /// Longer datagrams are dropped.  Receive slots are 64 KiB with gro.
+        std::size_t maxDatagramBytes = 2048;
+        bool reusePort = false;
+        bool gro = false;
+        bool gso = false;
+        /// SO_RCVBUF, 0 keeps the system default.
+        int receiveBufferBytes = 0;
+        /// send() drops datagrams while this much is queued for a full
+        /// socket buffer.
+        std::size_t maxPendingBytes = 4 * 1024 * 1024;
+    };
+
+    struct Stats {
+        uint64_t packetsReceived = 0;
+        uint64_t receiveCalls = 0;
+        uint64_t packetsSent = 0;
+        uint64_t sendCalls = 0;
+        /// Truncated on receipt, refused by send() or failed to go out.
+        uint64_t dropped = 0;
+    };
+
+    using MessageCallback = std::function<void(const UdpSocketPtr&, const char* data,
+                                               std::size_t len, const InetAddress& peer,
+                                               Timestamp receiveTime)>;
+
+    UdpSocket(EventLoop* loop, const InetAddress& bindAddr);
+    UdpSocket(EventLoop* loop, const InetAddress& bindAddr, const Options& options);
+    ~UdpSocket();
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    /// The bound address, with the port the kernel picked for port 0.
+    InetAddress localAddress() const;
+    bool groEnabled() const { return gro_; }
+    bool gsoEnabled() const { return gso_; }
+
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+    /// Starts reading.
+    void start();
+    /// Queues a datagram for @c peer, false if it was dropped because too
+    /// much is queued already or it is longer than a datagram can be.
+    bool send(const InetAddress& peer, const void* data, std::size_t len);
+    /// Sends what is queued now instead of at the end of the loop iteration.
+    void flush();
+
+    /// Thread safe.
+    Stats stats() const;
+
+ private:
+    // One sendmmsg entry: a run of equally sized datagrams to one peer,
+    // more than one only with GSO.
+    struct Pending {
+        InetAddress peer;
+        std::size_t offset;
+        std::size_t length;
+        std::size_t segmentSize;
+        int segments;
+    };
+
+    EventLoop* loop_;
+    Socket socket_;
+    Channel channel_;
+    const Options options_;
+    bool gro_;
+    bool gso_;
+    MessageCallback messageCallback_;
+
+    const std::size_t slotBytes_;
+    std::vector<char> receiveBuffer_;  // batchSize slots
+    std::vector<char> receiveControl_;
+    std::vector<struct sockaddr_in6> receiveAddrs_;
+    std::vector<struct iovec> receiveIovs_;
+    std::vector<struct mmsghdr> receiveMsgs_;
+
+    std::vector<char> sendBuffer_;  // queued datagrams back to back
+    std::vector<Pending> pending_;
+    std::size_t sent_;  // entries of pending_ already sent
+    std::vector<char> sendControl_;
+    std::vector<struct iovec> sendIovs_;
+    std::vector<struct mmsghdr> sendMsgs_;
+    bool flushQueued_;
+
+    std::atomic<uint64_t> packetsReceived_;
+    std::atomic<uint64_t> receiveCalls_;
+    std::atomic<uint64_t> packetsSent_;
+    std::atomic<uint64_t> sendCalls_;
+    std::atomic<uint64_t> dropped_;
+
+    static const int kMaxGsoSegments;
+    static const std::size_t kMaxGsoBytes;
+    static const int kMaxReadRounds;
+
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void splitGsoBatches();
+};
+
+}  // namespace dws::net
@@ -1,6 +1,7 @@
 #include "Acceptor.h"
 
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <cerrno>
@@ -12,15 +13,44 @@
 
 namespace dws::net {
 
+namespace {
+
+// Whether nobody listens on the socket file of @c addr any more, so that it
+// can be removed.  A live server accepts the connection or, with a full
+// backlog, refuses it with EAGAIN instead of ECONNREFUSED.
+bool isStaleSocketFile(const InetAddress& addr) {
+    int fd = sockets::createNonblockingOrDie(AF_UNIX);
+    bool stale = sockets::connect(fd, addr.getSockAddr()) < 0 && errno == ECONNREFUSED;
+    sockets::close(fd);
+    return stale;
+}
+
+}  // namespace
+
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
     : loop_(loop),
       acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),
       acceptChannel_(loop, acceptSocket_.fd()),
       listening_(false),
-      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      fastOpenQueueLength_(0),
+      isUnix_(listenAddr.isUnix()) {
     assert(idleFd_ >= 0);
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(reuseport);
+    if (listenAddr.isUnix()) {
+        unixPath_ = listenAddr.toIp();
+        if (unixPath_.empty() || unixPath_[0] == '@') {
+            unixPath_.clear();  // abstract, nothing on disk
+        } else {
+            struct stat st;
+            if (::stat(unixPath_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) &&
+                isStaleSocketFile(listenAddr)) {
+                ::unlink(unixPath_.c_str());  // from an earlier run
+            }
+        }
+    } else {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(reuseport);
+    }
     acceptSocket_.bindAddress(listenAddr);
     acceptChannel_.setReadCallback([this](Timestamp) { handleRead(); });
 }
@@ -29,11 +59,17 @@ Acceptor::~Acceptor() {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
     ::close(idleFd_);
+    if (!unixPath_.empty()) {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
 void Acceptor::listen() {
     loop_->assertInLoopThread();
     listening_ = true;
+    if (fastOpenQueueLength_ > 0 && !isUnix_) {
+        acceptSocket_.setTcpFastOpen(fastOpenQueueLength_);
+    }
     acceptSocket_.listen();
     acceptChannel_.enableReading();
 }
@@ -0,0 +1,216 @@
+#include "AdaptiveBalancer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "EventLoop.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+namespace {
+
+// weights of a new sample in the short and long term latency averages,
+// about the last 10 and the last 100 requests
+const double kShortWeight = 0.1;
+const double kLongWeight = 0.01;
+
+double median(std::vector<double> values) {
+    assert(!values.empty());
+    std::size_t mid = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(mid), values.end());
+    if (values.size() % 2 == 1) {
+        return values[mid];
+    }
+    double lower = *std::max_element(values.begin(), values.begin() + static_cast<long>(mid));
+    return (lower + values[mid]) / 2;
+}
+
+}  // namespace
+
+AdaptiveBalancer::AdaptiveBalancer(EventLoop* loop, const std::vector<InetAddress>& endpoints)
+    : AdaptiveBalancer(loop, endpoints, Options()) {}
+
+AdaptiveBalancer::AdaptiveBalancer(EventLoop* loop, const std::vector<InetAddress>& endpoints,
+                                   const Options& options)
+    : loop_(CHECK_NOTNULL(loop)), options_(options), next_(0), numEjected_(0), totalEjections_(0) {
+    assert(!endpoints.empty());
+    assert(0 < options_.minLimit && options_.minLimit <= options_.maxLimit);
+    double initial = std::clamp(options_.initialLimit, options_.minLimit, options_.maxLimit);
+    endpoints_.reserve(endpoints.size());
+    for (const InetAddress& addr : endpoints) {
+        endpoints_.emplace_back(addr, initial);
+    }
+}
+
+AdaptiveBalancer::~AdaptiveBalancer() {
+    loop_->assertInLoopThread();
+    loop_->cancel(checkTimer_);
+}
+
+void AdaptiveBalancer::start() {
+    loop_->assertInLoopThread();
+    if (options_.intervalSeconds > 0) {
+        checkTimer_ = loop_->runEvery(options_.intervalSeconds, [this] { checkOutliers(); });
+    }
+}
+
+int AdaptiveBalancer::limit(int index) const {
+    return std::max(options_.minLimit, static_cast<int>(endpoints_[index].limit));
+}
+
+int AdaptiveBalancer::acquire() {
+    loop_->assertInLoopThread();
+    if (numEjected_ > 0) {
+        restoreExpired(Timestamp::now());
+    }
+    const int n = size();
+    // rotating the start spreads ties
+    const int start = next_;
+    next_ = (next_ + 1) % n;
+    int chosen = -1;
+    double lowest = 0;
+    for (int i = 0; i < n; ++i) {
+        int index = (start + i) % n;
+        const Endpoint& endpoint = endpoints_[index];
+        int max = limit(index);
+        if (endpoint.ejected || endpoint.inFlight >= max) {
+            continue;
+        }
+        double load = static_cast<double>(endpoint.inFlight) / max;
+        if (chosen < 0 || load < lowest) {
+            lowest = load;
+            chosen = index;
+        }
+    }
+    if (chosen >= 0) {
+        ++endpoints_[chosen].inFlight;
+    }
+    return chosen;
+}
+
+void AdaptiveBalancer::release(int index, double latencySeconds, bool ok) {
+    loop_->assertInLoopThread();
+    Endpoint& endpoint = endpoints_[index];
+    assert(endpoint.inFlight > 0);
+    int inFlight = endpoint.inFlight--;
+    ++endpoint.samples;
+    if (ok) {
+        endpoint.consecutiveFailures = 0;
+        endpoint.latencySum += latencySeconds;
+        updateLimit(&endpoint, latencySeconds, inFlight);
+        return;
+    }
+    ++endpoint.failures;
+    endpoint.limit = std::max<double>(options_.minLimit, endpoint.limit * options_.backoffRatio);
+    if (++endpoint.consecutiveFailures >= options_.consecutiveErrors && !endpoint.ejected) {
+        eject(index, "consecutive errors");
+    }
+}
+
+void AdaptiveBalancer::updateLimit(Endpoint* endpoint, double latency, int inFlight) {
+    if (endpoint->longLatency == 0) {
+        endpoint->longLatency = latency;
+        endpoint->shortLatency = latency;
+    } else {
+        endpoint->shortLatency += (latency - endpoint->shortLatency) * kShortWeight;
+        endpoint->longLatency += (latency - endpoint->longLatency) * kLongWeight;
+        // after a slow spell the long term average comes down faster
+        if (endpoint->longLatency > 2 * endpoint->shortLatency) {
+            endpoint->longLatency *= 0.95;
+        }
+    }
+    if (endpoint->shortLatency <= 0) {
+        return;
+    }
+    // a request issued well below the limit says nothing about the limit
+    if (inFlight * 2 < endpoint->limit) {
+        return;
+    }
+    double gradient = std::clamp(
+            options_.tolerance * endpoint->longLatency / endpoint->shortLatency, 0.5, 1.0);
+    double target = endpoint->limit * gradient + std::sqrt(endpoint->limit);
+    double limit = endpoint->limit * (1 - options_.smoothing) + target * options_.smoothing;
+    endpoint->limit = std::clamp<double>(limit, options_.minLimit, options_.maxLimit);
+}
+
+void AdaptiveBalancer::checkOutliers() {
+    const Timestamp now = Timestamp::now();
+    restoreExpired(now);
+    const int n = size();
+    std::vector<int> candidates;
+    std::vector<double> means;
+    for (int i = 0; i < n; ++i) {
+        const Endpoint& endpoint = endpoints_[i];
+        int successes = endpoint.samples - endpoint.failures;
+        if (!endpoint.ejected && successes >= options_.minSamples) {
+            candidates.push_back(i);
+            means.push_back(endpoint.latencySum / successes);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        Endpoint& endpoint = endpoints_[i];
+        if (endpoint.ejected) {
+            continue;
+        }
+        if (endpoint.samples >= options_.minSamples &&
+            endpoint.failures > options_.maxErrorRate * endpoint.samples) {
+            eject(i, "error rate");
+        } else if (endpoint.failures == 0 && endpoint.ejections > 0) {
+            --endpoint.ejections;
+        }
+    }
+    if (candidates.size() >= 2) {
+        for (std::size_t i = 0; i < candidates.size(); ++i) {
+            std::vector<double> others(means);
+            others.erase(others.begin() + static_cast<long>(i));
+            double threshold = options_.latencyFactor * median(std::move(others));
+            if (means[i] > threshold && means[i] > options_.minOutlierSeconds &&
+                !endpoints_[candidates[i]].ejected) {
+                eject(candidates[i], "latency");
+            }
+        }
+    }
+    for (Endpoint& endpoint : endpoints_) {
+        endpoint.samples = 0;
+        endpoint.failures = 0;
+        endpoint.latencySum = 0;
+    }
+}
+
+void AdaptiveBalancer::eject(int index, const char* reason) {
+    Endpoint& endpoint = endpoints_[index];
+    if (numEjected_ + 1 > options_.maxEjectedFraction * size()) {
+        LOG(DEBUG) << "[AdaptiveBalancer::eject] " << endpoint.address.toIpPort() << " " << reason
+                   << ", not ejected, " << numEjected_ << " out already";
+        return;
+    }
+    ++endpoint.ejections;
+    ++numEjected_;
+    ++totalEjections_;
+    double seconds = std::min(options_.baseEjectionSeconds * endpoint.ejections,
+                              options_.maxEjectionSeconds);
+    endpoint.ejected = true;
+    endpoint.ejectedUntil = addTime(Timestamp::now(), seconds);
+    endpoint.consecutiveFailures = 0;
+    LOG(WARN) << "[AdaptiveBalancer::eject] " << endpoint.address.toIpPort() << " " << reason
+              << ", ejected for " << seconds << "s";
+}
+
+void AdaptiveBalancer::restoreExpired(Timestamp now) {
+    for (Endpoint& endpoint : endpoints_) {
+        if (endpoint.ejected && endpoint.ejectedUntil <= now) {
+            endpoint.ejected = false;
+            --numEjected_;
+            // starts over from what it had, the interval counts are stale
+            endpoint.samples = 0;
+            endpoint.failures = 0;
+            endpoint.latencySum = 0;
+            LOG(INFO) << "[AdaptiveBalancer::restoreExpired] " << endpoint.address.toIpPort()
+                      << " back";
+        }
+    }
+}
+
+}  // namespace dws::net
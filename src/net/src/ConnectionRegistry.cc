@@ -0,0 +1,75 @@
+#include "ConnectionRegistry.h"
+
+#include <cassert>
+
+#include "Logging.h"
+
+namespace dws::net {
+
+const uint32_t ConnectionRegistry::kMaxSlots;
+
+ConnectionId ConnectionRegistry::allocate(int loopIndex) {
+    assert(loopIndex >= 0 && loopIndex < (1 << kLoopIndexBits));
+    uint32_t slot = 0;
+    if (!freeSlots_.empty()) {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    } else {
+        if (slots_.size() >= kMaxSlots) {
+            LOG_FATAL << "[ConnectionRegistry::allocate] more than " << kMaxSlots
+                      << " connections";
+        }
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    Slot& s = slots_[slot];
+    assert(!s.used && !s.conn);
+    s.used = true;
+    ++size_;
+    return makeId(loopIndex, s.generation, slot);
+}
+
+void ConnectionRegistry::attach(ConnectionId id, TcpConnectionPtr conn) {
+    uint32_t slot = slotOf(id);
+    assert(slot < slots_.size());
+    Slot& s = slots_[slot];
+    assert(s.used && s.generation == generationOf(id));
+    s.conn = std::move(conn);
+}
+
+bool ConnectionRegistry::remove(ConnectionId id) {
+    if (lookup(id) == nullptr) {
+        return false;
+    }
+    uint32_t slot = slotOf(id);
+    slots_[slot].conn.reset();
+    release(slot);
+    return true;
+}
+
+TcpConnectionPtr ConnectionRegistry::find(ConnectionId id) const {
+    const Slot* s = lookup(id);
+    return s ? s->conn : TcpConnectionPtr();
+}
+
+const ConnectionRegistry::Slot* ConnectionRegistry::lookup(ConnectionId id) const {
+    uint32_t slot = slotOf(id);
+    if (slot >= slots_.size()) {
+        return nullptr;
+    }
+    const Slot& s = slots_[slot];
+    return (s.used && s.generation == generationOf(id)) ? &s : nullptr;
+}
+
+void ConnectionRegistry::release(uint32_t slot) {
+    Slot& s = slots_[slot];
+    s.used = false;
+    s.generation = (s.generation + 1) & ((1u << kGenerationBits) - 1);
+    if (s.generation == 0) {
+        s.generation = 1;
+    }
+    freeSlots_.push_back(slot);
+    --size_;
+}
+
+}  // namespace dws::net
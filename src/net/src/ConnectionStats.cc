@@ -0,0 +1,48 @@
+#include "ConnectionStats.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+namespace dws::net {
+
+ConnectionStats::Snapshot& ConnectionStats::Snapshot::operator+=(const Snapshot& rhs) {
+    bytesReceived += rhs.bytesReceived;
+    bytesSent += rhs.bytesSent;
+    messagesReceived += rhs.messagesReceived;
+    messagesSent += rhs.messagesSent;
+    readCalls += rhs.readCalls;
+    writeCalls += rhs.writeCalls;
+    callbackMicroSeconds += rhs.callbackMicroSeconds;
+    maxOutputBufferBytes = std::max(maxOutputBufferBytes, rhs.maxOutputBufferBytes);
+    rttMicroSeconds = std::max(rttMicroSeconds, rhs.rttMicroSeconds);
+    rttVarMicroSeconds = std::max(rttVarMicroSeconds, rhs.rttVarMicroSeconds);
+    return *this;
+}
+
+std::string ConnectionStats::Snapshot::toString() const {
+    char buf[384];
+    snprintf(buf, sizeof buf,
+             "in=%" PRIu64 "B/%" PRIu64 "msg out=%" PRIu64 "B/%" PRIu64 "msg "
+             "reads=%" PRIu64 " writes=%" PRIu64 " cb=%" PRIu64 "us "
+             "maxOutBuf=%" PRIu64 "B rtt=%uus rttvar=%uus",
+             bytesReceived, messagesReceived, bytesSent, messagesSent, readCalls, writeCalls,
+             callbackMicroSeconds, maxOutputBufferBytes, rttMicroSeconds, rttVarMicroSeconds);
+    return buf;
+}
+
+ConnectionStats::Snapshot ConnectionStats::snapshot() const {
+    Snapshot s;
+    s.bytesReceived = bytesReceived_.load(std::memory_order_relaxed);
+    s.bytesSent = bytesSent_.load(std::memory_order_relaxed);
+    s.messagesReceived = messagesReceived_.load(std::memory_order_relaxed);
+    s.messagesSent = messagesSent_.load(std::memory_order_relaxed);
+    s.readCalls = readCalls_.load(std::memory_order_relaxed);
+    s.writeCalls = writeCalls_.load(std::memory_order_relaxed);
+    s.callbackMicroSeconds = callbackMicroSeconds_.load(std::memory_order_relaxed);
+    s.maxOutputBufferBytes = maxOutputBufferBytes_.load(std::memory_order_relaxed);
+    s.rttMicroSeconds = rttMicroSeconds_.load(std::memory_order_relaxed);
+    s.rttVarMicroSeconds = rttVarMicroSeconds_.load(std::memory_order_relaxed);
+    return s;
+}
+
+}  // namespace dws::net
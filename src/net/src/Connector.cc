@@ -1,6 +1,10 @@
 #include "Connector.h"
 
+#include <sys/socket.h>
+
+#include <algorithm>
 #include <cerrno>
+#include <random>
 
 #include "Channel.h"
 #include "EventLoop.h"
@@ -9,20 +13,92 @@
 
 namespace dws::net {
 
+namespace {
+
+// RFC 8305 section 4: alternate the families, the first address's first.
+std::vector<InetAddress> interleaveFamilies(const std::vector<InetAddress>& addresses) {
+    std::vector<InetAddress> preferred;
+    std::vector<InetAddress> other;
+    for (const auto& addr : addresses) {
+        (addr.family() == addresses.front().family() ? preferred : other).push_back(addr);
+    }
+    std::vector<InetAddress> result;
+    result.reserve(addresses.size());
+    for (std::size_t i = 0; i < std::max(preferred.size(), other.size()); ++i) {
+        if (i < preferred.size()) {
+            result.push_back(preferred[i]);
+        }
+        if (i < other.size()) {
+            result.push_back(other[i]);
+        }
+    }
+    return result;
+}
+
+// Uniform in [delayMs / 2, delayMs], so that clients dropped together do
+// not come back together.
+int jittered(int delayMs) {
+    thread_local std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<int> half(0, delayMs / 2);
+    return delayMs - half(random);
+}
+
+}  // namespace
+
 const int Connector::kMaxRetryDelayMs;
+const std::size_t Connector::kMaxFastOpenBytes;
 
 Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+    : Connector(loop, std::vector<InetAddress>(1, serverAddr)) {}
+
+Connector::Connector(EventLoop* loop, std::vector<InetAddress> addresses)
     : loop_(loop),
-      serverAddr_(serverAddr),
+      serverAddr_(addresses.front()),
+      resolver_(nullptr),
+      port_(addresses.front().port()),
+      addresses_(interleaveFamilies(addresses)),
+      nextAddress_(0),
+      attemptTimerArmed_(false),
+      retryable_(false),
+      lastErrno_(0),
+      attemptDelay_(0.25),
       connect_(false),
       state_(kDisconnected),
       retryDelayMs_(kInitRetryDelayMs) {
     LOG(DEBUG) << "ctor[" << this << "]";
 }
 
+Connector::Connector(EventLoop* loop, Resolver* resolver, std::string host, uint16_t port)
+    : loop_(loop),
+      resolver_(CHECK_NOTNULL(resolver)),
+      host_(std::move(host)),
+      port_(port),
+      nextAddress_(0),
+      attemptTimerArmed_(false),
+      retryable_(false),
+      lastErrno_(0),
+      attemptDelay_(0.25),
+      connect_(false),
+      state_(kDisconnected),
+      retryDelayMs_(kInitRetryDelayMs) {
+    LOG(DEBUG) << "ctor[" << this << "] " << host_;
+}
+
 Connector::~Connector() {
     LOG(DEBUG) << "dtor[" << this << "]";
-    assert(!channel_);
+    assert(attempts_.empty());
+}
+
+std::string Connector::serverName() const {
+    if (!resolver_) {
+        return serverAddr_.toIpPort();
+    }
+    return host_ + ":" + std::to_string(port_);
+}
+
+void Connector::setFastOpenData(std::string data) {
+    assert(data.size() <= kMaxFastOpenBytes);
+    fastOpenData_ = std::move(data);
 }
 
 void Connector::start() {
@@ -32,9 +108,16 @@ void Connector::start() {
 
 void Connector::startInLoop() {
     loop_->assertInLoopThread();
+    if (state_ == kResolving) {
+        return;  // onResolved() goes on
+    }
     assert(state_ == kDisconnected);
     if (connect_) {
-        connect();
+        if (resolver_) {
+            resolve();
+        } else {
+            startRound();
+        }
     } else {
         LOG(DEBUG) << "[Connector::startInLoop] don't connect";
     }
@@ -42,53 +125,183 @@ void Connector::startInLoop() {
 
 void Connector::stop() {
     connect_ = false;
-    loop_->queueInLoop([this]() { stopInLoop(); });
+    // right away in the loop thread, whose loop may not run again
+    loop_->runInLoop([this]() { stopInLoop(); });
 }
 
 void Connector::stopInLoop() {
     loop_->assertInLoopThread();
     if (state_ == kConnecting) {
+        closeAttempts();
         setState(kDisconnected);
-        int sockfd = removeAndResetChannel();
-        retry(sockfd);
-    }
-}
-
-void Connector::connect() {
-    int sockfd = sockets::createNonblockingOrDie(serverAddr_.family());
-    int res = sockets::connect(sockfd, serverAddr_.getSockAddr());
-    int save_errno = (res == 0) ? 0 : errno;
-    switch (save_errno) {
-        case 0:
-        case EINPROGRESS:
-        case EINTR:
-        case EISCONN:
-            connecting(sockfd);
-            break;
-
-        case EAGAIN:
-        case EADDRINUSE:
-        case EADDRNOTAVAIL:
-        case ECONNREFUSED:
-        case ENETUNREACH:
-            retry(sockfd);
-            break;
-
-        case EACCES:
-        case EPERM:
-        case EAFNOSUPPORT:
-        case EALREADY:
-        case EBADF:
-        case EFAULT:
-        case ENOTSOCK:
-            LOG_SYSERR << "[Connector::connect] connect error" << save_errno;
-            sockets::close(sockfd);
-            break;
+        LOG(DEBUG) << "[Connector::stopInLoop] don't connect";
+    }
+}
 
-        default:
-            LOG_SYSERR << "[Connector::connect] Unexpected error" << save_errno;
-            sockets::close(sockfd);
-            break;
+void Connector::resolve() {
+    setState(kResolving);
+    std::weak_ptr<Connector> weak(shared_from_this());
+    EventLoop* loop = loop_;
+    // the resolver may run in another loop
+    resolver_->resolve(host_, port_, Resolver::kAny,
+                       [weak, loop](Resolver::Error error,
+                                    const std::vector<InetAddress>& addresses) {
+                           loop->runInLoop([weak, error, addresses] {
+                               if (auto ptr = weak.lock()) {
+                                   ptr->onResolved(error, addresses);
+                               }
+                           });
+                       });
+}
+
+void Connector::onResolved(Resolver::Error error, const std::vector<InetAddress>& addresses) {
+    loop_->assertInLoopThread();
+    assert(state_ == kResolving);
+    setState(kDisconnected);
+    if (!connect_) {
+        LOG(DEBUG) << "[Connector::onResolved] don't connect";
+        return;
+    }
+    if (error != Resolver::kOk) {
+        LOG(WARN) << "[Connector::onResolved] " << serverName() << ": "
+                  << Resolver::errorString(error);
+        if (errorCallback_) {
+            report(error == Resolver::kTimeout ? ETIMEDOUT : EHOSTUNREACH);
+        } else {
+            backoff();
+        }
+        return;
+    }
+    addresses_ = interleaveFamilies(addresses);
+    serverAddr_ = addresses_.front();
+    startRound();
+}
+
+void Connector::startRound() {
+    setState(kConnecting);
+    nextAddress_ = 0;
+    retryable_ = false;
+    lastErrno_ = 0;
+    startNextAttempt();
+}
+
+// Starts attempts until one is in flight or the addresses are used up.
+void Connector::startNextAttempt() {
+    while (nextAddress_ < addresses_.size()) {
+        const InetAddress& address = addresses_[nextAddress_++];
+        int sockfd = sockets::createNonblockingOrDie(address.family());
+        std::size_t fastOpenSent = 0;
+        int save_errno = connect(sockfd, address, &fastOpenSent);
+        switch (save_errno) {
+            case 0:
+            case EINPROGRESS:
+            case EINTR:
+            case EISCONN: {
+                LOG(DEBUG) << "[Connector::startNextAttempt] connecting to "
+                           << address.toIpPort();
+                auto channel = std::make_shared<Channel>(loop_, sockfd);
+                Channel* raw = channel.get();
+                channel->setWriteCallback([this, raw]() { handleWrite(raw); });
+                channel->setErrorCallback([this, raw]() { handleError(raw); });
+                channel->enableWriting();
+                attempts_.push_back(Attempt{address, channel, fastOpenSent});
+                if (nextAddress_ < addresses_.size()) {
+                    std::weak_ptr<Connector> weak(shared_from_this());
+                    attemptTimer_ = loop_->runAfter(attemptDelay_, [weak] {
+                        if (auto ptr = weak.lock()) {
+                            ptr->onAttemptDelay();
+                        }
+                    });
+                    attemptTimerArmed_ = true;
+                }
+                return;
+            }
+
+            case EAGAIN:
+            case EADDRINUSE:
+            case EADDRNOTAVAIL:
+            case ECONNREFUSED:
+            case ENETUNREACH:
+            case ENOENT:  // Unix domain socket not created yet
+                LOG(DEBUG) << "[Connector::startNextAttempt] " << address.toIpPort() << ": "
+                           << strerror_tl(save_errno);
+                retryable_ = true;
+                break;
+
+            case EACCES:
+            case EPERM:
+            case EAFNOSUPPORT:
+            case EALREADY:
+            case EBADF:
+            case EFAULT:
+            case ENOTSOCK:
+                LOG_SYSERR << "[Connector::connect] connect error" << save_errno;
+                break;
+
+            default:
+                LOG_SYSERR << "[Connector::connect] Unexpected error" << save_errno;
+                break;
+        }
+        sockets::close(sockfd);
+        lastErrno_ = save_errno;
+    }
+    if (attempts_.empty()) {
+        roundFailed();
+    }
+}
+
+// connect(2), or sendto(2) with MSG_FASTOPEN which connects as well and
+// puts as much of the data into the SYN as the server's cookie allows.
+// Returns the errno.
+int Connector::connect(int sockfd, const InetAddress& address, std::size_t* fastOpenSent) {
+    if (!fastOpenData_.empty() && !address.isUnix()) {
+        ssize_t n = ::sendto(sockfd, fastOpenData_.data(), fastOpenData_.size(),
+                             MSG_FASTOPEN | MSG_NOSIGNAL, address.getSockAddr(),
+                             address.length());
+        if (n >= 0) {
+            *fastOpenSent = static_cast<std::size_t>(n);
+            return 0;
+        }
+        if (errno != EOPNOTSUPP) {
+            return errno;  // EINPROGRESS without a cookie yet, the data waits
+        }
+        LOG(WARN) << "[Connector::connect] TCP Fast Open disabled, net.ipv4.tcp_fastopen & 1";
+    }
+    int res = sockets::connect(sockfd, address.getSockAddr());
+    return res == 0 ? 0 : errno;
+}
+
+// Whatever of the fast open data did not fit into the SYN, on a socket
+// that has just connected and has its whole send buffer free.
+bool Connector::sendFastOpenRest(int sockfd, std::size_t fastOpenSent) {
+    while (fastOpenSent < fastOpenData_.size()) {
+        ssize_t n = sockets::write(sockfd, fastOpenData_.data() + fastOpenSent,
+                                   fastOpenData_.size() - fastOpenSent);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            LOG_SYSERR << "[Connector::sendFastOpenRest] write";
+            return false;
+        }
+        fastOpenSent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+void Connector::onAttemptDelay() {
+    attemptTimerArmed_ = false;
+    if (state_ == kConnecting && connect_) {
+        LOG(DEBUG) << "[Connector::onAttemptDelay] " << attempts_.size()
+                   << " attempts pending, starting another";
+        startNextAttempt();
+    }
+}
+
+void Connector::cancelAttemptDelay() {
+    if (attemptTimerArmed_) {
+        loop_->cancel(attemptTimer_);
+        attemptTimerArmed_ = false;
     }
 }
 
@@ -100,67 +313,121 @@ void Connector::restart() {
     startInLoop();
 }
 
-void Connector::connecting(int sockfd) {
-    setState(kConnecting);
-    assert(!channel_);
-    channel_.reset(new Channel(loop_, sockfd));
-    channel_->setWriteCallback([this]() { handleWrite(); });
-    channel_->setErrorCallback([this]() { handleError(); });
-    channel_->enableWriting();
+// False if the attempt is gone already, an error and a write event may
+// come together.
+bool Connector::removeAttempt(Channel* channel, Attempt* removed) {
+    auto it = std::find_if(attempts_.begin(), attempts_.end(),
+                           [channel](const Attempt& a) { return a.channel.get() == channel; });
+    if (it == attempts_.end()) {
+        return false;
+    }
+    Attempt attempt = std::move(*it);
+    attempts_.erase(it);
+    attempt.channel->disableAll();
+    attempt.channel->remove();
+    // may be within its own callback, destroyed later
+    loop_->queueInLoop([dead = attempt.channel] {});
+    if (removed) {
+        *removed = attempt;
+    }
+    return true;
 }
 
-int Connector::removeAndResetChannel() {
-    channel_->disableAll();
-    channel_->remove();
-    int sockfd = channel_->fd();
-    loop_->queueInLoop([this]() { resetChannel(); });
-    return sockfd;
+void Connector::closeAttempts() {
+    cancelAttemptDelay();
+    while (!attempts_.empty()) {
+        Channel* channel = attempts_.back().channel.get();
+        int sockfd = channel->fd();
+        removeAttempt(channel, nullptr);
+        sockets::close(sockfd);
+    }
 }
 
-void Connector::resetChannel() { channel_.reset(); }
-
-void Connector::handleWrite() {
+void Connector::handleWrite(Channel* channel) {
     LOG(TRACE) << "[Connector::handleWrite] state " << state_;
-    if (state_ == kConnecting) {
-        int sockfd = removeAndResetChannel();
-        int err = sockets::getSocketError(sockfd);
-        if (err) {
-            LOG(WARN) << "[Connector::handleWrite] SOERROR = " << err << " " << strerror_tl(err);
-            retry(sockfd);
-        } else if (sockets::isSelfConnect(sockfd)) {
-            LOG(WARN) << "[Connector::handleWrite] Self connect";
-            retry(sockfd);
+    Attempt attempt;
+    if (!removeAttempt(channel, &attempt)) {
+        return;
+    }
+    assert(state_ == kConnecting);
+    int sockfd = channel->fd();
+    int err = sockets::getSocketError(sockfd);
+    if (err) {
+        LOG(WARN) << "[Connector::handleWrite] " << attempt.address.toIpPort()
+                  << " SOERROR = " << err << " " << strerror_tl(err);
+        sockets::close(sockfd);
+        attemptFailed(err);
+    } else if (sockets::isSelfConnect(sockfd)) {
+        LOG(WARN) << "[Connector::handleWrite] Self connect";
+        sockets::close(sockfd);
+        attemptFailed(ECONNREFUSED);
+    } else if (!sendFastOpenRest(sockfd, attempt.fastOpenSent)) {
+        int savedErrno = errno;
+        sockets::close(sockfd);
+        attemptFailed(savedErrno);
+    } else {
+        closeAttempts();  // the slower ones
+        serverAddr_ = attempt.address;
+        setState(kConnected);
+        if (connect_) {
+            newConnectionCallback_(sockfd);
         } else {
-            setState(kConnected);
-            if (connect_) {
-                newConnectionCallback_(sockfd);
-            } else {
-                sockets::close(sockfd);
-            }
+            sockets::close(sockfd);
         }
-    } else {
-        assert(state_ == kDisconnected);
     }
 }
 
-void Connector::handleError() {
+void Connector::handleError(Channel* channel) {
     LOG(ERROR) << "[Connector::handleError] state = " << state_;
-    if (state_ == kConnecting) {
-        int sockfd = removeAndResetChannel();
-        int err = sockets::getSocketError(sockfd);
-        LOG(TRACE) << "SO_ERROR = " << err << " " << strerror_tl(err);
-        retry(sockfd);
+    if (!removeAttempt(channel, nullptr)) {
+        return;
     }
+    int sockfd = channel->fd();
+    int err = sockets::getSocketError(sockfd);
+    LOG(TRACE) << "SO_ERROR = " << err << " " << strerror_tl(err);
+    sockets::close(sockfd);
+    attemptFailed(err);
 }
 
-void Connector::retry(int sockfd) {
-    sockets::close(sockfd);
+void Connector::attemptFailed(int savedErrno) {
+    lastErrno_ = savedErrno;
+    retryable_ = true;
+    if (connect_ && nextAddress_ < addresses_.size()) {
+        // a failure starts the next attempt without waiting for the delay
+        cancelAttemptDelay();
+        startNextAttempt();
+    } else if (attempts_.empty()) {
+        roundFailed();
+    }
+}
+
+void Connector::roundFailed() {
+    cancelAttemptDelay();
     setState(kDisconnected);
+    if (errorCallback_ || !retryable_) {
+        report(lastErrno_);
+    } else {
+        backoff();
+    }
+}
+
+void Connector::report(int savedErrno) {
+    if (connect_ && errorCallback_) {
+        // deferred, start() may be on the caller's stack
+        loop_->queueInLoop([ptr = shared_from_this(), savedErrno] {
+            if (ptr->connect_) {
+                ptr->errorCallback_(savedErrno);
+            }
+        });
+    }
+}
+
+void Connector::backoff() {
     if (connect_) {
-        LOG(INFO) << "[Connector::retry] Retry connecting to " << serverAddr_.toIpPort() << " in "
-                  << retryDelayMs_ << " milliseconds.";
-        loop_->runAfter(retryDelayMs_ / 1000.0,
-                        [ptr = shared_from_this()] { ptr->startInLoop(); });
+        int delayMs = jittered(retryDelayMs_);
+        LOG(INFO) << "[Connector::retry] Retry connecting to " << serverName() << " in "
+                  << delayMs << " milliseconds.";
+        loop_->runAfter(delayMs / 1000.0, [ptr = shared_from_this()] { ptr->startInLoop(); });
         retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
     } else {
         LOG(DEBUG) << "[Connector::retry] don't connect";
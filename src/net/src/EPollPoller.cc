@@ -41,7 +41,7 @@ Timestamp EPollPoller::poll(int timeout_ms, ChannelList* activeChannels) {
             ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeout_ms);
     int err = errno;
     Timestamp now(Timestamp::now());
-    if (err > 0) {
+    if (numEvents > 0) {
         LOG(TRACE) << "[EPollPoller::poll]" << numEvents << " events happened";
         fillActiveChannels(numEvents, activeChannels);
         if (static_cast<size_t>(numEvents) == events_.size()) {
@@ -89,7 +89,13 @@ void EPollPoller::updateChannel(Channel* channel) {
             assert(it->second == channel);
         }
 
-        channel->set_index(index);
+        // epoll reports EPOLLHUP even for an empty interest set, which would
+        // reach a connection that stopped reading and then closed
+        if (channel->isNoneEvent()) {
+            channel->set_index(kDeleted);
+            return;
+        }
+        channel->set_index(kAdded);
         update(EPOLL_CTL_ADD, channel);
     } else {
         auto it = channels_.find(fd);
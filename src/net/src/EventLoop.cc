@@ -45,7 +45,9 @@ EventLoop::EventLoop()
       quit_(false),
       eventHandling_(false),
       callingPendingFunctors_(false),
+      callingIterationEndCallbacks_(false),
       iteration_(0),
+      busyMicroSeconds_(0),
       threadId_(CurrentThread::tid()),
       pollReturnTime_(),
       poller_(Poller::newDefaultPoller(this)),
@@ -84,7 +86,7 @@ void EventLoop::loop() {
         activeChannels_.clear();
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
         ++iteration_;
-        if (Logger::logLevel() <= Logger::TRACE) {
+        if (DWS_LOG_ENABLED(TRACE)) {
             printActiveChannels();
         }
         eventHandling_ = true;
@@ -95,8 +97,16 @@ void EventLoop::loop() {
         currentActiveChannel_ = nullptr;
         eventHandling_ = false;
         doPendingFunctors();
+        doIterationEndCallbacks();
+        int64_t busy = Timestamp::now().microSecondsSinceEpoch() -
+                       pollReturnTime_.microSecondsSinceEpoch();
+        busyMicroSeconds_.store(busyMicroSeconds_.load(std::memory_order_relaxed) + busy,
+                                std::memory_order_relaxed);
     }
 
+    // functors queued before quit(), e.g. TcpServer's connectDestroyed(),
+    // would otherwise be dropped if they missed the last iteration
+    doPendingFunctors();
     LOG(TRACE) << "EventLoop " << this << " stop looping";
     looping_ = false;
 }
@@ -122,7 +132,7 @@ void EventLoop::queueInLoop(Functor cb) {
         pendingFunctors_.push_back(std::move(cb));
     }
 
-    if (!isInLoopThread() || callingPendingFunctors_) {
+    if (!isInLoopThread() || callingPendingFunctors_ || callingIterationEndCallbacks_) {
         wakeup();
     }
 }
@@ -171,6 +181,14 @@ bool EventLoop::hasChannel(Channel* channel) {
     return poller_->hasChannel(channel);
 }
 
+void EventLoop::runAtIterationEnd(Functor cb) {
+    assertInLoopThread();
+    iterationEndCallbacks_.push_back(std::move(cb));
+    if (!eventHandling_ && !callingPendingFunctors_) {
+        wakeup();
+    }
+}
+
 void EventLoop::abortNotInLoopThread() {
     LOG_FATAL << "EventLoop::abortNotInLoopThread - EventLoop " << this
               << " was created in threadId_ = " << threadId_
@@ -209,6 +227,24 @@ void EventLoop::doPendingFunctors() {
     callingPendingFunctors_ = false;
 }
 
+void EventLoop::doIterationEndCallbacks() {
+    if (iterationEndCallbacks_.empty()) {
+        return;
+    }
+    std::vector<Functor> callbacks;
+    callbacks.swap(iterationEndCallbacks_);
+    callingIterationEndCallbacks_ = true;
+    for (const Functor& cb : callbacks) {
+        cb();
+    }
+    callingIterationEndCallbacks_ = false;
+    callbacks.clear();
+    if (iterationEndCallbacks_.empty()) {
+        // keeps the capacity, callbacks are queued every busy iteration
+        iterationEndCallbacks_.swap(callbacks);
+    }
+}
+
 void EventLoop::printActiveChannels() const {
     for (const Channel* channel : activeChannels_) {
         LOG(TRACE) << "{" << channel->reventsToString() << "} ";
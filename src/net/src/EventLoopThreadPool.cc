@@ -35,10 +35,17 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb) {
 }
 
 EventLoop *EventLoopThreadPool::getNextLoop() {
+    int loopIndex = 0;
+    return getNextLoop(&loopIndex);
+}
+
+EventLoop *EventLoopThreadPool::getNextLoop(int *loopIndex) {
     baseLoop_->assertInLoopThread();
     assert(started_);
     EventLoop *loop = baseLoop_;
+    *loopIndex = 0;
     if (!loops_.empty()) {
+        *loopIndex = next_;
         loop = loops_[next_++];
         if (static_cast<size_t>(next_) >= loops_.size()) {
             next_ = 0;
@@ -51,7 +58,7 @@ EventLoop *EventLoopThreadPool::getLoopForHash(size_t hashCode) {
     baseLoop_->assertInLoopThread();
     EventLoop *loop = baseLoop_;
     if (!loops_.empty()) {
-        loop = loops_[hashCode & loops_.size()];
+        loop = loops_[hashCode % loops_.size()];
     }
     return loop;
 }
@@ -39,8 +39,10 @@ static const in_addr_t kInaddrLoopback = INADDR_LOOPBACK;
 
 namespace dws::net {
 
-static_assert(sizeof(InetAddress) == sizeof(struct sockaddr_in6),
-              "InetAddress is same size as sockaddr_in6");
+static_assert(sizeof(InetAddress) >= sizeof(struct sockaddr_un),
+              "InetAddress holds a sockaddr_un");
+static_assert(sizeof(InetAddress) <= sizeof(struct sockaddr_storage),
+              "InetAddress fits in sockaddr_storage");
 static_assert(offsetof(sockaddr_in, sin_family) == 0, "sin_family offset 0");
 static_assert(offsetof(sockaddr_in6, sin6_family) == 0, "sin6_family offset 0");
 static_assert(offsetof(sockaddr_in, sin_port) == 2, "sin_port offset 2");
@@ -74,14 +76,34 @@ InetAddress::InetAddress(StringArg ip, uint16_t port, bool ipv6) {
     }
 }
 
+InetAddress::InetAddress(const struct sockaddr_storage &addr) {
+    memcpy(&addrUn_, &addr, sizeof addrUn_);
+}
+
+InetAddress InetAddress::fromUnixPath(StringArg path) {
+    struct sockaddr_un addr;
+    memZero(&addr, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    size_t len = ::strlen(path.c_str());
+    if (len >= sizeof addr.sun_path) {
+        LOG(ERROR) << "InetAddress::fromUnixPath path too long: " << path.c_str();
+        len = sizeof addr.sun_path - 1;
+    }
+    memcpy(addr.sun_path, path.c_str(), len);
+    if (addr.sun_path[0] == '@') {
+        addr.sun_path[0] = '\0';
+    }
+    return InetAddress(addr);
+}
+
 std::string InetAddress::toIp() const {
-    char buf[64] = "";
+    char buf[sizeof addrUn_.sun_path + 8] = "";
     sockets::toIp(buf, sizeof buf, getSockAddr());
     return buf;
 }
 
 std::string InetAddress::toIpPort() const {
-    char buf[64] = "";
+    char buf[sizeof addrUn_.sun_path + 8] = "";
     sockets::toIpPort(buf, sizeof buf, getSockAddr());
     return buf;
 }
@@ -91,7 +113,11 @@ uint32_t InetAddress::ipv4NetEndian() const {
     return addr_.sin_addr.s_addr;
 }
 
-uint16_t InetAddress::port() const { return sockets::networkToHost16(portNetEndian()); }
+uint16_t InetAddress::port() const {
+    return isUnix() ? 0 : sockets::networkToHost16(portNetEndian());
+}
+
+socklen_t InetAddress::length() const { return sockets::sockaddrLength(getSockAddr()); }
 
 static __thread char t_resolveBuffer[64 * 1024];
 
@@ -0,0 +1,226 @@
+#include "PipelinedClient.h"
+
+#include "EventLoop.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+PipelinedClient::PipelinedClient(EventLoop* loop, const InetAddress& serverAddr,
+                                 const std::string& name, Framer framer)
+    : PipelinedClient(loop, serverAddr, name, std::move(framer), Options()) {}
+
+PipelinedClient::PipelinedClient(EventLoop* loop, const InetAddress& serverAddr,
+                                 const std::string& name, Framer framer, const Options& options)
+    : loop_(loop),
+      alive_(std::make_shared<bool>(true)),
+      client_(loop, serverAddr, name),
+      framer_(std::move(framer)),
+      options_(options),
+      inFlight_(0),
+      writes_(0),
+      pumpQueued_(false) {
+    assert(options_.maxInFlight > 0);
+    client_.enableRetry();
+    client_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    client_.setMessageCallback(
+            [this](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { onMessage(conn, buf); });
+}
+
+PipelinedClient::~PipelinedClient() {
+    loop_->assertInLoopThread();
+    if (connection_) {
+        // the TcpClient closes it, without calling back into this
+        connection_->setConnectionCallback(defaultConnectionCallback);
+        connection_->setMessageCallback(defaultMessageCallback);
+    }
+    for (const auto& call : queued_) {
+        loop_->cancel(call->timer);
+    }
+    for (const auto& call : sentInOrder_) {
+        loop_->cancel(call->timer);
+    }
+    for (const auto& entry : sentById_) {
+        loop_->cancel(entry.second->timer);
+    }
+}
+
+const char* PipelinedClient::errorString(Error error) {
+    switch (error) {
+        case kOk:
+            return "ok";
+        case kTimeout:
+            return "timeout";
+        case kConnectionClosed:
+            return "connection closed";
+        case kBadResponse:
+            return "bad response";
+        case kOverloaded:
+            return "overloaded";
+        case kDuplicateId:
+            return "duplicate id";
+    }
+    return "unknown";
+}
+
+void PipelinedClient::connect() { client_.connect(); }
+
+void PipelinedClient::disconnect() { client_.disconnect(); }
+
+void PipelinedClient::send(std::string request, Callback cb) {
+    send(std::move(request), 0, std::move(cb));
+}
+
+void PipelinedClient::send(std::string request, uint64_t id, Callback cb) {
+    auto call = std::make_shared<Call>();
+    call->request = std::move(request);
+    call->id = id;
+    call->cb = std::move(cb);
+    loop_->runInLoop([this, alive = std::weak_ptr<bool>(alive_), call] {
+        if (alive.lock()) {
+            sendInLoop(call);
+        }
+    });
+}
+
+void PipelinedClient::sendInLoop(const CallPtr& call) {
+    loop_->assertInLoopThread();
+    if (queued_.size() >= options_.maxQueued) {
+        loop_->queueInLoop([call] { call->cb(kOverloaded, StringPiece()); });
+        return;
+    }
+    call->timer = loop_->runAfter(options_.timeoutSeconds, [this, call] { onTimeout(call); });
+    queued_.push_back(call);
+    // everything sent in this iteration goes out in one write
+    if (!pumpQueued_) {
+        pumpQueued_ = true;
+        loop_->queueInLoop([this, alive = std::weak_ptr<bool>(alive_)] {
+            if (alive.lock()) {
+                pumpQueued_ = false;
+                pump();
+            }
+        });
+    }
+}
+
+void PipelinedClient::pump() {
+    if (!connection_ || !connection_->connected()) {
+        return;
+    }
+    Buffer out;
+    while (!queued_.empty() && inFlight_ < options_.maxInFlight) {
+        CallPtr call = std::move(queued_.front());
+        queued_.pop_front();
+        if (!call->cb) {
+            continue;  // timed out while queued
+        }
+        if (options_.matching == kById && sentById_.count(call->id) != 0) {
+            // its response could not be told apart, and would never free a place
+            LOG(ERROR) << "[PipelinedClient::pump] " << client_.name() << " id " << call->id
+                       << " is in flight already";
+            complete(call, kDuplicateId, StringPiece());
+            continue;
+        }
+        out.append(call->request.data(), call->request.size());
+        std::string().swap(call->request);
+        call->sent = true;
+        if (options_.matching == kFifo) {
+            sentInOrder_.push_back(std::move(call));
+        } else {
+            uint64_t id = call->id;
+            sentById_[id] = std::move(call);
+        }
+        ++inFlight_;
+    }
+    if (out.readableBytes() > 0) {
+        ++writes_;
+        connection_->send(&out);
+    }
+}
+
+void PipelinedClient::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        connection_ = conn;
+        pump();
+    } else {
+        connection_.reset();
+        failInFlight(kConnectionClosed);
+    }
+    if (connectionCallback_) {
+        connectionCallback_(conn);
+    }
+}
+
+void PipelinedClient::onMessage(const TcpConnectionPtr& conn, Buffer* buf) {
+    while (buf->readableBytes() > 0) {
+        uint64_t id = 0;
+        ssize_t n = framer_(*buf, &id);
+        if (n == 0) {
+            break;
+        }
+        CallPtr call;
+        if (n > 0 && static_cast<std::size_t>(n) <= buf->readableBytes()) {
+            if (options_.matching == kFifo) {
+                if (!sentInOrder_.empty()) {
+                    call = std::move(sentInOrder_.front());
+                    sentInOrder_.pop_front();
+                }
+            } else {
+                auto it = sentById_.find(id);
+                if (it != sentById_.end()) {
+                    call = std::move(it->second);
+                    sentById_.erase(it);
+                }
+            }
+        }
+        if (!call) {
+            LOG(ERROR) << "[PipelinedClient::onMessage] " << *conn
+                       << " unexpected response, closing";
+            buf->retrieveAll();
+            failInFlight(kBadResponse);
+            conn->forceClose();
+            return;
+        }
+        --inFlight_;
+        complete(call, kOk, StringPiece(buf->peek(), static_cast<int>(n)));
+        buf->retrieve(static_cast<std::size_t>(n));
+    }
+    pump();
+}
+
+void PipelinedClient::onTimeout(const CallPtr& call) {
+    if (!call->cb) {
+        return;
+    }
+    LOG(DEBUG) << "[PipelinedClient::onTimeout] " << client_.name() << " request "
+               << (call->sent ? "in flight" : "queued") << " timed out";
+    complete(call, kTimeout, StringPiece());
+    while (!queued_.empty() && !queued_.front()->cb) {
+        queued_.pop_front();
+    }
+}
+
+void PipelinedClient::failInFlight(Error error) {
+    std::deque<CallPtr> inOrder;
+    inOrder.swap(sentInOrder_);
+    std::unordered_map<uint64_t, CallPtr> byId;
+    byId.swap(sentById_);
+    inFlight_ = 0;
+    for (const auto& call : inOrder) {
+        complete(call, error, StringPiece());
+    }
+    for (const auto& entry : byId) {
+        complete(entry.second, error, StringPiece());
+    }
+}
+
+void PipelinedClient::complete(const CallPtr& call, Error error, StringPiece response) {
+    if (!call->cb) {
+        return;  // answered late, the caller has had kTimeout
+    }
+    loop_->cancel(call->timer);
+    Callback cb = std::move(call->cb);
+    call->cb = nullptr;
+    cb(error, response);
+}
+
+}  // namespace dws::net
@@ -0,0 +1,519 @@
+#include "Resolver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "EventLoop.h"
+#include "FileUtil.h"
+#include "Logging.h"
+#include "UdpSocket.h"
+
+namespace dws::net {
+
+namespace {
+
+const uint16_t kTypeA = 1;
+const uint16_t kTypeCname = 5;
+const uint16_t kTypeAaaa = 28;
+const uint16_t kClassIn = 1;
+const std::size_t kHeaderBytes = 12;
+const std::size_t kMaxNameBytes = 253;
+const std::size_t kMaxLabelBytes = 63;
+const std::size_t kMaxResponseBytes = 4096;
+
+uint16_t read16(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+uint32_t read32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<uint32_t>(u[0]) << 24) | (static_cast<uint32_t>(u[1]) << 16) |
+           (static_cast<uint32_t>(u[2]) << 8) | u[3];
+}
+
+void append16(std::string* out, uint16_t value) {
+    out->push_back(static_cast<char>(value >> 8));
+    out->push_back(static_cast<char>(value & 0xff));
+}
+
+// Lower case without the trailing dot, false if it cannot be a host name.
+bool normalizeName(const std::string& host, std::string* name) {
+    name->clear();
+    std::size_t end = host.size();
+    if (end > 0 && host[end - 1] == '.') {
+        --end;
+    }
+    if (end == 0 || end > kMaxNameBytes) {
+        return false;
+    }
+    std::size_t label = 0;
+    for (std::size_t i = 0; i < end; ++i) {
+        unsigned char c = static_cast<unsigned char>(host[i]);
+        if (c == '.') {
+            if (label == 0) {
+                return false;
+            }
+            label = 0;
+        } else if (std::isalnum(c) || c == '-' || c == '_') {
+            if (++label > kMaxLabelBytes) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        name->push_back(static_cast<char>(std::tolower(c)));
+    }
+    return true;
+}
+
+std::string buildQuery(uint16_t id, const std::string& name, uint16_t type) {
+    std::string packet;
+    packet.reserve(kHeaderBytes + name.size() + 6);
+    append16(&packet, id);
+    append16(&packet, 0x0100);  // standard query, recursion desired
+    append16(&packet, 1);       // one question
+    append16(&packet, 0);
+    append16(&packet, 0);
+    append16(&packet, 0);
+    std::size_t start = 0;
+    while (start <= name.size()) {
+        std::size_t dot = std::min(name.find('.', start), name.size());
+        packet.push_back(static_cast<char>(dot - start));
+        packet.append(name, start, dot - start);
+        start = dot + 1;
+    }
+    packet.push_back('\0');
+    append16(&packet, type);
+    append16(&packet, kClassIn);
+    return packet;
+}
+
+// Reads the possibly compressed name at *pos into @c name, lower case and
+// dot separated, and moves *pos past it.
+bool readName(const char* msg, std::size_t len, std::size_t* pos, std::string* name) {
+    name->clear();
+    std::size_t p = *pos;
+    std::size_t next = 0;  // where to continue after the first pointer
+    int jumps = 0;
+    while (true) {
+        if (p >= len) {
+            return false;
+        }
+        unsigned char n = static_cast<unsigned char>(msg[p]);
+        if (n == 0) {
+            ++p;
+            break;
+        }
+        if ((n & 0xc0) == 0xc0) {
+            if (p + 1 >= len || ++jumps > 16) {
+                return false;
+            }
+            if (next == 0) {
+                next = p + 2;
+            }
+            p = read16(msg + p) & 0x3fff;
+            continue;
+        }
+        if ((n & 0xc0) != 0 || p + 1 + n > len) {
+            return false;
+        }
+        if (!name->empty()) {
+            name->push_back('.');
+        }
+        for (std::size_t i = p + 1; i < p + 1 + n; ++i) {
+            name->push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(msg[i]))));
+        }
+        if (name->size() > kMaxNameBytes) {
+            return false;
+        }
+        p += 1 + n;
+    }
+    *pos = next ? next : p;
+    return true;
+}
+
+std::string cacheKey(const std::string& name, uint16_t type) {
+    return name + (type == kTypeA ? "/A" : "/AAAA");
+}
+
+InetAddress withPort(const InetAddress& addr, uint16_t port) {
+    if (addr.family() == AF_INET6) {
+        struct sockaddr_in6 addr6;
+        std::memcpy(&addr6, addr.getSockAddr(), sizeof addr6);
+        addr6.sin6_port = htons(port);
+        return InetAddress(addr6);
+    }
+    struct sockaddr_in addr4;
+    std::memcpy(&addr4, addr.getSockAddr(), sizeof addr4);
+    addr4.sin_port = htons(port);
+    return InetAddress(addr4);
+}
+
+// IP literals and localhost, no query needed.
+bool resolveLocally(const std::string& name, Resolver::Family family,
+                    std::vector<InetAddress>* addresses) {
+    struct sockaddr_in addr4;
+    std::memset(&addr4, 0, sizeof addr4);
+    addr4.sin_family = AF_INET;
+    struct sockaddr_in6 addr6;
+    std::memset(&addr6, 0, sizeof addr6);
+    addr6.sin6_family = AF_INET6;
+    if (::inet_pton(AF_INET, name.c_str(), &addr4.sin_addr) == 1) {
+        if (family != Resolver::kIPv6) {
+            addresses->push_back(InetAddress(addr4));
+        }
+        return true;
+    }
+    if (::inet_pton(AF_INET6, name.c_str(), &addr6.sin6_addr) == 1) {
+        if (family != Resolver::kIPv4) {
+            addresses->push_back(InetAddress(addr6));
+        }
+        return true;
+    }
+    if (name == "localhost" || name == "localhost.") {
+        if (family != Resolver::kIPv4) {
+            addr6.sin6_addr = in6addr_loopback;
+            addresses->push_back(InetAddress(addr6));
+        }
+        if (family != Resolver::kIPv6) {
+            addr4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addresses->push_back(InetAddress(addr4));
+        }
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+Resolver::Resolver(EventLoop* loop) : Resolver(loop, systemNameserver(), Options()) {}
+
+Resolver::Resolver(EventLoop* loop, const InetAddress& nameserver)
+    : Resolver(loop, nameserver, Options()) {}
+
+Resolver::Resolver(EventLoop* loop, const InetAddress& nameserver, const Options& options)
+    : loop_(loop),
+      nameserver_(nameserver),
+      options_(options),
+      random_(std::random_device()()),
+      queriesSent_(0),
+      cacheHits_(0),
+      coalesced_(0) {
+    assert(options_.attempts > 0);
+    UdpSocket::Options socketOptions;
+    socketOptions.batchSize = 8;
+    socketOptions.maxDatagramBytes = kMaxResponseBytes;
+    socket_ = std::make_shared<UdpSocket>(
+        loop_, InetAddress(0, false, nameserver_.family() == AF_INET6), socketOptions);
+    socket_->setMessageCallback(
+        [this](const UdpSocketPtr&, const char* data, std::size_t len, const InetAddress& peer,
+               Timestamp) { onResponse(data, len, peer); });
+    loop_->runInLoop([socket = socket_] { socket->start(); });
+}
+
+Resolver::~Resolver() {
+    loop_->assertInLoopThread();
+    for (auto& entry : queries_) {
+        loop_->cancel(entry.second->timer);
+    }
+    socket_->setMessageCallback(UdpSocket::MessageCallback());
+}
+
+InetAddress Resolver::systemNameserver() {
+    std::string content;
+    FileUtil::readFile("/etc/resolv.conf", 64 * 1024, &content);
+    std::size_t start = 0;
+    while (start < content.size()) {
+        std::size_t end = content.find('\n', start);
+        if (end == std::string::npos) {
+            end = content.size();
+        }
+        std::string line = content.substr(start, end - start);
+        start = end + 1;
+        const char kKeyword[] = "nameserver";
+        if (line.compare(0, sizeof kKeyword - 1, kKeyword) != 0) {
+            continue;
+        }
+        std::size_t first = line.find_first_not_of(" \t", sizeof kKeyword - 1);
+        if (first == std::string::npos || first == sizeof kKeyword - 1) {
+            continue;
+        }
+        std::string ip = line.substr(first, line.find_first_of(" \t\r#;", first) - first);
+        std::vector<InetAddress> addresses;
+        // scoped IPv6 addresses are not parsed and skipped
+        if (resolveLocally(ip, kAny, &addresses) && !addresses.empty()) {
+            return withPort(addresses.front(), 53);
+        }
+    }
+    return InetAddress("127.0.0.1", 53);
+}
+
+const char* Resolver::errorString(Error error) {
+    switch (error) {
+        case kOk:
+            return "ok";
+        case kNotFound:
+            return "not found";
+        case kTimeout:
+            return "timeout";
+        case kServerFailure:
+            return "server failure";
+        case kBadName:
+            return "bad name";
+    }
+    return "unknown";
+}
+
+void Resolver::resolve(const std::string& host, uint16_t port, Family family, Callback cb) {
+    loop_->runInLoop([this, host, port, family, cb = std::move(cb)]() mutable {
+        resolveInLoop(host, port, family, std::move(cb));
+    });
+}
+
+void Resolver::resolveInLoop(const std::string& host, uint16_t port, Family family,
+                             Callback cb) {
+    loop_->assertInLoopThread();
+    std::vector<InetAddress> addresses;
+    if (resolveLocally(host, family, &addresses)) {
+        for (auto& addr : addresses) {
+            addr = withPort(addr, port);
+        }
+        Error error = addresses.empty() ? kNotFound : kOk;
+        loop_->queueInLoop([cb = std::move(cb), error, addresses] { cb(error, addresses); });
+        return;
+    }
+    std::string name;
+    if (!normalizeName(host, &name)) {
+        loop_->queueInLoop([cb = std::move(cb)] { cb(kBadName, std::vector<InetAddress>()); });
+        return;
+    }
+    if (family != kAny) {
+        lookup(name, family == kIPv4 ? kTypeA : kTypeAaaa,
+               [cb = std::move(cb), port](Error error, const std::vector<InetAddress>& found) {
+                   std::vector<InetAddress> result;
+                   result.reserve(found.size());
+                   for (const auto& addr : found) {
+                       result.push_back(withPort(addr, port));
+                   }
+                   cb(error, result);
+               });
+        return;
+    }
+    // both queries at once, the answer waits for the slower one
+    struct Both {
+        Callback cb;
+        Error errors[2] = {kOk, kOk};
+        std::vector<InetAddress> found[2];  // AAAA, A
+        int remaining = 2;
+    };
+    auto both = std::make_shared<Both>();
+    both->cb = std::move(cb);
+    for (int i = 0; i < 2; ++i) {
+        lookup(name, i == 0 ? kTypeAaaa : kTypeA,
+               [both, i, port](Error error, const std::vector<InetAddress>& found) {
+                   both->errors[i] = error;
+                   both->found[i] = found;
+                   if (--both->remaining > 0) {
+                       return;
+                   }
+                   std::vector<InetAddress> result;
+                   for (const auto& list : both->found) {
+                       for (const auto& addr : list) {
+                           result.push_back(withPort(addr, port));
+                       }
+                   }
+                   Error combined = kOk;
+                   if (result.empty()) {
+                       combined = both->errors[0] != kNotFound ? both->errors[0] : both->errors[1];
+                       if (combined == kOk) {
+                           combined = kNotFound;
+                       }
+                   }
+                   both->cb(combined, result);
+               });
+    }
+}
+
+void Resolver::lookup(const std::string& name, uint16_t type, LookupCallback cb) {
+    std::string key = cacheKey(name, type);
+    auto cached = cache_.find(key);
+    if (cached != cache_.end()) {
+        if (Timestamp::now() < cached->second.expires) {
+            ++cacheHits_;
+            loop_->queueInLoop([cb = std::move(cb), entry = cached->second] {
+                cb(entry.error, entry.addresses);
+            });
+            return;
+        }
+        cache_.erase(cached);
+    }
+    auto pending = pending_.find(key);
+    if (pending != pending_.end()) {
+        ++coalesced_;
+        queries_[pending->second]->waiters.push_back(std::move(cb));
+        return;
+    }
+    auto query = std::make_unique<Query>();
+    query->id = nextId();
+    query->type = type;
+    query->name = name;
+    query->packet = buildQuery(query->id, name, type);
+    query->attemptsLeft = options_.attempts;
+    query->waiters.push_back(std::move(cb));
+    Query* raw = query.get();
+    pending_[key] = raw->id;
+    queries_[raw->id] = std::move(query);
+    send(raw);
+}
+
+uint16_t Resolver::nextId() {
+    uint16_t id;
+    do {
+        id = static_cast<uint16_t>(random_());
+    } while (queries_.count(id) > 0);
+    return id;
+}
+
+void Resolver::send(Query* query) {
+    --query->attemptsLeft;
+    ++queriesSent_;
+    LOG(DEBUG) << "[Resolver::send] " << query->name << (query->type == kTypeA ? " A" : " AAAA")
+               << " to " << nameserver_.toIpPort();
+    socket_->send(nameserver_, query->packet.data(), query->packet.size());
+    uint16_t id = query->id;
+    query->timer = loop_->runAfter(options_.timeoutSeconds, [this, id] { onTimeout(id); });
+}
+
+void Resolver::onTimeout(uint16_t id) {
+    auto it = queries_.find(id);
+    if (it == queries_.end()) {
+        return;
+    }
+    if (it->second->attemptsLeft > 0) {
+        send(it->second.get());
+    } else {
+        LOG(WARN) << "[Resolver::onTimeout] no answer for " << it->second->name << " from "
+                  << nameserver_.toIpPort();
+        finish(id, kTimeout, std::vector<InetAddress>(), 0);
+    }
+}
+
+void Resolver::onResponse(const char* data, std::size_t len, const InetAddress& peer) {
+    if (peer.toIpPort() != nameserver_.toIpPort() || len < kHeaderBytes) {
+        return;
+    }
+    uint16_t id = read16(data);
+    auto it = queries_.find(id);
+    if (it == queries_.end()) {
+        return;  // late answer to a finished query, or spoofed
+    }
+    const Query& query = *it->second;
+    uint16_t flags = read16(data + 2);
+    if ((flags & 0x8000) == 0 || read16(data + 4) != 1) {
+        return;
+    }
+    std::size_t pos = kHeaderBytes;
+    std::string owner;
+    if (!readName(data, len, &pos, &owner) || pos + 4 > len || owner != query.name ||
+        read16(data + pos) != query.type || read16(data + pos + 2) != kClassIn) {
+        return;
+    }
+    pos += 4;
+    int rcode = flags & 0x000f;
+    if (rcode == 3) {
+        finish(id, kNotFound, std::vector<InetAddress>(), options_.negativeTtlSeconds);
+        return;
+    }
+    if (rcode != 0) {
+        LOG(WARN) << "[Resolver::onResponse] rcode " << rcode << " for " << query.name;
+        finish(id, kServerFailure, std::vector<InetAddress>(), 0);
+        return;
+    }
+    // follows the CNAME chain, recursive servers list it in order
+    std::vector<std::string> names(1, query.name);
+    std::vector<InetAddress> addresses;
+    uint32_t ttl = UINT32_MAX;
+    int answers = read16(data + 6);
+    for (int i = 0; i < answers; ++i) {
+        if (!readName(data, len, &pos, &owner) || pos + 10 > len) {
+            break;
+        }
+        uint16_t type = read16(data + pos);
+        uint16_t klass = read16(data + pos + 2);
+        uint32_t recordTtl = read32(data + pos + 4);
+        std::size_t rdlength = read16(data + pos + 8);
+        pos += 10;
+        if (pos + rdlength > len) {
+            break;  // truncated, keep what is complete
+        }
+        bool ours = std::find(names.begin(), names.end(), owner) != names.end();
+        if (ours && klass == kClassIn) {
+            if (type == kTypeCname) {
+                std::size_t target = pos;
+                std::string alias;
+                if (readName(data, len, &target, &alias)) {
+                    names.push_back(alias);
+                    ttl = std::min(ttl, recordTtl);
+                }
+            } else if (type == query.type && type == kTypeA && rdlength == 4) {
+                struct sockaddr_in addr;
+                std::memset(&addr, 0, sizeof addr);
+                addr.sin_family = AF_INET;
+                std::memcpy(&addr.sin_addr, data + pos, 4);
+                addresses.push_back(InetAddress(addr));
+                ttl = std::min(ttl, recordTtl);
+            } else if (type == query.type && type == kTypeAaaa && rdlength == 16) {
+                struct sockaddr_in6 addr;
+                std::memset(&addr, 0, sizeof addr);
+                addr.sin6_family = AF_INET6;
+                std::memcpy(&addr.sin6_addr, data + pos, 16);
+                addresses.push_back(InetAddress(addr));
+                ttl = std::min(ttl, recordTtl);
+            }
+        }
+        pos += rdlength;
+    }
+    if (addresses.empty()) {
+        finish(id, kNotFound, addresses, options_.negativeTtlSeconds);
+    } else {
+        finish(id, kOk, addresses, static_cast<double>(ttl));
+    }
+}
+
+void Resolver::finish(uint16_t id, Error error, const std::vector<InetAddress>& addresses,
+                      double ttlSeconds) {
+    auto it = queries_.find(id);
+    assert(it != queries_.end());
+    std::unique_ptr<Query> query = std::move(it->second);
+    queries_.erase(it);
+    loop_->cancel(query->timer);
+    std::string key = cacheKey(query->name, query->type);
+    pending_.erase(key);
+    if (error == kOk || error == kNotFound) {
+        Timestamp now = Timestamp::now();
+        if (cache_.size() >= options_.maxCacheEntries) {
+            for (auto entry = cache_.begin(); entry != cache_.end();) {
+                entry = entry->second.expires <= now ? cache_.erase(entry) : std::next(entry);
+            }
+        }
+        if (cache_.size() >= options_.maxCacheEntries && !cache_.empty()) {
+            cache_.erase(cache_.begin());
+        }
+        if (options_.maxCacheEntries > 0) {
+            double ttl = error == kOk ? std::min(std::max(ttlSeconds, options_.minTtlSeconds),
+                                                 options_.maxTtlSeconds)
+                                      : ttlSeconds;
+            cache_[key] = CacheEntry{error, addresses, addTime(now, ttl)};
+        }
+    }
+    for (auto& waiter : query->waiters) {
+        waiter(error, addresses);
+    }
+}
+
+}  // namespace dws::net
@@ -2,6 +2,7 @@
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/socket.h>
 
 #include <cstdio>  // snprintf
 
@@ -19,6 +20,12 @@ bool Socket::getTcpInfo(struct tcp_info *tcpi) const {
     return ::getsockopt(sockfd_, SOL_TCP, TCP_INFO, tcpi, &len) == 0;
 }
 
+bool Socket::getPeerCredentials(struct ucred *cred) const {
+    socklen_t len = sizeof(*cred);
+    std::memset(cred, 0, len);
+    return ::getsockopt(sockfd_, SOL_SOCKET, SO_PEERCRED, cred, &len) == 0;
+}
+
 bool Socket::getTcpInfoString(char *buf, int len) const {
     struct tcp_info tcpi {};
     bool res = getTcpInfo(&tcpi);
@@ -43,11 +50,11 @@ void Socket::bindAddress(const dws::net::InetAddress &localaddr) {
 void Socket::listen() { sockets::listenOrDie(sockfd_); }
 
 int Socket::accept(dws::net::InetAddress *peeraddr) {
-    struct sockaddr_in6 addr {};
+    struct sockaddr_storage addr {};
     bzero(&addr, sizeof addr);
     int connfd = sockets::accept(sockfd_, &addr);
     if (connfd >= 0) {
-        peeraddr->setSockAddrInet6(addr);
+        *peeraddr = InetAddress(addr);
     }
     return connfd;
 }
@@ -84,4 +91,13 @@ void Socket::setKeepAlive(bool on) {
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, static_cast<socklen_t>(sizeof optval));
 }
 
+bool Socket::setTcpFastOpen(int queueLength) {
+    int ret = ::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &queueLength,
+                           static_cast<socklen_t>(sizeof queueLength));
+    if (ret < 0) {
+        LOG_SYSERR << "[Socket::setTcpFastOpen] TCP_FASTOPEN failed";
+    }
+    return ret == 0;
+}
+
 }  // namespace dws::net
@@ -1,11 +1,14 @@
 #include "SocketsOps.h"
 
 #include <fcntl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
-#include <sys/uio.h>  // readv
+#include <sys/uio.h>  // readv, writev
+#include <sys/un.h>
 #include <unistd.h>
 
 #include <cerrno>
+#include <cstddef>  // offsetof
 #include <cstdio>  // snprintf
 
 #include "Endian.h"
@@ -56,6 +59,10 @@ SA *sockaddr_cast(struct sockaddr_in6 *addr) {
     return static_cast<SA *>(reinterpret_cast<void *>(addr));
 }
 
+SA *sockaddr_cast(struct sockaddr_storage *addr) {
+    return static_cast<SA *>(reinterpret_cast<void *>(addr));
+}
+
 const struct sockaddr_in *sockaddr_in_cast(const struct sockaddr *addr) {
     return static_cast<const struct sockaddr_in *>(reinterpret_cast<const void *>(addr));
 }
@@ -65,14 +72,15 @@ const struct sockaddr_in6 *sockaddr_in6_cast(const struct sockaddr *addr) {
 }
 
 int createNonblockingOrDie(sa_family_t family) {
+    const int protocol = family == AF_UNIX ? 0 : IPPROTO_TCP;
 #if VALGRIND
-    int sockfd = ::socket(family, SOCK_STREAM, IPPROTO_TCP);
+    int sockfd = ::socket(family, SOCK_STREAM, protocol);
     if (sockfd < 0) {
         LOG_SYSFATAL << "sockets::createNonblockingOrDie";
     }
     setNonBlockAndCloseOnExec(sockfd);
 #else
-    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
     if (sockfd < 0) {
         LOG_SYSFATAL << "sockets::createNonblockingOrDie";
     }
@@ -80,8 +88,16 @@ int createNonblockingOrDie(sa_family_t family) {
     return sockfd;
 }
 
+int createUdpNonblockingOrDie(sa_family_t family) {
+    int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0) {
+        LOG_SYSFATAL << "sockets::createUdpNonblockingOrDie";
+    }
+    return sockfd;
+}
+
 void bindOrDie(int sockfd, const struct sockaddr *addr) {
-    int ret = ::bind(sockfd, addr, static_cast<socklen_t>(sizeof(struct sockaddr_in6)));
+    int ret = ::bind(sockfd, addr, sockaddrLength(addr));
     if (ret < 0) {
         LOG_SYSFATAL << "sockets::bindOrDie";
     }
@@ -94,7 +110,7 @@ void listenOrDie(int sockfd) {
     }
 }
 
-int accept(int sockfd, struct sockaddr_in6 *addr) {
+int accept(int sockfd, struct sockaddr_storage *addr) {
     socklen_t addrlen = static_cast<socklen_t>(sizeof *addr);
 #if VALGRIND || defined(NO_ACCEPT4)
     int connfd = ::accept(sockfd, sockaddr_cast(addr), &addrlen);
@@ -135,7 +151,7 @@ int accept(int sockfd, struct sockaddr_in6 *addr) {
 }
 
 int connect(int sockfd, const struct sockaddr *addr) {
-    return ::connect(sockfd, addr, static_cast<socklen_t>(sizeof(struct sockaddr_in6)));
+    return ::connect(sockfd, addr, sockaddrLength(addr));
 }
 
 ssize_t read(int sockfd, void *buf, size_t count) { return ::read(sockfd, buf, count); }
@@ -146,6 +162,21 @@ ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt) {
 
 ssize_t write(int sockfd, const void *buf, size_t count) { return ::write(sockfd, buf, count); }
 
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt) {
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t splice(int fdIn, int fdOut, size_t len) {
+    return ::splice(fdIn, nullptr, fdOut, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+
+ssize_t sendfile(int sockfd, int fileFd, int64_t *offset, size_t count) {
+    off_t off = static_cast<off_t>(*offset);
+    ssize_t n = ::sendfile(sockfd, fileFd, &off, count);
+    *offset = off;
+    return n;
+}
+
 void close(int sockfd) {
     if (::close(sockfd) < 0) {
         LOG_SYSERR << "sockets::close";
@@ -159,6 +190,13 @@ void shutdownWrite(int sockfd) {
 }
 
 void toIpPort(char *buf, size_t size, const struct sockaddr *addr) {
+    if (addr->sa_family == AF_UNIX) {
+        size_t len = ::strlen("unix:");
+        assert(size > len);
+        memcpy(buf, "unix:", len);
+        toIp(buf + len, size - len, addr);
+        return;
+    }
     if (addr->sa_family == AF_INET6) {
         buf[0] = '[';
         toIp(buf + 1, size - 1, addr);
@@ -186,6 +224,18 @@ void toIp(char *buf, size_t size, const struct sockaddr *addr) {
         assert(size >= INET6_ADDRSTRLEN);
         const struct sockaddr_in6 *addr6 = sockaddr_in6_cast(addr);
         ::inet_ntop(AF_INET6, &addr6->sin6_addr, buf, static_cast<socklen_t>(size));
+    } else if (addr->sa_family == AF_UNIX) {
+        // the path, abstract names with a leading '@' for the NUL
+        const struct sockaddr_un *un =
+                static_cast<const struct sockaddr_un *>(reinterpret_cast<const void *>(addr));
+        const size_t maxPath = sizeof un->sun_path;
+        if (un->sun_path[0] == '\0' && un->sun_path[1] != '\0') {
+            snprintf(buf, size, "@%.*s", static_cast<int>(::strnlen(un->sun_path + 1, maxPath - 1)),
+                     un->sun_path + 1);
+        } else {
+            snprintf(buf, size, "%.*s", static_cast<int>(::strnlen(un->sun_path, maxPath)),
+                     un->sun_path);
+        }
     }
 }
 
@@ -216,8 +266,23 @@ int getSocketError(int sockfd) {
     }
 }
 
-struct sockaddr_in6 getLocalAddr(int sockfd) {
-    struct sockaddr_in6 localaddr;
+socklen_t sockaddrLength(const struct sockaddr *addr) {
+    if (addr->sa_family == AF_INET) {
+        return static_cast<socklen_t>(sizeof(struct sockaddr_in));
+    }
+    if (addr->sa_family == AF_UNIX) {
+        const struct sockaddr_un *un =
+                static_cast<const struct sockaddr_un *>(reinterpret_cast<const void *>(addr));
+        const size_t maxPath = sizeof un->sun_path;
+        size_t len = un->sun_path[0] == '\0' ? 1 + ::strnlen(un->sun_path + 1, maxPath - 1)
+                                             : ::strnlen(un->sun_path, maxPath - 1) + 1;
+        return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + len);
+    }
+    return static_cast<socklen_t>(sizeof(struct sockaddr_in6));
+}
+
+struct sockaddr_storage getLocalAddr(int sockfd) {
+    struct sockaddr_storage localaddr;
     memZero(&localaddr, sizeof localaddr);
     socklen_t addrlen = static_cast<socklen_t>(sizeof localaddr);
     if (::getsockname(sockfd, sockaddr_cast(&localaddr), &addrlen) < 0) {
@@ -226,8 +291,8 @@ struct sockaddr_in6 getLocalAddr(int sockfd) {
     return localaddr;
 }
 
-struct sockaddr_in6 getPeerAddr(int sockfd) {
-    struct sockaddr_in6 peeraddr;
+struct sockaddr_storage getPeerAddr(int sockfd) {
+    struct sockaddr_storage peeraddr;
     memZero(&peeraddr, sizeof peeraddr);
     socklen_t addrlen = static_cast<socklen_t>(sizeof peeraddr);
     if (::getpeername(sockfd, sockaddr_cast(&peeraddr), &addrlen) < 0) {
@@ -237,16 +302,18 @@ struct sockaddr_in6 getPeerAddr(int sockfd) {
 }
 
 bool isSelfConnect(int sockfd) {
-    struct sockaddr_in6 localaddr = getLocalAddr(sockfd);
-    struct sockaddr_in6 peeraddr = getPeerAddr(sockfd);
-    if (localaddr.sin6_family == AF_INET) {
-        const struct sockaddr_in *laddr4 = reinterpret_cast<struct sockaddr_in *>(&localaddr);
-        const struct sockaddr_in *raddr4 = reinterpret_cast<struct sockaddr_in *>(&peeraddr);
+    struct sockaddr_storage local = getLocalAddr(sockfd);
+    struct sockaddr_storage peer = getPeerAddr(sockfd);
+    if (local.ss_family == AF_INET) {
+        const struct sockaddr_in *laddr4 = sockaddr_in_cast(sockaddr_cast(&local));
+        const struct sockaddr_in *raddr4 = sockaddr_in_cast(sockaddr_cast(&peer));
         return laddr4->sin_port == raddr4->sin_port &&
                laddr4->sin_addr.s_addr == raddr4->sin_addr.s_addr;
-    } else if (localaddr.sin6_family == AF_INET6) {
-        return localaddr.sin6_port == peeraddr.sin6_port &&
-               memcmp(&localaddr.sin6_addr, &peeraddr.sin6_addr, sizeof localaddr.sin6_addr) == 0;
+    } else if (local.ss_family == AF_INET6) {
+        const struct sockaddr_in6 *laddr6 = sockaddr_in6_cast(sockaddr_cast(&local));
+        const struct sockaddr_in6 *raddr6 = sockaddr_in6_cast(sockaddr_cast(&peer));
+        return laddr6->sin6_port == raddr6->sin6_port &&
+               memcmp(&laddr6->sin6_addr, &raddr6->sin6_addr, sizeof laddr6->sin6_addr) == 0;
     } else {
         return false;
     }
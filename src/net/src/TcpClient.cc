@@ -28,6 +28,23 @@ TcpClient::TcpClient(EventLoop* loop, const InetAddress& serverAddr, std::string
       retry_(false),
       connect_(true),
       nextConnId_(1) {
+    init();
+}
+
+TcpClient::TcpClient(EventLoop* loop, Resolver* resolver, const std::string& host,
+                     uint16_t port, std::string name)
+    : loop_(CHECK_NOTNULL(loop)),
+      connector_(new Connector(loop, resolver, host, port)),
+      name_(std::move(name)),
+      connectionCallback_(defaultConnectionCallback),
+      messageCallback_(defaultMessageCallback),
+      retry_(false),
+      connect_(true),
+      nextConnId_(1) {
+    init();
+}
+
+void TcpClient::init() {
     connector_->setNewConnectionCallback([this](int socket) { newConnection(socket); });
     LOG(INFO) << "[TcpClient::TcpClient] " << name_ << " - connector " << connector_.get();
 }
@@ -47,19 +64,21 @@ TcpClient::~TcpClient() {
         CloseCallback cb = [this](const TcpConnectionPtr& tcp_conn) {
             detail::removeConnection(loop_, tcp_conn);
         };
-        loop_->runInLoop([&conn, &cb] { conn->setCloseCallback(cb); });
+        loop_->runInLoop([conn, cb] { conn->setCloseCallback(cb); });
         if (unique) {
             conn->forceClose();
         }
     } else {
         connector_->stop();
-        loop_->runAfter(1, [this] { detail::removeConnector(connector_); });
+        loop_->runAfter(1, [connector = connector_] { detail::removeConnector(connector); });
     }
 }
 
+void TcpClient::setFastOpenData(std::string data) { connector_->setFastOpenData(std::move(data)); }
+
 void TcpClient::connect() {
     LOG(INFO) << "[TcpClient::connect] " << name_ << " - connecting to "
-              << connector_->serverAddress().toIpPort();
+              << connector_->serverName();
     connect_ = true;
     connector_->start();
 }
@@ -110,10 +129,10 @@ void TcpClient::removeConnection(const TcpConnectionPtr& conn) {
         connection_.reset();
     }
 
-    loop_->queueInLoop(([&conn] { conn->connectDestroyed(); }));
+    loop_->queueInLoop([conn] { conn->connectDestroyed(); });
     if (retry_ && connect_) {
         LOG(INFO) << "[TcpClient::connect] " << name_ << " - Reconnecting to "
-                  << connector_->serverAddress().toIpPort();
+                  << connector_->serverName();
         connector_->restart();
     }
 }
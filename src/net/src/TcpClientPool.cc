@@ -0,0 +1,283 @@
+#include "TcpClientPool.h"
+
+#include <cstdio>
+#include <limits>
+
+#include "Connector.h"
+#include "CountDownLatch.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logging.h"
+#include "SocketsOps.h"
+
+namespace dws::net {
+
+namespace {
+
+// Runs @c cb in @c loop, another loop's thread, and waits until the
+// Connectors' stopInLoop() it queued and the resetChannel() those queue in
+// turn have run too.
+void runInLoopAndWait(EventLoop* loop, std::function<void()> cb) {
+    CountDownLatch latch(1);
+    loop->queueInLoop([loop, &latch, &cb] {
+        cb();
+        loop->queueInLoop([loop, &latch] {
+            loop->queueInLoop([&latch] { latch.countDown(); });
+        });
+    });
+    latch.wait();
+}
+
+}  // namespace
+
+TcpClientPool::TcpClientPool(EventLoop* baseLoop, const InetAddress& serverAddr,
+                             const std::string& name)
+    : TcpClientPool(baseLoop, serverAddr, name, Options()) {}
+
+TcpClientPool::TcpClientPool(EventLoop* baseLoop, const InetAddress& serverAddr,
+                             const std::string& name, const Options& options)
+    : baseLoop_(CHECK_NOTNULL(baseLoop)),
+      serverAddr_(serverAddr),
+      name_(name),
+      options_(options),
+      threadPool_(new EventLoopThreadPool(baseLoop, name)),
+      connectionCallback_(defaultConnectionCallback),
+      messageCallback_(defaultMessageCallback),
+      started_(false),
+      stopping_(false),
+      replaced_(0) {
+    assert(options_.minConnections >= 1);
+    assert(options_.maxConnections >= options_.minConnections);
+    threadPool_->setThreadNum(options_.numThreads);
+}
+
+TcpClientPool::~TcpClientPool() {
+    baseLoop_->assertInLoopThread();
+    stopping_ = true;
+    std::vector<SlotPtr> slots;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots.swap(slots_);
+    }
+    // the IO loops go with threadPool_, so each one tears its slots down
+    // and finishes the queued work before we go on
+    for (EventLoop* loop : loops_) {
+        auto teardown = [&slots, loop] {
+            for (const SlotPtr& slot : slots) {
+                if (slot->loop != loop) {
+                    continue;
+                }
+                slot->retired = true;
+                slot->connector->stop();
+                // keeps the Connector alive until its queued stopInLoop() ran
+                loop->queueInLoop([connector = slot->connector] {});
+                if (slot->connection) {
+                    slot->connection->connectDestroyed();
+                    slot->connection.reset();
+                }
+            }
+        };
+        if (loop == baseLoop_) {
+            teardown();
+        } else {
+            runInLoopAndWait(loop, teardown);
+        }
+    }
+}
+
+void TcpClientPool::start() {
+    baseLoop_->assertInLoopThread();
+    assert(!started_);
+    threadPool_->start();
+    loops_ = threadPool_->getAllLoops();
+    started_ = true;
+    std::vector<SlotPtr> added;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < options_.minConnections; ++i) {
+            added.push_back(addSlotLocked());
+        }
+    }
+    for (const SlotPtr& slot : added) {
+        startSlot(slot);
+    }
+}
+
+TcpClientPool::SlotPtr TcpClientPool::addSlotLocked() {
+    auto slot = std::make_shared<Slot>();
+    slot->index = static_cast<int>(slots_.size());
+    slot->loop = loops_[slots_.size() % loops_.size()];
+    slot->connector = std::make_shared<Connector>(slot->loop, serverAddr_);
+    std::weak_ptr<Slot> weakSlot(slot);
+    slot->connector->setNewConnectionCallback([this, weakSlot](int sockfd) {
+        SlotPtr s = weakSlot.lock();
+        if (s) {
+            newConnection(s, sockfd);
+        } else {
+            sockets::close(sockfd);
+        }
+    });
+    slots_.push_back(slot);
+    LOG(DEBUG) << "[TcpClientPool::addSlotLocked] " << name_ << " slot " << slot->index;
+    return slot;
+}
+
+void TcpClientPool::startSlot(const SlotPtr& slot) {
+    slot->loop->runInLoop([slot] {
+        if (!slot->retired) {
+            slot->connector->start();
+        }
+    });
+}
+
+void TcpClientPool::newConnection(const SlotPtr& slot, int sockfd) {
+    slot->loop->assertInLoopThread();
+    InetAddress peerAddr(sockets::getPeerAddr(sockfd));
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    char buf[160];
+    snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), slot->index);
+    TcpConnectionPtr conn(new TcpConnection(slot->loop, name_ + buf, sockfd, localAddr, peerAddr));
+    if (options_.tcpNoDelay && !peerAddr.isUnix()) {
+        conn->setTcpNoDelay(true);
+    }
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    std::weak_ptr<Slot> weakSlot(slot);
+    conn->setCloseCallback([this, weakSlot](const TcpConnectionPtr& c) {
+        SlotPtr s = weakSlot.lock();
+        if (s) {
+            removeConnection(s, c);
+        } else {
+            c->getLoop()->queueInLoop([c] { c->connectDestroyed(); });
+        }
+    });
+    if (slot->everConnected) {
+        replaced_.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot->everConnected = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot->connection = conn;
+        slot->inFlight = 0;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClientPool::removeConnection(const SlotPtr& slot, const TcpConnectionPtr& conn) {
+    slot->loop->assertInLoopThread();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (slot->connection == conn) {
+            slot->connection.reset();
+            slot->inFlight = 0;
+        }
+    }
+    slot->loop->queueInLoop([conn] { conn->connectDestroyed(); });
+    if (!stopping_) {
+        LOG(INFO) << "[TcpClientPool::removeConnection] " << name_ << " replacing "
+                  << *conn;
+        slot->connector->restart();
+    }
+}
+
+TcpClientPool::SlotPtr TcpClientPool::pickLocked(SlotPtr* added) {
+    SlotPtr best;
+    int64_t least = std::numeric_limits<int64_t>::max();
+    std::size_t connected = 0;
+    for (const SlotPtr& slot : slots_) {
+        if (slot->connection && slot->connection->connected()) {
+            ++connected;
+            if (slot->inFlight < least) {
+                least = slot->inFlight;
+                best = slot;
+            }
+        }
+    }
+    // warm one more while every slot is up and even the idlest is busy
+    if (started_ && !stopping_ && connected == slots_.size() &&
+        slots_.size() < static_cast<std::size_t>(options_.maxConnections) &&
+        (!best || least >= static_cast<int64_t>(options_.growInFlightBytes))) {
+        *added = addSlotLocked();
+    }
+    return best;
+}
+
+TcpConnectionPtr TcpClientPool::pick() {
+    TcpConnectionPtr conn;
+    SlotPtr added;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SlotPtr slot = pickLocked(&added);
+        if (slot) {
+            conn = slot->connection;
+        }
+    }
+    if (added) {
+        startSlot(added);
+    }
+    return conn;
+}
+
+TcpConnectionPtr TcpClientPool::send(const StringPiece& message) {
+    TcpConnectionPtr conn;
+    SlotPtr added;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SlotPtr slot = pickLocked(&added);
+        if (slot) {
+            slot->inFlight += message.size();
+            conn = slot->connection;
+        }
+    }
+    if (added) {
+        startSlot(added);
+    }
+    if (conn) {
+        conn->send(message);
+    }
+    return conn;
+}
+
+void TcpClientPool::complete(const TcpConnectionPtr& conn, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SlotPtr slot = findSlotLocked(conn);
+    if (slot) {
+        slot->inFlight = std::max<int64_t>(0, slot->inFlight - static_cast<int64_t>(bytes));
+    }
+}
+
+TcpClientPool::SlotPtr TcpClientPool::findSlotLocked(const TcpConnectionPtr& conn) const {
+    for (const SlotPtr& slot : slots_) {
+        if (slot->connection == conn) {
+            return slot;
+        }
+    }
+    return SlotPtr();
+}
+
+int TcpClientPool::numSlots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(slots_.size());
+}
+
+int TcpClientPool::numConnected() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int n = 0;
+    for (const SlotPtr& slot : slots_) {
+        if (slot->connection && slot->connection->connected()) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+int64_t TcpClientPool::inFlightBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t total = 0;
+    for (const SlotPtr& slot : slots_) {
+        total += slot->inFlight;
+    }
+    return total;
+}
+
+}  // namespace dws::net
@@ -1,6 +1,12 @@
 #include "TcpConnection.h"
 
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+
+#include <algorithm>
 #include <cerrno>
+#include <climits>  // IOV_MAX
+#include <cstdio>
 
 #include "Channel.h"
 #include "EventLoop.h"
@@ -22,32 +28,75 @@ void defaultMessageCallback(const TcpConnectionPtr&, Buffer* buffer, Timestamp)
 
 TcpConnection::TcpConnection(EventLoop* loop, const std::string& name, int sockfd,
                              const InetAddress& localAddr, const InetAddress& peerAddr)
+    : TcpConnection(loop, 0, std::make_shared<const std::string>(name), sockfd, localAddr,
+                    peerAddr) {}
+
+TcpConnection::TcpConnection(EventLoop* loop, ConnectionId id,
+                             std::shared_ptr<const std::string> namePrefix, int sockfd,
+                             const InetAddress& localAddr, const InetAddress& peerAddr)
     : loop_(CHECK_NOTNULL(loop)),
-      name_(name),
+      id_(id),
+      namePrefix_(std::move(namePrefix)),
       state_(kConnecting),
       reading_(true),
+      draining_(false),
+      pendingResponses_(0),
       socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) {
-    channel_->setReadCallback([this](Timestamp timestamp) { handleRead(timestamp); });
-    channel_->setWriteCallback([this] { handleWrite(); });
-    channel_->setCloseCallback([this] { handleClose(); });
-    channel_->setErrorCallback([this] { handleError(); });
-    LOG(DEBUG) << "[TcpConnection::TcpConnection]" << " TcpConnection::ctor[" << name_ << "] at "
+      highWaterMark_(64 * 1024 * 1024),
+      coalescing_(false),
+      flushQueued_(false),
+      maxCoalesceBytes_(kDefaultMaxCoalesceBytes),
+      maxCoalesceDelayUs_(kDefaultMaxCoalesceDelayUs),
+      coalescingSince_(0),
+      flushBase_(0),
+      pipeFd_(-1),
+      pipeBytes_(0),
+      fileFd_(-1),
+      fileOffset_(0),
+      fileBytes_(0),
+      peerShutdown_(false),
+      writeShutdown_(false),
+      lastRttSample_(0) {
+    setupChannel();
+    LOG(DEBUG) << "[TcpConnection::TcpConnection]" << " TcpConnection::ctor[" << *this << "] at "
                << this << " fd = " << sockfd;
     socket_->setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection() {
-    LOG(DEBUG) << "[TcpConnection::~TcpConnection]" << " TcpConnection::dtor[" << name_ << "] at "
+    LOG(DEBUG) << "[TcpConnection::~TcpConnection]" << " TcpConnection::dtor[" << *this << "] at "
                << this << " fd = " << channel_->fd() << " state = " << stateToString();
     assert(state_ == kDisconnected);
 }
 
+void TcpConnection::setupChannel() {
+    channel_->setReadCallback([this](Timestamp timestamp) { handleRead(timestamp); });
+    channel_->setWriteCallback([this] { handleWrite(); });
+    channel_->setCloseCallback([this] { handleClose(); });
+    channel_->setErrorCallback([this] { handleError(); });
+}
+
+std::string TcpConnection::name() const {
+    return id_ == 0 ? *namePrefix_ : *namePrefix_ + "#" + std::to_string(id_);
+}
+
+LogStream& operator<<(LogStream& s, const TcpConnection& conn) {
+    s << conn.namePrefix();
+    if (conn.id() != 0) {
+        s << '#' << conn.id();
+    }
+    return s;
+}
+
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const { return socket_->getTcpInfo(tcpi); }
 
+bool TcpConnection::getPeerCredentials(struct ucred* cred) const {
+    return socket_->getPeerCredentials(cred);
+}
+
 std::string TcpConnection::getTcpInfoString() const {
     char buf[1024];
     bzero(buf, 1024);
@@ -55,28 +104,112 @@ std::string TcpConnection::getTcpInfoString() const {
     return buf;
 }
 
+void TcpConnection::sampleRtt(Timestamp now) {
+    lastRttSample_ = now.microSecondsSinceEpoch();
+    struct tcp_info tcpi {};
+    if (socket_->getTcpInfo(&tcpi)) {
+        stats_.onRttSample(tcpi.tcpi_rtt, tcpi.tcpi_rttvar);
+    }
+}
+
 void TcpConnection::send(const void* message, int len) {
     send(StringPiece(reinterpret_cast<const char*>(message), len));
 }
 
 void TcpConnection::send(const StringPiece& message) {
     if (state_ == kConnected) {
-        if (loop_->isInLoopThread()) {
+        if (getLoop()->isInLoopThread()) {
             sendInLoop(message);
         } else {
-            loop_->runInLoop([this, message] { sendInLoop(message); });
+            runInOwnerLoop([this, message = message.as_string()] { sendInLoop(message); });
         }
     }
 }
 
 void TcpConnection::send(Buffer* buf) {
     if (state_ == kConnected) {
-        if (loop_->isInLoopThread()) {
+        if (getLoop()->isInLoopThread()) {
             sendInLoop(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
         } else {
-            loop_->runInLoop([this, buf] { sendInLoop(buf->toStringPiece()); });
+            runInOwnerLoop([this, message = buf->retrieveAllAsString()] { sendInLoop(message); });
+        }
+    }
+}
+
+void TcpConnection::sendInLoop(const std::string& message) {
+    sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::runInOwnerLoop(std::function<void()> cb) {
+    EventLoop* loop = getLoop();
+    if (loop->isInLoopThread()) {
+        cb();
+    } else {
+        // re-dispatched if the connection migrates before the functor runs
+        loop->queueInLoop([ptr = shared_from_this(), cb = std::move(cb)]() mutable {
+            ptr->runInOwnerLoop(std::move(cb));
+        });
+    }
+}
+
+void TcpConnection::migrate(EventLoop* target, MigrateCallback cb) {
+    assert(target != nullptr);
+    // Always deferred, the Channel must not be replaced while it handles events.
+    getLoop()->queueInLoop([ptr = shared_from_this(), target, cb = std::move(cb)]() mutable {
+        if (ptr->getLoop()->isInLoopThread()) {
+            ptr->migrateInLoop(target, std::move(cb));
+        } else {
+            ptr->migrate(target, std::move(cb));
         }
+    });
+}
+
+void TcpConnection::migrateInLoop(EventLoop* target, MigrateCallback cb) {
+    EventLoop* source = getLoop();
+    source->assertInLoopThread();
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        LOG(DEBUG) << "[TcpConnection::migrateInLoop] " << *this << " is "
+                   << stateToString() << ", not migrating";
+        return;
+    }
+    if (target == source) {
+        if (cb) cb(shared_from_this());
+        return;
+    }
+    if (flushQueued_) {
+        flushCoalescedWrites();
+    }
+    LOG(DEBUG) << "[TcpConnection::migrateInLoop] " << *this << " from loop " << source
+               << " to loop " << target;
+    channel_->disableAll();
+    channel_->remove();
+    channel_.reset(new Channel(target, socket_->fd()));
+    setupChannel();
+    loop_.store(target, std::memory_order_release);
+    target->queueInLoop([ptr = shared_from_this(), cb = std::move(cb)] {
+        ptr->attachAfterMigration(cb);
+    });
+}
+
+void TcpConnection::attachAfterMigration(const MigrateCallback& cb) {
+    getLoop()->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        return;
+    }
+    channel_->tie(shared_from_this());
+    if (reading_) {
+        channel_->enableReading();
+    }
+    if (outputBuffer_.readableBytes() > 0 || pipeBytes_ > 0 || fileBytes_ > 0) {
+        channel_->enableWriting();
+    }
+    if (channel_->isNoneEvent()) {
+        // registers the channel, so connectDestroyed() can remove it
+        channel_->disableAll();
+    }
+    if (cb) {
+        cb(shared_from_this());
     }
 }
 
@@ -85,7 +218,7 @@ void TcpConnection::sendInLoop(const StringPiece& message) {
 }
 
 void TcpConnection::sendInLoop(const void* message, size_t len) {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool err = false;
@@ -93,12 +226,20 @@ void TcpConnection::sendInLoop(const void* message, size_t len) {
         LOG(WARN) << "[TcpConnection::sendInLoop]" << " disconnected, give up writing";
         return;
     }
+    stats_.onSend();
+    if (coalescing_ && !channel_->isWriting()) {
+        size_t oldLen = outputBuffer_.readableBytes();
+        outputBuffer_.append(message, len);
+        coalesce(oldLen);
+        return;
+    }
     if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
         nwrote = sockets::write(channel_->fd(), message, len);
+        stats_.onWrite(nwrote);
         if (nwrote >= 0) {
             remaining = len - nwrote;
             if (remaining == 0 && writeCompleteCallback_) {
-                loop_->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
+                getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
             }
         } else {
             nwrote = 0;
@@ -116,11 +257,149 @@ void TcpConnection::sendInLoop(const void* message, size_t len) {
         size_t oldLen = outputBuffer_.readableBytes();
         size_t size = oldLen + remaining;
         if (size >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
-            loop_->queueInLoop([this, &size] { highWaterMarkCallback_(shared_from_this(), size); });
-            outputBuffer_.append(reinterpret_cast<const char*>(message) + nwrote, remaining);
-            if (!channel_->isWriting()) {
-                channel_->enableWriting();
+            getLoop()->queueInLoop([this, size] { highWaterMarkCallback_(shared_from_this(), size); });
+        }
+        outputBuffer_.append(reinterpret_cast<const char*>(message) + nwrote, remaining);
+        stats_.onOutputBuffer(outputBuffer_.readableBytes());
+        if (!channel_->isWriting()) {
+            channel_->enableWriting();
+        }
+    }
+}
+
+void TcpConnection::sendOutputBuffer() {
+    getLoop()->assertInLoopThread();
+    if (state_ == kDisconnected || outputBuffer_.readableBytes() == 0) {
+        return;
+    }
+    stats_.onSend();
+    stats_.onOutputBuffer(outputBuffer_.readableBytes());
+    if (channel_->isWriting()) {
+        return;  // handleWrite() picks it up
+    }
+    // with the channel not writing nothing was buffered before, but what a
+    // queued flush is waiting for
+    if (coalescing_) {
+        coalesce(0);
+    } else {
+        flushCoalescedWrites();
+    }
+}
+
+void TcpConnection::setWriteCoalescing(bool on, size_t maxPendingBytes, int64_t maxDelayUs) {
+    runInOwnerLoop([this, on, maxPendingBytes, maxDelayUs] {
+        coalescing_ = on;
+        maxCoalesceBytes_ = maxPendingBytes;
+        maxCoalesceDelayUs_ = maxDelayUs;
+        if (!on) {
+            flushCoalescedWrites();
+        }
+    });
+}
+
+void TcpConnection::coalesce(size_t oldLen) {
+    size_t size = outputBuffer_.readableBytes();
+    stats_.onOutputBuffer(size);
+    if (!flushQueued_) {
+        flushBase_ = oldLen;
+    }
+    if (size >= maxCoalesceBytes_ ||
+        (flushQueued_ &&
+         Timestamp::now().microSecondsSinceEpoch() - coalescingSince_ >= maxCoalesceDelayUs_)) {
+        flushCoalescedWrites();
+    } else if (!flushQueued_) {
+        flushQueued_ = true;
+        coalescingSince_ = Timestamp::now().microSecondsSinceEpoch();
+        getLoop()->runAtIterationEnd([ptr = shared_from_this()] {
+            // a migrated connection has flushed before leaving this loop
+            if (ptr->flushQueued_ && ptr->getLoop()->isInLoopThread()) {
+                ptr->flushCoalescedWrites();
             }
+        });
+    }
+}
+
+void TcpConnection::sendVectored(const struct iovec* iov, int iovcnt) {
+    getLoop()->assertInLoopThread();
+    if (state_ == kDisconnected) {
+        LOG(WARN) << "[TcpConnection::sendVectored] disconnected, give up writing";
+        return;
+    }
+    stats_.onSend();
+    size_t nwrote = 0;
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && iovcnt > 0) {
+        ssize_t n = sockets::writev(channel_->fd(), iov, std::min(iovcnt, IOV_MAX));
+        stats_.onWrite(n);
+        if (n >= 0) {
+            nwrote = static_cast<size_t>(n);
+        } else if (errno != EWOULDBLOCK) {
+            LOG_SYSERR << "[TcpConnection::sendVectored] ERROR";
+            if (errno == EPIPE || errno == ECONNRESET) {
+                return;
+            }
+        }
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    for (int i = 0; i < iovcnt; ++i) {
+        if (nwrote >= iov[i].iov_len) {
+            nwrote -= iov[i].iov_len;
+            continue;
+        }
+        outputBuffer_.append(static_cast<const char*>(iov[i].iov_base) + nwrote,
+                             iov[i].iov_len - nwrote);
+        nwrote = 0;
+    }
+    size_t size = outputBuffer_.readableBytes();
+    if (size == 0) {
+        if (writeCompleteCallback_) {
+            getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
+        }
+        return;
+    }
+    stats_.onOutputBuffer(size);
+    if (size >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+        getLoop()->queueInLoop([this, size] { highWaterMarkCallback_(shared_from_this(), size); });
+    }
+    if (!channel_->isWriting() && !flushQueued_) {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::flushCoalescedWrites() {
+    getLoop()->assertInLoopThread();
+    flushQueued_ = false;
+    size_t oldLen = flushBase_;
+    flushBase_ = 0;
+    if (state_ == kDisconnected || channel_->isWriting() || outputBuffer_.readableBytes() == 0) {
+        return;
+    }
+    ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
+    stats_.onWrite(n);
+    if (n >= 0) {
+        outputBuffer_.retrieve(n);
+    } else if (errno != EWOULDBLOCK) {
+        LOG_SYSERR << "[TcpConnection::flushCoalescedWrites] ERROR";
+        if (errno == EPIPE || errno == ECONNRESET) {
+            // nothing buffered can be delivered, close instead of waiting
+            // for a shutdown() that would never be carried out
+            outputBuffer_.retrieveAll();
+            forceClose();
+            return;
+        }
+    }
+    if (outputBuffer_.readableBytes() > 0) {
+        // handleWrite() retries, and runs a pending shutdown() when done
+        size_t size = outputBuffer_.readableBytes();
+        if (size >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+            getLoop()->queueInLoop([this, size] { highWaterMarkCallback_(shared_from_this(), size); });
+        }
+        channel_->enableWriting();
+    } else {
+        if (writeCompleteCallback_) {
+            getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
+        }
+        if (state_ == kDisconnecting) {
+            shutdownInLoop();
         }
     }
 }
@@ -128,34 +407,68 @@ void TcpConnection::sendInLoop(const void* message, size_t len) {
 void TcpConnection::shutdown() {
     if (state_ == kConnected) {
         setState(kDisconnecting);
-        loop_->runInLoop([this] { shutdownInLoop(); });
+        runInOwnerLoop([this] { shutdownInLoop(); });
     }
 }
 
 void TcpConnection::shutdownInLoop() {
-    loop_->assertInLoopThread();
-    if (!channel_->isWriting()) {
+    getLoop()->assertInLoopThread();
+    // a queued coalesced flush shuts down once it has written everything
+    if (!channel_->isWriting() && !flushQueued_ && !writeShutdown_) {
         socket_->shutdownWrite();
+        writeShutdown_ = true;
+        // queued, another channel's handler may have got here while this
+        // one still has events pending in the same poll round
+        if (peerShutdown_) {
+            forceClose();
+        }
+    }
+}
+
+void TcpConnection::drain() {
+    runInOwnerLoop([this] { drainInLoop(); });
+}
+
+void TcpConnection::drainInLoop() {
+    getLoop()->assertInLoopThread();
+    draining_ = true;
+    if (!reading_) {
+        startReadInLoop();
+    }
+    if (state_ == kConnected && pendingResponses_ == 0) {
+        setState(kDisconnecting);
+        shutdownInLoop();
+    }
+}
+
+void TcpConnection::beginResponse() { ++pendingResponses_; }
+
+void TcpConnection::endResponse() {
+    // queued behind a send() from the same thread
+    if (--pendingResponses_ == 0 && draining_) {
+        runInOwnerLoop([this] { drainInLoop(); });
     }
 }
 
 void TcpConnection::forceClose() {
     if (state_ == kConnected || state_ == kDisconnecting) {
         setState(kDisconnecting);
-        loop_->queueInLoop([ptr = shared_from_this()] { ptr->forceCloseInLoop(); });
+        getLoop()->queueInLoop([ptr = shared_from_this()] {
+            ptr->runInOwnerLoop([ptr] { ptr->forceCloseInLoop(); });
+        });
     }
 }
 
 void TcpConnection::forceCloseWithDelay(double seconds) {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (state_ == kConnected || state_ == kDisconnecting) {
         setState(kDisconnecting);
-        loop_->runAfter(seconds, makeWeakCallback(shared_from_this(), &TcpConnection::forceClose));
+        getLoop()->runAfter(seconds, makeWeakCallback(shared_from_this(), &TcpConnection::forceClose));
     }
 }
 
 void TcpConnection::forceCloseInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (state_ == kConnected || state_ == kDisconnecting) {
         handleClose();
     }
@@ -179,11 +492,11 @@ const char* TcpConnection::stateToString() const {
 void TcpConnection::setTcpNoDelay(bool on) { socket_->setTcpNoDelay(on); }
 
 void TcpConnection::startRead() {
-    loop_->runInLoop([this] { startReadInLoop(); });
+    runInOwnerLoop([this] { startReadInLoop(); });
 }
 
 void TcpConnection::startReadInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (!reading_ || !channel_->isReading()) {
         channel_->enableReading();
         reading_ = true;
@@ -191,11 +504,11 @@ void TcpConnection::startReadInLoop() {
 }
 
 void TcpConnection::stopRead() {
-    loop_->runInLoop([this] { stopReadInLoop(); });
+    runInOwnerLoop([this] { stopReadInLoop(); });
 }
 
 void TcpConnection::stopReadInLoop() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     if (reading_ || channel_->isReading()) {
         channel_->disableReading();
         reading_ = false;
@@ -203,7 +516,7 @@ void TcpConnection::stopReadInLoop() {
 }
 
 void TcpConnection::connectEstablished() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     assert(state_ == kConnecting);
     setState(kConnected);
     channel_->tie(shared_from_this());
@@ -213,8 +526,9 @@ void TcpConnection::connectEstablished() {
 }
 
 void TcpConnection::connectDestroyed() {
-    loop_->assertInLoopThread();
-    if (state_ == kConnected) {
+    getLoop()->assertInLoopThread();
+    // a connection shut down but not yet closed by the peer is still registered
+    if (state_ == kConnected || state_ == kDisconnecting) {
         setState(kDisconnected);
         channel_->disableAll();
         connectionCallback_(shared_from_this());
@@ -223,13 +537,35 @@ void TcpConnection::connectDestroyed() {
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime) {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     int err = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &err);
+    const bool external = static_cast<bool>(readHandler_);
+    ssize_t n = external ? readHandler_(channel_->fd(), &err)
+                         : inputBuffer_.readFd(channel_->fd(), &err);
+    if (n < 0 && external && (err == EAGAIN || err == EWOULDBLOCK)) {
+        return;
+    }
+    stats_.onRead(n);
     if (n > 0) {
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        if (receiveTime.microSecondsSinceEpoch() - lastRttSample_ >= kRttSampleIntervalUs) {
+            sampleRtt(receiveTime);
+        }
+        if (external) {
+            // the handler has consumed the data
+        } else if (draining_) {
+            inputBuffer_.retrieveAll();
+        } else {
+            Timestamp start(Timestamp::now());
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            stats_.onMessage(Timestamp::now().microSecondsSinceEpoch() -
+                             start.microSecondsSinceEpoch());
+        }
     } else if (n == 0) {
-        handleClose();
+        if (halfCloseCallback_ && !peerShutdown_) {
+            handlePeerShutdown();
+        } else {
+            handleClose();
+        }
     } else {
         errno = err;
         LOG_SYSERR << "[TcpConnection::handleRead] ERROR";
@@ -237,24 +573,158 @@ void TcpConnection::handleRead(Timestamp receiveTime) {
     }
 }
 
-void TcpConnection::handleWrite() {
-    loop_->assertInLoopThread();
+void TcpConnection::handlePeerShutdown() {
+    peerShutdown_ = true;
+    stopReadInLoop();
+    halfCloseCallback_(shared_from_this());
+    // both directions are done if this side has shut down already
+    if (state_ == kDisconnecting && writeShutdown_) {
+        handleClose();
+    }
+}
+
+void TcpConnection::sendPipe(int pipeFd, size_t bytes) {
+    getLoop()->assertInLoopThread();
+    assert(outputBuffer_.readableBytes() == 0 && !flushQueued_);
+    assert(pipeBytes_ == 0 || pipeFd == pipeFd_);
+    if (state_ == kDisconnected) {
+        LOG(WARN) << "[TcpConnection::sendPipe] disconnected, give up writing";
+        return;
+    }
+    stats_.onSend();
+    pipeFd_ = pipeFd;
+    pipeBytes_ += bytes;
+    if (channel_->isWriting() || !writePipe()) {
+        return;
+    }
+    if (pipeBytes_ > 0) {
+        channel_->enableWriting();
+    } else if (writeCompleteCallback_) {
+        getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
+    }
+}
+
+bool TcpConnection::writePipe() {
+    while (pipeBytes_ > 0) {
+        ssize_t n = sockets::splice(pipeFd_, channel_->fd(), pipeBytes_);
+        stats_.onWrite(n);
+        if (n > 0) {
+            pipeBytes_ -= n;
+        } else if (n < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            LOG_SYSERR << "[TcpConnection::writePipe] ERROR";
+            return false;
+        }
+    }
+    return true;
+}
+
+void TcpConnection::sendFile(int fd, int64_t offset, size_t count,
+                             std::shared_ptr<const void> owner) {
+    getLoop()->assertInLoopThread();
+    assert(fileBytes_ == 0 && pipeBytes_ == 0);
+    if (state_ == kDisconnected) {
+        LOG(WARN) << "[TcpConnection::sendFile] disconnected, give up writing";
+        return;
+    }
+    stats_.onSend();
+    fileFd_ = fd;
+    fileOffset_ = offset;
+    fileBytes_ = count;
+    fileOwner_ = std::move(owner);
     if (channel_->isWriting()) {
+        return;  // handleWrite() gets to the file after the buffer
+    }
+    // the header usually fits the socket buffer, then the file follows at once
+    if (outputBuffer_.readableBytes() > 0) {
         ssize_t n =
                 sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
+        stats_.onWrite(n);
         if (n > 0) {
             outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {
-                channel_->disableWriting();
-                if (writeCompleteCallback_) {
-                    loop_->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
-                }
-                if (state_ == kDisconnecting) {
-                    shutdownInLoop();
-                }
+        }
+    }
+    if (outputBuffer_.readableBytes() == 0) {
+        if (!writeFile()) {
+            forceClose();
+            return;
+        }
+        if (fileBytes_ == 0) {
+            if (writeCompleteCallback_) {
+                getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
             }
+            return;
+        }
+    }
+    channel_->enableWriting();
+}
+
+bool TcpConnection::writeFile() {
+    while (fileBytes_ > 0) {
+        ssize_t n = sockets::sendfile(channel_->fd(), fileFd_, &fileOffset_, fileBytes_);
+        stats_.onWrite(n);
+        if (n > 0) {
+            fileBytes_ -= n;
+        } else if (n < 0 && errno == EAGAIN) {
+            return true;
         } else {
-            LOG_SYSERR << "[TcpConnection::handleWrite] ERROR";
+            if (n == 0) {
+                LOG(ERROR) << "[TcpConnection::writeFile] file ended " << fileBytes_
+                           << " bytes early";
+            } else {
+                LOG_SYSERR << "[TcpConnection::writeFile] ERROR";
+            }
+            fileBytes_ = 0;
+            fileOwner_.reset();
+            return false;
+        }
+    }
+    fileOwner_.reset();
+    return true;
+}
+
+void TcpConnection::handleWrite() {
+    getLoop()->assertInLoopThread();
+    if (channel_->isWriting() && pipeBytes_ > 0) {
+        if (!writePipe()) {
+            // the peer is gone, its close or error event follows
+            channel_->disableWriting();
+        } else if (pipeBytes_ == 0) {
+            channel_->disableWriting();
+            if (writeCompleteCallback_) {
+                getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
+            }
+            if (state_ == kDisconnecting) {
+                shutdownInLoop();
+            }
+        }
+        return;
+    }
+    if (channel_->isWriting()) {
+        if (outputBuffer_.readableBytes() > 0) {
+            ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(),
+                                       outputBuffer_.readableBytes());
+            stats_.onWrite(n);
+            if (n <= 0) {
+                LOG_SYSERR << "[TcpConnection::handleWrite] ERROR";
+                return;
+            }
+            outputBuffer_.retrieve(n);
+        }
+        if (outputBuffer_.readableBytes() == 0 && fileBytes_ > 0 && !writeFile()) {
+            channel_->disableWriting();
+            forceClose();
+            return;
+        }
+        if (outputBuffer_.readableBytes() == 0 && fileBytes_ == 0) {
+            channel_->disableWriting();
+            if (writeCompleteCallback_) {
+                getLoop()->queueInLoop([this] { writeCompleteCallback_(shared_from_this()); });
+            }
+            if (state_ == kDisconnecting) {
+                shutdownInLoop();
+            }
         }
     } else {
         LOG(TRACE) << "[TcpConnection::handleWrite]" << "Connection fd = " << channel_->fd()
@@ -263,7 +733,7 @@ void TcpConnection::handleWrite() {
 }
 
 void TcpConnection::handleClose() {
-    loop_->assertInLoopThread();
+    getLoop()->assertInLoopThread();
     LOG(TRACE) << "[TcpConnection::handleClose]" << " fd = " << channel_->fd()
                << " state = " << stateToString();
     assert(state_ == kConnected || state_ == kDisconnecting);
@@ -277,7 +747,7 @@ void TcpConnection::handleClose() {
 
 void TcpConnection::handleError() {
     int err = sockets::getSocketError(channel_->fd());
-    LOG(ERROR) << "[TcpConnection::handleError] " << name_ << " - SO_ERROR = " << err << " "
+    LOG(ERROR) << "[TcpConnection::handleError] " << *this << " - SO_ERROR = " << err << " "
                << strerror_tl(err);
 }
 
@@ -1,6 +1,6 @@
 #include "TcpServer.h"
 
-#include <cstdio>
+#include <algorithm>
 
 #include "Acceptor.h"
 #include "EventLoop.h"
@@ -15,11 +15,16 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr, const std::
     : loop_(CHECK_NOTNULL(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(name),
+      connNamePrefix_(std::make_shared<const std::string>(name_ + "-" + ipPort_)),
       acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
       threadPool_(new EventLoopThreadPool(loop, name)),
       connectionCallback_(defaultConnectionCallback),
       messageCallback_(defaultMessageCallback),
-      nextConnId_(1) {
+      migratable_(true),
+      stopping_(false),
+      forcedClosed_(0),
+      rebalanceInterval_(0.0),
+      rebalanceThreshold_(0.0) {
     acceptor_->setNewConnectionCallback([this](auto&& _1, auto&& _2) {
         newConnection(std::forward<decltype(_1)>(_1), std::forward<decltype(_2)>(_2));
     });
@@ -28,10 +33,135 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr, const std::
 TcpServer::~TcpServer() {
     loop_->assertInLoopThread();
     LOG(TRACE) << "[TcpServer::~TcpServer] " << name_ << " destructing";
-    for (auto& item : connections_) {
-        TcpConnectionPtr conn(item.second);
-        item.second.reset();
+    loop_->cancel(rebalanceTimer_);
+    loop_->cancel(stopTimer_);  // destroyed while draining
+    connections_.releaseAll([](const TcpConnectionPtr& conn) {
         conn->getLoop()->runInLoop([conn] { conn->connectDestroyed(); });
+    });
+}
+
+std::size_t TcpServer::numConnections() const {
+    loop_->assertInLoopThread();
+    return connections_.size();
+}
+
+TcpConnectionPtr TcpServer::findConnection(ConnectionId id) const {
+    loop_->assertInLoopThread();
+    return connections_.find(id);
+}
+
+std::vector<TcpServer::StatsSnapshot> TcpServer::statsPerLoop() const {
+    loop_->assertInLoopThread();
+    std::vector<StatsSnapshot> result(closedStats_);
+    connections_.forEach([this, &result](const TcpConnectionPtr& conn) {
+        std::size_t index = loopIndexOf(conn->getLoop());
+        if (result.size() <= index) {
+            result.resize(index + 1);
+        }
+        result[index] += conn->stats().snapshot();
+    });
+    return result;
+}
+
+TcpServer::StatsSnapshot TcpServer::stats() const {
+    StatsSnapshot total;
+    for (const StatsSnapshot& s : statsPerLoop()) {
+        total += s;
+    }
+    return total;
+}
+
+std::vector<std::pair<ConnectionId, TcpServer::StatsSnapshot>> TcpServer::busiestConnections(
+        std::size_t n) const {
+    loop_->assertInLoopThread();
+    std::vector<std::pair<ConnectionId, StatsSnapshot>> result;
+    result.reserve(connections_.size());
+    connections_.forEach([&result](const TcpConnectionPtr& conn) {
+        result.emplace_back(conn->id(), conn->stats().snapshot());
+    });
+    auto busier = [](const auto& lhs, const auto& rhs) {
+        return lhs.second.totalBytes() > rhs.second.totalBytes();
+    };
+    if (result.size() > n) {
+        std::partial_sort(result.begin(), result.begin() + n, result.end(), busier);
+        result.resize(n);
+    } else {
+        std::sort(result.begin(), result.end(), busier);
+    }
+    return result;
+}
+
+std::size_t TcpServer::loopIndexOf(EventLoop* ioLoop) const {
+    // connections may have migrated, so the loop index in the id is stale
+    auto it = loopIndex_.find(ioLoop);
+    return it != loopIndex_.end() ? it->second : loops_.size();
+}
+
+void TcpServer::enableRebalancing(double intervalSeconds, double busyThreshold) {
+    if (!migratable_) {
+        LOG_ERROR << "[TcpServer::enableRebalancing] " << name_
+                  << " keeps per-loop state, connections must not migrate";
+        return;
+    }
+    loop_->runInLoop([this, intervalSeconds, busyThreshold] {
+        loop_->cancel(rebalanceTimer_);
+        rebalanceInterval_ = intervalSeconds;
+        rebalanceThreshold_ = busyThreshold;
+        rebalanceTimer_ = loop_->runEvery(intervalSeconds, [this] { rebalance(); });
+    });
+}
+
+void TcpServer::rebalance() {
+    loop_->assertInLoopThread();
+    const std::vector<EventLoop*>& loops = loops_;
+    if (loops.size() < 2 || stopping_) {
+        return;
+    }
+    lastLoopBusy_.resize(loops.size(), 0);
+    std::vector<int64_t> busy(loops.size());
+    for (std::size_t i = 0; i < loops.size(); ++i) {
+        int64_t total = loops[i]->busyMicroSeconds();
+        busy[i] = total - lastLoopBusy_[i];
+        lastLoopBusy_[i] = total;
+    }
+
+    std::unordered_map<ConnectionId, uint64_t> callbackTime;
+    callbackTime.reserve(connections_.size());
+    connections_.forEach([&callbackTime](const TcpConnectionPtr& conn) {
+        callbackTime[conn->id()] = conn->stats().snapshot().callbackMicroSeconds;
+    });
+    lastCallbackTime_.swap(callbackTime);
+    std::unordered_map<ConnectionId, uint64_t>& previous = callbackTime;
+
+    std::size_t hot = std::max_element(busy.begin(), busy.end()) - busy.begin();
+    std::size_t cold = std::min_element(busy.begin(), busy.end()) - busy.begin();
+    double intervalUs = rebalanceInterval_ * Timestamp::kMicroSecondsPerSecond;
+    if (busy[hot] < rebalanceThreshold_ * intervalUs || busy[hot] < 2 * busy[cold]) {
+        return;
+    }
+
+    uint64_t halfGap = static_cast<uint64_t>(busy[hot] - busy[cold]) / 2;
+    TcpConnectionPtr candidate;
+    uint64_t candidateLoad = 0;
+    connections_.forEach([&](const TcpConnectionPtr& conn) {
+        if (conn->getLoop() != loops[hot] || !conn->connected()) {
+            return;
+        }
+        uint64_t load = lastCallbackTime_[conn->id()];
+        auto it = previous.find(conn->id());
+        if (it != previous.end()) {
+            load -= it->second;
+        }
+        if (load <= halfGap && load > candidateLoad) {
+            candidate = conn;
+            candidateLoad = load;
+        }
+    });
+    if (candidate) {
+        LOG(INFO) << "[TcpServer::rebalance] " << name_ << " moving " << *candidate
+                  << " (" << candidateLoad << "us) from loop " << hot << " (" << busy[hot]
+                  << "us) to loop " << cold << " (" << busy[cold] << "us)";
+        candidate->migrate(loops[cold]);
     }
 }
 
@@ -40,27 +170,88 @@ void TcpServer::setThreadNum(int numThreads) {
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setFastOpen(int queueLength) {
+    assert(acceptor_ && !acceptor_->listenning());
+    if (!acceptor_) {
+        return;  // stopped
+    }
+    acceptor_->setFastOpen(queueLength);
+}
+
 void TcpServer::start() {
     started_ = 1;
     threadPool_->start(threadInitCallback_);
+    loops_ = threadPool_->getAllLoops();
+    for (std::size_t i = 0; i < loops_.size(); ++i) {
+        loopIndex_[loops_[i]] = i;
+    }
 
-    assert(!acceptor_->listenning());
+    assert(acceptor_ && !acceptor_->listenning());
     loop_->runInLoop([ptr = acceptor_.get()] { ptr->listen(); });
 }
 
+void TcpServer::stop(double timeoutSeconds, StopCallback cb) {
+    loop_->runInLoop([this, timeoutSeconds, cb = std::move(cb)]() mutable {
+        stopInLoop(timeoutSeconds, std::move(cb));
+    });
+}
+
+void TcpServer::stopInLoop(double timeoutSeconds, StopCallback cb) {
+    loop_->assertInLoopThread();
+    if (stopping_) {
+        LOG(WARN) << "[TcpServer::stopInLoop] " << name_ << " is already stopping";
+        return;
+    }
+    stopping_ = true;
+    stopCallback_ = std::move(cb);
+    loop_->cancel(rebalanceTimer_);
+    // Closes the listening socket, so SO_REUSEPORT peers take over new SYNs.
+    // Not right here: stop() may be called back from the Acceptor's own event.
+    std::shared_ptr<Acceptor> acceptor(acceptor_.release());
+    loop_->queueInLoop([acceptor] {});
+    LOG(INFO) << "[TcpServer::stopInLoop] " << name_ << " draining " << connections_.size()
+              << " connections within " << timeoutSeconds << "s";
+    connections_.forEach([](const TcpConnectionPtr& conn) { conn->drain(); });
+    if (connections_.empty()) {
+        reportStopProgress();
+    } else {
+        stopTimer_ = loop_->runAfter(timeoutSeconds, [this] { forceCloseRemaining(); });
+    }
+}
+
+void TcpServer::forceCloseRemaining() {
+    loop_->assertInLoopThread();
+    stopTimer_ = TimerId();
+    LOG(WARN) << "[TcpServer::forceCloseRemaining] " << name_ << " force closing "
+              << connections_.size() << " connections";
+    forcedClosed_ += connections_.size();
+    connections_.forEach([](const TcpConnectionPtr& conn) { conn->forceClose(); });
+}
+
+void TcpServer::reportStopProgress() {
+    std::size_t remaining = connections_.size();
+    if (remaining == 0) {
+        loop_->cancel(stopTimer_);
+        LOG(INFO) << "[TcpServer::reportStopProgress] " << name_ << " stopped, "
+                  << forcedClosed_ << " connections force closed";
+    }
+    if (stopCallback_) {
+        stopCallback_(remaining, forcedClosed_);
+    }
+}
+
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
     loop_->assertInLoopThread();
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    char buf[64];
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+    int loopIndex = 0;
+    EventLoop* ioLoop = threadPool_->getNextLoop(&loopIndex);
+    ConnectionId id = connections_.allocate(loopIndex);
 
-    LOG(INFO) << "[TcpServer::newConnection] " << name_ << " - new connection " << connName
-              << " from " << peerAddr.toIpPort();
     InetAddress localAddr(sockets::getLocalAddr(sockfd));
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    connections_[connName] = conn;
+    TcpConnectionPtr conn(
+            new TcpConnection(ioLoop, id, connNamePrefix_, sockfd, localAddr, peerAddr));
+    LOG(INFO) << "[TcpServer::newConnection] " << name_ << " - new connection " << *conn
+              << " from " << peerAddr.toIpPort();
+    connections_.attach(id, conn);
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
@@ -75,11 +266,20 @@ void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
     loop_->assertInLoopThread();
     LOG(INFO) << "[TcpServer::removeConnectionInLoop] " << name_ << " - connection "
-              << conn->name();
-    size_t n = connections_.erase(conn->name());
-    assert(n == 1);
+              << *conn;
+    bool removed = connections_.remove(conn->id());
+    assert(removed);
+    (void)removed;
+    std::size_t index = loopIndexOf(conn->getLoop());
+    if (closedStats_.size() <= index) {
+        closedStats_.resize(index + 1);
+    }
+    closedStats_[index] += conn->stats().snapshot();
     EventLoop* ioLoop = conn->getLoop();
     ioLoop->queueInLoop([conn] { conn->connectDestroyed(); });
+    if (stopping_) {
+        reportStopProgress();
+    }
 }
 
 }  // namespace dws::net
@@ -0,0 +1,67 @@
+#include "UdpServer.h"
+
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name)
+    : UdpServer(loop, listenAddr, name, UdpSocket::Options()) {}
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+                     const UdpSocket::Options& options)
+    : loop_(CHECK_NOTNULL(loop)),
+      listenAddr_(listenAddr),
+      name_(name),
+      options_(options),
+      threadPool_(new EventLoopThreadPool(loop, name)),
+      started_(false) {}
+
+UdpServer::~UdpServer() {
+    loop_->assertInLoopThread();
+    LOG(TRACE) << "[UdpServer::~UdpServer] " << name_ << " destructing";
+    // each socket goes away in its own loop
+    for (UdpSocketPtr& socket : sockets_) {
+        EventLoop* ioLoop = socket->getLoop();
+        ioLoop->runInLoop([socket = std::move(socket)]() mutable { socket.reset(); });
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads) {
+    assert(numThreads >= 0);
+    threadPool_->setThreadNum(numThreads);
+    if (numThreads > 0) {
+        options_.reusePort = true;
+    }
+}
+
+void UdpServer::start() {
+    loop_->assertInLoopThread();
+    assert(!started_);
+    started_ = true;
+    threadPool_->start(threadInitCallback_);
+    for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+        auto socket = std::make_shared<UdpSocket>(ioLoop, listenAddr_, options_);
+        socket->setMessageCallback(messageCallback_);
+        sockets_.push_back(socket);
+        ioLoop->runInLoop([socket] { socket->start(); });
+    }
+    LOG(INFO) << "[UdpServer::start] " << name_ << " on " << listenAddr_.toIpPort() << " with "
+              << sockets_.size() << " sockets";
+}
+
+UdpSocket::Stats UdpServer::stats() const {
+    UdpSocket::Stats total;
+    for (const UdpSocketPtr& socket : sockets_) {
+        UdpSocket::Stats stats = socket->stats();
+        total.packetsReceived += stats.packetsReceived;
+        total.receiveCalls += stats.receiveCalls;
+        total.packetsSent += stats.packetsSent;
+        total.sendCalls += stats.sendCalls;
+        total.dropped += stats.dropped;
+    }
+    return total;
+}
+
+}  // namespace dws::net
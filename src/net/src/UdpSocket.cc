@@ -0,0 +1,309 @@
+#include "UdpSocket.h"
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "EventLoop.h"
+#include "Logging.h"
+#include "SocketsOps.h"
+#include "WeakCallback.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+namespace dws::net {
+
+const int UdpSocket::kMaxGsoSegments = 64;
+const std::size_t UdpSocket::kMaxGsoBytes = 65000;
+const int UdpSocket::kMaxReadRounds = 16;
+
+namespace {
+
+const std::size_t kGroSlotBytes = 65536;
+const std::size_t kMaxUdpPayload = 65507;
+// room for one UDP_GRO / UDP_SEGMENT control message
+const std::size_t kControlBytes = CMSG_SPACE(sizeof(int));
+
+bool samePeer(const InetAddress& a, const InetAddress& b) {
+    return a.family() == b.family() &&
+           memcmp(a.getSockAddr(), b.getSockAddr(), a.length()) == 0;
+}
+
+// The segment size of a GRO train, 0 if the datagram came alone.
+std::size_t groSegmentSize(struct msghdr* msg) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size = 0;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof size);
+            return size > 0 ? static_cast<std::size_t>(size) : 0;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+UdpSocket::UdpSocket(EventLoop* loop, const InetAddress& bindAddr)
+    : UdpSocket(loop, bindAddr, Options()) {}
+
+UdpSocket::UdpSocket(EventLoop* loop, const InetAddress& bindAddr, const Options& options)
+    : loop_(loop),
+      socket_(sockets::createUdpNonblockingOrDie(bindAddr.family())),
+      channel_(loop, socket_.fd()),
+      options_(options),
+      gro_(false),
+      gso_(options.gso),
+      slotBytes_(options.gro ? kGroSlotBytes : options.maxDatagramBytes),
+      receiveBuffer_(slotBytes_ * static_cast<std::size_t>(options.batchSize)),
+      receiveControl_(kControlBytes * static_cast<std::size_t>(options.batchSize)),
+      receiveAddrs_(static_cast<std::size_t>(options.batchSize)),
+      receiveIovs_(static_cast<std::size_t>(options.batchSize)),
+      receiveMsgs_(static_cast<std::size_t>(options.batchSize)),
+      sent_(0),
+      sendControl_(kControlBytes * static_cast<std::size_t>(options.batchSize)),
+      sendIovs_(static_cast<std::size_t>(options.batchSize)),
+      sendMsgs_(static_cast<std::size_t>(options.batchSize)),
+      flushQueued_(false),
+      packetsReceived_(0),
+      receiveCalls_(0),
+      packetsSent_(0),
+      sendCalls_(0),
+      dropped_(0) {
+    assert(options_.batchSize > 0);
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(options_.reusePort);
+    if (options_.receiveBufferBytes > 0) {
+        int size = options_.receiveBufferBytes;
+        if (::setsockopt(socket_.fd(), SOL_SOCKET, SO_RCVBUF, &size,
+                         static_cast<socklen_t>(sizeof size)) < 0) {
+            LOG_SYSERR << "[UdpSocket::UdpSocket] SO_RCVBUF";
+        }
+    }
+    if (options_.gro) {
+        int on = 1;
+        gro_ = ::setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &on,
+                            static_cast<socklen_t>(sizeof on)) == 0;
+        if (!gro_) {
+            LOG(WARN) << "[UdpSocket::UdpSocket] UDP_GRO unavailable: " << strerror_tl(errno);
+        }
+    }
+    socket_.bindAddress(bindAddr);
+    for (int i = 0; i < options_.batchSize; ++i) {
+        receiveIovs_[i].iov_base = &receiveBuffer_[slotBytes_ * static_cast<std::size_t>(i)];
+        struct msghdr& hdr = receiveMsgs_[i].msg_hdr;
+        hdr.msg_name = &receiveAddrs_[i];
+        hdr.msg_iov = &receiveIovs_[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = &receiveControl_[kControlBytes * static_cast<std::size_t>(i)];
+    }
+    channel_.setReadCallback([this](Timestamp receiveTime) { handleRead(receiveTime); });
+    channel_.setWriteCallback([this] { handleWrite(); });
+}
+
+UdpSocket::~UdpSocket() {
+    channel_.disableAll();
+    channel_.remove();
+}
+
+InetAddress UdpSocket::localAddress() const {
+    return InetAddress(sockets::getLocalAddr(socket_.fd()));
+}
+
+void UdpSocket::start() {
+    loop_->assertInLoopThread();
+    channel_.tie(shared_from_this());
+    channel_.enableReading();
+}
+
+UdpSocket::Stats UdpSocket::stats() const {
+    Stats stats;
+    stats.packetsReceived = packetsReceived_.load(std::memory_order_relaxed);
+    stats.receiveCalls = receiveCalls_.load(std::memory_order_relaxed);
+    stats.packetsSent = packetsSent_.load(std::memory_order_relaxed);
+    stats.sendCalls = sendCalls_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime) {
+    loop_->assertInLoopThread();
+    UdpSocketPtr self(shared_from_this());
+    const unsigned batch = static_cast<unsigned>(options_.batchSize);
+    // bounded so that one busy socket cannot starve the rest of the loop
+    for (int round = 0; round < kMaxReadRounds; ++round) {
+        for (unsigned i = 0; i < batch; ++i) {
+            receiveIovs_[i].iov_len = slotBytes_;
+            struct msghdr& hdr = receiveMsgs_[i].msg_hdr;
+            hdr.msg_namelen = static_cast<socklen_t>(sizeof(struct sockaddr_in6));
+            hdr.msg_controllen = gro_ ? kControlBytes : 0;
+            hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(socket_.fd(), receiveMsgs_.data(), batch, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_SYSERR << "[UdpSocket::handleRead] recvmmsg";
+            }
+            break;
+        }
+        receiveCalls_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t received = 0;
+        uint64_t dropped = 0;
+        for (int i = 0; i < n; ++i) {
+            struct msghdr& hdr = receiveMsgs_[i].msg_hdr;
+            std::size_t len = receiveMsgs_[i].msg_len;
+            std::size_t segmentSize = gro_ ? groSegmentSize(&hdr) : 0;
+            if ((hdr.msg_flags & MSG_TRUNC) ||
+                (segmentSize == 0 && len > options_.maxDatagramBytes)) {
+                ++dropped;
+                continue;
+            }
+            if (segmentSize == 0) {
+                segmentSize = std::max<std::size_t>(len, 1);
+            }
+            const char* data = static_cast<const char*>(receiveIovs_[i].iov_base);
+            InetAddress peer(receiveAddrs_[i]);
+            std::size_t offset = 0;
+            do {
+                std::size_t segment = std::min(segmentSize, len - offset);
+                ++received;
+                if (messageCallback_) {
+                    messageCallback_(self, data + offset, segment, peer, receiveTime);
+                }
+                offset += segment;
+            } while (offset < len);
+        }
+        packetsReceived_.fetch_add(received, std::memory_order_relaxed);
+        if (dropped > 0) {
+            dropped_.fetch_add(dropped, std::memory_order_relaxed);
+        }
+        if (static_cast<unsigned>(n) < batch) {
+            break;
+        }
+    }
+}
+
+bool UdpSocket::send(const InetAddress& peer, const void* data, std::size_t len) {
+    loop_->assertInLoopThread();
+    if (len > kMaxUdpPayload || sendBuffer_.size() + len > options_.maxPendingBytes) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (pending_.size() - sent_ >= static_cast<std::size_t>(options_.batchSize)) {
+        flush();
+    }
+    std::size_t offset = sendBuffer_.size();
+    const char* bytes = static_cast<const char*>(data);
+    sendBuffer_.insert(sendBuffer_.end(), bytes, bytes + len);
+    if (gso_ && pending_.size() > sent_) {
+        Pending& last = pending_.back();
+        if (last.segmentSize == len && last.segments < kMaxGsoSegments &&
+            last.length + len <= kMaxGsoBytes && samePeer(last.peer, peer)) {
+            last.length += len;
+            ++last.segments;
+            return true;
+        }
+    }
+    pending_.push_back(Pending{peer, offset, len, len, 1});
+    if (!flushQueued_) {
+        flushQueued_ = true;
+        loop_->queueInLoop(makeWeakCallback(shared_from_this(), &UdpSocket::flush));
+    }
+    return true;
+}
+
+void UdpSocket::flush() {
+    loop_->assertInLoopThread();
+    flushQueued_ = false;
+    if (channel_.isWriting()) {
+        return;  // handleWrite() will go on
+    }
+    while (sent_ < pending_.size()) {
+        std::size_t count =
+                std::min(pending_.size() - sent_, static_cast<std::size_t>(options_.batchSize));
+        for (std::size_t i = 0; i < count; ++i) {
+            Pending& p = pending_[sent_ + i];
+            sendIovs_[i].iov_base = &sendBuffer_[p.offset];
+            sendIovs_[i].iov_len = p.length;
+            struct msghdr& hdr = sendMsgs_[i].msg_hdr;
+            memset(&hdr, 0, sizeof hdr);
+            hdr.msg_name = const_cast<struct sockaddr*>(p.peer.getSockAddr());
+            hdr.msg_namelen = p.peer.length();
+            hdr.msg_iov = &sendIovs_[i];
+            hdr.msg_iovlen = 1;
+            if (p.segments > 1) {
+                hdr.msg_control = &sendControl_[kControlBytes * i];
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = static_cast<uint16_t>(p.segmentSize);
+                memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+            }
+        }
+        int n = ::sendmmsg(socket_.fd(), sendMsgs_.data(), static_cast<unsigned>(count), 0);
+        if (n > 0) {
+            sendCalls_.fetch_add(1, std::memory_order_relaxed);
+            uint64_t packets = 0;
+            for (int i = 0; i < n; ++i) {
+                packets += static_cast<uint64_t>(pending_[sent_ + i].segments);
+            }
+            packetsSent_.fetch_add(packets, std::memory_order_relaxed);
+            sent_ += static_cast<std::size_t>(n);
+            continue;
+        }
+        int savedErrno = n < 0 ? errno : EAGAIN;
+        if (savedErrno == EINTR) {
+            continue;
+        }
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK || savedErrno == ENOBUFS) {
+            channel_.enableWriting();
+            return;
+        }
+        Pending& first = pending_[sent_];
+        if (first.segments > 1 && (savedErrno == EIO || savedErrno == EINVAL)) {
+            // e.g. no GSO on the outgoing device
+            LOG(WARN) << "[UdpSocket::flush] UDP GSO failed, disabled: " << strerror_tl(savedErrno);
+            gso_ = false;
+            splitGsoBatches();
+            continue;
+        }
+        // ICMP errors such as ECONNREFUSED belong to an earlier datagram,
+        // only the first one is given up for
+        LOG(DEBUG) << "[UdpSocket::flush] to " << first.peer.toIpPort() << ": "
+                   << strerror_tl(savedErrno);
+        dropped_.fetch_add(static_cast<uint64_t>(first.segments), std::memory_order_relaxed);
+        ++sent_;
+    }
+    pending_.clear();
+    sendBuffer_.clear();
+    sent_ = 0;
+}
+
+void UdpSocket::handleWrite() {
+    loop_->assertInLoopThread();
+    channel_.disableWriting();
+    flush();
+}
+
+void UdpSocket::splitGsoBatches() {
+    std::vector<Pending> split(pending_.begin(), pending_.begin() + static_cast<long>(sent_));
+    for (std::size_t i = sent_; i < pending_.size(); ++i) {
+        const Pending& p = pending_[i];
+        for (int s = 0; s < p.segments; ++s) {
+            std::size_t offset = p.offset + p.segmentSize * static_cast<std::size_t>(s);
+            std::size_t length = std::min(p.segmentSize, p.offset + p.length - offset);
+            split.push_back(Pending{p.peer, offset, length, length, 1});
+        }
+    }
+    pending_.swap(split);
+}
+
+}  // namespace dws::net
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "noncopyable.h"
+
+namespace dws::net {
+
+class Connector;
+class EventLoop;
+
+/// The upstream servers of a TcpProxy with backend selection and health
+/// checks.
+///
+/// Every backend is probed with a TCP connect on the loop's TimerQueue;
+/// it is taken out of rotation after Options::unhealthyThreshold failed
+/// probes in a row and put back after Options::healthyThreshold successful
+/// ones.  Failed proxy connects count as failed probes.  acquire() and
+/// release() may be called from any thread, the probes run in the loop
+/// given to the constructor.  Destroy the pool in that loop's thread, after
+/// the proxies using it.
+class BackendPool : noncopyable {
+ public:
+    enum Policy { kRoundRobin, kLeastConnections };
+
+    struct Options {
+        Policy policy = kRoundRobin;
+        /// 0 disables the health checks, every backend stays healthy.
+        double healthCheckIntervalSeconds = 2.0;
+        double healthCheckTimeoutSeconds = 1.0;
+        int unhealthyThreshold = 2;
+        int healthyThreshold = 2;
+    };
+
+    BackendPool(EventLoop* loop, const std::vector<InetAddress>& backends);
+    BackendPool(EventLoop* loop, const std::vector<InetAddress>& backends, const Options& options);
+    ~BackendPool();
+
+    /// Starts the health checks.  Loop thread only.
+    void start();
+
+    /// Picks a healthy backend by the policy and counts a connection to it,
+    /// -1 if none is healthy.
+    int acquire();
+    void release(int index);
+    /// A connect to the backend failed, counted like a failed probe.
+    void reportFailure(int index);
+
+    std::size_t size() const { return backends_.size(); }
+    const InetAddress& address(int index) const { return backends_[index]->address; }
+    bool healthy(int index) const { return backends_[index]->healthy.load(); }
+    int activeConnections(int index) const { return backends_[index]->active.load(); }
+
+ private:
+    struct Backend {
+        explicit Backend(const InetAddress& addr) : address(addr) {}
+
+        const InetAddress address;
+        std::atomic<bool> healthy{true};
+        std::atomic<int> active{0};
+        // loop thread only
+        int failures = 0;
+        int successes = 0;
+        std::shared_ptr<Connector> probe;
+        TimerId probeTimer;
+    };
+
+    void checkAll();
+    void probe(int index);
+    void onProbeResult(int index, bool ok);
+    void stopProbe(Backend* backend);
+
+    EventLoop* loop_;
+    const Options options_;
+    std::vector<std::unique_ptr<Backend>> backends_;
+    std::atomic<unsigned> next_;
+    TimerId checkTimer_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "BackendPool.h"
+#include "TcpServer.h"
+
+namespace dws::net {
+
+/// Layer 4 reverse proxy relaying every accepted connection to a backend
+/// picked by a BackendPool.
+///
+/// Each client connection is paired with an upstream connection opened in
+/// the same IO loop, reading from the client is held until it is up.  A
+/// failed or timed out connect is reported to the pool and tried on another
+/// backend.  Bytes are relayed with splice(2) through a pipe per direction
+/// so that payloads never enter user space; a direction falls back to
+/// copying through the connections' Buffers if pipes cannot be created or
+/// splice() is refused.  Reading from one side stops while the other still
+/// has relayed bytes to write.  A FIN is passed on as a shutdown of the
+/// other side once everything before it is written, so half-closed
+/// connections keep working in the other direction; a reset closes both.
+class TcpProxy : noncopyable {
+ public:
+    static const int kMaxConnectAttempts = 3;
+    /// Bytes a direction copies ahead of the slower side in Buffer mode.
+    static const std::size_t kMaxPendingOutput = 1024 * 1024;
+
+    TcpProxy(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+             BackendPool* backends, TcpServer::Option option = TcpServer::kNoReusePort);
+    ~TcpProxy();
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+    TcpServer* tcpServer() { return &server_; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    /// On by default.  Before start().
+    void setSplice(bool on) { splice_ = on; }
+    /// 3 seconds by default.  Before start().
+    void setConnectTimeout(double seconds) { connectTimeoutSeconds_ = seconds; }
+    void start();
+
+    /// Client connections being relayed or connecting, thread safe.
+    std::size_t numSessions() const { return sessions_.load(std::memory_order_relaxed); }
+    /// Directions that relayed with splice(2) and through Buffers so far,
+    /// thread safe.
+    uint64_t splicedDirections() const { return spliced_.load(std::memory_order_relaxed); }
+    uint64_t copiedDirections() const { return copied_.load(std::memory_order_relaxed); }
+
+ private:
+    struct Session;
+    using SessionPtr = std::shared_ptr<Session>;
+
+    void onConnection(const TcpConnectionPtr& conn);
+    void connectUpstream(const SessionPtr& session);
+    void onUpstreamConnected(const SessionPtr& session, int sockfd);
+    void onUpstreamFailed(const SessionPtr& session, int savedErrno);
+    void startRelay(const SessionPtr& session);
+    /// The read handler of @c from in splice mode.
+    ssize_t spliceIn(const SessionPtr& session, bool fromClient, int sockfd, int* savedErrno);
+    void onMessage(const SessionPtr& session, bool fromClient, Buffer* buf);
+    void onWriteComplete(const SessionPtr& session, bool toClient);
+    void onHalfClose(const SessionPtr& session, bool client);
+    void onClose(const SessionPtr& session, bool client);
+    void stopConnecting(Session* session);
+
+    TcpServer server_;
+    BackendPool* backends_;
+    bool splice_;
+    double connectTimeoutSeconds_;
+    std::atomic<std::size_t> sessions_;
+    std::atomic<uint64_t> spliced_;
+    std::atomic<uint64_t> copied_;
+};
+
+}  // namespace dws::net
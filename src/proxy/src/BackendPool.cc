@@ -0,0 +1,134 @@
+#include "BackendPool.h"
+
+#include <cassert>
+#include <limits>
+
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logging.h"
+#include "SocketsOps.h"
+
+namespace dws::net {
+
+BackendPool::BackendPool(EventLoop* loop, const std::vector<InetAddress>& backends)
+    : BackendPool(loop, backends, Options()) {}
+
+BackendPool::BackendPool(EventLoop* loop, const std::vector<InetAddress>& backends,
+                         const Options& options)
+    : loop_(CHECK_NOTNULL(loop)), options_(options), next_(0) {
+    assert(!backends.empty());
+    for (const InetAddress& addr : backends) {
+        backends_.push_back(std::make_unique<Backend>(addr));
+    }
+}
+
+BackendPool::~BackendPool() {
+    loop_->assertInLoopThread();
+    loop_->cancel(checkTimer_);
+    for (auto& backend : backends_) {
+        stopProbe(backend.get());
+    }
+}
+
+void BackendPool::start() {
+    loop_->assertInLoopThread();
+    if (options_.healthCheckIntervalSeconds > 0) {
+        checkTimer_ = loop_->runEvery(options_.healthCheckIntervalSeconds, [this] { checkAll(); });
+    }
+}
+
+int BackendPool::acquire() {
+    const int n = static_cast<int>(backends_.size());
+    // rotating the start spreads ties of least connections as well
+    const int start = static_cast<int>(next_.fetch_add(1, std::memory_order_relaxed) % n);
+    int chosen = -1;
+    int fewest = std::numeric_limits<int>::max();
+    for (int i = 0; i < n; ++i) {
+        int index = (start + i) % n;
+        Backend* backend = backends_[index].get();
+        if (!backend->healthy.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        if (options_.policy == kRoundRobin) {
+            chosen = index;
+            break;
+        }
+        int active = backend->active.load(std::memory_order_relaxed);
+        if (active < fewest) {
+            fewest = active;
+            chosen = index;
+        }
+    }
+    if (chosen >= 0) {
+        backends_[chosen]->active.fetch_add(1, std::memory_order_relaxed);
+    }
+    return chosen;
+}
+
+void BackendPool::release(int index) {
+    backends_[index]->active.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void BackendPool::reportFailure(int index) {
+    loop_->runInLoop([this, index] { onProbeResult(index, false); });
+}
+
+void BackendPool::checkAll() {
+    for (int i = 0; i < static_cast<int>(backends_.size()); ++i) {
+        // a probe still running from the last round is left to its timeout
+        if (!backends_[i]->probe) {
+            probe(i);
+        }
+    }
+}
+
+void BackendPool::probe(int index) {
+    Backend* backend = backends_[index].get();
+    backend->probe = std::make_shared<Connector>(loop_, backend->address);
+    backend->probe->setNewConnectionCallback([this, index](int sockfd) {
+        sockets::close(sockfd);
+        stopProbe(backends_[index].get());
+        onProbeResult(index, true);
+    });
+    backend->probe->setErrorCallback([this, index](int) {
+        stopProbe(backends_[index].get());
+        onProbeResult(index, false);
+    });
+    backend->probeTimer = loop_->runAfter(options_.healthCheckTimeoutSeconds, [this, index] {
+        stopProbe(backends_[index].get());
+        onProbeResult(index, false);
+    });
+    backend->probe->start();
+}
+
+void BackendPool::onProbeResult(int index, bool ok) {
+    loop_->assertInLoopThread();
+    Backend* backend = backends_[index].get();
+    if (ok) {
+        backend->failures = 0;
+        if (!backend->healthy && ++backend->successes >= options_.healthyThreshold) {
+            LOG(INFO) << "[BackendPool::onProbeResult] " << backend->address.toIpPort()
+                      << " is healthy";
+            backend->healthy = true;
+        }
+    } else {
+        backend->successes = 0;
+        if (backend->healthy && ++backend->failures >= options_.unhealthyThreshold) {
+            LOG(WARN) << "[BackendPool::onProbeResult] " << backend->address.toIpPort()
+                      << " is unhealthy";
+            backend->healthy = false;
+        }
+    }
+}
+
+void BackendPool::stopProbe(Backend* backend) {
+    if (backend->probe) {
+        loop_->cancel(backend->probeTimer);
+        // stop() finishes in a queued functor that needs the connector
+        backend->probe->stop();
+        loop_->queueInLoop([probe = backend->probe] {});
+        backend->probe.reset();
+    }
+}
+
+}  // namespace dws::net
@@ -0,0 +1,341 @@
+#include "TcpProxy.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logging.h"
+#include "SocketsOps.h"
+
+namespace dws::net {
+
+namespace {
+
+// a bigger pipe moves more per splice() than the default 64 KiB
+const int kPipeCapacity = 256 * 1024;
+
+class Pipe : noncopyable {
+ public:
+    Pipe() : capacity_(0) {
+        if (::pipe2(fds_, O_NONBLOCK | O_CLOEXEC) < 0) {
+            LOG_SYSERR << "[Pipe::Pipe] pipe2";
+            fds_[0] = fds_[1] = -1;
+            return;
+        }
+        // unprivileged processes may be limited below kPipeCapacity, keep the default then
+        ::fcntl(fds_[1], F_SETPIPE_SZ, kPipeCapacity);
+        capacity_ = ::fcntl(fds_[1], F_GETPIPE_SZ);
+    }
+    ~Pipe() {
+        if (valid()) {
+            sockets::close(fds_[0]);
+            sockets::close(fds_[1]);
+        }
+    }
+
+    bool valid() const { return fds_[0] >= 0 && capacity_ > 0; }
+    int readFd() const { return fds_[0]; }
+    int writeFd() const { return fds_[1]; }
+    std::size_t capacity() const { return static_cast<std::size_t>(capacity_); }
+
+ private:
+    int fds_[2];
+    int capacity_;
+};
+
+}  // namespace
+
+struct TcpProxy::Session {
+    TcpConnectionPtr client;
+    TcpConnectionPtr upstream;
+    std::shared_ptr<Connector> connector;  // while connecting
+    TimerId connectTimer;
+    int backend = -1;  // counted in the pool while >= 0
+    int attempts = 0;
+    bool clientEof = false;  // FIN received from the client
+    bool upstreamEof = false;
+    bool clientClosed = false;
+    bool upstreamClosed = false;
+    std::unique_ptr<Pipe> toUpstream;  // splice mode only
+    std::unique_ptr<Pipe> toClient;
+};
+
+const int TcpProxy::kMaxConnectAttempts;
+const std::size_t TcpProxy::kMaxPendingOutput;
+
+TcpProxy::TcpProxy(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+                   BackendPool* backends, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      backends_(CHECK_NOTNULL(backends)),
+      splice_(true),
+      connectTimeoutSeconds_(3.0),
+      sessions_(0),
+      spliced_(0),
+      copied_(0) {
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        if (auto* session = std::any_cast<SessionPtr>(conn->getMutableContext())) {
+            onMessage(*session, true, buf);
+        } else {
+            buf->retrieveAll();
+        }
+    });
+    server_.setWriteCompleteCallback([this](const TcpConnectionPtr& conn) {
+        if (auto* session = std::any_cast<SessionPtr>(conn->getMutableContext())) {
+            onWriteComplete(*session, true);
+        }
+    });
+}
+
+TcpProxy::~TcpProxy() = default;
+
+void TcpProxy::start() { server_.start(); }
+
+void TcpProxy::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        sessions_.fetch_add(1, std::memory_order_relaxed);
+        SessionPtr session = std::make_shared<Session>();
+        session->client = conn;
+        conn->setContext(session);
+        conn->setTcpNoDelay(true);
+        // nothing is read before there is somewhere to relay it
+        conn->stopRead();
+        std::weak_ptr<Session> weak(session);
+        conn->setHalfCloseCallback([this, weak](const TcpConnectionPtr&) {
+            if (SessionPtr s = weak.lock()) {
+                onHalfClose(s, true);
+            }
+        });
+        connectUpstream(session);
+    } else if (auto* context = std::any_cast<SessionPtr>(conn->getMutableContext())) {
+        SessionPtr session = std::move(*context);
+        conn->setContext(std::any());
+        onClose(session, true);
+    }
+}
+
+void TcpProxy::connectUpstream(const SessionPtr& session) {
+    int index = backends_->acquire();
+    if (index < 0) {
+        LOG(WARN) << "[TcpProxy::connectUpstream] " << *session->client
+                  << " no healthy backend";
+        session->client->forceClose();
+        return;
+    }
+    session->backend = index;
+    ++session->attempts;
+    EventLoop* loop = session->client->getLoop();
+    std::weak_ptr<Session> weak(session);
+    session->connector = std::make_shared<Connector>(loop, backends_->address(index));
+    session->connector->setNewConnectionCallback([this, weak](int sockfd) {
+        if (SessionPtr s = weak.lock()) {
+            onUpstreamConnected(s, sockfd);
+        } else {
+            sockets::close(sockfd);
+        }
+    });
+    session->connector->setErrorCallback([this, weak](int savedErrno) {
+        if (SessionPtr s = weak.lock()) {
+            onUpstreamFailed(s, savedErrno);
+        }
+    });
+    session->connectTimer = loop->runAfter(connectTimeoutSeconds_, [this, weak] {
+        if (SessionPtr s = weak.lock()) {
+            onUpstreamFailed(s, ETIMEDOUT);
+        }
+    });
+    session->connector->start();
+}
+
+void TcpProxy::onUpstreamFailed(const SessionPtr& session, int savedErrno) {
+    if (!session->connector) {
+        return;
+    }
+    int index = session->backend;
+    LOG(WARN) << "[TcpProxy::onUpstreamFailed] " << *session->client << " - "
+              << backends_->address(index).toIpPort() << " " << strerror_tl(savedErrno);
+    backends_->reportFailure(index);
+    stopConnecting(session.get());
+    int maxAttempts = std::min(kMaxConnectAttempts, static_cast<int>(backends_->size()));
+    if (session->attempts < maxAttempts) {
+        connectUpstream(session);
+    } else {
+        session->client->forceClose();
+    }
+}
+
+void TcpProxy::onUpstreamConnected(const SessionPtr& session, int sockfd) {
+    EventLoop* loop = session->client->getLoop();
+    loop->assertInLoopThread();
+    loop->cancel(session->connectTimer);
+    session->connector->stop();
+    loop->queueInLoop([connector = session->connector] {});
+    session->connector.reset();
+
+    InetAddress peerAddr(sockets::getPeerAddr(sockfd));
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    TcpConnectionPtr upstream(new TcpConnection(
+            loop, session->client->name() + "->" + peerAddr.toIpPort(), sockfd, localAddr, peerAddr));
+    upstream->setTcpNoDelay(true);
+    upstream->setConnectionCallback(defaultConnectionCallback);
+    std::weak_ptr<Session> weak(session);
+    upstream->setMessageCallback([this, weak](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+        if (SessionPtr s = weak.lock()) {
+            onMessage(s, false, buf);
+        } else {
+            buf->retrieveAll();
+        }
+    });
+    upstream->setWriteCompleteCallback([this, weak](const TcpConnectionPtr&) {
+        if (SessionPtr s = weak.lock()) {
+            onWriteComplete(s, false);
+        }
+    });
+    upstream->setHalfCloseCallback([this, weak](const TcpConnectionPtr&) {
+        if (SessionPtr s = weak.lock()) {
+            onHalfClose(s, false);
+        }
+    });
+    upstream->setCloseCallback([this, weak, loop](const TcpConnectionPtr& conn) {
+        if (SessionPtr s = weak.lock()) {
+            onClose(s, false);
+        }
+        loop->queueInLoop([conn] { conn->connectDestroyed(); });
+    });
+    // keeps the session alive while the client side may already be gone
+    upstream->setContext(session);
+    session->upstream = upstream;
+    upstream->connectEstablished();
+    startRelay(session);
+}
+
+void TcpProxy::startRelay(const SessionPtr& session) {
+    if (splice_) {
+        session->toUpstream = std::make_unique<Pipe>();
+        session->toClient = std::make_unique<Pipe>();
+        if (session->toUpstream->valid() && session->toClient->valid()) {
+            std::weak_ptr<Session> weak(session);
+            session->client->setReadHandler([this, weak](int sockfd, int* savedErrno) {
+                SessionPtr s = weak.lock();
+                return s ? spliceIn(s, true, sockfd, savedErrno) : (*savedErrno = EAGAIN, -1);
+            });
+            session->upstream->setReadHandler([this, weak](int sockfd, int* savedErrno) {
+                SessionPtr s = weak.lock();
+                return s ? spliceIn(s, false, sockfd, savedErrno) : (*savedErrno = EAGAIN, -1);
+            });
+            spliced_.fetch_add(2, std::memory_order_relaxed);
+        } else {
+            session->toUpstream.reset();
+            session->toClient.reset();
+            copied_.fetch_add(2, std::memory_order_relaxed);
+        }
+    } else {
+        copied_.fetch_add(2, std::memory_order_relaxed);
+    }
+    session->client->startRead();
+}
+
+ssize_t TcpProxy::spliceIn(const SessionPtr& session, bool fromClient, int sockfd,
+                           int* savedErrno) {
+    Pipe* pipe = fromClient ? session->toUpstream.get() : session->toClient.get();
+    const TcpConnectionPtr& from = fromClient ? session->client : session->upstream;
+    const TcpConnectionPtr& to = fromClient ? session->upstream : session->client;
+    // the pipe is empty, reading stops below until the other side took everything
+    ssize_t n = sockets::splice(sockfd, pipe->writeFd(), pipe->capacity());
+    if (n > 0) {
+        to->sendPipe(pipe->readFd(), n);
+        if (to->pipeBytes() > 0) {
+            from->stopRead();
+        }
+    } else if (n < 0) {
+        *savedErrno = errno;
+        if (errno == EINVAL) {
+            LOG(WARN) << "[TcpProxy::spliceIn] " << *from
+                      << " does not support splice, copying";
+            // the handler must not be replaced while it runs, the data is
+            // still there for the next readable event
+            from->getLoop()->queueInLoop(
+                    [from] { from->setReadHandler(TcpConnection::ReadHandler()); });
+            spliced_.fetch_sub(1, std::memory_order_relaxed);
+            copied_.fetch_add(1, std::memory_order_relaxed);
+            *savedErrno = EAGAIN;
+        }
+    }
+    return n;
+}
+
+void TcpProxy::onMessage(const SessionPtr& session, bool fromClient, Buffer* buf) {
+    const TcpConnectionPtr& from = fromClient ? session->client : session->upstream;
+    const TcpConnectionPtr& to = fromClient ? session->upstream : session->client;
+    if (!to) {
+        buf->retrieveAll();
+        return;
+    }
+    to->send(buf);
+    if (to->outputBuffer()->readableBytes() > kMaxPendingOutput) {
+        from->stopRead();
+    }
+}
+
+void TcpProxy::onWriteComplete(const SessionPtr& session, bool toClient) {
+    const TcpConnectionPtr& from = toClient ? session->upstream : session->client;
+    const bool fromEof = toClient ? session->upstreamEof : session->clientEof;
+    // a side shut down for writing may still be read from
+    if (from && !fromEof && !from->disconnected() && !from->isReading()) {
+        from->startRead();
+    }
+}
+
+void TcpProxy::onHalfClose(const SessionPtr& session, bool client) {
+    // the FIN follows once everything before it is written
+    if (client) {
+        session->clientEof = true;
+        if (session->upstream) {
+            session->upstream->shutdown();
+        }
+    } else {
+        session->upstreamEof = true;
+        session->client->shutdown();
+    }
+}
+
+void TcpProxy::onClose(const SessionPtr& session, bool client) {
+    // after FINs both ways the other side closes on its own once flushed,
+    // anything else resets it
+    const bool graceful = session->clientEof && session->upstreamEof;
+    if (client) {
+        session->clientClosed = true;
+        sessions_.fetch_sub(1, std::memory_order_relaxed);
+        stopConnecting(session.get());
+        if (session->upstream && !session->upstreamClosed && !graceful) {
+            session->upstream->forceClose();
+        }
+    } else {
+        session->upstreamClosed = true;
+        backends_->release(session->backend);
+        session->backend = -1;
+        session->upstream->setContext(std::any());
+        if (!session->clientClosed && !graceful) {
+            session->client->forceClose();
+        }
+    }
+}
+
+void TcpProxy::stopConnecting(Session* session) {
+    if (session->connector) {
+        session->client->getLoop()->cancel(session->connectTimer);
+        // stop() finishes in a queued functor that needs the connector
+        session->connector->stop();
+        session->client->getLoop()->queueInLoop([connector = session->connector] {});
+        session->connector.reset();
+        backends_->release(session->backend);
+        session->backend = -1;
+    }
+}
+
+}  // namespace dws::net
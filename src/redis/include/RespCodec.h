@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "StringPiece.h"
+
+namespace dws::net {
+
+class Buffer;
+
+/// REdis Serialization Protocol, versions 2 and 3.
+///
+/// Parsing never copies: strings are views into the parsed bytes, which
+/// stay valid until they are retrieved from the Buffer.  Encoders append to
+/// a Buffer, usually the connection's output buffer, so the replies to a
+/// pipelined batch of commands go out in one write.
+namespace resp {
+
+enum Protocol { kResp2 = 2, kResp3 = 3 };
+
+/// The first byte of every value, RESP2 knows the first five.
+enum Type : char {
+    kSimpleString = '+',
+    kError = '-',
+    kInteger = ':',
+    kBulkString = '$',  // a RESP2 null bulk string is parsed as kNull
+    kArray = '*',       // a RESP2 null array is parsed as kNull
+    kNull = '_',
+    kDouble = ',',
+    kBoolean = '#',
+    kBigNumber = '(',
+    kBulkError = '!',
+    kVerbatimString = '=',
+    kMap = '%',
+    kSet = '~',
+    kAttribute = '|',
+    kPush = '>',
+};
+
+enum ParseResult { kNeedMore, kOk, kProtocolError };
+
+const std::size_t kMaxBulkBytes = 512 * 1024 * 1024;
+const std::size_t kMaxInlineBytes = 64 * 1024;
+const int64_t kMaxElements = 1024 * 1024;
+const int kMaxNesting = 32;
+
+struct Value {
+    Type type = kNull;
+    /// Text of strings, errors and big numbers; verbatim strings keep their
+    /// "txt:" prefix.
+    StringPiece string;
+    int64_t integer = 0;  // also 0 or 1 for booleans
+    double number = 0;
+    /// Aggregates; maps and attributes hold keys and values alternately.
+    std::vector<Value> elements;
+};
+
+/// Parses the value at the start of [begin, end); @c bytes is its encoded
+/// length on kOk.
+ParseResult parseValue(const char* begin, const char* end, Value* value, std::size_t* bytes);
+
+/// Parses the command at the start of @c buf, either an array of bulk
+/// strings as sent by clients or an inline command as typed into telnet.
+/// An empty inline line yields no arguments.  @c bytes is its length on kOk.
+ParseResult parseCommand(const Buffer& buf, std::vector<StringPiece>* args, std::size_t* bytes);
+
+void appendSimpleString(Buffer* out, const StringPiece& str);
+/// @c message starts with the error code, e.g. "ERR unknown command".
+void appendError(Buffer* out, const StringPiece& message);
+void appendInteger(Buffer* out, int64_t value);
+void appendBulkString(Buffer* out, const StringPiece& str);
+void appendNull(Buffer* out, Protocol protocol);
+void appendArrayHeader(Buffer* out, std::size_t count);
+/// RESP2 has no maps, they are sent as arrays of keys and values.
+void appendMapHeader(Buffer* out, std::size_t pairs, Protocol protocol);
+/// A bulk string in RESP2.
+void appendDouble(Buffer* out, double value, Protocol protocol);
+/// The integer 0 or 1 in RESP2.
+void appendBoolean(Buffer* out, bool value, Protocol protocol);
+/// Encodes a command the way clients send it.
+void appendCommand(Buffer* out, const std::vector<StringPiece>& args);
+
+}  // namespace resp
+
+}  // namespace dws::net
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RespCodec.h"
+#include "TcpServer.h"
+
+namespace dws::net {
+
+/// In-memory key-value server speaking the Redis protocol, an example of
+/// building a RESP service on dws.
+///
+/// Keys are sharded across the IO loops by hash, every shard is owned by
+/// exactly one loop and needs no lock.  A command on a key of the
+/// connection's own loop runs inline; the others of one read are batched
+/// per shard, handed over with a single queueInLoop() and answered with a
+/// single batch back.  Replies are written in request order, whichever
+/// shard finishes first.  Supports PING, ECHO, HELLO, SELECT 0, DBSIZE,
+/// GET, SET, DEL, EXISTS, INCR, DECR, STRLEN and QUIT, with one key per
+/// command.  Connections must not be migrated to other loops.
+class ShardedKvServer : noncopyable {
+ public:
+    ShardedKvServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name,
+                    TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+    TcpServer* tcpServer() { return &server_; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void start();
+
+    /// Keys over all shards, thread safe.
+    std::size_t numKeys() const;
+
+ private:
+    struct Shard {
+        EventLoop* loop = nullptr;
+        std::unordered_map<std::string, std::string> data;
+        std::atomic<std::size_t> size{0};
+    };
+    struct Command;
+    struct Session;
+    struct Batch;
+
+    static const std::size_t kMaxPendingOutput = 1024 * 1024;
+    /// Commands read but not answered yet, per connection.
+    static const std::size_t kMaxPendingReplies = 64 * 1024;
+
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void resumeReading(const TcpConnectionPtr& conn);
+    std::size_t shardOf(const StringPiece& key) const;
+    void dispatchBatches(Session* session);
+    void runBatch(Shard* shard, const std::shared_ptr<Batch>& batch);
+    void completeBatch(const TcpConnectionPtr& conn, const Batch& batch);
+    /// Commands without a key and invalid ones, in the connection's loop.
+    void executeLocal(Session* session, const Command* command,
+                      const std::vector<StringPiece>& args, Buffer* out);
+    static const Command* findCommand(const StringPiece& name);
+    static void execute(Shard* shard, const Command& command,
+                        const std::vector<StringPiece>& args, resp::Protocol protocol,
+                        Buffer* out);
+
+    TcpServer server_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,359 @@
+#include "RespCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Buffer.h"
+
+namespace dws::net::resp {
+
+namespace {
+
+// Finds the CR of the CRLF ending the line that starts at p.
+ParseResult findLineEnd(const char* p, const char* end, std::size_t maxBytes, const char** cr) {
+    const char* limit = end - p > static_cast<ptrdiff_t>(maxBytes) ? p + maxBytes : end;
+    const void* found = memchr(p, '\r', limit - p);
+    if (found == nullptr) {
+        return limit == end ? kNeedMore : kProtocolError;
+    }
+    *cr = static_cast<const char*>(found);
+    if (*cr + 1 == end) {
+        return kNeedMore;
+    }
+    return (*cr)[1] == '\n' ? kOk : kProtocolError;
+}
+
+bool parseInteger(const char* p, const char* end, int64_t* value) {
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) {
+        ++p;
+    }
+    if (p == end || end - p > 19) {
+        return false;
+    }
+    uint64_t n = 0;
+    for (; p < end; ++p) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        n = n * 10 + static_cast<uint64_t>(*p - '0');
+    }
+    if (n > static_cast<uint64_t>(INT64_MAX)) {
+        return false;
+    }
+    *value = negative ? -static_cast<int64_t>(n) : static_cast<int64_t>(n);
+    return true;
+}
+
+// Reads the "<integer>\r\n" following a type byte.
+ParseResult parseLength(const char* p, const char* end, int64_t* value, const char** next) {
+    const char* cr = nullptr;
+    ParseResult result = findLineEnd(p, end, 32, &cr);
+    if (result != kOk) {
+        return result;
+    }
+    if (!parseInteger(p, cr, value)) {
+        return kProtocolError;
+    }
+    *next = cr + 2;
+    return kOk;
+}
+
+ParseResult parseValueAt(const char* p, const char* end, int depth, Value* value,
+                         const char** next) {
+    if (p == end) {
+        return kNeedMore;
+    }
+    Type type = static_cast<Type>(*p++);
+    value->type = type;
+    value->elements.clear();
+    const char* cr = nullptr;
+    ParseResult result = kOk;
+    switch (type) {
+        case kSimpleString:
+        case kError:
+        case kBigNumber:
+        case kInteger:
+        case kDouble:
+        case kBoolean:
+        case kNull: {
+            result = findLineEnd(p, end, kMaxInlineBytes, &cr);
+            if (result != kOk) {
+                return result;
+            }
+            value->string = StringPiece(p, static_cast<int>(cr - p));
+            if (type == kInteger && !parseInteger(p, cr, &value->integer)) {
+                return kProtocolError;
+            } else if (type == kDouble) {
+                char number[64];
+                if (cr - p == 0 || cr - p >= static_cast<ptrdiff_t>(sizeof number)) {
+                    return kProtocolError;
+                }
+                memcpy(number, p, cr - p);
+                number[cr - p] = '\0';
+                char* last = nullptr;
+                value->number = strtod(number, &last);
+                if (last != number + (cr - p)) {
+                    return kProtocolError;
+                }
+            } else if (type == kBoolean) {
+                if (cr - p != 1 || (*p != 't' && *p != 'f')) {
+                    return kProtocolError;
+                }
+                value->integer = *p == 't';
+            } else if (type == kNull && cr != p) {
+                return kProtocolError;
+            }
+            *next = cr + 2;
+            return kOk;
+        }
+        case kBulkString:
+        case kBulkError:
+        case kVerbatimString: {
+            int64_t length = 0;
+            result = parseLength(p, end, &length, &p);
+            if (result != kOk) {
+                return result;
+            }
+            if (length == -1 && type == kBulkString) {
+                value->type = kNull;
+                *next = p;
+                return kOk;
+            }
+            if (length < 0 || length > static_cast<int64_t>(kMaxBulkBytes) ||
+                (type == kVerbatimString && length < 4)) {
+                return kProtocolError;
+            }
+            if (end - p < length + 2) {
+                return kNeedMore;
+            }
+            if (p[length] != '\r' || p[length + 1] != '\n' ||
+                (type == kVerbatimString && p[3] != ':')) {
+                return kProtocolError;
+            }
+            value->string = StringPiece(p, static_cast<int>(length));
+            *next = p + length + 2;
+            return kOk;
+        }
+        case kArray:
+        case kMap:
+        case kSet:
+        case kAttribute:
+        case kPush: {
+            int64_t count = 0;
+            result = parseLength(p, end, &count, &p);
+            if (result != kOk) {
+                return result;
+            }
+            if (count == -1 && type == kArray) {
+                value->type = kNull;
+                *next = p;
+                return kOk;
+            }
+            if (count < 0 || count > kMaxElements || depth >= kMaxNesting) {
+                return kProtocolError;
+            }
+            if (type == kMap || type == kAttribute) {
+                count *= 2;
+            }
+            // grows with the input, a bogus count must not allocate up front
+            value->elements.reserve(std::min<int64_t>(count, 64));
+            for (int64_t i = 0; i < count; ++i) {
+                value->elements.emplace_back();
+                result = parseValueAt(p, end, depth + 1, &value->elements.back(), &p);
+                if (result != kOk) {
+                    return result;
+                }
+            }
+            *next = p;
+            return kOk;
+        }
+        default:
+            return kProtocolError;
+    }
+}
+
+// Writes "<type><value>\r\n".
+void appendLine(Buffer* out, char type, int64_t value) {
+    out->ensureWritableBytes(24);
+    char* begin = out->beginWrite();
+    char* p = begin;
+    *p++ = type;
+    uint64_t n = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    if (value < 0) {
+        *p++ = '-';
+    }
+    char digits[20];
+    int i = 0;
+    do {
+        digits[i++] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    while (i > 0) {
+        *p++ = digits[--i];
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+    out->hasWritten(p - begin);
+}
+
+void appendLine(Buffer* out, char type, const StringPiece& str) {
+    out->ensureWritableBytes(str.size() + 3);
+    char* p = out->beginWrite();
+    *p++ = type;
+    memcpy(p, str.data(), str.size());
+    p += str.size();
+    *p++ = '\r';
+    *p = '\n';
+    out->hasWritten(str.size() + 3);
+}
+
+}  // namespace
+
+ParseResult parseValue(const char* begin, const char* end, Value* value, std::size_t* bytes) {
+    const char* next = begin;
+    ParseResult result = parseValueAt(begin, end, 0, value, &next);
+    if (result == kOk) {
+        *bytes = next - begin;
+    }
+    return result;
+}
+
+ParseResult parseCommand(const Buffer& buf, std::vector<StringPiece>* args, std::size_t* bytes) {
+    const char* begin = buf.peek();
+    const char* end = buf.beginWrite();
+    const char* p = begin;
+    args->clear();
+    if (p == end) {
+        return kNeedMore;
+    }
+    if (*p == kArray) {
+        int64_t count = 0;
+        ParseResult result = parseLength(p + 1, end, &count, &p);
+        if (result != kOk) {
+            return result;
+        }
+        if (count > kMaxElements) {
+            return kProtocolError;
+        }
+        for (int64_t i = 0; i < count; ++i) {
+            if (p == end) {
+                return kNeedMore;
+            }
+            if (*p != kBulkString) {
+                return kProtocolError;
+            }
+            int64_t length = 0;
+            result = parseLength(p + 1, end, &length, &p);
+            if (result != kOk) {
+                return result;
+            }
+            if (length < 0 || length > static_cast<int64_t>(kMaxBulkBytes)) {
+                return kProtocolError;
+            }
+            if (end - p < length + 2) {
+                return kNeedMore;
+            }
+            if (p[length] != '\r' || p[length + 1] != '\n') {
+                return kProtocolError;
+            }
+            args->push_back(StringPiece(p, static_cast<int>(length)));
+            p += length + 2;
+        }
+        *bytes = p - begin;
+        return kOk;
+    }
+
+    const char* eol = buf.findEOL();
+    if (eol == nullptr) {
+        return buf.readableBytes() > kMaxInlineBytes ? kProtocolError : kNeedMore;
+    }
+    const char* lineEnd = eol > begin && eol[-1] == '\r' ? eol - 1 : eol;
+    while (p < lineEnd) {
+        while (p < lineEnd && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+        const char* word = p;
+        while (p < lineEnd && *p != ' ' && *p != '\t') {
+            ++p;
+        }
+        if (p > word) {
+            args->push_back(StringPiece(word, static_cast<int>(p - word)));
+        }
+    }
+    *bytes = eol + 1 - begin;
+    return kOk;
+}
+
+void appendSimpleString(Buffer* out, const StringPiece& str) { appendLine(out, kSimpleString, str); }
+
+void appendError(Buffer* out, const StringPiece& message) { appendLine(out, kError, message); }
+
+void appendInteger(Buffer* out, int64_t value) { appendLine(out, kInteger, value); }
+
+void appendBulkString(Buffer* out, const StringPiece& str) {
+    appendLine(out, kBulkString, static_cast<int64_t>(str.size()));
+    out->ensureWritableBytes(str.size() + 2);
+    char* p = out->beginWrite();
+    memcpy(p, str.data(), str.size());
+    p[str.size()] = '\r';
+    p[str.size() + 1] = '\n';
+    out->hasWritten(str.size() + 2);
+}
+
+void appendNull(Buffer* out, Protocol protocol) {
+    if (protocol == kResp3) {
+        out->append("_\r\n", 3);
+    } else {
+        out->append("$-1\r\n", 5);
+    }
+}
+
+void appendArrayHeader(Buffer* out, std::size_t count) {
+    appendLine(out, kArray, static_cast<int64_t>(count));
+}
+
+void appendMapHeader(Buffer* out, std::size_t pairs, Protocol protocol) {
+    if (protocol == kResp3) {
+        appendLine(out, kMap, static_cast<int64_t>(pairs));
+    } else {
+        appendLine(out, kArray, static_cast<int64_t>(pairs * 2));
+    }
+}
+
+void appendDouble(Buffer* out, double value, Protocol protocol) {
+    char buf[32];
+    int n = 0;
+    if (std::isnan(value)) {
+        n = snprintf(buf, sizeof buf, "nan");
+    } else if (std::isinf(value)) {
+        n = snprintf(buf, sizeof buf, value > 0 ? "inf" : "-inf");
+    } else {
+        n = snprintf(buf, sizeof buf, "%.17g", value);
+    }
+    if (protocol == kResp3) {
+        appendLine(out, kDouble, StringPiece(buf, n));
+    } else {
+        appendBulkString(out, StringPiece(buf, n));
+    }
+}
+
+void appendBoolean(Buffer* out, bool value, Protocol protocol) {
+    if (protocol == kResp3) {
+        out->append(value ? "#t\r\n" : "#f\r\n", 4);
+    } else {
+        appendInteger(out, value ? 1 : 0);
+    }
+}
+
+void appendCommand(Buffer* out, const std::vector<StringPiece>& args) {
+    appendArrayHeader(out, args.size());
+    for (const StringPiece& arg : args) {
+        appendBulkString(out, arg);
+    }
+}
+
+}  // namespace dws::net::resp
@@ -0,0 +1,455 @@
+#include "ShardedKvServer.h"
+
+#include <strings.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+#include "ConnectionRegistry.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+struct ShardedKvServer::Command {
+    enum Id {
+        kPing,
+        kEcho,
+        kHello,
+        kSelect,
+        kDbSize,
+        kCommandInfo,
+        kConfig,
+        kQuit,
+        kGet,
+        kSet,
+        kDel,
+        kExists,
+        kIncr,
+        kDecr,
+        kStrlen,
+    };
+
+    bool accepts(std::size_t argc) const {
+        return arity > 0 ? argc == static_cast<std::size_t>(arity)
+                         : argc >= static_cast<std::size_t>(-arity);
+    }
+
+    const char* name;
+    Id id;
+    int arity;   // exact if positive, minimum if negative, the name included
+    bool keyed;  // the key is the first argument
+};
+
+namespace {
+
+bool parseInt64(const std::string& str, int64_t* value) {
+    if (str.empty() || str.size() > 20) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long n = strtoll(str.c_str(), &end, 10);
+    if (errno != 0 || end != str.c_str() + str.size()) {
+        return false;
+    }
+    *value = n;
+    return true;
+}
+
+}  // namespace
+
+struct ShardedKvServer::Session {
+    struct Reply {
+        std::string data;
+        bool ready = false;
+    };
+
+    resp::Protocol protocol = resp::kResp2;
+    bool closing = false;  // QUIT or a protocol error, close once answered
+    std::vector<StringPiece> args;
+    // Replies held back behind one still computed by another shard, front()
+    // answers command number firstPending.
+    std::deque<Reply> pending;
+    uint64_t firstPending = 0;
+    Buffer scratch;
+    // Commands of the current read for other shards, by shard index.
+    std::vector<std::shared_ptr<Batch>> batches;
+};
+
+/// Commands handed to another shard and their replies.
+struct ShardedKvServer::Batch {
+    std::weak_ptr<TcpConnection> conn;
+    EventLoop* connLoop = nullptr;
+    resp::Protocol protocol = resp::kResp2;
+    std::vector<const Command*> commands;
+    std::vector<uint64_t> seqs;
+    std::vector<uint32_t> argc;      // arguments per command
+    std::vector<uint32_t> argBytes;  // length of every argument
+    std::string args;                // all arguments back to back
+    Buffer replies;                  // filled by the shard
+    std::vector<uint32_t> replyBytes;
+};
+
+const ShardedKvServer::Command* ShardedKvServer::findCommand(const StringPiece& name) {
+    static const Command kCommands[] = {
+            {"get", Command::kGet, 2, true},
+            {"set", Command::kSet, 3, true},
+            {"del", Command::kDel, 2, true},
+            {"exists", Command::kExists, 2, true},
+            {"incr", Command::kIncr, 2, true},
+            {"decr", Command::kDecr, 2, true},
+            {"strlen", Command::kStrlen, 2, true},
+            {"ping", Command::kPing, -1, false},
+            {"echo", Command::kEcho, 2, false},
+            {"hello", Command::kHello, -1, false},
+            {"select", Command::kSelect, 2, false},
+            {"dbsize", Command::kDbSize, 1, false},
+            {"command", Command::kCommandInfo, -1, false},
+            {"config", Command::kConfig, -2, false},
+            {"quit", Command::kQuit, 1, false},
+    };
+    for (const Command& command : kCommands) {
+        if (strlen(command.name) == static_cast<std::size_t>(name.size()) &&
+            strncasecmp(command.name, name.data(), name.size()) == 0) {
+            return &command;
+        }
+    }
+    return nullptr;
+}
+
+const std::size_t ShardedKvServer::kMaxPendingOutput;
+const std::size_t ShardedKvServer::kMaxPendingReplies;
+
+ShardedKvServer::ShardedKvServer(EventLoop* loop, const InetAddress& listenAddr,
+                                 const std::string& name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option) {
+    // a connection's own shard is the one of the loop index in its id
+    server_.disableMigration();
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf,
+                                      Timestamp receiveTime) { onMessage(conn, buf, receiveTime); });
+    server_.setWriteCompleteCallback([this](const TcpConnectionPtr& conn) { resumeReading(conn); });
+}
+
+void ShardedKvServer::start() {
+    server_.start();
+    for (EventLoop* loop : server_.threadPool()->getAllLoops()) {
+        shards_.emplace_back(new Shard);
+        shards_.back()->loop = loop;
+    }
+    LOG(INFO) << "[ShardedKvServer::start] ShardedKvServer[" << server_.name()
+              << "] starts listening on " << server_.ipPort() << " with " << shards_.size()
+              << " shards";
+}
+
+std::size_t ShardedKvServer::numKeys() const {
+    std::size_t n = 0;
+    for (const auto& shard : shards_) {
+        n += shard->size.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+std::size_t ShardedKvServer::shardOf(const StringPiece& key) const {
+    // the same mapping as EventLoopThreadPool::getLoopForHash()
+    return std::hash<std::string_view>()(std::string_view(key.data(), key.size())) %
+           shards_.size();
+}
+
+void ShardedKvServer::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->setTcpNoDelay(true);
+        // replies of several shards finishing in one iteration share a write
+        conn->setWriteCoalescing(true);
+        auto session = std::make_shared<Session>();
+        session->batches.resize(shards_.size());
+        conn->setContext(session);
+    }
+}
+
+void ShardedKvServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getMutableContext())->get();
+    if (session->closing) {
+        buf->retrieveAll();
+        return;
+    }
+    Buffer* output = conn->outputBuffer();
+    std::size_t self = ConnectionRegistry::loopIndexOf(conn->id());
+    while (buf->readableBytes() > 0) {
+        if (output->readableBytes() >= kMaxPendingOutput ||
+            session->pending.size() >= kMaxPendingReplies) {
+            // resumed by resumeReading()
+            conn->stopRead();
+            break;
+        }
+        std::size_t bytes = 0;
+        resp::ParseResult result = resp::parseCommand(*buf, &session->args, &bytes);
+        if (result == resp::kNeedMore) {
+            break;
+        }
+        Buffer* out = session->pending.empty() ? output : &session->scratch;
+        if (result == resp::kProtocolError) {
+            resp::appendError(out, StringPiece("ERR Protocol error"));
+            session->closing = true;
+            buf->retrieveAll();
+        } else if (!session->args.empty()) {
+            const std::vector<StringPiece>& args = session->args;
+            const Command* command = findCommand(args[0]);
+            bool valid = command != nullptr && command->accepts(args.size());
+            std::size_t shard = valid && command->keyed ? shardOf(args[1]) : self;
+            if (shard != self) {
+                std::shared_ptr<Batch>& batch = session->batches[shard];
+                if (!batch) {
+                    batch = std::make_shared<Batch>();
+                    batch->conn = conn;
+                    batch->connLoop = conn->getLoop();
+                    batch->protocol = session->protocol;
+                }
+                batch->commands.push_back(command);
+                batch->seqs.push_back(session->firstPending + session->pending.size());
+                batch->argc.push_back(static_cast<uint32_t>(args.size()));
+                for (const StringPiece& arg : args) {
+                    batch->argBytes.push_back(static_cast<uint32_t>(arg.size()));
+                    batch->args.append(arg.data(), arg.size());
+                }
+                session->pending.emplace_back();
+                out = nullptr;
+            } else if (valid && command->keyed) {
+                execute(shards_[self].get(), *command, args, session->protocol, out);
+            } else {
+                resp::Protocol protocol = session->protocol;
+                executeLocal(session, command, args, out);
+                if (session->protocol != protocol) {
+                    // queued commands are answered in the protocol they were sent with
+                    dispatchBatches(session);
+                }
+            }
+            buf->retrieve(bytes);
+        } else {
+            buf->retrieve(bytes);
+        }
+        if (out == &session->scratch) {
+            session->pending.emplace_back();
+            session->pending.back().data = session->scratch.retrieveAllAsString();
+            session->pending.back().ready = true;
+        }
+        if (session->closing) {
+            buf->retrieveAll();
+            break;
+        }
+    }
+    dispatchBatches(session);
+    conn->sendOutputBuffer();
+    if (session->closing && session->pending.empty()) {
+        conn->shutdown();
+    }
+}
+
+void ShardedKvServer::dispatchBatches(Session* session) {
+    for (std::size_t i = 0; i < session->batches.size(); ++i) {
+        if (session->batches[i]) {
+            Shard* shard = shards_[i].get();
+            shard->loop->queueInLoop(
+                    [this, shard, batch = std::move(session->batches[i])] { runBatch(shard, batch); });
+        }
+    }
+}
+
+void ShardedKvServer::runBatch(Shard* shard, const std::shared_ptr<Batch>& batch) {
+    std::vector<StringPiece> args;
+    const char* p = batch->args.data();
+    std::size_t argIndex = 0;
+    for (std::size_t i = 0; i < batch->commands.size(); ++i) {
+        args.clear();
+        for (uint32_t j = 0; j < batch->argc[i]; ++j, ++argIndex) {
+            args.push_back(StringPiece(p, static_cast<int>(batch->argBytes[argIndex])));
+            p += batch->argBytes[argIndex];
+        }
+        std::size_t before = batch->replies.readableBytes();
+        execute(shard, *batch->commands[i], args, batch->protocol, &batch->replies);
+        batch->replyBytes.push_back(
+                static_cast<uint32_t>(batch->replies.readableBytes() - before));
+    }
+    batch->connLoop->queueInLoop([this, batch] {
+        TcpConnectionPtr conn = batch->conn.lock();
+        if (conn && conn->connected()) {
+            completeBatch(conn, *batch);
+        }
+    });
+}
+
+void ShardedKvServer::completeBatch(const TcpConnectionPtr& conn, const Batch& batch) {
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getMutableContext())->get();
+    Buffer* output = conn->outputBuffer();
+    const char* p = batch.replies.peek();
+    for (std::size_t i = 0; i < batch.seqs.size(); ++i) {
+        Session::Reply& reply = session->pending[batch.seqs[i] - session->firstPending];
+        reply.data.assign(p, batch.replyBytes[i]);
+        reply.ready = true;
+        p += batch.replyBytes[i];
+        while (!session->pending.empty() && session->pending.front().ready) {
+            output->append(StringPiece(session->pending.front().data));
+            session->pending.pop_front();
+            ++session->firstPending;
+        }
+    }
+    conn->sendOutputBuffer();
+    if (session->closing && session->pending.empty()) {
+        conn->shutdown();
+    } else {
+        resumeReading(conn);
+    }
+}
+
+void ShardedKvServer::resumeReading(const TcpConnectionPtr& conn) {
+    if (conn->isReading() || !conn->connected()) {
+        return;
+    }
+    Session* session = std::any_cast<std::shared_ptr<Session>>(conn->getMutableContext())->get();
+    if (conn->outputBuffer()->readableBytes() < kMaxPendingOutput &&
+        session->pending.size() < kMaxPendingReplies) {
+        conn->startRead();
+        // pipelined commands may be waiting in the buffer without new input arriving
+        onMessage(conn, conn->inputBuffer(), Timestamp::now());
+    }
+}
+
+void ShardedKvServer::executeLocal(Session* session, const Command* command,
+                                   const std::vector<StringPiece>& args, Buffer* out) {
+    if (command == nullptr) {
+        std::string message = "ERR unknown command '" + args[0].as_string() + "'";
+        resp::appendError(out, StringPiece(message));
+        return;
+    }
+    if (!command->accepts(args.size())) {
+        std::string message =
+                std::string("ERR wrong number of arguments for '") + command->name + "' command";
+        resp::appendError(out, StringPiece(message));
+        return;
+    }
+    switch (command->id) {
+        case Command::kPing:
+            if (args.size() == 1) {
+                resp::appendSimpleString(out, StringPiece("PONG"));
+            } else {
+                resp::appendBulkString(out, args[1]);
+            }
+            break;
+        case Command::kEcho:
+            resp::appendBulkString(out, args[1]);
+            break;
+        case Command::kHello: {
+            resp::Protocol protocol = session->protocol;
+            if (args.size() > 1) {
+                if (args[1] == StringPiece("2")) {
+                    protocol = resp::kResp2;
+                } else if (args[1] == StringPiece("3")) {
+                    protocol = resp::kResp3;
+                } else {
+                    resp::appendError(out, StringPiece("NOPROTO unsupported protocol version"));
+                    break;
+                }
+            }
+            session->protocol = protocol;
+            resp::appendMapHeader(out, 3, protocol);
+            resp::appendBulkString(out, StringPiece("server"));
+            resp::appendBulkString(out, StringPiece("dws"));
+            resp::appendBulkString(out, StringPiece("proto"));
+            resp::appendInteger(out, protocol);
+            resp::appendBulkString(out, StringPiece("mode"));
+            resp::appendBulkString(out, StringPiece("standalone"));
+            break;
+        }
+        case Command::kSelect:
+            if (args[1] == StringPiece("0")) {
+                resp::appendSimpleString(out, StringPiece("OK"));
+            } else {
+                resp::appendError(out, StringPiece("ERR DB index is out of range"));
+            }
+            break;
+        case Command::kDbSize:
+            resp::appendInteger(out, static_cast<int64_t>(numKeys()));
+            break;
+        case Command::kCommandInfo:
+            resp::appendArrayHeader(out, 0);
+            break;
+        case Command::kConfig:
+            // clients such as redis-benchmark ask for settings, there are none
+            resp::appendMapHeader(out, 0, session->protocol);
+            break;
+        case Command::kQuit:
+            resp::appendSimpleString(out, StringPiece("OK"));
+            session->closing = true;
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+void ShardedKvServer::execute(Shard* shard, const Command& command,
+                              const std::vector<StringPiece>& args, resp::Protocol protocol,
+                              Buffer* out) {
+    // a shard is touched by its own loop only, the key's capacity is reused
+    thread_local std::string key;
+    key.assign(args[1].data(), args[1].size());
+    auto& data = shard->data;
+    switch (command.id) {
+        case Command::kGet: {
+            auto it = data.find(key);
+            if (it == data.end()) {
+                resp::appendNull(out, protocol);
+            } else {
+                resp::appendBulkString(out, StringPiece(it->second));
+            }
+            break;
+        }
+        case Command::kSet:
+            data[key].assign(args[2].data(), args[2].size());
+            resp::appendSimpleString(out, StringPiece("OK"));
+            break;
+        case Command::kDel:
+            resp::appendInteger(out, static_cast<int64_t>(data.erase(key)));
+            break;
+        case Command::kExists:
+            resp::appendInteger(out, data.count(key) ? 1 : 0);
+            break;
+        case Command::kIncr:
+        case Command::kDecr: {
+            std::string& value = data[key];
+            int64_t n = 0;
+            if (!value.empty() && !parseInt64(value, &n)) {
+                resp::appendError(out, StringPiece("ERR value is not an integer or out of range"));
+                break;
+            }
+            if ((command.id == Command::kIncr && n == INT64_MAX) ||
+                (command.id == Command::kDecr && n == INT64_MIN)) {
+                resp::appendError(out, StringPiece("ERR increment or decrement would overflow"));
+                break;
+            }
+            n += command.id == Command::kIncr ? 1 : -1;
+            value = std::to_string(n);
+            resp::appendInteger(out, n);
+            break;
+        }
+        case Command::kStrlen: {
+            auto it = data.find(key);
+            resp::appendInteger(out, it == data.end() ? 0 : static_cast<int64_t>(it->second.size()));
+            break;
+        }
+        default:
+            assert(false);
+            break;
+    }
+    shard->size.store(data.size(), std::memory_order_relaxed);
+}
+
+}  // namespace dws::net
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "Buffer.h"
+#include "RpcCodec.h"
+#include "TcpClient.h"
+#include "TimerId.h"
+
+namespace dws::net {
+
+/// Client side of one RpcServer connection, multiplexing any number of
+/// concurrent calls over it.
+///
+/// Calls made before the connection is up are buffered and sent once it
+/// is; calls in flight or buffered when it goes down fail with
+/// kConnectionClosed.  Every
+/// call has its own deadline on the loop's TimerQueue.  Destroy the channel
+/// before its loop.
+class RpcChannel : noncopyable {
+ public:
+    /// Runs in the channel's loop, @c response is only valid during the call.
+    using Callback = std::function<void(rpc::Status status, const StringPiece& response)>;
+
+    static constexpr double kDefaultTimeoutSeconds = 5.0;
+
+    RpcChannel(EventLoop* loop, const InetAddress& serverAddr, const std::string& name);
+    ~RpcChannel();
+
+    EventLoop* getLoop() const { return loop_; }
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    bool connected() const;
+
+    /// Thread safe.
+    void call(const StringPiece& method, const StringPiece& request, Callback cb,
+              double timeoutSeconds = kDefaultTimeoutSeconds);
+    /// Blocks until the response or the timeout; must not be called in the
+    /// channel's loop.
+    rpc::Status callSync(const StringPiece& method, const StringPiece& request,
+                         std::string* response, double timeoutSeconds = kDefaultTimeoutSeconds);
+    /// Calls awaiting a response, loop thread only.
+    std::size_t numPending() const { return pending_.size(); }
+
+ private:
+    struct PendingCall {
+        Callback callback;
+        TimerId timer;
+    };
+
+    void callInLoop(const StringPiece& method, const StringPiece& request, Callback cb,
+                    double timeoutSeconds);
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void onTimeout(uint64_t id);
+    void failAll(rpc::Status status);
+
+    EventLoop* loop_;
+    TcpClient client_;
+    TcpConnectionPtr connection_;  // loop thread only
+    Buffer unsent_;                // requests made while disconnected
+    uint64_t nextId_;
+    std::unordered_map<uint64_t, PendingCall> pending_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "StringPiece.h"
+
+namespace dws::net {
+
+class Buffer;
+
+/// Wire format shared by RpcServer and RpcChannel.
+///
+/// Every message starts with a 16-byte big-endian header:
+/// @code
+///   uint32 length        bytes following the header
+///   uint64 id            chosen by the caller, echoed by the response
+///   uint8  type          kRequest or kResponse
+///   uint8  status        Status of a response, 0 in requests
+///   uint16 methodLength  length of the method name that follows a request
+/// @endcode
+/// followed by the method name (requests only) and the payload.
+namespace rpc {
+
+enum Status {
+    kOk = 0,
+    kNoSuchMethod = 1,
+    kBadRequest = 2,
+    kServerError = 3,
+    kTimeout = 4,  // set by the client, never sent
+    kConnectionClosed = 5,  // set by the client, never sent
+};
+
+const char* statusString(Status status);
+
+enum MessageType { kRequest = 0, kResponse = 1 };
+
+const std::size_t kHeaderBytes = 16;
+const std::size_t kMaxMessageBytes = 64 * 1024 * 1024;
+
+/// method and payload are views into the parsed buffer.
+struct Message {
+    MessageType type = kRequest;
+    Status status = kOk;
+    uint64_t id = 0;
+    StringPiece method;
+    StringPiece payload;
+    std::size_t bytes = 0;  // header included, to retrieve once handled
+};
+
+enum ParseResult { kNeedMore, kMessage, kMalformed };
+
+ParseResult parseMessage(const Buffer& buf, Message* message);
+void appendRequest(Buffer* out, uint64_t id, const StringPiece& method,
+                   const StringPiece& payload);
+void appendResponse(Buffer* out, uint64_t id, Status status, const StringPiece& payload);
+
+}  // namespace rpc
+
+}  // namespace dws::net
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "RpcCodec.h"
+#include "TcpServer.h"
+#include "ThreadPool.h"
+
+namespace dws::net {
+
+/// Serves requests of RpcChannel clients.
+///
+/// Many calls may be in flight on one connection; responses go out in
+/// completion order and carry the request id.  Responses produced in the
+/// same loop iteration are coalesced into one write.
+class RpcServer : noncopyable {
+ public:
+    /// Completes a call, exactly once, from any thread.
+    using Done = std::function<void(rpc::Status status, const StringPiece& response)>;
+    /// @c request is only valid during the call, copy it to answer later.
+    using Method = std::function<void(const StringPiece& request, const Done& done)>;
+
+    enum Dispatch {
+        kInLoop,    // run in the connection's IO loop, for short non-blocking methods
+        kInWorker,  // run on the worker ThreadPool, the request is copied
+    };
+
+    RpcServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name);
+
+    EventLoop* getLoop() const { return server_.getLoop(); }
+    TcpServer* tcpServer() { return &server_; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    /// Size of the pool running kInWorker methods, they run in the IO loop
+    /// when it is zero.
+    void setWorkerThreadNum(int numThreads) { numWorkers_ = numThreads; }
+    /// Not thread safe, register methods before start().
+    void registerMethod(const std::string& name, Method method, Dispatch dispatch = kInLoop);
+    void start();
+
+ private:
+    struct MethodEntry {
+        Method method;
+        Dispatch dispatch;
+    };
+
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    static Done makeDone(const TcpConnectionPtr& conn, uint64_t id);
+
+    TcpServer server_;
+    std::unordered_map<std::string, MethodEntry> methods_;
+    ThreadPool workers_;
+    int numWorkers_;
+};
+
+}  // namespace dws::net
@@ -0,0 +1,155 @@
+#include "RpcChannel.h"
+
+#include <cassert>
+#include <utility>
+
+#include "CountDownLatch.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+namespace dws::net {
+
+constexpr double RpcChannel::kDefaultTimeoutSeconds;
+
+RpcChannel::RpcChannel(EventLoop* loop, const InetAddress& serverAddr, const std::string& name)
+    : loop_(CHECK_NOTNULL(loop)), client_(loop, serverAddr, name), nextId_(1) {
+    client_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    client_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf,
+                                      Timestamp receiveTime) { onMessage(conn, buf, receiveTime); });
+}
+
+RpcChannel::~RpcChannel() {
+    // pending timers and the connection's callbacks refer to this channel,
+    // TcpClient closes the connection later
+    auto cancelAll = [this] {
+        for (auto& entry : pending_) {
+            loop_->cancel(entry.second.timer);
+        }
+        pending_.clear();
+        if (connection_) {
+            connection_->setConnectionCallback(defaultConnectionCallback);
+            connection_->setMessageCallback(defaultMessageCallback);
+            connection_.reset();
+        }
+    };
+    if (loop_->isInLoopThread()) {
+        cancelAll();
+    } else {
+        CountDownLatch latch(1);
+        loop_->runInLoop([&] {
+            cancelAll();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+}
+
+bool RpcChannel::connected() const {
+    TcpConnectionPtr conn = client_.connection();
+    return conn && conn->connected();
+}
+
+void RpcChannel::call(const StringPiece& method, const StringPiece& request, Callback cb,
+                      double timeoutSeconds) {
+    if (loop_->isInLoopThread()) {
+        callInLoop(method, request, std::move(cb), timeoutSeconds);
+    } else {
+        loop_->queueInLoop([this, method = method.as_string(), request = request.as_string(),
+                            cb = std::move(cb), timeoutSeconds]() mutable {
+            callInLoop(StringPiece(method), StringPiece(request), std::move(cb), timeoutSeconds);
+        });
+    }
+}
+
+rpc::Status RpcChannel::callSync(const StringPiece& method, const StringPiece& request,
+                                 std::string* response, double timeoutSeconds) {
+    assert(!loop_->isInLoopThread());
+    CountDownLatch latch(1);
+    rpc::Status result = rpc::kOk;
+    call(method, request,
+         [&](rpc::Status status, const StringPiece& payload) {
+             result = status;
+             if (response) {
+                 payload.CopyToString(response);
+             }
+             latch.countDown();
+         },
+         timeoutSeconds);
+    latch.wait();
+    return result;
+}
+
+void RpcChannel::callInLoop(const StringPiece& method, const StringPiece& request, Callback cb,
+                            double timeoutSeconds) {
+    loop_->assertInLoopThread();
+    uint64_t id = nextId_++;
+    TimerId timer = loop_->runAfter(timeoutSeconds, [this, id] { onTimeout(id); });
+    pending_.emplace(id, PendingCall{std::move(cb), timer});
+    if (connection_ && connection_->connected()) {
+        // coalesced with the other calls of this loop iteration
+        rpc::appendRequest(connection_->outputBuffer(), id, method, request);
+        connection_->sendOutputBuffer();
+    } else {
+        rpc::appendRequest(&unsent_, id, method, request);
+    }
+}
+
+void RpcChannel::onConnection(const TcpConnectionPtr& conn) {
+    loop_->assertInLoopThread();
+    if (conn->connected()) {
+        conn->setTcpNoDelay(true);
+        conn->setWriteCoalescing(true);
+        connection_ = conn;
+        if (unsent_.readableBytes() > 0) {
+            conn->send(&unsent_);
+        }
+    } else {
+        connection_.reset();
+        failAll(rpc::kConnectionClosed);
+    }
+}
+
+void RpcChannel::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    rpc::Message message;
+    while (true) {
+        rpc::ParseResult result = rpc::parseMessage(*buf, &message);
+        if (result == rpc::kNeedMore) {
+            break;
+        }
+        if (result == rpc::kMalformed || message.type != rpc::kResponse) {
+            LOG(ERROR) << "[RpcChannel::onMessage] " << *conn << " malformed message";
+            buf->retrieveAll();
+            conn->shutdown();
+            break;
+        }
+        auto it = pending_.find(message.id);
+        if (it != pending_.end()) {  // otherwise it has timed out already
+            Callback cb = std::move(it->second.callback);
+            loop_->cancel(it->second.timer);
+            pending_.erase(it);
+            cb(message.status, message.payload);
+        }
+        buf->retrieve(message.bytes);
+    }
+}
+
+void RpcChannel::onTimeout(uint64_t id) {
+    auto it = pending_.find(id);
+    if (it != pending_.end()) {
+        Callback cb = std::move(it->second.callback);
+        pending_.erase(it);
+        cb(rpc::kTimeout, StringPiece());
+    }
+}
+
+void RpcChannel::failAll(rpc::Status status) {
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    unsent_.retrieveAll();
+    for (auto& entry : pending) {
+        loop_->cancel(entry.second.timer);
+        entry.second.callback(status, StringPiece());
+    }
+}
+
+}  // namespace dws::net
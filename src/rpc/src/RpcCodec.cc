@@ -0,0 +1,90 @@
+#include "RpcCodec.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "Buffer.h"
+#include "Endian.h"
+
+namespace dws::net::rpc {
+
+namespace {
+
+void appendHeader(Buffer* out, uint32_t length, uint64_t id, MessageType type, Status status,
+                  uint16_t methodLength) {
+    out->appendInt32(static_cast<int32_t>(length));
+    out->appendInt64(static_cast<int64_t>(id));
+    out->appendInt8(static_cast<int8_t>(type));
+    out->appendInt8(static_cast<int8_t>(status));
+    out->appendInt16(static_cast<int16_t>(methodLength));
+}
+
+}  // namespace
+
+const char* statusString(Status status) {
+    switch (status) {
+        case kOk:
+            return "ok";
+        case kNoSuchMethod:
+            return "no such method";
+        case kBadRequest:
+            return "bad request";
+        case kServerError:
+            return "server error";
+        case kTimeout:
+            return "timeout";
+        case kConnectionClosed:
+            return "connection closed";
+        default:
+            return "unknown status";
+    }
+}
+
+ParseResult parseMessage(const Buffer& buf, Message* message) {
+    if (buf.readableBytes() < kHeaderBytes) {
+        return kNeedMore;
+    }
+    const char* p = buf.peek();
+    uint32_t length = static_cast<uint32_t>(buf.peekInt32());
+    if (length > kMaxMessageBytes) {
+        return kMalformed;
+    }
+    if (buf.readableBytes() < kHeaderBytes + length) {
+        return kNeedMore;
+    }
+    uint64_t id = 0;
+    memcpy(&id, p + 4, sizeof id);
+    uint8_t type = static_cast<uint8_t>(p[12]);
+    uint8_t status = static_cast<uint8_t>(p[13]);
+    uint16_t methodLength = 0;
+    memcpy(&methodLength, p + 14, sizeof methodLength);
+    methodLength = sockets::networkToHost16(methodLength);
+    if (type > kResponse || status > kConnectionClosed || methodLength > length ||
+        (type == kResponse && methodLength != 0)) {
+        return kMalformed;
+    }
+    message->type = static_cast<MessageType>(type);
+    message->status = static_cast<Status>(status);
+    message->id = sockets::networkToHost64(id);
+    message->method = StringPiece(p + kHeaderBytes, methodLength);
+    message->payload = StringPiece(p + kHeaderBytes + methodLength,
+                                   static_cast<int>(length - methodLength));
+    message->bytes = kHeaderBytes + length;
+    return kMessage;
+}
+
+void appendRequest(Buffer* out, uint64_t id, const StringPiece& method,
+                   const StringPiece& payload) {
+    assert(method.size() <= 0xFFFF);
+    appendHeader(out, static_cast<uint32_t>(method.size() + payload.size()), id, kRequest, kOk,
+                 static_cast<uint16_t>(method.size()));
+    out->append(method);
+    out->append(payload);
+}
+
+void appendResponse(Buffer* out, uint64_t id, Status status, const StringPiece& payload) {
+    appendHeader(out, static_cast<uint32_t>(payload.size()), id, kResponse, status, 0);
+    out->append(payload);
+}
+
+}  // namespace dws::net::rpc
@@ -0,0 +1,86 @@
+#include "RpcServer.h"
+
+#include <memory>
+#include <utility>
+
+#include "Logging.h"
+
+namespace dws::net {
+
+RpcServer::RpcServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name)
+    : server_(loop, listenAddr, name), workers_(name + "-worker"), numWorkers_(0) {
+    server_.setConnectionCallback([this](const TcpConnectionPtr& conn) { onConnection(conn); });
+    server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf,
+                                      Timestamp receiveTime) { onMessage(conn, buf, receiveTime); });
+}
+
+void RpcServer::registerMethod(const std::string& name, Method method, Dispatch dispatch) {
+    methods_[name] = MethodEntry{std::move(method), dispatch};
+}
+
+void RpcServer::start() {
+    LOG(INFO) << "[RpcServer::start] RpcServer[" << server_.name() << "] starts listening on "
+              << server_.ipPort() << " with " << methods_.size() << " methods";
+    if (numWorkers_ > 0) {
+        workers_.start(numWorkers_);
+    }
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->setTcpNoDelay(true);
+        conn->setWriteCoalescing(true);
+    }
+}
+
+RpcServer::Done RpcServer::makeDone(const TcpConnectionPtr& conn, uint64_t id) {
+    // a draining connection stays writable until every call is done
+    conn->beginResponse();
+    return [weakConn = std::weak_ptr<TcpConnection>(conn), id](rpc::Status status,
+                                                             const StringPiece& response) {
+        TcpConnectionPtr c = weakConn.lock();
+        if (c) {
+            Buffer buf;
+            rpc::appendResponse(&buf, id, status, response);
+            c->send(&buf);
+            c->endResponse();
+        }
+    };
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    // methods_ is read-only once started, the key's capacity is reused
+    thread_local std::string key;
+    rpc::Message message;
+    while (conn->connected()) {
+        rpc::ParseResult result = rpc::parseMessage(*buf, &message);
+        if (result == rpc::kNeedMore) {
+            break;
+        }
+        if (result == rpc::kMalformed || message.type != rpc::kRequest) {
+            LOG(ERROR) << "[RpcServer::onMessage] " << *conn << " malformed message";
+            buf->retrieveAll();
+            conn->shutdown();
+            break;
+        }
+        key.assign(message.method.data(), message.method.size());
+        auto it = methods_.find(key);
+        if (it == methods_.end()) {
+            Buffer response;
+            rpc::appendResponse(&response, message.id, rpc::kNoSuchMethod, StringPiece());
+            conn->send(&response);
+        } else if (it->second.dispatch == kInWorker && numWorkers_ > 0) {
+            const Method& method = it->second.method;
+            workers_.run([&method, request = message.payload.as_string(),
+                          done = makeDone(conn, message.id)] {
+                method(StringPiece(request), done);
+            });
+        } else {
+            it->second.method(message.payload, makeDone(conn, message.id));
+        }
+        buf->retrieve(message.bytes);
+    }
+}
+
+}  // namespace dws::net
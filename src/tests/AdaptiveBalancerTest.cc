@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "AdaptiveBalancer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+using dws::Timestamp;
+using dws::net::AdaptiveBalancer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+
+namespace {
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done) {
+    dws::net::TimerId check = loop->runEvery(0.01, [loop, &done] {
+        if (done()) {
+            loop->quit();
+        }
+    });
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(check);
+    loop->cancel(timeout);
+}
+
+void sleepFor(EventLoop* loop, double seconds) {
+    Timestamp start = Timestamp::now();
+    runUntil(loop, [start, seconds] {
+        return dws::timeDifference(Timestamp::now(), start) >= seconds;
+    });
+}
+
+std::vector<InetAddress> endpoints(int n) {
+    std::vector<InetAddress> addrs;
+    for (int i = 0; i < n; ++i) {
+        addrs.emplace_back("127.0.0.1", static_cast<uint16_t>(9000 + i));
+    }
+    return addrs;
+}
+
+// Sends as many requests as the limit allows and completes them all.
+void fillAndDrain(AdaptiveBalancer* balancer, double latency) {
+    std::vector<int> taken;
+    for (int index = balancer->acquire(); index >= 0; index = balancer->acquire()) {
+        taken.push_back(index);
+    }
+    for (int index : taken) {
+        balancer->release(index, latency, true);
+    }
+}
+
+}  // namespace
+
+TEST(AdaptiveBalancerTest, SpreadsLoadUpToLimits) {
+    EventLoop loop;
+    AdaptiveBalancer::Options options;
+    options.initialLimit = 2;
+    AdaptiveBalancer balancer(&loop, endpoints(2), options);
+
+    std::vector<int> picked;
+    for (int i = 0; i < 4; ++i) {
+        picked.push_back(balancer.acquire());
+    }
+    std::sort(picked.begin(), picked.end());
+    EXPECT_EQ(picked, std::vector<int>({0, 0, 1, 1}));
+    EXPECT_EQ(balancer.acquire(), -1);
+
+    balancer.release(1, 0.001, true);
+    EXPECT_EQ(balancer.acquire(), 1);
+}
+
+TEST(AdaptiveBalancerTest, EjectsAfterConsecutiveErrorsForCooldown) {
+    EventLoop loop;
+    AdaptiveBalancer::Options options;
+    options.consecutiveErrors = 3;
+    options.baseEjectionSeconds = 0.05;
+    AdaptiveBalancer balancer(&loop, endpoints(3), options);
+
+    // only endpoint 0 fails
+    for (int i = 0; i < 100 && !balancer.ejected(0); ++i) {
+        int index = balancer.acquire();
+        ASSERT_GE(index, 0);
+        balancer.release(index, 0.001, index != 0);
+    }
+    EXPECT_TRUE(balancer.ejected(0));
+    EXPECT_EQ(balancer.numEjected(), 1);
+    for (int i = 0; i < 10; ++i) {
+        int index = balancer.acquire();
+        EXPECT_NE(index, 0);
+        balancer.release(index, 0.001, true);
+    }
+
+    sleepFor(&loop, 0.06);
+    bool picked = false;
+    for (int i = 0; i < 3; ++i) {
+        int index = balancer.acquire();
+        picked = picked || index == 0;
+        balancer.release(index, 0.001, true);
+    }
+    EXPECT_TRUE(picked);
+    EXPECT_FALSE(balancer.ejected(0));
+    EXPECT_EQ(balancer.totalEjections(), 1);
+}
+
+TEST(AdaptiveBalancerTest, EjectsLatencyOutlier) {
+    EventLoop loop;
+    AdaptiveBalancer::Options options;
+    options.intervalSeconds = 0.02;
+    options.minSamples = 10;
+    options.baseEjectionSeconds = 10;
+    AdaptiveBalancer balancer(&loop, endpoints(3), options);
+    balancer.start();
+
+    for (int i = 0; i < 30; ++i) {
+        int index = balancer.acquire();
+        ASSERT_GE(index, 0);
+        balancer.release(index, index == 2 ? 0.02 : 0.002, true);
+    }
+    runUntil(&loop, [&] { return balancer.ejected(2); });
+    EXPECT_TRUE(balancer.ejected(2));
+    EXPECT_FALSE(balancer.ejected(0));
+    EXPECT_FALSE(balancer.ejected(1));
+}
+
+TEST(AdaptiveBalancerTest, KeepsEjectionsUnderFraction) {
+    EventLoop loop;
+    AdaptiveBalancer::Options options;
+    options.consecutiveErrors = 1;
+    AdaptiveBalancer balancer(&loop, endpoints(2), options);
+
+    for (int i = 0; i < 4; ++i) {
+        int index = balancer.acquire();
+        ASSERT_GE(index, 0);
+        balancer.release(index, 0.001, false);
+    }
+    EXPECT_EQ(balancer.numEjected(), 1);
+
+    AdaptiveBalancer single(&loop, endpoints(1), options);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(single.acquire(), 0);
+        single.release(0, 0.001, false);
+    }
+    EXPECT_EQ(single.numEjected(), 0);
+}
+
+TEST(AdaptiveBalancerTest, LimitFollowsLatency) {
+    EventLoop loop;
+    AdaptiveBalancer::Options options;
+    options.initialLimit = 4;
+    options.maxLimit = 64;
+    AdaptiveBalancer balancer(&loop, endpoints(1), options);
+
+    for (int i = 0; i < 50; ++i) {
+        fillAndDrain(&balancer, 0.001);
+    }
+    EXPECT_EQ(balancer.limit(0), 64);
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(balancer.acquire(), 0);
+        balancer.release(0, 0.001, false);
+    }
+    EXPECT_LT(balancer.limit(0), 40);
+    for (int i = 0; i < 20; ++i) {
+        fillAndDrain(&balancer, 0.001);
+    }
+    EXPECT_EQ(balancer.limit(0), 64);
+
+    // ten times slower under the same load, the backend is queueing
+    for (int i = 0; i < 3; ++i) {
+        fillAndDrain(&balancer, 0.01);
+    }
+    EXPECT_LT(balancer.limit(0), 32);
+    EXPECT_GE(balancer.limit(0), options.minLimit);
+}
@@ -0,0 +1,159 @@
+#include <dirent.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncLogging.h"
+#include "DeferredLogging.h"
+
+using dws::AsyncLogging;
+
+namespace {
+
+// Runs @c fn in a fresh directory, LogFile takes no paths, and returns
+// everything written to the files there.
+template <typename Fn>
+std::string logInTempDir(Fn fn) {
+    char dir[] = "/tmp/dws_async_logging_XXXXXX";
+    EXPECT_NE(mkdtemp(dir), nullptr);
+    char cwd[4096];
+    EXPECT_NE(getcwd(cwd, sizeof cwd), nullptr);
+    EXPECT_EQ(chdir(dir), 0);
+    fn();
+    EXPECT_EQ(chdir(cwd), 0);
+
+    std::vector<std::string> files;
+    DIR* d = opendir(dir);
+    while (struct dirent* entry = readdir(d)) {
+        if (entry->d_name[0] != '.') {
+            files.push_back(std::string(dir) + "/" + entry->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    std::string content;
+    for (const std::string& file : files) {
+        std::ifstream in(file);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        content += ss.str();
+        unlink(file.c_str());
+    }
+    rmdir(dir);
+    return content;
+}
+
+void append(AsyncLogging* log, const std::string& line) {
+    log->append(line.data(), static_cast<int>(line.size()));
+}
+
+std::string g_captured;
+
+void capture(const char* msg, int len) { g_captured.append(msg, len); }
+
+void toStdout(const char* msg, int len) { fwrite(msg, 1, len, stdout); }
+
+}  // namespace
+
+TEST(AsyncLoggingTest, KeepsEveryLineInThreadOrder) {
+    const int kThreads = 4;
+    const int kLines = 50000;  // several staging chunks per thread
+    std::string content = logInTempDir([&] {
+        AsyncLogging log("async", 1024 * 1024 * 1024);
+        log.start();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < kLines; ++i) {
+                    append(&log, std::to_string(t) + " " + std::to_string(i) + "\n");
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        log.stop();
+    });
+
+    std::vector<int> next(kThreads, 0);
+    std::istringstream in(content);
+    int t, i;
+    int lines = 0;
+    while (in >> t >> i) {
+        ASSERT_GE(t, 0);
+        ASSERT_LT(t, kThreads);
+        ASSERT_EQ(i, next[t]);
+        ++next[t];
+        ++lines;
+    }
+    EXPECT_EQ(lines, kThreads * kLines);
+}
+
+TEST(AsyncLoggingTest, MergesThreadsByTime) {
+    std::string content = logInTempDir([] {
+        AsyncLogging log("ordered", 1024 * 1024 * 1024);
+        log.setOrderedByTime(true);
+        log.start();
+        append(&log, "1\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::thread([&log] { append(&log, "2\n"); }).join();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        append(&log, "3\n");
+        log.stop();
+        append(&log, "after stop\n");
+    });
+    EXPECT_EQ(content, "1\n2\n3\n");
+}
+
+TEST(AsyncLoggingTest, FormatsDeferredRecordsInLoggingThread) {
+    std::string content = logInTempDir([] {
+        AsyncLogging log("deferred", 1024 * 1024 * 1024);
+        dws::setDeferredLogging(&log);
+        log.start();
+        std::string name = "alice";
+        LOG_FMT(INFO, "user %s took %d us, ratio %.2f", name, 42, 0.5);
+        append(&log, "plain\n");
+        LOG_FMT(WARN, "[%5s|%-4d|%x|%c|%%|%.*s|%s|%lld|%zu]", "ab", -7, 255u, 'z', 3, "abcdef",
+                dws::StringPiece("piece"), -(1LL << 40), sizeof(int64_t));
+        LOG_FMT(DEBUG, "below the level, %d", 1);
+        log.stop();
+        dws::setDeferredLogging(nullptr);
+    });
+
+    std::istringstream in(content);
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_NE(line.find("INFO  "), std::string::npos) << line;
+    EXPECT_NE(line.find(" user alice took 42 us, ratio 0.50 - AsyncLoggingTest.cc:"),
+              std::string::npos)
+            << line;
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_EQ(line, "plain");
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_NE(line.find("WARN  "), std::string::npos) << line;
+    EXPECT_NE(line.find(" [   ab|-7  |ff|z|%|abc|piece|-1099511627776|8] - "), std::string::npos)
+            << line;
+    EXPECT_FALSE(std::getline(in, line)) << line;
+}
+
+TEST(AsyncLoggingTest, FormatsDeferredRecordsInPlaceWithoutLoggingThread) {
+    g_captured.clear();
+    dws::Logger::setOutput(capture);
+    LOG_FMT(INFO, "%d apples and %s", 3, "pears");
+    // a record beyond the stack buffer keeps all its arguments
+    LOG_FMT(INFO, "n=%d s=%.5s", 42, std::string(3995, 'x'));
+    dws::Logger::setOutput(toStdout);
+    EXPECT_NE(g_captured.find(" 3 apples and pears - AsyncLoggingTest.cc:"), std::string::npos)
+            << g_captured;
+    EXPECT_NE(g_captured.find(" n=42 s=xxxxx - AsyncLoggingTest.cc:"), std::string::npos)
+            << g_captured;
+}
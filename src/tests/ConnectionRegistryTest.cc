@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+
+#include "ConnectionRegistry.h"
+
+using dws::net::ConnectionId;
+using dws::net::ConnectionRegistry;
+
+TEST(ConnectionRegistryTest, IdLayout) {
+    ConnectionId id = ConnectionRegistry::makeId(3, 7, 42);
+    EXPECT_EQ(ConnectionRegistry::loopIndexOf(id), 3);
+    EXPECT_EQ(ConnectionRegistry::generationOf(id), 7u);
+    EXPECT_EQ(ConnectionRegistry::slotOf(id), 42u);
+}
+
+TEST(ConnectionRegistryTest, ReuseSlotWithNewGeneration) {
+    ConnectionRegistry registry;
+    ConnectionId a = registry.allocate(1);
+    ConnectionId b = registry.allocate(2);
+    EXPECT_EQ(registry.size(), 2u);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(ConnectionRegistry::loopIndexOf(b), 2);
+
+    EXPECT_TRUE(registry.remove(a));
+    EXPECT_FALSE(registry.remove(a));
+    EXPECT_EQ(registry.size(), 1u);
+
+    ConnectionId c = registry.allocate(1);
+    EXPECT_EQ(ConnectionRegistry::slotOf(c), ConnectionRegistry::slotOf(a));
+    EXPECT_NE(c, 0u);
+    EXPECT_NE(ConnectionRegistry::generationOf(c), ConnectionRegistry::generationOf(a));
+    EXPECT_FALSE(registry.remove(a));
+    EXPECT_TRUE(registry.remove(c));
+    EXPECT_TRUE(registry.remove(b));
+    EXPECT_TRUE(registry.empty());
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Buffer.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "FileUtil.h"
+#include "InetAddress.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::Connector;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpClient;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+// A listener on [::1]:port whose accept queue is full, so that further
+// SYNs are dropped and connecting hangs like to a broken route.
+class Blackhole {
+ public:
+    explicit Blackhole(uint16_t port) : listenFd_(::socket(AF_INET6, SOCK_STREAM, 0)) {
+        addr_ = InetAddress("::1", port, true);
+        int on = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+        EXPECT_EQ(::bind(listenFd_, addr_.getSockAddr(), addr_.length()), 0);
+        EXPECT_EQ(::listen(listenFd_, 0), 0);
+        for (int i = 0; i < 2; ++i) {
+            int fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            ::connect(fd, addr_.getSockAddr(), addr_.length());
+            fillers_.push_back(fd);
+        }
+        ::usleep(50 * 1000);
+    }
+    ~Blackhole() {
+        for (int fd : fillers_) {
+            ::close(fd);
+        }
+        ::close(listenFd_);
+    }
+
+    const InetAddress& address() const { return addr_; }
+
+ private:
+    int listenFd_;
+    InetAddress addr_;
+    std::vector<int> fillers_;
+};
+
+struct Outcome {
+    bool connected = false;
+    std::string peer;
+    double seconds = 0;
+};
+
+Outcome connectTo(EventLoop* loop, std::vector<InetAddress> addresses, double attemptDelay) {
+    Outcome outcome;
+    auto connector = std::make_shared<Connector>(loop, std::move(addresses));
+    connector->setAttemptDelay(attemptDelay);
+    Timestamp start = Timestamp::now();
+    connector->setNewConnectionCallback([&](int sockfd) {
+        outcome.connected = true;
+        outcome.seconds = dws::timeDifference(Timestamp::now(), start);
+        outcome.peer = connector->serverAddress().toIpPort();
+        ::close(sockfd);
+        loop->quit();
+    });
+    connector->start();
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(timeout);
+    connector->stop();
+    loop->queueInLoop([connector] {});  // stopInLoop() captures a raw pointer
+    return outcome;
+}
+
+}  // namespace
+
+TEST(ConnectorTest, RacesPastUnresponsiveAddress) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(29304, true), "Good");
+    server.start();
+    Blackhole blackhole(29305);
+
+    // IPv6 first but stuck, IPv4 starts after the attempt delay and wins
+    Outcome outcome = connectTo(
+            &loop, {blackhole.address(), InetAddress("127.0.0.1", 29304)}, 0.05);
+    EXPECT_TRUE(outcome.connected);
+    EXPECT_EQ(outcome.peer, "127.0.0.1:29304");
+    EXPECT_GE(outcome.seconds, 0.04);
+    EXPECT_LT(outcome.seconds, 0.9);  // the SYN retransmit would take a second
+}
+
+TEST(ConnectorTest, FailedAttemptStartsNextAtOnce) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(29306, true), "Good");
+    server.start();
+
+    // nothing listens on [::1]:29307, the delay is never waited for
+    Outcome outcome = connectTo(
+            &loop, {InetAddress("::1", 29307, true), InetAddress("127.0.0.1", 29306)}, 3.0);
+    EXPECT_TRUE(outcome.connected);
+    EXPECT_EQ(outcome.peer, "127.0.0.1:29306");
+    EXPECT_LT(outcome.seconds, 1.0);
+}
+
+TEST(ConnectorTest, InterleavesFamilies) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(29308, true), "Good");
+    server.start();
+    Blackhole first(29309);
+    Blackhole second(29310);
+
+    // given v6, v6, v4 the v4 address goes second, one delay in
+    Outcome outcome = connectTo(
+            &loop, {first.address(), second.address(), InetAddress("127.0.0.1", 29308)}, 0.2);
+    EXPECT_TRUE(outcome.connected);
+    EXPECT_EQ(outcome.peer, "127.0.0.1:29308");
+    EXPECT_GE(outcome.seconds, 0.19);
+    EXPECT_LT(outcome.seconds, 0.35);
+}
+
+namespace {
+
+bool fastOpenEnabled() {
+    std::string value;
+    dws::FileUtil::readFile("/proc/sys/net/ipv4/tcp_fastopen", 64, &value);
+    return (std::atoi(value.c_str()) & 3) == 3;
+}
+
+struct Received {
+    std::string data;
+    bool synData = false;
+};
+
+// Connects to a server, sends "second\n" from the connection callback and
+// returns what the server got first and whether it came with the SYN.
+Received fastOpenRound(EventLoop* loop, TcpServer* server, const InetAddress& addr) {
+    Received received;
+    server->setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        struct tcp_info info;
+        if (conn->connected() && conn->getTcpInfo(&info)) {
+            received.synData = (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+        }
+    });
+    server->setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        received.data += buf->retrieveAllAsString();
+        if (received.data.size() >= 13) {
+            conn->shutdown();
+        }
+    });
+    TcpClient client(loop, addr, "FastOpenClient");
+    client.setFastOpenData("GET /\n");
+    client.setConnectionCallback([loop](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->send(dws::StringPiece("second\n"));
+        } else {
+            loop->quit();
+        }
+    });
+    client.connect();
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(timeout);
+    return received;
+}
+
+}  // namespace
+
+TEST(ConnectorTest, FastOpenDataGoesFirst) {
+    EventLoop loop;
+    InetAddress addr(29316, true);
+    TcpServer server(&loop, addr, "FastOpen");
+    server.setFastOpen(16);
+    server.start();
+
+    // the first connection fetches the cookie unless the kernel has it
+    // from an earlier run, the second one uses it
+    Received first = fastOpenRound(&loop, &server, addr);
+    EXPECT_EQ(first.data, "GET /\nsecond\n");
+    Received second = fastOpenRound(&loop, &server, addr);
+    EXPECT_EQ(second.data, "GET /\nsecond\n");
+    if (fastOpenEnabled()) {
+        EXPECT_TRUE(second.synData);
+    }
+
+    // no SYN to carry anything, written after connecting
+    InetAddress unixAddr =
+            InetAddress::fromUnixPath("@dws-fastopen-test-" + std::to_string(::getpid()));
+    TcpServer unixServer(&loop, unixAddr, "FastOpenUnix");
+    unixServer.setFastOpen(16);
+    unixServer.start();
+    EXPECT_EQ(fastOpenRound(&loop, &unixServer, unixAddr).data, "GET /\nsecond\n");
+}
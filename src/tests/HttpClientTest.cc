@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <any>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "EventLoop.h"
+#include "HttpClient.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "TcpServer.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::HttpClient;
+using dws::net::HttpClientResponse;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpServer;
+using dws::net::InetAddress;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+TEST(HttpClientTest, ReusesAndPipelinesKeepAliveConnections) {
+    EventLoop loop;
+    InetAddress serverAddr(29279, true);
+    HttpServer server(&loop, serverAddr, "HttpClientTestServer");
+    server.setThreadNum(1);
+    server.setHttpCallback([](const HttpRequest& req, HttpResponse* resp) {
+        std::string body = req.path().as_string();
+        body.append(req.body().data(), req.body().size());
+        resp->setBody(StringPiece(body));
+    });
+    server.start();
+
+    HttpClient::Options options;
+    options.maxConnectionsPerHost = 2;
+    options.maxPipelineDepth = 8;
+    HttpClient client(&loop, "HttpClientTest", options);
+
+    // one request at a time shares a single connection
+    const int kSequential = 10;
+    int sequential = 0;
+    std::function<void()> next = [&] {
+        client.get(serverAddr, "/seq" + std::to_string(sequential),
+                   [&](HttpClient::Error error, const HttpClientResponse& resp) {
+                       ASSERT_EQ(error, HttpClient::kOk);
+                       EXPECT_EQ(resp.statusCode(), 200);
+                       EXPECT_EQ(resp.body().as_string(), "/seq" + std::to_string(sequential));
+                       if (++sequential < kSequential) {
+                           next();
+                       } else {
+                           loop.quit();
+                       }
+                   });
+    };
+    next();
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    EXPECT_EQ(sequential, kSequential);
+    EXPECT_EQ(client.numConnects(), 1u);
+
+    // a burst fills the pool, then pipelines, answers keep their requests
+    const int kBurst = 16;
+    std::vector<std::string> bodies(kBurst);
+    int done = 0;
+    for (int i = 0; i < kBurst; ++i) {
+        HttpClient::Request request;
+        request.method = i % 4 == 0 ? HttpRequest::kPost : HttpRequest::kGet;
+        request.target = "/burst" + std::to_string(i);
+        request.body = i % 4 == 0 ? "+body" : "";
+        client.send(serverAddr, request, [&, i](HttpClient::Error error,
+                                                const HttpClientResponse& resp) {
+            EXPECT_EQ(error, HttpClient::kOk);
+            bodies[i] = resp.body().as_string();
+            if (++done == kBurst) {
+                loop.quit();
+            }
+        });
+    }
+    EXPECT_EQ(client.numInFlight(), static_cast<std::size_t>(kBurst));
+    loop.loop();
+    ASSERT_EQ(done, kBurst);
+    for (int i = 0; i < kBurst; ++i) {
+        EXPECT_EQ(bodies[i], "/burst" + std::to_string(i) + (i % 4 == 0 ? "+body" : ""));
+    }
+    EXPECT_EQ(client.numConnects(), 2u);
+    EXPECT_EQ(client.numInFlight(), 0u);
+}
+
+TEST(HttpClientTest, ConnectFailureAndRequestTimeout) {
+    EventLoop loop;
+    // accepts and never answers
+    InetAddress silentAddr(29280, true);
+    TcpServer silent(&loop, silentAddr, "HttpClientTestSilent");
+    silent.setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+        buf->retrieveAll();
+    });
+    silent.start();
+
+    HttpClient::Options options;
+    options.requestTimeoutSeconds = 0.2;
+    options.maxInFlight = 2;
+    HttpClient client(&loop, "HttpClientTest", options);
+
+    std::vector<HttpClient::Error> errors;
+    auto record = [&](HttpClient::Error error, const HttpClientResponse& resp) {
+        EXPECT_EQ(resp.statusCode(), 0);
+        errors.push_back(error);
+        if (errors.size() == 3) {
+            loop.quit();
+        }
+    };
+    client.get(InetAddress(29281, true), "/", record);  // nothing listens there
+    client.get(silentAddr, "/", record);
+    client.get(silentAddr, "/", record);  // over maxInFlight, fails right away
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+
+    ASSERT_EQ(errors.size(), 3u);
+    EXPECT_EQ(errors[0], HttpClient::kOverloaded);
+    EXPECT_EQ(errors[1], HttpClient::kConnectFailed);
+    EXPECT_EQ(errors[2], HttpClient::kTimeout);
+    EXPECT_EQ(client.numInFlight(), 0u);
+}
+
+TEST(HttpClientTest, ResendsIdempotentRequestOnStaleConnection) {
+    EventLoop loop;
+    InetAddress serverAddr(29279, true);
+    // answers the first request of a connection and closes it on the next,
+    // like a server dropping an idle keep-alive connection just as it is reused
+    TcpServer server(&loop, serverAddr, "HttpClientTestStale");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setContext(0);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        buf->retrieveAll();
+        int* requests = std::any_cast<int>(conn->getMutableContext());
+        if ((*requests)++ == 0) {
+            conn->send(StringPiece("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"));
+        } else {
+            conn->forceClose();
+        }
+    });
+    server.start();
+
+    HttpClient client(&loop, "HttpClientTest");
+    int ok = 0;
+    HttpClient::Error postError = HttpClient::kOk;
+    client.get(serverAddr, "/", [&](HttpClient::Error error, const HttpClientResponse&) {
+        ASSERT_EQ(error, HttpClient::kOk);
+        ++ok;
+        // goes out again on a new connection
+        client.get(serverAddr, "/", [&](HttpClient::Error e, const HttpClientResponse& r) {
+            EXPECT_EQ(e, HttpClient::kOk);
+            EXPECT_EQ(r.body(), StringPiece("ok"));
+            ++ok;
+            // may have had side effects, so it is not sent again
+            HttpClient::Request post;
+            post.method = HttpRequest::kPost;
+            client.send(serverAddr, post, [&](HttpClient::Error pe, const HttpClientResponse&) {
+                postError = pe;
+                loop.quit();
+            });
+        });
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+
+    EXPECT_EQ(ok, 2);
+    EXPECT_EQ(postError, HttpClient::kConnectionClosed);
+    EXPECT_EQ(client.numConnects(), 2u);
+}
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "Buffer.h"
+#include "HttpParser.h"
+#include "HttpResponse.h"
+#include "HttpResponseParser.h"
+
+using dws::StringPiece;
+using dws::net::Buffer;
+using dws::net::HttpParser;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpResponseParser;
+
+TEST(HttpParserTest, RequestLineAndHeaders) {
+    Buffer buf;
+    buf.append(StringPiece("GET /index.html?a=1 HTTP/1.1\r\nHost: example.com\r\n"
+                           "X-Trace :bad\r\n"));
+    HttpParser parser;
+    EXPECT_EQ(parser.parse(buf), HttpParser::kError);
+    EXPECT_EQ(parser.errorStatus(), 400);
+
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(StringPiece("GET /index.html?a=1 HTTP/1.1\r\nHost: example.com\r\n"
+                           "user-agent:  curl \r\n\r\n"));
+    ASSERT_EQ(parser.parse(buf), HttpParser::kComplete);
+    const HttpRequest& req = parser.request();
+    EXPECT_EQ(req.method(), HttpRequest::kGet);
+    EXPECT_EQ(req.version(), HttpRequest::kHttp11);
+    EXPECT_EQ(req.path(), StringPiece("/index.html"));
+    EXPECT_EQ(req.query(), StringPiece("a=1"));
+    EXPECT_EQ(req.getHeader(StringPiece("User-Agent")), StringPiece("curl"));
+    EXPECT_EQ(req.numHeaders(), 2u);
+    EXPECT_TRUE(req.keepAlive());
+    EXPECT_EQ(parser.messageBytes(), buf.readableBytes());
+    // views point into the buffer, not into copies
+    EXPECT_EQ(req.path().data(), buf.peek() + 4);
+}
+
+TEST(HttpParserTest, ByteByByteAndPipelined) {
+    const std::string first = "POST /a HTTP/1.1\r\nHost: h\r\nContent-Length: 5\r\n\r\nhello";
+    const std::string second = "GET /b HTTP/1.0\r\n\r\n";
+    Buffer buf;
+    HttpParser parser;
+    HttpParser::Result result = HttpParser::kNeedMore;
+    for (char c : first) {
+        ASSERT_EQ(result, HttpParser::kNeedMore);
+        buf.append(&c, 1);
+        result = parser.parse(buf);
+    }
+    ASSERT_EQ(result, HttpParser::kComplete);
+    EXPECT_EQ(parser.request().body(), StringPiece("hello"));
+
+    // two requests in one read
+    buf.append(StringPiece(second));
+    ASSERT_EQ(parser.parse(buf), HttpParser::kComplete);
+    EXPECT_EQ(parser.messageBytes(), first.size());
+    buf.retrieve(parser.messageBytes());
+    parser.reset();
+    ASSERT_EQ(parser.parse(buf), HttpParser::kComplete);
+    EXPECT_EQ(parser.request().path(), StringPiece("/b"));
+    EXPECT_EQ(parser.request().version(), HttpRequest::kHttp10);
+    EXPECT_FALSE(parser.request().keepAlive());
+}
+
+TEST(HttpParserTest, ChunkedBody) {
+    Buffer buf;
+    buf.append(StringPiece("PUT /c HTTP/1.1\r\nHost: h\r\nTransfer-Encoding: chunked\r\n\r\n"
+                           "5;ext=1\r\nhello\r\n"));
+    HttpParser parser;
+    EXPECT_EQ(parser.parse(buf), HttpParser::kNeedMore);
+    buf.append(StringPiece("7\r\n, world\r\n0\r\nTrailer: x\r\n\r\n"));
+    ASSERT_EQ(parser.parse(buf), HttpParser::kComplete);
+    EXPECT_TRUE(parser.request().chunked());
+    EXPECT_EQ(parser.request().body(), StringPiece("hello, world"));
+    EXPECT_EQ(parser.messageBytes(), buf.readableBytes());
+}
+
+TEST(HttpParserTest, Limits) {
+    Buffer buf;
+    HttpParser parser(16);
+    buf.append(StringPiece("POST / HTTP/1.1\r\nHost: h\r\nContent-Length: 17\r\n\r\n"));
+    EXPECT_EQ(parser.parse(buf), HttpParser::kError);
+    EXPECT_EQ(parser.errorStatus(), 413);
+
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(StringPiece("GET / HTTP/2.0\r\n\r\n"));
+    EXPECT_EQ(parser.parse(buf), HttpParser::kError);
+    EXPECT_EQ(parser.errorStatus(), 505);
+
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(StringPiece("POST / HTTP/1.1\r\nHost: h\r\nContent-Length: 1\r\n"
+                           "Transfer-Encoding: chunked\r\n\r\n"));
+    EXPECT_EQ(parser.parse(buf), HttpParser::kError);
+    EXPECT_EQ(parser.errorStatus(), 400);
+
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(std::string(HttpParser::kMaxHeaderBytes + 1, 'a').data(),
+               HttpParser::kMaxHeaderBytes + 1);
+    EXPECT_EQ(parser.parse(buf), HttpParser::kError);
+    EXPECT_EQ(parser.errorStatus(), 431);
+}
+
+TEST(HttpResponseTest, WritesIntoBuffer) {
+    Buffer out;
+    {
+        HttpResponse resp(&out, false);
+        resp.setStatusCode(404);
+        resp.setContentType(StringPiece("text/plain"));
+        resp.setBody(StringPiece("nope"));
+    }
+    EXPECT_EQ(out.retrieveAllAsString(),
+              "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+              "Content-Length: 4\r\n\r\nnope");
+
+    HttpResponse chunked(&out, true);
+    chunked.beginChunked();
+    chunked.appendChunk(StringPiece("0123456789abcdefg"));
+    chunked.finish();
+    EXPECT_TRUE(chunked.finished());
+    EXPECT_EQ(out.retrieveAllAsString(),
+              "HTTP/1.1 200 OK\r\nConnection: close\r\nTransfer-Encoding: chunked\r\n\r\n"
+              "11\r\n0123456789abcdefg\r\n0\r\n\r\n");
+}
+
+TEST(HttpResponseParserTest, BodyFraming) {
+    Buffer buf;
+    buf.append(StringPiece("HTTP/1.1 100 Continue\r\n\r\n"
+                           "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n"));
+    HttpResponseParser parser;
+    ASSERT_EQ(parser.parse(buf, false), HttpResponseParser::kComplete);
+    EXPECT_EQ(parser.response().statusCode(), 100);
+    buf.retrieve(parser.messageBytes());
+    parser.reset();
+    EXPECT_EQ(parser.parse(buf, false), HttpResponseParser::kNeedMore);
+    buf.append(StringPiece("1\r\nd\r\n0\r\n\r\n"));
+    ASSERT_EQ(parser.parse(buf, false), HttpResponseParser::kComplete);
+    EXPECT_EQ(parser.response().reason(), StringPiece("OK"));
+    EXPECT_EQ(parser.response().body(), StringPiece("abcd"));
+    EXPECT_TRUE(parser.response().keepAlive());
+
+    // HEAD responses carry the length of a body that is not sent
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(StringPiece("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n"
+                           "HTTP/1.1 204\r\n\r\n"));
+    ASSERT_EQ(parser.parse(buf, true), HttpResponseParser::kComplete);
+    EXPECT_TRUE(parser.response().body().empty());
+    buf.retrieve(parser.messageBytes());
+    parser.reset();
+    ASSERT_EQ(parser.parse(buf, false), HttpResponseParser::kComplete);
+    EXPECT_EQ(parser.response().statusCode(), 204);
+    EXPECT_EQ(parser.messageBytes(), buf.readableBytes());
+
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(StringPiece("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\nuntil"));
+    EXPECT_EQ(parser.parse(buf, false), HttpResponseParser::kNeedMore);
+    buf.append(StringPiece(" close"));
+    EXPECT_EQ(parser.parse(buf, false), HttpResponseParser::kNeedMore);
+    ASSERT_EQ(parser.parseAtClose(buf), HttpResponseParser::kComplete);
+    EXPECT_EQ(parser.response().body(), StringPiece("until close"));
+    EXPECT_FALSE(parser.response().keepAlive());
+
+    buf.retrieveAll();
+    parser.reset();
+    buf.append(StringPiece("HTTP/1.1 2x0 OK\r\n\r\n"));
+    EXPECT_EQ(parser.parse(buf, false), HttpResponseParser::kError);
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+
+using dws::StringPiece;
+using dws::net::EventLoop;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpServer;
+using dws::net::InetAddress;
+
+TEST(HttpServerTest, PipelinedRequestsAnsweredInOrder) {
+    EventLoop loop;
+    InetAddress listenAddr(29274, true);
+    HttpServer server(&loop, listenAddr, "HttpTest");
+    server.setThreadNum(1);
+    server.setHttpCallback([](const HttpRequest& req, HttpResponse* resp) {
+        resp->setBody(req.path());
+    });
+    server.start();
+
+    std::string received;
+    std::thread client([&] {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ASSERT_EQ(::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+        const std::string requests =
+                "GET /1 HTTP/1.1\r\nHost: h\r\n\r\n"
+                "POST /22 HTTP/1.1\r\nHost: h\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"
+                "GET /333 HTTP/1.1\r\nHost: h\r\nConnection: close\r\n\r\n";
+        ASSERT_EQ(::write(fd, requests.data(), requests.size()),
+                  static_cast<ssize_t>(requests.size()));
+        char buf[1024];
+        ssize_t n = 0;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+            received.append(buf, n);
+        }
+        ::close(fd);
+        loop.quit();
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    EXPECT_EQ(received,
+              "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n/1"
+              "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\n/22"
+              "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 4\r\n\r\n/333");
+}
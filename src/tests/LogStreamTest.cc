@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "LogStream.h"
+
+using dws::LogStream;
+
+namespace {
+
+template <typename T>
+std::string format(T v) {
+    LogStream os;
+    os << v;
+    return os.buffer().toString();
+}
+
+}  // namespace
+
+TEST(LogStreamTest, FormatsIntegerLimits) {
+    EXPECT_EQ(format(0), "0");
+    EXPECT_EQ(format(7), "7");
+    EXPECT_EQ(format(-7), "-7");
+    EXPECT_EQ(format(10), "10");
+    EXPECT_EQ(format(-99), "-99");
+    EXPECT_EQ(format(100), "100");
+    EXPECT_EQ(format(static_cast<short>(-32768)), "-32768");
+    EXPECT_EQ(format(static_cast<unsigned short>(65535)), "65535");
+    EXPECT_EQ(format(std::numeric_limits<int>::min()), "-2147483648");
+    EXPECT_EQ(format(std::numeric_limits<int>::max()), "2147483647");
+    EXPECT_EQ(format(std::numeric_limits<unsigned>::max()), "4294967295");
+    EXPECT_EQ(format(std::numeric_limits<int64_t>::min()), "-9223372036854775808");
+    EXPECT_EQ(format(std::numeric_limits<int64_t>::max()), "9223372036854775807");
+    EXPECT_EQ(format(std::numeric_limits<uint64_t>::max()), "18446744073709551615");
+}
+
+TEST(LogStreamTest, FormatsIntegersLikeToString) {
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 10000; ++i) {
+        int64_t v = static_cast<int64_t>(rng() >> (rng() % 64));
+        ASSERT_EQ(format(v), std::to_string(v));
+        ASSERT_EQ(format(-v), std::to_string(-v));
+    }
+}
+
+TEST(LogStreamTest, FormatsPointersInHex) {
+    EXPECT_EQ(format(reinterpret_cast<const void *>(0)), "0x0");
+    EXPECT_EQ(format(reinterpret_cast<const void *>(0xdeadbeef)), "0xDEADBEEF");
+}
+
+TEST(LogStreamTest, FormatsShortestRoundTripDoubles) {
+    EXPECT_EQ(format(0.0), "0");
+    EXPECT_EQ(format(-0.0), "-0");
+    EXPECT_EQ(format(0.1), "0.1");
+    EXPECT_EQ(format(1.5), "1.5");
+    EXPECT_EQ(format(-2.25), "-2.25");
+    EXPECT_EQ(format(1e20), "1e+20");
+    EXPECT_EQ(format(1e-7), "1e-07");
+    EXPECT_EQ(format(0.1f), "0.1");
+    EXPECT_EQ(format(std::numeric_limits<double>::infinity()), "inf");
+
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 10000; ++i) {
+        uint64_t bits = rng();
+        double v;
+        memcpy(&v, &bits, sizeof v);
+        if (v != v || v - v != 0) {
+            continue;  // nan or inf
+        }
+        std::string s = format(v);
+        ASSERT_EQ(strtod(s.c_str(), nullptr), v) << s;
+    }
+}
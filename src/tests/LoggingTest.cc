@@ -0,0 +1,96 @@
+// TRACE statements of this file are compiled out, whatever the level.
+#undef DWS_LOG_MIN_LEVEL
+#define DWS_LOG_MIN_LEVEL DEBUG
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "Logging.h"
+
+using dws::Logger;
+
+namespace {
+
+std::string g_logged;
+
+void capture(const char *msg, int len) { g_logged.append(msg, len); }
+
+// Collects what is logged in its scope into g_logged, then gives the
+// output back to whoever had it.
+class CaptureOutput {
+ public:
+    CaptureOutput() : saved_(Logger::output()) {
+        g_logged.clear();
+        Logger::setOutput(capture);
+    }
+    ~CaptureOutput() { Logger::setOutput(saved_); }
+
+ private:
+    Logger::OutputFunc saved_;
+};
+
+// the levels of the lines logged by a statement of each level in this file
+std::string logEveryLevel() {
+    {
+        CaptureOutput capturing;
+        LOG_DEBUG << "d";
+        LOG_INFO << "i";
+        LOG_WARN << "w";
+        LOG_ERROR << "e";
+    }
+    std::string levels;
+    for (char level : {'D', 'I', 'W', 'E'}) {
+        if (g_logged.find(std::string(1, static_cast<char>(tolower(level))) + " - LoggingTest") !=
+            std::string::npos) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+int g_evaluated = 0;
+
+int evaluate() { return ++g_evaluated; }
+
+}  // namespace
+
+TEST(LoggingTest, FollowsTheLevelOfTheModule) {
+    Logger::LogLevel saved = Logger::logLevel();
+    Logger::setLogLevel(Logger::ERROR);
+    EXPECT_EQ(logEveryLevel(), "E");
+
+    Logger::setLogLevel("tests", Logger::INFO);  // the directory
+    EXPECT_EQ(Logger::lowestLogLevel(), Logger::INFO);
+    EXPECT_EQ(logEveryLevel(), "IWE");
+
+    Logger::setLogLevel("LoggingTest", Logger::DEBUG);  // the file wins
+    EXPECT_EQ(logEveryLevel(), "DIWE");
+
+    Logger::setLogLevel("LoggingTest", Logger::WARN);
+    EXPECT_EQ(logEveryLevel(), "WE");
+
+    Logger::clearLogLevel("LoggingTest");
+    EXPECT_EQ(logEveryLevel(), "IWE");
+
+    Logger::clearLogLevel("tests");
+    EXPECT_EQ(Logger::lowestLogLevel(), Logger::ERROR);
+    EXPECT_EQ(logEveryLevel(), "E");
+
+    Logger::setLogLevel(saved);
+}
+
+TEST(LoggingTest, CompilesOutStatementsBelowTheMinimum) {
+    Logger::LogLevel saved = Logger::logLevel();
+    Logger::setLogLevel(Logger::TRACE);
+    {
+        CaptureOutput capturing;
+        g_evaluated = 0;
+        LOG_TRACE << evaluate();
+        LOG(TRACE) << evaluate();
+        EXPECT_EQ(g_evaluated, 0);
+        LOG_DEBUG << evaluate();
+        EXPECT_EQ(g_evaluated, 1);
+    }
+    Logger::setLogLevel(saved);
+}
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "ItemStore.h"
+#include "MemcacheCodec.h"
+#include "MemcacheServer.h"
+
+using dws::StringPiece;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::MemcacheServer;
+using dws::net::memcache::ItemStore;
+namespace memcache = dws::net::memcache;
+namespace binary = dws::net::memcache::binary;
+
+namespace {
+
+std::string valueOf(const ItemStore::Item* item) {
+    return item == nullptr ? "<null>" : std::string(item->value(), item->valueBytes);
+}
+
+void appendBinaryRequest(Buffer* out, uint8_t opcode, const std::string& extras,
+                         const std::string& key, const std::string& value) {
+    out->appendInt8(static_cast<int8_t>(binary::kRequestMagic));
+    out->appendInt8(static_cast<int8_t>(opcode));
+    out->appendInt16(static_cast<int16_t>(key.size()));
+    out->appendInt8(static_cast<int8_t>(extras.size()));
+    out->appendInt8(0);
+    out->appendInt16(0);
+    out->appendInt32(static_cast<int32_t>(extras.size() + key.size() + value.size()));
+    out->appendInt32(0x1234);
+    out->appendInt64(0);
+    out->append(StringPiece(extras));
+    out->append(StringPiece(key));
+    out->append(StringPiece(value));
+}
+
+}  // namespace
+
+TEST(ItemStoreTest, StorageCommands) {
+    ItemStore store(4 * 1024 * 1024);
+    const int64_t now = 1000000000;
+    uint64_t cas = 0;
+    EXPECT_EQ(store.store(ItemStore::kAdd, StringPiece("k"), StringPiece("v1"), 3, 0, 0, now, &cas),
+              ItemStore::kStored);
+    EXPECT_EQ(store.store(ItemStore::kAdd, StringPiece("k"), StringPiece("v2"), 0, 0, 0, now),
+              ItemStore::kNotStored);
+    EXPECT_EQ(store.store(ItemStore::kReplace, StringPiece("x"), StringPiece("v"), 0, 0, 0, now),
+              ItemStore::kNotStored);
+    EXPECT_EQ(store.store(ItemStore::kCas, StringPiece("k"), StringPiece("v3"), 0, 0, cas + 1, now),
+              ItemStore::kExists);
+    EXPECT_EQ(store.store(ItemStore::kCas, StringPiece("k"), StringPiece("v3"), 5, 0, cas, now),
+              ItemStore::kStored);
+    EXPECT_EQ(store.store(ItemStore::kAppend, StringPiece("k"), StringPiece("+"), 0, 0, 0, now),
+              ItemStore::kStored);
+    EXPECT_EQ(store.store(ItemStore::kPrepend, StringPiece("k"), StringPiece("-"), 0, 0, 0, now),
+              ItemStore::kStored);
+    ItemStore::Item* item = store.get(StringPiece("k"), now);
+    EXPECT_EQ(valueOf(item), "-v3+");
+    EXPECT_EQ(item->flags, 5u);
+    EXPECT_EQ(std::string(item->value() + item->valueBytes, 2), "\r\n");
+
+    uint64_t value = 0;
+    EXPECT_EQ(store.arithmetic(StringPiece("k"), true, 1, now, &value), ItemStore::kNonNumeric);
+    store.store(ItemStore::kSet, StringPiece("n"), StringPiece("18446744073709551615"), 0, 0, 0,
+                now);
+    EXPECT_EQ(store.arithmetic(StringPiece("n"), true, 2, now, &value), ItemStore::kArithOk);
+    EXPECT_EQ(value, 1u);
+    EXPECT_EQ(store.arithmetic(StringPiece("n"), false, 5, now, &value), ItemStore::kArithOk);
+    EXPECT_EQ(value, 0u);
+    EXPECT_EQ(valueOf(store.get(StringPiece("n"), now)), "0");
+
+    EXPECT_TRUE(store.touch(StringPiece("n"), ItemStore::absoluteExptime(10, now), now));
+    EXPECT_NE(store.get(StringPiece("n"), now + 9), nullptr);
+    EXPECT_EQ(store.get(StringPiece("n"), now + 10), nullptr);
+    store.store(ItemStore::kSet, StringPiece("gone"), StringPiece("v"), 0,
+                ItemStore::absoluteExptime(-1, now), 0, now);
+    EXPECT_EQ(store.get(StringPiece("gone"), now), nullptr);
+
+    EXPECT_EQ(store.remove(StringPiece("k"), 1, now), ItemStore::kExists);
+    EXPECT_EQ(store.remove(StringPiece("k"), 0, now), ItemStore::kDeleted);
+    EXPECT_EQ(store.remove(StringPiece("k"), 0, now), ItemStore::kNotFound);
+    EXPECT_EQ(store.numItems(), 0u);
+}
+
+TEST(ItemStoreTest, EvictsLeastRecentlyUsedButNotPinned) {
+    ItemStore store(ItemStore::kPageBytes);
+    const int64_t now = 1000000000;
+    const std::string big(100 * 1000, 'x');
+    store.store(ItemStore::kSet, StringPiece("key:0"), StringPiece(big), 0, 0, 0, now);
+    ItemStore::Item* pinned = store.get(StringPiece("key:0"), now);
+    store.pin(pinned);
+    for (int i = 1; i < 30; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        ASSERT_EQ(store.store(ItemStore::kSet, StringPiece(key), StringPiece(big), 0, 0, 0, now),
+                  ItemStore::kStored);
+    }
+    EXPECT_GT(store.evictions(), 0u);
+    EXPECT_LT(store.numItems(), 30u);
+    EXPECT_EQ(store.memoryUsed(), ItemStore::kPageBytes);
+    EXPECT_EQ(store.get(StringPiece("key:0"), now), pinned);
+    EXPECT_EQ(store.get(StringPiece("key:1"), now), nullptr);
+    EXPECT_NE(store.get(StringPiece("key:29"), now), nullptr);
+
+    // replaced while pinned, the old value stays readable until released
+    store.store(ItemStore::kSet, StringPiece("key:0"), StringPiece("new"), 0, 0, 0, now);
+    EXPECT_EQ(valueOf(pinned), big);
+    EXPECT_EQ(valueOf(store.get(StringPiece("key:0"), now)), "new");
+    store.release(pinned);
+
+    std::string tooLarge(ItemStore::maxValueBytes(5) + 1, 'y');
+    EXPECT_EQ(store.store(ItemStore::kSet, StringPiece("key:0"), StringPiece(tooLarge), 0, 0, 0,
+                          now),
+              ItemStore::kTooLarge);
+    store.flushAll();
+    EXPECT_EQ(store.numItems(), 0u);
+}
+
+TEST(MemcacheCodecTest, ParseTextAndBinary) {
+    Buffer buf;
+    buf.append(StringPiece("get a bb c\r\nset k 5 -1 3 noreply\r\nab"));
+    memcache::Request request;
+    std::size_t bytes = 0;
+    ASSERT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kOk);
+    EXPECT_EQ(request.command, memcache::kGet);
+    ASSERT_EQ(request.keys.size(), 3u);
+    EXPECT_EQ(request.keys[1], StringPiece("bb"));
+    buf.retrieve(bytes);
+    EXPECT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kNeedMore);
+    buf.append(StringPiece("c\r\ncas k 0 0 1 77\r\nxyz"));
+    ASSERT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kOk);
+    EXPECT_EQ(request.command, memcache::kSet);
+    EXPECT_TRUE(request.noreply);
+    EXPECT_EQ(request.flags, 5u);
+    EXPECT_EQ(request.exptime, -1);
+    EXPECT_EQ(request.value, StringPiece("abc"));
+    buf.retrieve(bytes);
+    ASSERT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kClientError);
+    EXPECT_STREQ(request.error, "CLIENT_ERROR bad data chunk");
+    buf.retrieve(bytes);
+    EXPECT_EQ(buf.readableBytes(), 0u);
+
+    appendBinaryRequest(&buf, binary::kOpGetKQ, "", "key", "");
+    std::string extras(8, '\0');
+    extras[3] = 9;
+    appendBinaryRequest(&buf, binary::kOpSetQ, extras, "key", "value");
+    appendBinaryRequest(&buf, 0x55, "", "", "");
+    ASSERT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kOk);
+    EXPECT_TRUE(request.binary);
+    EXPECT_TRUE(request.noreply);
+    EXPECT_TRUE(request.returnKey);
+    EXPECT_EQ(request.opaque, 0x1234u);
+    EXPECT_EQ(request.key, StringPiece("key"));
+    buf.retrieve(bytes);
+    ASSERT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kOk);
+    EXPECT_EQ(request.command, memcache::kSet);
+    EXPECT_EQ(request.flags, 9u);
+    EXPECT_EQ(request.value, StringPiece("value"));
+    buf.retrieve(bytes);
+    ASSERT_EQ(memcache::parseRequest(buf, &request, &bytes), memcache::kClientError);
+    EXPECT_EQ(request.command, memcache::kUnknown);
+    EXPECT_EQ(bytes, buf.readableBytes());
+}
+
+TEST(MemcacheServerTest, TextAndBinaryAcrossShards) {
+    EventLoop loop;
+    InetAddress listenAddr(29278, true);
+    MemcacheServer server(&loop, listenAddr, "MemcacheTest");
+    server.setThreadNum(3);
+    server.start();
+
+    const int kKeys = 100;
+    std::string request;
+    std::string expected;
+    std::string multiGet = "get";
+    std::string hits;
+    for (int i = 0; i < kKeys; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        std::string value(100 + 50 * i, static_cast<char>('a' + i % 26));
+        request += "set " + key + " " + std::to_string(i) + " 0 " +
+                   std::to_string(value.size()) + "\r\n" + value + "\r\n";
+        expected += "STORED\r\n";
+        multiGet += " " + key;
+        hits += "VALUE " + key + " " + std::to_string(i) + " " + std::to_string(value.size()) +
+                "\r\n" + value + "\r\n";
+    }
+    request += multiGet + " missing\r\n";
+    expected += hits + "END\r\n";
+    request += "append key:1 0 0 2\r\n++\r\nincr key:1 1\r\n";
+    expected += "STORED\r\nCLIENT_ERROR cannot increment or decrement non-numeric value\r\n";
+    request += "set n 0 0 2\r\n10\r\nincr n 5\r\ndecr n 100\r\nset q 0 0 1 noreply\r\nq\r\n";
+    expected += "STORED\r\n15\r\n0\r\n";
+    request += "delete key:2\r\ndelete key:2\r\nbogus\r\nget q\r\n";
+    expected += "DELETED\r\nNOT_FOUND\r\nERROR\r\nVALUE q 0 1\r\nq\r\nEND\r\n";
+
+    Buffer binaryRequests;
+    std::string extras(8, '\0');
+    extras[3] = 7;
+    appendBinaryRequest(&binaryRequests, binary::kOpSetQ, extras, "bin", "payload");
+    appendBinaryRequest(&binaryRequests, binary::kOpGetKQ, "", "nokey", "");
+    appendBinaryRequest(&binaryRequests, binary::kOpGetK, "", "bin", "");
+    appendBinaryRequest(&binaryRequests, binary::kOpNoop, "", "", "");
+    request += binaryRequests.retrieveAllAsString() + "quit\r\n";
+
+    std::string received;
+    std::thread client([&] {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ASSERT_EQ(::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+        ASSERT_EQ(::write(fd, request.data(), request.size()),
+                  static_cast<ssize_t>(request.size()));
+        char buf[4096];
+        ssize_t n = 0;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+            received.append(buf, n);
+        }
+        ::close(fd);
+        loop.quit();
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    ASSERT_GE(received.size(), expected.size());
+    EXPECT_EQ(received.substr(0, expected.size()), expected);
+    Buffer replies;
+    replies.append(received.data() + expected.size(), received.size() - expected.size());
+    ASSERT_EQ(replies.readableBytes(), 2 * binary::kHeaderBytes + 4 + 3 + 7);
+    EXPECT_EQ(static_cast<uint8_t>(replies.readInt8()), binary::kResponseMagic);
+    EXPECT_EQ(static_cast<uint8_t>(replies.readInt8()), binary::kOpGetK);
+    EXPECT_EQ(replies.readInt16(), 3);
+    EXPECT_EQ(replies.readInt8(), 4);
+    replies.retrieve(1);
+    EXPECT_EQ(replies.readInt16(), binary::kNoError);
+    EXPECT_EQ(replies.readInt32(), 4 + 3 + 7);
+    EXPECT_EQ(replies.readInt32(), 0x1234);
+    EXPECT_NE(replies.readInt64(), 0);
+    EXPECT_EQ(replies.readInt32(), 7);
+    EXPECT_EQ(std::string(replies.peek(), 10), "binpayload");
+    replies.retrieve(10);
+    EXPECT_EQ(static_cast<uint8_t>(replies.peek()[1]), binary::kOpNoop);
+    EXPECT_EQ(server.numItems(), static_cast<std::size_t>(kKeys + 2));
+}
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "PipelinedClient.h"
+#include "TcpServer.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::PipelinedClient;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done);
+
+// Closes the connection before the loop goes away.
+void disconnect(EventLoop* loop, PipelinedClient* client) {
+    client->disconnect();
+    runUntil(loop, [client] { return !client->connected(); });
+}
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done) {
+    dws::net::TimerId check = loop->runEvery(0.01, [loop, &done] {
+        if (done()) {
+            loop->quit();
+        }
+    });
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(check);
+    loop->cancel(timeout);
+}
+
+// "<id> <payload>\n" both ways.
+ssize_t lineFramer(const Buffer& buf, uint64_t* id) {
+    const char* eol = buf.findEOL();
+    if (!eol) {
+        return 0;
+    }
+    *id = std::strtoull(buf.peek(), nullptr, 10);
+    return eol + 1 - buf.peek();
+}
+
+// Answers every line, in reverse order per batch of @c batch lines, and
+// holds the reply to a "slow" line and everything after it for 0.25 s.
+class LineServer {
+ public:
+    LineServer(EventLoop* loop, uint16_t port, std::size_t batch)
+        : loop_(loop), server_(loop, InetAddress(port, true), "LineServer"), batch_(batch) {
+        server_.setMessageCallback([this](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            while (const char* eol = buf->findEOL()) {
+                std::string line(buf->peek(), eol + 1);
+                buf->retrieveUntil(eol + 1);
+                ++received;
+                if (line.find(" close") != std::string::npos) {
+                    conn->forceClose();
+                    return;
+                }
+                pending_.push_back(line);
+            }
+            reply(conn);
+        });
+        server_.start();
+    }
+
+    int received = 0;
+
+ private:
+    EventLoop* loop_;
+    TcpServer server_;
+    const std::size_t batch_;
+    std::vector<std::string> pending_;
+    bool holding_ = false;
+
+    void reply(const TcpConnectionPtr& conn) {
+        std::string out;
+        while (!holding_ && pending_.size() >= batch_) {
+            if (pending_.front().find(" slow") != std::string::npos) {
+                holding_ = true;
+                loop_->runAfter(0.25, [this, conn] {
+                    std::string& slow = pending_.front();
+                    slow.replace(slow.find(" slow"), 5, " done");
+                    holding_ = false;
+                    reply(conn);
+                });
+                break;
+            }
+            for (std::size_t j = batch_; j > 0; --j) {
+                out += pending_[j - 1];
+            }
+            pending_.erase(pending_.begin(), pending_.begin() + static_cast<long>(batch_));
+        }
+        if (!out.empty()) {
+            conn->send(StringPiece(out));
+        }
+    }
+};
+
+}  // namespace
+
+TEST(PipelinedClientTest, KeepsWindowAndOrder) {
+    EventLoop loop;
+    LineServer server(&loop, 29311, 1);
+    PipelinedClient::Options options;
+    options.maxInFlight = 8;
+    PipelinedClient client(&loop, InetAddress(29311, true), "Fifo", lineFramer, options);
+    client.connect();
+
+    const int kCount = 100;
+    std::vector<std::string> replies;
+    std::size_t maxInFlight = 0;
+    for (int i = 0; i < kCount; ++i) {
+        client.send(std::to_string(i) + " request\n",
+                    [&](PipelinedClient::Error error, StringPiece response) {
+                        EXPECT_EQ(error, PipelinedClient::kOk);
+                        replies.push_back(response.as_string());
+                        maxInFlight = std::max(maxInFlight, client.numInFlight() + 1);
+                    });
+    }
+    runUntil(&loop, [&] { return replies.size() == kCount; });
+
+    ASSERT_EQ(replies.size(), static_cast<std::size_t>(kCount));
+    for (int i = 0; i < kCount; ++i) {
+        EXPECT_EQ(replies[i], std::to_string(i) + " request\n");
+    }
+    EXPECT_LE(maxInFlight, 8u);
+    EXPECT_GE(maxInFlight, 2u);
+    EXPECT_LT(client.numWrites(), static_cast<uint64_t>(kCount));
+    EXPECT_EQ(client.numInFlight(), 0u);
+    disconnect(&loop, &client);
+}
+
+TEST(PipelinedClientTest, MatchesOutOfOrderResponsesById) {
+    EventLoop loop;
+    LineServer server(&loop, 29312, 4);  // answers each group of 4 backwards
+    PipelinedClient::Options options;
+    options.matching = PipelinedClient::kById;
+    options.maxInFlight = 4;
+    PipelinedClient client(&loop, InetAddress(29312, true), "ById", lineFramer, options);
+    client.connect();
+
+    std::vector<uint64_t> order;
+    for (uint64_t id = 100; id < 108; ++id) {
+        client.send(std::to_string(id) + " payload-" + std::to_string(id) + "\n", id,
+                    [&order, id](PipelinedClient::Error error, StringPiece response) {
+                        EXPECT_EQ(error, PipelinedClient::kOk);
+                        EXPECT_EQ(response.as_string(),
+                                  std::to_string(id) + " payload-" + std::to_string(id) + "\n");
+                        order.push_back(id);
+                    });
+    }
+    runUntil(&loop, [&] { return order.size() == 8; });
+    EXPECT_EQ(order, std::vector<uint64_t>({103, 102, 101, 100, 107, 106, 105, 104}));
+    disconnect(&loop, &client);
+}
+
+TEST(PipelinedClientTest, RejectsIdAlreadyInFlight) {
+    EventLoop loop;
+    LineServer server(&loop, 29324, 1);
+    PipelinedClient::Options options;
+    options.matching = PipelinedClient::kById;
+    PipelinedClient client(&loop, InetAddress(29324, true), "Duplicate", lineFramer, options);
+    client.connect();
+
+    std::vector<std::string> results;
+    auto record = [&](PipelinedClient::Error error, StringPiece response) {
+        results.push_back(std::string(PipelinedClient::errorString(error)) + ":" +
+                          response.as_string());
+    };
+    client.send("7 slow\n", 7, record);
+    runUntil(&loop, [&] { return server.received == 1; });
+    client.send("7 again\n", 7, record);
+    runUntil(&loop, [&] { return results.size() == 2; });
+    EXPECT_EQ(results, std::vector<std::string>({"duplicate id:", "ok:7 done\n"}));
+    EXPECT_EQ(client.numInFlight(), 0u);
+    EXPECT_EQ(server.received, 1);
+    disconnect(&loop, &client);
+}
+
+TEST(PipelinedClientTest, LateResponseKeepsItsPlace) {
+    EventLoop loop;
+    LineServer server(&loop, 29313, 1);
+    PipelinedClient::Options options;
+    options.timeoutSeconds = 0.2;
+    PipelinedClient client(&loop, InetAddress(29313, true), "Deadline", lineFramer, options);
+    client.connect();
+
+    std::vector<std::string> results;
+    auto record = [&](PipelinedClient::Error error, StringPiece response) {
+        results.push_back(std::string(PipelinedClient::errorString(error)) + ":" +
+                          response.as_string());
+    };
+    client.send("1 slow\n", record);
+    runUntil(&loop, [&] { return results.size() == 1; });
+    EXPECT_EQ(results, std::vector<std::string>({"timeout:"}));
+    EXPECT_EQ(client.numInFlight(), 1u);  // the server still has it
+
+    // answered after the late reply to the first one, not mistaken for it
+    client.send("2 fast\n", record);
+    runUntil(&loop, [&] { return results.size() == 2; });
+    EXPECT_EQ(results, std::vector<std::string>({"timeout:", "ok:2 fast\n"}));
+    EXPECT_EQ(client.numInFlight(), 0u);
+    disconnect(&loop, &client);
+}
+
+TEST(PipelinedClientTest, FailsInFlightOnCloseAndReconnects) {
+    EventLoop loop;
+    LineServer server(&loop, 29314, 1);
+    PipelinedClient client(&loop, InetAddress(29314, true), "Reconnect", lineFramer);
+    client.connect();
+
+    std::vector<std::string> results;
+    auto record = [&](PipelinedClient::Error error, StringPiece response) {
+        results.push_back(std::string(PipelinedClient::errorString(error)) + ":" +
+                          response.as_string());
+    };
+    client.send("1 close\n", record);
+    runUntil(&loop, [&] { return results.size() == 1; });
+    client.send("2 again\n", record);
+    runUntil(&loop, [&] { return results.size() == 2; });
+    EXPECT_EQ(results, std::vector<std::string>({"connection closed:", "ok:2 again\n"}));
+    disconnect(&loop, &client);
+}
+
+TEST(PipelinedClientTest, RefusesBeyondQueueLimit) {
+    EventLoop loop;
+    PipelinedClient::Options options;
+    options.maxQueued = 2;
+    PipelinedClient client(&loop, InetAddress(29315, true), "Overload", lineFramer, options);
+
+    std::vector<PipelinedClient::Error> errors;
+    for (int i = 0; i < 3; ++i) {
+        client.send("x\n", [&](PipelinedClient::Error error, StringPiece) {
+            errors.push_back(error);
+        });
+    }
+    runUntil(&loop, [&] { return !errors.empty(); });
+    EXPECT_EQ(errors, std::vector<PipelinedClient::Error>({PipelinedClient::kOverloaded}));
+    EXPECT_EQ(client.numQueued(), 2u);
+}
@@ -0,0 +1,272 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Resolver.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "UdpSocket.h"
+
+using dws::Timestamp;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::Resolver;
+using dws::net::TcpClient;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+using dws::net::UdpSocket;
+using dws::net::UdpSocketPtr;
+
+namespace {
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done) {
+    dws::net::TimerId check = loop->runEvery(0.01, [loop, &done] {
+        if (done()) {
+            loop->quit();
+        }
+    });
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(check);
+    loop->cancel(timeout);
+}
+
+void append16(std::string* out, int value) {
+    out->push_back(static_cast<char>(value >> 8));
+    out->push_back(static_cast<char>(value & 0xff));
+}
+
+std::string encodeName(const std::string& name) {
+    std::string out;
+    std::size_t start = 0;
+    while (start < name.size()) {
+        std::size_t dot = std::min(name.find('.', start), name.size());
+        out.push_back(static_cast<char>(dot - start));
+        out.append(name, start, dot - start);
+        start = dot + 1;
+    }
+    out.push_back('\0');
+    return out;
+}
+
+// Answers A, AAAA and CNAME questions from tables, NXDOMAIN for unknown
+// names, and nothing at all for the silent ones.
+class StubDns {
+ public:
+    StubDns(EventLoop* loop, const InetAddress& addr)
+        : socket_(std::make_shared<UdpSocket>(loop, addr)) {
+        socket_->setMessageCallback([this](const UdpSocketPtr& socket, const char* data,
+                                           std::size_t len, const InetAddress& peer, Timestamp) {
+            onQuery(socket, std::string(data, len), peer);
+        });
+        socket_->start();
+    }
+
+    std::map<std::string, std::string> a;
+    std::map<std::string, std::string> aaaa;
+    std::map<std::string, std::string> cname;
+    std::set<std::string> silent;
+    std::vector<std::string> queries;  // "name/type"
+
+ private:
+    UdpSocketPtr socket_;
+
+    void onQuery(const UdpSocketPtr& socket, const std::string& query, const InetAddress& peer) {
+        std::string name;
+        std::size_t pos = 12;
+        while (pos < query.size() && query[pos] != 0) {
+            int n = query[pos];
+            if (!name.empty()) {
+                name += '.';
+            }
+            name.append(query, pos + 1, static_cast<std::size_t>(n));
+            pos += 1 + static_cast<std::size_t>(n);
+        }
+        int type = static_cast<unsigned char>(query[pos + 2]);
+        queries.push_back(name + (type == 1 ? "/A" : "/AAAA"));
+        if (silent.count(name)) {
+            return;
+        }
+
+        std::string records;
+        int answers = 0;
+        std::string owner = "\xc0\x0c";  // the question's name
+        std::string current = name;
+        if (cname.count(current)) {
+            std::string target = encodeName(cname[current]);
+            records += owner;
+            append16(&records, 5);
+            append16(&records, 1);
+            records += std::string("\0\0\0\x3c", 4);
+            append16(&records, static_cast<int>(target.size()));
+            records += target;
+            ++answers;
+            current = cname[current];
+            owner = encodeName(current);
+        }
+        auto& table = type == 1 ? a : aaaa;
+        if (table.count(current)) {
+            char bytes[16];
+            int size = type == 1 ? 4 : 16;
+            ::inet_pton(type == 1 ? AF_INET : AF_INET6, table[current].c_str(), bytes);
+            records += owner;
+            append16(&records, type);
+            append16(&records, 1);
+            records += std::string("\0\0\0\x3c", 4);  // 60 seconds
+            append16(&records, size);
+            records.append(bytes, static_cast<std::size_t>(size));
+            ++answers;
+        }
+        bool known = a.count(current) || aaaa.count(current);
+        std::string reply = query.substr(0, 2);
+        append16(&reply, known ? 0x8180 : 0x8183);
+        append16(&reply, 1);
+        append16(&reply, answers);
+        append16(&reply, 0);
+        append16(&reply, 0);
+        reply += query.substr(12, pos + 5 - 12);
+        reply += records;
+        socket->send(peer, reply.data(), reply.size());
+    }
+};
+
+struct Result {
+    bool done = false;
+    Resolver::Error error = Resolver::kOk;
+    std::vector<std::string> addresses;
+};
+
+Resolver::Callback record(Result* result) {
+    return [result](Resolver::Error error, const std::vector<InetAddress>& addresses) {
+        result->done = true;
+        result->error = error;
+        for (const auto& addr : addresses) {
+            result->addresses.push_back(addr.toIpPort());
+        }
+    };
+}
+
+}  // namespace
+
+TEST(ResolverTest, ResolvesAndCachesAandAaaa) {
+    EventLoop loop;
+    InetAddress dnsAddr(29298, true);
+    StubDns dns(&loop, dnsAddr);
+    dns.a["web.test"] = "10.1.2.3";
+    dns.aaaa["web.test"] = "fd00::1";
+    Resolver resolver(&loop, dnsAddr);
+
+    Result v4, any;
+    resolver.resolve("Web.Test.", 80, Resolver::kIPv4, record(&v4));
+    resolver.resolve("web.test", 443, Resolver::kAny, record(&any));
+    runUntil(&loop, [&] { return v4.done && any.done; });
+    EXPECT_EQ(v4.error, Resolver::kOk);
+    EXPECT_EQ(v4.addresses, std::vector<std::string>({"10.1.2.3:80"}));
+    EXPECT_EQ(any.error, Resolver::kOk);
+    EXPECT_EQ(any.addresses, std::vector<std::string>({"[fd00::1]:443", "10.1.2.3:443"}));
+    // the A query of kAny joined the one in flight
+    EXPECT_EQ(dns.queries, std::vector<std::string>({"web.test/A", "web.test/AAAA"}));
+    EXPECT_EQ(resolver.coalesced(), 1u);
+
+    Result cached;
+    resolver.resolve("web.test", 8080, Resolver::kIPv6, record(&cached));
+    runUntil(&loop, [&] { return cached.done; });
+    EXPECT_EQ(cached.addresses, std::vector<std::string>({"[fd00::1]:8080"}));
+    EXPECT_EQ(resolver.cacheHits(), 1u);
+    EXPECT_EQ(resolver.queriesSent(), 2u);
+    EXPECT_EQ(dns.queries.size(), 2u);
+}
+
+TEST(ResolverTest, FollowsCnameAndCachesNotFound) {
+    EventLoop loop;
+    InetAddress dnsAddr(29299, true);
+    StubDns dns(&loop, dnsAddr);
+    dns.cname["alias.test"] = "real.test";
+    dns.a["real.test"] = "10.9.9.9";
+    Resolver resolver(&loop, dnsAddr);
+
+    Result alias, missing;
+    resolver.resolve("alias.test", 1, Resolver::kIPv4, record(&alias));
+    resolver.resolve("missing.test", 1, Resolver::kIPv4, record(&missing));
+    runUntil(&loop, [&] { return alias.done && missing.done; });
+    EXPECT_EQ(alias.error, Resolver::kOk);
+    EXPECT_EQ(alias.addresses, std::vector<std::string>({"10.9.9.9:1"}));
+    EXPECT_EQ(missing.error, Resolver::kNotFound);
+    EXPECT_TRUE(missing.addresses.empty());
+
+    Result again;
+    resolver.resolve("missing.test", 1, Resolver::kIPv4, record(&again));
+    runUntil(&loop, [&] { return again.done; });
+    EXPECT_EQ(again.error, Resolver::kNotFound);
+    EXPECT_EQ(dns.queries.size(), 2u);
+    EXPECT_EQ(resolver.cacheSize(), 2u);
+}
+
+TEST(ResolverTest, RetriesThenTimesOut) {
+    EventLoop loop;
+    InetAddress dnsAddr(29300, true);
+    StubDns dns(&loop, dnsAddr);
+    dns.silent.insert("slow.test");
+    Resolver::Options options;
+    options.timeoutSeconds = 0.05;
+    options.attempts = 3;
+    Resolver resolver(&loop, dnsAddr, options);
+
+    Result slow;
+    resolver.resolve("slow.test", 1, Resolver::kIPv4, record(&slow));
+    runUntil(&loop, [&] { return slow.done; });
+    EXPECT_EQ(slow.error, Resolver::kTimeout);
+    EXPECT_EQ(dns.queries.size(), 3u);
+    EXPECT_EQ(resolver.cacheSize(), 0u);
+}
+
+TEST(ResolverTest, AnswersLiteralsWithoutQueries) {
+    EventLoop loop;
+    Resolver resolver(&loop, InetAddress(29301, true));
+
+    Result v4, v6, localhost, bad, mismatch;
+    resolver.resolve("192.168.1.7", 22, Resolver::kAny, record(&v4));
+    resolver.resolve("::1", 22, Resolver::kAny, record(&v6));
+    resolver.resolve("localhost", 22, Resolver::kIPv4, record(&localhost));
+    resolver.resolve("bad name", 22, Resolver::kAny, record(&bad));
+    resolver.resolve("::1", 22, Resolver::kIPv4, record(&mismatch));
+    EXPECT_FALSE(v4.done);  // never from within resolve()
+    runUntil(&loop, [&] { return mismatch.done; });
+    EXPECT_EQ(v4.addresses, std::vector<std::string>({"192.168.1.7:22"}));
+    EXPECT_EQ(v6.addresses, std::vector<std::string>({"[::1]:22"}));
+    EXPECT_EQ(localhost.addresses, std::vector<std::string>({"127.0.0.1:22"}));
+    EXPECT_EQ(bad.error, Resolver::kBadName);
+    EXPECT_EQ(mismatch.error, Resolver::kNotFound);
+    EXPECT_EQ(resolver.queriesSent(), 0u);
+}
+
+TEST(ResolverTest, TcpClientConnectsByName) {
+    EventLoop loop;
+    InetAddress dnsAddr(29302, true);
+    StubDns dns(&loop, dnsAddr);
+    dns.a["svc.test"] = "127.0.0.1";
+    Resolver resolver(&loop, dnsAddr);
+
+    TcpServer server(&loop, InetAddress(29303, true), "NamedServer");
+    server.start();
+    bool connected = false;
+    TcpClient client(&loop, &resolver, "svc.test", 29303, "NamedClient");
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            connected = true;
+            EXPECT_EQ(conn->peerAddress().toIpPort(), "127.0.0.1:29303");
+            conn->shutdown();
+        }
+    });
+    client.connect();
+    runUntil(&loop, [&] { return connected; });
+    EXPECT_TRUE(connected);
+    EXPECT_EQ(dns.queries, std::vector<std::string>({"svc.test/AAAA", "svc.test/A"}));
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "RespCodec.h"
+#include "ShardedKvServer.h"
+
+using dws::StringPiece;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::ShardedKvServer;
+namespace resp = dws::net::resp;
+
+TEST(RespCodecTest, ParsePipelinedCommands) {
+    Buffer buf;
+    buf.append(StringPiece("*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$5\r\nhello\r\nPING\r\n  get   k \n*2\r\n$3\r\nGET"));
+    std::vector<StringPiece> args;
+    std::size_t bytes = 0;
+    ASSERT_EQ(resp::parseCommand(buf, &args, &bytes), resp::kOk);
+    ASSERT_EQ(args.size(), 3u);
+    EXPECT_EQ(args[2], StringPiece("hello"));
+    buf.retrieve(bytes);
+    ASSERT_EQ(resp::parseCommand(buf, &args, &bytes), resp::kOk);
+    ASSERT_EQ(args.size(), 1u);
+    EXPECT_EQ(args[0], StringPiece("PING"));
+    buf.retrieve(bytes);
+    ASSERT_EQ(resp::parseCommand(buf, &args, &bytes), resp::kOk);
+    ASSERT_EQ(args.size(), 2u);
+    EXPECT_EQ(args[1], StringPiece("k"));
+    buf.retrieve(bytes);
+    EXPECT_EQ(resp::parseCommand(buf, &args, &bytes), resp::kNeedMore);
+    buf.append(StringPiece("\r\n$1\r\nk\r\n"));
+    ASSERT_EQ(resp::parseCommand(buf, &args, &bytes), resp::kOk);
+    EXPECT_EQ(bytes, buf.readableBytes());
+
+    Buffer bad;
+    bad.append(StringPiece("*1\r\n:1\r\n"));
+    EXPECT_EQ(resp::parseCommand(bad, &args, &bytes), resp::kProtocolError);
+}
+
+TEST(RespCodecTest, ParseResp3Values) {
+    const std::string data =
+            "%2\r\n+key\r\n*3\r\n:-7\r\n,1.5\r\n#t\r\n$5\r\nabcde\r\n~1\r\n_\r\n"
+            "$-1\r\n=8\r\ntxt:some\r\n";
+    resp::Value value;
+    std::size_t bytes = 0;
+    const char* p = data.data();
+    const char* end = p + data.size();
+    ASSERT_EQ(resp::parseValue(p, end, &value, &bytes), resp::kOk);
+    ASSERT_EQ(value.type, resp::kMap);
+    ASSERT_EQ(value.elements.size(), 4u);
+    EXPECT_EQ(value.elements[0].string, StringPiece("key"));
+    ASSERT_EQ(value.elements[1].elements.size(), 3u);
+    EXPECT_EQ(value.elements[1].elements[0].integer, -7);
+    EXPECT_DOUBLE_EQ(value.elements[1].elements[1].number, 1.5);
+    EXPECT_EQ(value.elements[1].elements[2].integer, 1);
+    EXPECT_EQ(value.elements[3].type, resp::kSet);
+    p += bytes;
+    ASSERT_EQ(resp::parseValue(p, end, &value, &bytes), resp::kOk);
+    EXPECT_EQ(value.type, resp::kNull);
+    p += bytes;
+    EXPECT_EQ(resp::parseValue(p, end - 1, &value, &bytes), resp::kNeedMore);
+    ASSERT_EQ(resp::parseValue(p, end, &value, &bytes), resp::kOk);
+    EXPECT_EQ(value.type, resp::kVerbatimString);
+    EXPECT_EQ(p + bytes, end);
+
+    const std::string bogus = "*99999999\r\n";
+    EXPECT_EQ(resp::parseValue(bogus.data(), bogus.data() + bogus.size(), &value, &bytes),
+              resp::kProtocolError);
+}
+
+TEST(RespCodecTest, EncodeForBothProtocols) {
+    Buffer buf;
+    resp::appendNull(&buf, resp::kResp2);
+    resp::appendNull(&buf, resp::kResp3);
+    resp::appendMapHeader(&buf, 2, resp::kResp2);
+    resp::appendBoolean(&buf, true, resp::kResp3);
+    resp::appendInteger(&buf, -1234567890123);
+    resp::appendDouble(&buf, 0.25, resp::kResp3);
+    resp::appendCommand(&buf, {StringPiece("GET"), StringPiece("")});
+    EXPECT_EQ(buf.retrieveAllAsString(),
+              "$-1\r\n_\r\n*4\r\n#t\r\n:-1234567890123\r\n,0.25\r\n*2\r\n$3\r\nGET\r\n$0\r\n\r\n");
+}
+
+TEST(ShardedKvServerTest, PipelinedCommandsAcrossShards) {
+    EventLoop loop;
+    InetAddress listenAddr(29277, true);
+    ShardedKvServer server(&loop, listenAddr, "KvTest");
+    server.setThreadNum(3);
+    server.start();
+
+    const int kKeys = 200;
+    std::string received;
+    std::thread client([&] {
+        Buffer request;
+        for (int i = 0; i < kKeys; ++i) {
+            std::string key = "key:" + std::to_string(i);
+            resp::appendCommand(&request, {StringPiece("SET"), StringPiece(key), StringPiece(key)});
+        }
+        for (int i = 0; i < kKeys; ++i) {
+            std::string key = "key:" + std::to_string(i);
+            resp::appendCommand(&request, {StringPiece("GET"), StringPiece(key)});
+        }
+        request.append(StringPiece("HELLO 3\r\nGET missing\r\nINCR n\r\nincr n\r\nNOPE\r\nQUIT\r\n"));
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ASSERT_EQ(::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+        ASSERT_EQ(::write(fd, request.peek(), request.readableBytes()),
+                  static_cast<ssize_t>(request.readableBytes()));
+        char buf[4096];
+        ssize_t n = 0;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+            received.append(buf, n);
+        }
+        ::close(fd);
+        loop.quit();
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    const char* p = received.data();
+    const char* end = p + received.size();
+    std::vector<resp::Value> replies;
+    resp::Value value;
+    std::size_t bytes = 0;
+    while (resp::parseValue(p, end, &value, &bytes) == resp::kOk) {
+        replies.push_back(value);
+        p += bytes;
+    }
+    EXPECT_EQ(p, end);
+    ASSERT_EQ(replies.size(), static_cast<std::size_t>(2 * kKeys + 6));
+    for (int i = 0; i < kKeys; ++i) {
+        EXPECT_EQ(replies[i].string, StringPiece("OK"));
+        EXPECT_EQ(replies[kKeys + i].string.as_string(), "key:" + std::to_string(i));
+    }
+    const resp::Value* tail = &replies[2 * kKeys];
+    EXPECT_EQ(tail[0].type, resp::kMap);
+    EXPECT_EQ(tail[1].type, resp::kNull);
+    EXPECT_EQ(tail[2].integer, 1);
+    EXPECT_EQ(tail[3].integer, 2);
+    EXPECT_EQ(tail[4].type, resp::kError);
+    EXPECT_EQ(tail[5].string, StringPiece("OK"));
+    EXPECT_NE(received.find("\r\n_\r\n"), std::string::npos);
+    EXPECT_EQ(server.numKeys(), static_cast<std::size_t>(kKeys + 1));
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "Buffer.h"
+#include "CountDownLatch.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+#include "RpcChannel.h"
+#include "RpcServer.h"
+
+using dws::CountDownLatch;
+using dws::StringPiece;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::EventLoopThread;
+using dws::net::InetAddress;
+using dws::net::RpcChannel;
+using dws::net::RpcServer;
+namespace rpc = dws::net::rpc;
+
+TEST(RpcCodecTest, RoundTrip) {
+    Buffer buf;
+    rpc::appendRequest(&buf, 42, StringPiece("echo"), StringPiece("payload"));
+    rpc::appendResponse(&buf, 7, rpc::kNoSuchMethod, StringPiece());
+    rpc::Message message;
+    ASSERT_EQ(rpc::parseMessage(buf, &message), rpc::kMessage);
+    EXPECT_EQ(message.type, rpc::kRequest);
+    EXPECT_EQ(message.id, 42u);
+    EXPECT_EQ(message.method, StringPiece("echo"));
+    EXPECT_EQ(message.payload, StringPiece("payload"));
+    EXPECT_EQ(message.bytes, rpc::kHeaderBytes + 11);
+    buf.retrieve(message.bytes);
+
+    Buffer partial;
+    partial.append(buf.peek(), buf.readableBytes() - 1);
+    EXPECT_EQ(rpc::parseMessage(partial, &message), rpc::kNeedMore);
+    ASSERT_EQ(rpc::parseMessage(buf, &message), rpc::kMessage);
+    EXPECT_EQ(message.type, rpc::kResponse);
+    EXPECT_EQ(message.status, rpc::kNoSuchMethod);
+    EXPECT_EQ(message.id, 7u);
+
+    Buffer bad;
+    bad.appendInt32(static_cast<int32_t>(rpc::kMaxMessageBytes + 1));
+    bad.append(std::string(12, '\0').data(), 12);
+    EXPECT_EQ(rpc::parseMessage(bad, &message), rpc::kMalformed);
+}
+
+TEST(RpcTest, AsyncSyncTimeoutAndWorkers) {
+    EventLoop loop;
+    InetAddress serverAddr(29276, true);
+    RpcServer server(&loop, serverAddr, "RpcTest");
+    server.setThreadNum(1);
+    server.setWorkerThreadNum(2);
+    server.registerMethod("echo", [](const StringPiece& request, const RpcServer::Done& done) {
+        done(rpc::kOk, request);
+    });
+    server.registerMethod(
+            "upper",
+            [](const StringPiece& request, const RpcServer::Done& done) {
+                std::string s = request.as_string();
+                for (char& c : s) c = static_cast<char>(toupper(c));
+                done(rpc::kOk, StringPiece(s));
+            },
+            RpcServer::kInWorker);
+    server.registerMethod("never", [](const StringPiece&, const RpcServer::Done&) {});
+    server.start();
+
+    EventLoopThread clientThread;
+    std::atomic<int> ok(0);
+    std::atomic<int> notFound(0);
+    std::atomic<int> timedOut(0);
+    std::string upper;
+    rpc::Status unknown = rpc::kOk;
+    rpc::Status closed = rpc::kOk;
+    {
+        RpcChannel channel(clientThread.startLoop(), serverAddr, "RpcClient");
+        channel.connect();
+        std::thread caller([&] {
+            const int kCalls = 100;
+            // issued before the connection is up, sent once it is
+            for (int i = 0; i < kCalls; ++i) {
+                std::string payload = std::to_string(i);
+                channel.call(StringPiece("echo"), StringPiece(payload),
+                             [&ok, payload](rpc::Status status, const StringPiece& response) {
+                                 if (status == rpc::kOk && response == StringPiece(payload)) {
+                                     ++ok;
+                                 }
+                             });
+            }
+            channel.call(StringPiece("never"), StringPiece(),
+                         [&](rpc::Status status, const StringPiece&) {
+                             if (status == rpc::kTimeout) ++timedOut;
+                         },
+                         0.05);
+            EXPECT_EQ(channel.callSync(StringPiece("upper"), StringPiece("abc"), &upper),
+                      rpc::kOk);
+            unknown = channel.callSync(StringPiece("missing"), StringPiece(), nullptr);
+            channel.call(StringPiece("missing"), StringPiece(),
+                         [&](rpc::Status status, const StringPiece&) {
+                             if (status == rpc::kNoSuchMethod) ++notFound;
+                         });
+            // the timeout and the last call have settled once this returns
+            ::usleep(100 * 1000);
+            channel.callSync(StringPiece("echo"), StringPiece(), nullptr);
+            // closes both ends while the server's loop still runs
+            CountDownLatch latch(1);
+            channel.call(StringPiece("never"), StringPiece(),
+                         [&](rpc::Status status, const StringPiece&) {
+                             closed = status;
+                             latch.countDown();
+                         });
+            channel.disconnect();
+            latch.wait();
+            loop.quit();
+        });
+        loop.runAfter(5.0, [&] { loop.quit(); });
+        loop.loop();
+        caller.join();
+    }
+
+    EXPECT_EQ(ok, 100);
+    EXPECT_EQ(upper, "ABC");
+    EXPECT_EQ(unknown, rpc::kNoSuchMethod);
+    EXPECT_EQ(notFound, 1);
+    EXPECT_EQ(timedOut, 1);
+    EXPECT_EQ(closed, rpc::kConnectionClosed);
+}
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "EventLoop.h"
+#include "HttpClient.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "StaticFileHandler.h"
+
+using dws::StringPiece;
+using dws::net::EventLoop;
+using dws::net::FileCache;
+using dws::net::HttpClient;
+using dws::net::HttpClientResponse;
+using dws::net::HttpRequest;
+using dws::net::HttpResponse;
+using dws::net::HttpServer;
+using dws::net::InetAddress;
+using dws::net::StaticFileHandler;
+
+namespace {
+
+struct Reply {
+    int status = 0;
+    std::string body;
+    std::string etag;
+    std::string lastModified;
+    std::string contentRange;
+    std::string contentType;
+    std::string location;
+};
+
+void writeFile(const std::string& path, const std::string& contents) {
+    FILE* fp = ::fopen(path.c_str(), "wb");
+    ASSERT_NE(fp, nullptr);
+    ASSERT_EQ(::fwrite(contents.data(), 1, contents.size(), fp), contents.size());
+    ::fclose(fp);
+}
+
+// Sends all requests at once and runs the loop until every reply is in.
+std::vector<Reply> fetch(EventLoop* loop, HttpClient* client, const InetAddress& server,
+                         const std::vector<HttpClient::Request>& requests) {
+    std::vector<Reply> replies(requests.size());
+    std::size_t done = 0;
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        client->send(server, requests[i], [&, i](HttpClient::Error error,
+                                                 const HttpClientResponse& resp) {
+            EXPECT_EQ(error, HttpClient::kOk);
+            replies[i].status = resp.statusCode();
+            replies[i].body = resp.body().as_string();
+            replies[i].etag = resp.getHeader(StringPiece("ETag")).as_string();
+            replies[i].lastModified = resp.getHeader(StringPiece("Last-Modified")).as_string();
+            replies[i].contentRange = resp.getHeader(StringPiece("Content-Range")).as_string();
+            replies[i].contentType = resp.getHeader(StringPiece("Content-Type")).as_string();
+            replies[i].location = resp.getHeader(StringPiece("Location")).as_string();
+            if (++done == requests.size()) {
+                loop->quit();
+            }
+        });
+    }
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(timeout);
+    EXPECT_EQ(done, requests.size());
+    return replies;
+}
+
+HttpClient::Request get(const std::string& target,
+                        std::vector<std::pair<std::string, std::string>> headers = {}) {
+    HttpClient::Request request;
+    request.target = target;
+    request.headers = std::move(headers);
+    return request;
+}
+
+class StaticFileTest : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        char dir[] = "/tmp/dws_static_XXXXXX";
+        ASSERT_NE(::mkdtemp(dir), nullptr);
+        root_ = dir;
+        small_ = "hello, static world\n";
+        for (int i = 0; large_.size() < 300 * 1024; ++i) {
+            large_ += "line " + std::to_string(i) + '\n';
+        }
+        writeFile(root_ + "/small.txt", small_);
+        writeFile(root_ + "/large.bin", large_);
+        ASSERT_EQ(::mkdir((root_ + "/docs").c_str(), 0755), 0);
+        writeFile(root_ + "/docs/index.html", "<p>index</p>");
+    }
+
+    void TearDown() override {
+        ::unlink((root_ + "/small.txt").c_str());
+        ::unlink((root_ + "/large.bin").c_str());
+        ::unlink((root_ + "/docs/index.html").c_str());
+        ::rmdir((root_ + "/docs").c_str());
+        ::rmdir(root_.c_str());
+    }
+
+    std::string root_;
+    std::string small_;
+    std::string large_;
+};
+
+}  // namespace
+
+TEST_F(StaticFileTest, ServesRangesAndConditionalRequests) {
+    EventLoop loop;
+    InetAddress serverAddr(29291, true);
+    HttpServer server(&loop, serverAddr, "StaticFileTest");
+    StaticFileHandler files(root_);
+    server.setHttpCallback(
+            [&](const HttpRequest& req, HttpResponse* resp) { files.handle(req, resp); });
+    server.start();
+    HttpClient::Options options;
+    options.maxConnectionsPerHost = 1;
+    options.maxPipelineDepth = 8;
+    HttpClient client(&loop, "StaticFileTestClient", options);
+
+    // pipelined on one connection: the sendfile bodies hold back the later answers
+    std::vector<Reply> replies = fetch(&loop, &client, serverAddr,
+                                       {get("/small.txt"), get("/large.bin"),
+                                        get("/large.bin", {{"Range", "bytes=10-19"}}),
+                                        get("/large.bin", {{"Range", "bytes=-5"}}),
+                                        get("/small.txt", {{"Range", "bytes=7-"}}),
+                                        get("/large.bin", {{"Range", "bytes=999999999-"}}),
+                                        get("/docs/"), get("/nope")});
+    EXPECT_EQ(replies[0].status, 200);
+    EXPECT_EQ(replies[0].body, small_);
+    EXPECT_EQ(replies[0].contentType, "text/plain; charset=utf-8");
+    EXPECT_FALSE(replies[0].etag.empty());
+    EXPECT_FALSE(replies[0].lastModified.empty());
+    EXPECT_EQ(replies[1].status, 200);
+    EXPECT_TRUE(replies[1].body == large_) << replies[1].body.size() << " bytes";
+    EXPECT_EQ(replies[1].contentType, "application/octet-stream");
+    EXPECT_EQ(replies[2].status, 206);
+    EXPECT_EQ(replies[2].body, large_.substr(10, 10));
+    EXPECT_EQ(replies[2].contentRange, "bytes 10-19/" + std::to_string(large_.size()));
+    EXPECT_EQ(replies[3].status, 206);
+    EXPECT_EQ(replies[3].body, large_.substr(large_.size() - 5));
+    EXPECT_EQ(replies[4].status, 206);
+    EXPECT_EQ(replies[4].body, small_.substr(7));
+    EXPECT_EQ(replies[5].status, 416);
+    EXPECT_EQ(replies[5].contentRange, "bytes */" + std::to_string(large_.size()));
+    EXPECT_EQ(replies[6].status, 200);
+    EXPECT_EQ(replies[6].body, "<p>index</p>");
+    EXPECT_EQ(replies[7].status, 404);
+    EXPECT_EQ(client.numConnects(), 1u);
+
+    const std::string etag = replies[1].etag;
+    const std::string lastModified = replies[1].lastModified;
+    replies = fetch(&loop, &client, serverAddr,
+                    {get("/large.bin", {{"If-None-Match", "\"other\", " + etag}}),
+                     get("/large.bin", {{"If-Modified-Since", lastModified}}),
+                     get("/large.bin", {{"If-None-Match", "\"other\""},
+                                        {"If-Modified-Since", lastModified}}),
+                     get("/large.bin", {{"Range", "bytes=0-3"}, {"If-Range", etag}}),
+                     get("/large.bin", {{"Range", "bytes=0-3"}, {"If-Range", "\"stale\""}})});
+    EXPECT_EQ(replies[0].status, 304);
+    EXPECT_EQ(replies[0].etag, etag);
+    EXPECT_TRUE(replies[0].body.empty());
+    EXPECT_EQ(replies[1].status, 304);
+    // If-None-Match wins over If-Modified-Since
+    EXPECT_EQ(replies[2].status, 200);
+    EXPECT_EQ(replies[2].body.size(), large_.size());
+    EXPECT_EQ(replies[3].status, 206);
+    EXPECT_EQ(replies[3].body, large_.substr(0, 4));
+    EXPECT_EQ(replies[4].status, 200);
+    EXPECT_EQ(replies[4].body.size(), large_.size());
+
+    // every file was opened once, all later requests came from the cache
+    EXPECT_EQ(files.cache()->misses(), 4u);  // small, large, docs/index.html, nope
+    EXPECT_EQ(files.cache()->hits(), 9u);
+    EXPECT_EQ(files.cache()->size(), 3u);
+    EXPECT_EQ(files.cache()->memoryBytes(), small_.size() + 12);
+}
+
+TEST_F(StaticFileTest, RevalidatesAndRejectsBadPaths) {
+    EventLoop loop;
+    InetAddress serverAddr(29292, true);
+    HttpServer server(&loop, serverAddr, "StaticFileRevalidate");
+    FileCache::Options cacheOptions;
+    cacheOptions.revalidateSeconds = 0;
+    cacheOptions.maxInMemoryFileBytes = 0;  // everything through sendfile
+    StaticFileHandler files(root_, cacheOptions);
+    server.setHttpCallback(
+            [&](const HttpRequest& req, HttpResponse* resp) { files.handle(req, resp); });
+    server.start();
+    HttpClient client(&loop, "StaticFileRevalidateClient");
+
+    HttpClient::Request head = get("/small.txt");
+    head.method = HttpRequest::kHead;
+    HttpClient::Request post = get("/small.txt");
+    post.method = HttpRequest::kPost;
+    std::vector<Reply> replies =
+            fetch(&loop, &client, serverAddr,
+                  {get("/small.txt"), head, post, get("/docs"), get("/../etc/passwd"),
+                   get("/docs/%2e%2e/small.txt"), get("/%73mall.txt"), get("/bad%zz")});
+    EXPECT_EQ(replies[0].status, 200);
+    EXPECT_EQ(replies[0].body, small_);
+    EXPECT_EQ(replies[1].status, 200);
+    EXPECT_TRUE(replies[1].body.empty());
+    EXPECT_EQ(replies[2].status, 405);
+    EXPECT_EQ(replies[3].status, 301);
+    EXPECT_EQ(replies[3].location, "/docs/");
+    EXPECT_EQ(replies[4].status, 400);
+    EXPECT_EQ(replies[5].status, 400);
+    EXPECT_EQ(replies[6].status, 200);
+    EXPECT_EQ(replies[6].body, small_);
+    EXPECT_EQ(replies[7].status, 400);
+    EXPECT_EQ(files.cache()->memoryBytes(), 0u);
+
+    // replaced on disk: the next lookup's stat notices it
+    writeFile(root_ + "/small.txt", "changed contents, longer than before\n");
+    replies = fetch(&loop, &client, serverAddr, {get("/small.txt")});
+    EXPECT_EQ(replies[0].body, "changed contents, longer than before\n");
+}
+
+TEST(StaticFileHandlerTest, ContentTypesAndHttpDates) {
+    EXPECT_STREQ(StaticFileHandler::contentType(StringPiece("/a/b.HTML")),
+                 "text/html; charset=utf-8");
+    EXPECT_STREQ(StaticFileHandler::contentType(StringPiece("/x.png")), "image/png");
+    EXPECT_STREQ(StaticFileHandler::contentType(StringPiece("/v1.2/README")),
+                 "application/octet-stream");
+    EXPECT_EQ(FileCache::formatHttpDate(784111777), "Sun, 06 Nov 1994 08:49:37 GMT");
+    EXPECT_EQ(FileCache::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT"), 784111777);
+    EXPECT_EQ(FileCache::parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT"), -1);
+}
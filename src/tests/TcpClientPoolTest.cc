@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpClientPool.h"
+#include "TcpServer.h"
+
+using dws::StringPiece;
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpClientPool;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+// Runs the loop until @c done or five seconds have passed.
+bool runUntil(EventLoop* loop, const std::function<bool()>& done) {
+    dws::net::TimerId check = loop->runEvery(0.005, [loop, &done] {
+        if (done()) {
+            loop->quit();
+        }
+    });
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(check);
+    loop->cancel(timeout);
+    return done();
+}
+
+}  // namespace
+
+TEST(TcpClientPoolTest, PicksLeastInFlightAndGrows) {
+    EventLoop loop;
+    InetAddress serverAddr(29296, true);
+    TcpServer server(&loop, serverAddr, "PoolSink");
+    server.setMessageCallback(
+            [](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+
+    TcpClientPool::Options options;
+    options.minConnections = 2;
+    options.maxConnections = 3;
+    options.numThreads = 2;
+    options.growInFlightBytes = 100;
+    TcpClientPool pool(&loop, serverAddr, "Pool", options);
+    pool.start();
+    ASSERT_TRUE(runUntil(&loop, [&] { return pool.numConnected() == 2; }));
+    EXPECT_EQ(pool.numSlots(), 2);
+
+    const std::string message(60, 'm');
+    TcpConnectionPtr a = pool.send(StringPiece(message));
+    TcpConnectionPtr b = pool.send(StringPiece(message));
+    ASSERT_TRUE(a && b);
+    EXPECT_NE(a, b);
+    EXPECT_NE(a->getLoop(), b->getLoop());  // one per IO loop
+    EXPECT_EQ(pool.send(StringPiece(message)), a);  // a tie goes to the first
+    EXPECT_EQ(pool.inFlightBytes(), 180);
+    EXPECT_EQ(pool.numSlots(), 2);
+    // b has 60, still below the threshold
+    EXPECT_EQ(pool.send(StringPiece(message)), b);
+    // now everyone has 120: a third connection is warmed, the old ones serve
+    EXPECT_EQ(pool.send(StringPiece(message)), a);
+    EXPECT_EQ(pool.numSlots(), 3);
+    ASSERT_TRUE(runUntil(&loop, [&] { return pool.numConnected() == 3; }));
+    TcpConnectionPtr c = pool.send(StringPiece(message));
+    EXPECT_NE(c, a);
+    EXPECT_NE(c, b);
+
+    pool.complete(b, 120);
+    EXPECT_EQ(pool.pick(), b);
+    pool.complete(b, 1000);  // never below zero
+    EXPECT_EQ(pool.inFlightBytes(), 180 + 60);
+    EXPECT_EQ(pool.numSlots(), 3);  // at maxConnections
+}
+
+TEST(TcpClientPoolTest, ReplacesClosedConnections) {
+    EventLoop loop;
+    InetAddress serverAddr(29297, true);
+    std::set<TcpConnectionPtr> serverSide;  // outlives the server's callbacks
+    TcpServer server(&loop, serverAddr, "PoolEcho");
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            serverSide.insert(conn);
+        } else {
+            serverSide.erase(conn);
+        }
+    });
+    server.setMessageCallback(
+            [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+    server.start();
+
+    TcpClientPool::Options options;
+    options.minConnections = 3;
+    options.numThreads = 1;
+    TcpClientPool pool(&loop, serverAddr, "PoolReplace", options);
+    std::atomic<std::size_t> repliedBytes(0);
+    pool.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        pool.complete(conn, buf->readableBytes());
+        repliedBytes += buf->readableBytes();
+        buf->retrieveAll();
+    });
+    pool.start();
+    ASSERT_TRUE(runUntil(&loop, [&] { return pool.numConnected() == 3; }));
+
+    for (const TcpConnectionPtr& conn : std::vector<TcpConnectionPtr>(serverSide.begin(),
+                                                                      serverSide.end())) {
+        conn->forceClose();
+    }
+    ASSERT_TRUE(runUntil(&loop,
+                         [&] { return pool.numReplaced() == 3 && pool.numConnected() == 3; }));
+    EXPECT_EQ(pool.numSlots(), 3);
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_TRUE(pool.send(StringPiece("ping")));
+    }
+    ASSERT_TRUE(runUntil(&loop, [&] { return repliedBytes == 6 * 4; }));
+    EXPECT_EQ(pool.inFlightBytes(), 0);
+}
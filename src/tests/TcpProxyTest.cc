@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BackendPool.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpProxy.h"
+#include "TcpServer.h"
+
+using dws::net::BackendPool;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpProxy;
+using dws::net::TcpServer;
+
+namespace {
+
+// Answers only after the client's FIN: its name followed by everything it
+// got upper-cased, then shuts down.  Needs the half-close to be relayed.
+class ShoutServer {
+ public:
+    ShoutServer(EventLoop* loop, const InetAddress& addr, const std::string& name)
+        : server_(loop, addr, name) {
+        server_.setConnectionCallback([name](const TcpConnectionPtr& conn) {
+            if (!conn->connected()) {
+                return;
+            }
+            conn->setHalfCloseCallback([name](const TcpConnectionPtr& c) {
+                std::string reply = c->inputBuffer()->retrieveAllAsString();
+                for (char& ch : reply) {
+                    ch = static_cast<char>(::toupper(static_cast<unsigned char>(ch)));
+                }
+                c->send(dws::StringPiece(name + ":" + reply));
+                c->shutdown();
+            });
+        });
+        server_.setMessageCallback([](const TcpConnectionPtr&, Buffer*, dws::Timestamp) {});
+        server_.start();
+    }
+
+ private:
+    TcpServer server_;
+};
+
+// Sends payload, half-closes and reads the reply up to the proxy's FIN.
+std::string roundTrip(const InetAddress& proxyAddr, const std::string& payload) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, proxyAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+        ::close(fd);
+        return "connect failed";
+    }
+    std::string reply;
+    std::thread reader([&] {
+        char buf[65536];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+            reply.append(buf, static_cast<std::size_t>(n));
+        }
+    });
+    std::size_t written = 0;
+    while (written < payload.size()) {
+        ssize_t n = ::write(fd, payload.data() + written, payload.size() - written);
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    ::shutdown(fd, SHUT_WR);
+    reader.join();
+    ::close(fd);
+    return reply;
+}
+
+void relayRoundTrips(bool splice, uint16_t basePort) {
+    EventLoop loop;
+    InetAddress backendA(static_cast<uint16_t>(basePort + 1), true);
+    InetAddress backendB(static_cast<uint16_t>(basePort + 2), true);
+    ShoutServer serverA(&loop, backendA, "a");
+    ShoutServer serverB(&loop, backendB, "b");
+    BackendPool::Options options;
+    options.healthCheckIntervalSeconds = 0;
+    BackendPool pool(&loop, {backendA, backendB}, options);
+    pool.start();
+
+    InetAddress proxyAddr(basePort, true);
+    TcpProxy proxy(&loop, proxyAddr, "TcpProxyTest", &pool);
+    proxy.setThreadNum(1);
+    proxy.setSplice(splice);
+    proxy.start();
+
+    // large enough that reads stop while the other side is still writing
+    std::string payload;
+    for (int i = 0; payload.size() < 4 * 1024 * 1024; ++i) {
+        payload += "payload " + std::to_string(i) + '\n';
+    }
+    std::string upper = payload;
+    for (char& ch : upper) {
+        ch = static_cast<char>(::toupper(static_cast<unsigned char>(ch)));
+    }
+    std::vector<std::string> replies;
+    std::thread client([&] {
+        for (int i = 0; i < 4; ++i) {
+            replies.push_back(roundTrip(proxyAddr, i == 0 ? payload : "hi"));
+        }
+        loop.runAfter(0.2, [&] { loop.quit(); });
+    });
+    loop.runAfter(20.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    ASSERT_EQ(replies.size(), 4u);
+    EXPECT_TRUE(replies[0] == "a:" + upper) << "reply of " << replies[0].size() << " bytes";
+    // round robin alternates backends
+    EXPECT_EQ(replies[1], "b:HI");
+    EXPECT_EQ(replies[2], "a:HI");
+    EXPECT_EQ(replies[3], "b:HI");
+    EXPECT_EQ(proxy.numSessions(), 0u);
+    EXPECT_EQ(pool.activeConnections(0), 0);
+    EXPECT_EQ(pool.activeConnections(1), 0);
+    if (splice) {
+        EXPECT_EQ(proxy.splicedDirections(), 8u);
+    } else {
+        EXPECT_EQ(proxy.copiedDirections(), 8u);
+        EXPECT_EQ(proxy.splicedDirections(), 0u);
+    }
+}
+
+}  // namespace
+
+TEST(TcpProxyTest, SplicesBothWaysAndRelaysHalfClose) { relayRoundTrips(true, 29282); }
+
+TEST(TcpProxyTest, CopiesThroughBuffersWithoutSplice) { relayRoundTrips(false, 29285); }
+
+TEST(TcpProxyTest, FailsOverAndEjectsDeadBackend) {
+    EventLoop loop;
+    InetAddress dead(29289, true);  // nothing listens here
+    InetAddress live(29290, true);
+    ShoutServer server(&loop, live, "live");
+    BackendPool::Options options;
+    options.healthCheckIntervalSeconds = 0.05;
+    options.healthCheckTimeoutSeconds = 0.5;
+    BackendPool pool(&loop, {dead, live}, options);
+    pool.start();
+
+    InetAddress proxyAddr(29288, true);
+    TcpProxy proxy(&loop, proxyAddr, "TcpProxyFailover", &pool);
+    proxy.start();
+
+    std::vector<std::string> replies;
+    std::thread client([&] {
+        // the first connect is refused by the dead backend and retried
+        replies.push_back(roundTrip(proxyAddr, "one"));
+        ::usleep(300 * 1000);
+        replies.push_back(roundTrip(proxyAddr, "two"));
+        loop.runAfter(0.1, [&] { loop.quit(); });
+    });
+    loop.runAfter(10.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    ASSERT_EQ(replies.size(), 2u);
+    EXPECT_EQ(replies[0], "live:ONE");
+    EXPECT_EQ(replies[1], "live:TWO");
+    EXPECT_FALSE(pool.healthy(0));
+    EXPECT_TRUE(pool.healthy(1));
+    EXPECT_EQ(proxy.numSessions(), 0u);
+}
@@ -1 +1,387 @@
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "TcpServer.h"
+
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpServer;
+
+namespace {
+
+int connectTo(const InetAddress& addr) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}  // namespace
+
+TEST(TcpServerTest, StopDrainsAndForceClosesStragglers) {
+    EventLoop loop;
+    InetAddress listenAddr(29271, true);
+    TcpServer server(&loop, listenAddr, "DrainTest");
+    server.setThreadNum(2);
+
+    std::size_t lastRemaining = SIZE_MAX;
+    std::size_t forced = 0;
+    int calls = 0;
+    std::atomic<int> established(0);
+    server.setConnectionCallback([&](const dws::net::TcpConnectionPtr& conn) {
+        if (conn->connected() && ++established == 2) {
+            server.stop(0.3, [&](std::size_t remaining, std::size_t forcedClosed) {
+                ++calls;
+                lastRemaining = remaining;
+                forced = forcedClosed;
+                if (remaining == 0) {
+                    loop.quit();
+                }
+            });
+        }
+    });
+    server.start();
+
+    int polite = -1;
+    int stubborn = -1;
+    std::thread client([&] {
+        polite = connectTo(listenAddr);
+        stubborn = connectTo(listenAddr);
+        ASSERT_GE(polite, 0);
+        ASSERT_GE(stubborn, 0);
+        char buf[16];
+        // The polite client closes as soon as it sees the server's FIN.
+        while (::read(polite, buf, sizeof buf) > 0) {
+        }
+        ::close(polite);
+    });
+
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+    ::close(stubborn);
+
+    EXPECT_EQ(lastRemaining, 0u);
+    EXPECT_EQ(forced, 1u);
+    EXPECT_GE(calls, 2);
+    EXPECT_LT(connectTo(listenAddr), 0);
+}
+
+TEST(TcpServerTest, StopWaitsForPendingResponses) {
+    EventLoop loop;
+    InetAddress listenAddr(29320, true);
+    TcpServer server(&loop, listenAddr, "PendingTest");
+    server.setThreadNum(1);
+    std::vector<std::thread> workers;
+    std::size_t forced = SIZE_MAX;
+    server.setMessageCallback(
+            [&](const dws::net::TcpConnectionPtr& conn, dws::net::Buffer* buf, dws::Timestamp) {
+                buf->retrieveAll();
+                conn->beginResponse();
+                // the server stops while a worker still works on the reply
+                loop.runInLoop([&] {
+                    server.stop(5.0, [&](std::size_t remaining, std::size_t forcedClosed) {
+                        forced = forcedClosed;
+                        if (remaining == 0) {
+                            loop.quit();
+                        }
+                    });
+                });
+                workers.emplace_back([conn] {
+                    ::usleep(200 * 1000);
+                    conn->send(dws::StringPiece("pong"));
+                    conn->endResponse();
+                });
+            });
+    server.start();
+
+    std::string reply;
+    std::thread client([&] {
+        int fd = connectTo(listenAddr);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(::write(fd, "ping", 4), 4);
+        char buf[16];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+            reply.append(buf, n);
+        }
+        ::close(fd);
+    });
+
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    EXPECT_EQ(reply, "pong");
+    EXPECT_EQ(forced, 0u);
+}
+
+TEST(TcpServerTest, StatsCountTraffic) {
+    EventLoop loop;
+    InetAddress listenAddr(29272, true);
+    TcpServer server(&loop, listenAddr, "StatsTest");
+    server.setThreadNum(1);
+    server.setMessageCallback(
+            [](const dws::net::TcpConnectionPtr& conn, dws::net::Buffer* buf, dws::Timestamp) {
+                conn->send(buf);
+            });
+    TcpServer::StatsSnapshot total;
+    std::size_t busiest = 0;
+    server.setConnectionCallback([&](const dws::net::TcpConnectionPtr& conn) {
+        if (conn->disconnected()) {
+            loop.queueInLoop([&] {
+                total = server.stats();
+                busiest = server.busiestConnections(10).size();
+                loop.quit();
+            });
+        }
+    });
+    server.start();
+
+    std::thread client([&] {
+        int fd = connectTo(listenAddr);
+        ASSERT_GE(fd, 0);
+        char buf[100] = {0};
+        ASSERT_EQ(::write(fd, buf, sizeof buf), 100);
+        std::size_t received = 0;
+        while (received < sizeof buf) {
+            ssize_t n = ::read(fd, buf, sizeof buf);
+            ASSERT_GT(n, 0);
+            received += n;
+        }
+        ::close(fd);
+    });
+
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    EXPECT_EQ(total.bytesReceived, 100u);
+    EXPECT_EQ(total.bytesSent, 100u);
+    EXPECT_GE(total.messagesReceived, 1u);
+    EXPECT_GE(total.readCalls, 2u);
+    EXPECT_LE(busiest, 1u);
+}
+
+TEST(TcpServerTest, CoalescesSendsOfOneIteration) {
+    EventLoop loop;
+    InetAddress listenAddr(29321, true);
+    TcpServer server(&loop, listenAddr, "CoalesceTest");
+    server.setThreadNum(1);
+    // write calls for each request, read on the next one and at the close
+    std::vector<uint64_t> writes;
+    uint64_t last = 0;
+    server.setConnectionCallback([&](const dws::net::TcpConnectionPtr& conn) {
+        if (conn->disconnected()) {
+            writes.push_back(conn->stats().snapshot().writeCalls - last);
+            loop.quit();
+        }
+    });
+    server.setMessageCallback(
+            [&](const dws::net::TcpConnectionPtr& conn, dws::net::Buffer* buf, dws::Timestamp) {
+                uint64_t now = conn->stats().snapshot().writeCalls;
+                if (last > 0 || now > 0) {
+                    writes.push_back(now - last);
+                }
+                last = now;
+                std::string request = buf->retrieveAllAsString();
+                if (request == "bytes") {
+                    conn->setWriteCoalescing(true, 8);  // flushes after 8 bytes
+                } else {
+                    conn->setWriteCoalescing(true, 1024, 0);  // no delay allowed
+                }
+                for (int i = 0; i < 10; ++i) {
+                    conn->send(dws::StringPiece("x"));
+                }
+            });
+    server.start();
+
+    std::thread client([&] {
+        int fd = connectTo(listenAddr);
+        ASSERT_GE(fd, 0);
+        for (const char* request : {"bytes", "delay"}) {
+            ASSERT_EQ(::write(fd, request, 5), 5);
+            char buf[16];
+            std::size_t received = 0;
+            while (received < 10) {
+                ssize_t n = ::read(fd, buf, sizeof buf);
+                ASSERT_GT(n, 0);
+                received += n;
+            }
+            ASSERT_EQ(received, 10u);
+        }
+        ::close(fd);
+    });
+
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    // 8 bytes right away and 2 at the end of the iteration
+    ASSERT_EQ(writes.size(), 2u);
+    EXPECT_EQ(writes[0], 2u);
+    // every second send finds the first one waiting too long
+    EXPECT_EQ(writes[1], 5u);
+}
+
+TEST(TcpServerTest, MigrateConnectionToAnotherLoop) {
+    EventLoop loop;
+    InetAddress listenAddr(29273, true);
+    TcpServer server(&loop, listenAddr, "MigrateTest");
+    server.setThreadNum(2);
+    std::vector<EventLoop*> loops;
+    std::atomic<bool> migrated(false);
+    std::atomic<bool> echoedOnTarget(false);
+    EventLoop* target = nullptr;
+    server.setConnectionCallback([&](const dws::net::TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            target = conn->getLoop() == loops[0] ? loops[1] : loops[0];
+            conn->setContext(std::string("kept"));
+            conn->migrate(target, [&](const dws::net::TcpConnectionPtr& c) {
+                migrated = c->getLoop() == target && target->isInLoopThread() &&
+                           std::any_cast<std::string>(c->getContext()) == "kept";
+            });
+        } else {
+            loop.quit();
+        }
+    });
+    server.setMessageCallback(
+            [&](const dws::net::TcpConnectionPtr& conn, dws::net::Buffer* buf, dws::Timestamp) {
+                echoedOnTarget = conn->getLoop() == target && target->isInLoopThread();
+                conn->send(buf);
+            });
+    server.start();
+    loops = server.threadPool()->getAllLoops();
+
+    std::thread client([&] {
+        int fd = connectTo(listenAddr);
+        ASSERT_GE(fd, 0);
+        for (int i = 0; i < 100 && !migrated; ++i) {
+            ::usleep(10 * 1000);
+        }
+        char buf[4] = {'p', 'i', 'n', 'g'};
+        ASSERT_EQ(::write(fd, buf, sizeof buf), 4);
+        std::size_t received = 0;
+        while (received < sizeof buf) {
+            ssize_t n = ::read(fd, buf + received, sizeof buf - received);
+            ASSERT_GT(n, 0);
+            received += n;
+        }
+        ::close(fd);
+    });
+
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    EXPECT_TRUE(migrated);
+    EXPECT_TRUE(echoedOnTarget);
+}
+
+TEST(TcpServerTest, RebalancingMovesLoadToTheIdleLoop) {
+    EventLoop loop;
+    InetAddress listenAddr(29322, true);
+    TcpServer server(&loop, listenAddr, "RebalanceTest");
+    server.setThreadNum(2);
+    std::vector<EventLoop*> loops;
+    std::atomic<bool> moved(false);
+    server.setConnectionCallback([&](const dws::net::TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            // everything on the first loop is expensive, wherever it goes
+            conn->setContext(conn->getLoop() == loops[0]);
+        }
+    });
+    server.setMessageCallback(
+            [&](const dws::net::TcpConnectionPtr& conn, dws::net::Buffer* buf, dws::Timestamp) {
+                if (std::any_cast<bool>(conn->getContext())) {
+                    if (conn->getLoop() == loops[1]) {
+                        moved = true;
+                    }
+                    dws::Timestamp start = dws::Timestamp::now();
+                    while (dws::timeDifference(dws::Timestamp::now(), start) < 0.001) {
+                    }
+                }
+                conn->send(buf);
+            });
+    server.start();
+    loops = server.threadPool()->getAllLoops();
+    EXPECT_EQ(server.loopIndexOf(loops[1]), 1u);
+    EXPECT_EQ(server.loopIndexOf(&loop), 2u);
+    server.enableRebalancing(0.1, 0.2);
+
+    std::thread client([&] {
+        // connections alternate between the loops, three land on each
+        std::vector<int> fds;
+        for (int i = 0; i < 6; ++i) {
+            fds.push_back(connectTo(listenAddr));
+            ASSERT_GE(fds.back(), 0);
+        }
+        for (int round = 0; round < 3000 && !moved; ++round) {
+            for (int fd : fds) {
+                char c = 'x';
+                ASSERT_EQ(::write(fd, &c, 1), 1);
+                ASSERT_EQ(::read(fd, &c, 1), 1);
+            }
+        }
+        for (int fd : fds) {
+            ::close(fd);
+        }
+        loop.queueInLoop([&] { loop.quit(); });
+    });
+
+    loop.runAfter(10.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    EXPECT_TRUE(moved);
+}
+
+TEST(TcpServerTest, DestroyingServerStopsRebalancing) {
+    EventLoop loop;
+    auto server = std::make_unique<TcpServer>(&loop, InetAddress(29325, true), "RebalanceGone");
+    server->setThreadNum(2);
+    server->start();
+    server->enableRebalancing(0.05, 0.2);
+    // the rebalancing timer must not outlive the server
+    loop.runAfter(0.02, [&] { server.reset(); });
+    loop.runAfter(0.3, [&] { loop.quit(); });
+    loop.loop();
+    EXPECT_EQ(server, nullptr);
+}
+
+TEST(TcpServerTest, DestroyingServerWhileDraining) {
+    EventLoop loop;
+    InetAddress listenAddr(29326, true);
+    auto server = std::make_unique<TcpServer>(&loop, listenAddr, "DrainGone");
+    server->setConnectionCallback([&](const dws::net::TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            server->stop(0.1);
+            // gone before the drain deadline fires
+            loop.runAfter(0.02, [&] { server.reset(); });
+        }
+    });
+    server->start();
+    int stubborn = connectTo(listenAddr);
+    ASSERT_GE(stubborn, 0);
+
+    loop.runAfter(0.3, [&] { loop.quit(); });
+    loop.loop();
+    ::close(stubborn);
+    EXPECT_EQ(server, nullptr);
+}
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "CurrentThread.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "UdpServer.h"
+#include "UdpSocket.h"
+
+using dws::Timestamp;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::UdpServer;
+using dws::net::UdpSocket;
+using dws::net::UdpSocketPtr;
+
+namespace {
+
+void echo(const UdpSocketPtr& socket, const char* data, std::size_t len, const InetAddress& peer,
+          Timestamp) {
+    socket->send(peer, data, len);
+}
+
+// Runs the loop until @c done or five seconds have passed.
+void runUntil(EventLoop* loop, const std::function<bool()>& done) {
+    dws::net::TimerId check = loop->runEvery(0.01, [loop, &done] {
+        if (done()) {
+            loop->quit();
+        }
+    });
+    dws::net::TimerId timeout = loop->runAfter(5.0, [loop] { loop->quit(); });
+    loop->loop();
+    loop->cancel(check);
+    loop->cancel(timeout);
+}
+
+}  // namespace
+
+TEST(UdpTest, EchoesInBatches) {
+    EventLoop loop;
+    InetAddress serverAddr(29293, true);
+    UdpServer server(&loop, serverAddr, "UdpEcho");
+    server.setMessageCallback(echo);
+    server.start();
+
+    auto client = std::make_shared<UdpSocket>(&loop, InetAddress(0, true));
+    std::vector<std::string> replies;
+    client->setMessageCallback(
+            [&](const UdpSocketPtr&, const char* data, std::size_t len, const InetAddress& peer,
+                Timestamp) {
+                EXPECT_EQ(peer.toIpPort(), serverAddr.toIpPort());
+                replies.emplace_back(data, len);
+            });
+    client->start();
+    const int kCount = 100;
+    for (int i = 0; i < kCount; ++i) {
+        std::string message = "datagram " + std::to_string(i);
+        EXPECT_TRUE(client->send(serverAddr, message.data(), message.size()));
+    }
+    runUntil(&loop, [&] { return replies.size() == kCount; });
+
+    ASSERT_EQ(replies.size(), static_cast<std::size_t>(kCount));
+    std::set<std::string> unique(replies.begin(), replies.end());
+    EXPECT_EQ(unique.size(), static_cast<std::size_t>(kCount));
+    EXPECT_EQ(unique.count("datagram 42"), 1u);
+    UdpSocket::Stats clientStats = client->stats();
+    EXPECT_EQ(clientStats.packetsSent, static_cast<uint64_t>(kCount));
+    EXPECT_LE(clientStats.sendCalls, 2u);  // batches of 64
+    UdpSocket::Stats serverStats = server.stats();
+    EXPECT_EQ(serverStats.packetsReceived, static_cast<uint64_t>(kCount));
+    EXPECT_EQ(serverStats.packetsSent, static_cast<uint64_t>(kCount));
+    EXPECT_LT(serverStats.receiveCalls, serverStats.packetsReceived);
+    EXPECT_LT(serverStats.sendCalls, serverStats.packetsSent);
+    EXPECT_EQ(serverStats.dropped, 0u);
+}
+
+TEST(UdpTest, SegmentsWithGsoAndGro) {
+    EventLoop loop;
+    UdpSocket::Options serverOptions;
+    serverOptions.gro = true;
+    serverOptions.batchSize = 4;
+    auto server = std::make_shared<UdpSocket>(&loop, InetAddress(29294, true), serverOptions);
+    std::vector<std::string> received;
+    server->setMessageCallback([&](const UdpSocketPtr&, const char* data, std::size_t len,
+                                   const InetAddress&, Timestamp) {
+        received.emplace_back(data, len);
+    });
+    server->start();
+
+    UdpSocket::Options clientOptions;
+    clientOptions.gso = true;
+    auto client = std::make_shared<UdpSocket>(&loop, InetAddress(0, true), clientOptions);
+    client->start();
+    InetAddress serverAddr(29294, true);
+    std::string expected;
+    for (int i = 0; i < 20; ++i) {
+        std::string message(100, static_cast<char>('a' + i));
+        client->send(serverAddr, message.data(), message.size());
+        expected += message;
+    }
+    // another size starts a new run
+    client->send(serverAddr, "tail", 4);
+    expected += "tail";
+    runUntil(&loop, [&] { return received.size() == 21; });
+
+    ASSERT_EQ(received.size(), 21u);
+    std::string all;
+    for (std::size_t i = 0; i < 20; ++i) {
+        EXPECT_EQ(received[i].size(), 100u);
+        all += received[i];
+    }
+    all += received[20];
+    EXPECT_EQ(all, expected);
+    UdpSocket::Stats clientStats = client->stats();
+    EXPECT_EQ(clientStats.packetsSent, 21u);
+    EXPECT_EQ(clientStats.sendCalls, 1u);
+    UdpSocket::Stats serverStats = server->stats();
+    EXPECT_EQ(serverStats.packetsReceived, 21u);
+    if (client->gsoEnabled() && server->groEnabled()) {
+        // the 20 equal datagrams came as one buffer
+        EXPECT_EQ(serverStats.receiveCalls, 1u);
+    }
+}
+
+TEST(UdpTest, ShardsAcrossLoopsWithReusePort) {
+    EventLoop loop;
+    InetAddress serverAddr(29295, true);
+    UdpServer server(&loop, serverAddr, "UdpShards");
+    server.setThreadNum(2);
+    // the reply carries the id of the thread that served it
+    server.setMessageCallback([](const UdpSocketPtr& socket, const char*, std::size_t,
+                                 const InetAddress& peer, Timestamp) {
+        int tid = dws::CurrentThread::tid();
+        socket->send(peer, &tid, sizeof tid);
+    });
+    server.start();
+    ASSERT_EQ(server.sockets().size(), 2u);
+    EXPECT_NE(server.sockets()[0]->getLoop(), server.sockets()[1]->getLoop());
+
+    const int kClients = 16;
+    std::vector<UdpSocketPtr> clients;
+    std::set<int> servingThreads;
+    int replies = 0;
+    for (int i = 0; i < kClients; ++i) {
+        auto client = std::make_shared<UdpSocket>(&loop, InetAddress(0, true));
+        client->setMessageCallback([&](const UdpSocketPtr&, const char* data, std::size_t len,
+                                       const InetAddress&, Timestamp) {
+            ASSERT_EQ(len, sizeof(int));
+            int tid = 0;
+            memcpy(&tid, data, sizeof tid);
+            servingThreads.insert(tid);
+            ++replies;
+        });
+        client->start();
+        for (int j = 0; j < 4; ++j) {
+            client->send(serverAddr, "ping", 4);
+        }
+        clients.push_back(client);
+    }
+    runUntil(&loop, [&] { return replies == kClients * 4; });
+
+    EXPECT_EQ(replies, kClients * 4);
+    EXPECT_GE(servingThreads.size(), 1u);
+    EXPECT_LE(servingThreads.size(), 2u);
+    EXPECT_EQ(servingThreads.count(dws::CurrentThread::tid()), 0u);
+    EXPECT_EQ(server.stats().packetsReceived, static_cast<uint64_t>(kClients * 4));
+    // each socket saw whole clients only: the kernel hashes by peer
+    uint64_t perSocket = server.sockets()[0]->stats().packetsReceived;
+    EXPECT_EQ(perSocket % 4, 0u);
+}
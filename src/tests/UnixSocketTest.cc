@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+using dws::Timestamp;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpClient;
+using dws::net::TcpConnectionPtr;
+using dws::net::TcpServer;
+
+namespace {
+
+struct EchoResult {
+    std::string reply;
+    std::string serverPeer;
+    std::string clientPeer;
+    struct ucred credentials {};
+    bool gotCredentials = false;
+};
+
+// Starts the client first when @c clientFirst, so that its Connector has to
+// retry until the server is listening.
+EchoResult echoOver(const InetAddress& addr, bool clientFirst) {
+    EventLoop loop;
+    EchoResult result;
+    std::unique_ptr<TcpServer> server;
+    auto startServer = [&] {
+        server = std::make_unique<TcpServer>(&loop, addr, "UnixEcho");
+        server->setConnectionCallback([&](const TcpConnectionPtr& conn) {
+            if (conn->connected()) {
+                result.serverPeer = conn->peerAddress().toIpPort();
+                result.gotCredentials = conn->getPeerCredentials(&result.credentials);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf);
+        });
+        server->start();
+    };
+    if (!clientFirst) {
+        startServer();
+    }
+    TcpClient client(&loop, addr, "UnixEchoClient");
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            result.clientPeer = conn->peerAddress().toIpPort();
+            conn->send(dws::StringPiece("hello over AF_UNIX"));
+        } else {
+            loop.quit();
+        }
+    });
+    client.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        result.reply += buf->retrieveAllAsString();
+        if (result.reply.size() >= 18) {
+            conn->shutdown();  // the server closes in turn
+        }
+    });
+    client.connect();
+    if (clientFirst) {
+        loop.runAfter(0.1, startServer);
+    }
+    loop.runAfter(5.0, [&loop] { loop.quit(); });
+    loop.loop();
+    return result;
+}
+
+}  // namespace
+
+TEST(UnixSocketTest, AddressFormsAndLengths) {
+    InetAddress path = InetAddress::fromUnixPath("/run/dws.sock");
+    EXPECT_TRUE(path.isUnix());
+    EXPECT_EQ(path.family(), AF_UNIX);
+    EXPECT_EQ(path.toIp(), "/run/dws.sock");
+    EXPECT_EQ(path.toIpPort(), "unix:/run/dws.sock");
+    EXPECT_EQ(path.port(), 0);
+    EXPECT_EQ(path.length(), sizeof(sa_family_t) + sizeof("/run/dws.sock"));
+
+    InetAddress abstract = InetAddress::fromUnixPath("@dws-test");
+    EXPECT_EQ(abstract.toIpPort(), "unix:@dws-test");
+    // the leading NUL and the name, no terminator
+    EXPECT_EQ(abstract.length(), sizeof(sa_family_t) + 1 + 8);
+
+    InetAddress inet(8080, true);
+    EXPECT_FALSE(inet.isUnix());
+    EXPECT_EQ(inet.length(), sizeof(struct sockaddr_in));
+    EXPECT_EQ(InetAddress(8080, true, true).length(), sizeof(struct sockaddr_in6));
+}
+
+TEST(UnixSocketTest, EchoesOverPathWithPeerCredentials) {
+    char dir[] = "/tmp/dws_unix_XXXXXX";
+    ASSERT_NE(::mkdtemp(dir), nullptr);
+    const std::string path = std::string(dir) + "/echo.sock";
+    InetAddress addr = InetAddress::fromUnixPath(path);
+
+    // a socket file left behind by an earlier run is replaced
+    int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(::bind(stale, addr.getSockAddr(), addr.length()), 0);
+    ::close(stale);
+
+    EchoResult result = echoOver(addr, false);
+    EXPECT_EQ(result.reply, "hello over AF_UNIX");
+    EXPECT_EQ(result.clientPeer, "unix:" + path);
+    EXPECT_EQ(result.serverPeer, "unix:");  // the client is unnamed
+    ASSERT_TRUE(result.gotCredentials);
+    EXPECT_EQ(result.credentials.pid, ::getpid());
+    EXPECT_EQ(result.credentials.uid, ::getuid());
+    EXPECT_EQ(result.credentials.gid, ::getgid());
+
+    // the server removed its socket file
+    struct stat st;
+    EXPECT_NE(::stat(path.c_str(), &st), 0);
+    ::rmdir(dir);
+}
+
+TEST(UnixSocketTest, LeavesLiveListenersSocketFileInPlace) {
+    char dir[] = "/tmp/dws_unix_XXXXXX";
+    ASSERT_NE(::mkdtemp(dir), nullptr);
+    const std::string path = std::string(dir) + "/live.sock";
+    InetAddress addr = InetAddress::fromUnixPath(path);
+
+    int live = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(::bind(live, addr.getSockAddr(), addr.length()), 0);
+    ASSERT_EQ(::listen(live, 1), 0);
+
+    // a second server must fail to bind instead of stealing the path
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_DEATH(
+        {
+            EventLoop loop;
+            TcpServer server(&loop, addr, "UnixLiveTest");
+            server.start();
+        },
+        "");  // the FATAL log goes to stdout, which death tests do not capture
+
+    struct stat st;
+    EXPECT_EQ(::stat(path.c_str(), &st), 0);
+    int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    EXPECT_EQ(::connect(client, addr.getSockAddr(), addr.length()), 0);
+    ::close(client);
+    ::close(live);
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+}
+
+TEST(UnixSocketTest, ConnectorRetriesUntilAbstractSocketExists) {
+    InetAddress addr =
+            InetAddress::fromUnixPath("@dws-unix-test-" + std::to_string(::getpid()));
+    EchoResult result = echoOver(addr, true);
+    EXPECT_EQ(result.reply, "hello over AF_UNIX");
+    EXPECT_EQ(result.clientPeer, addr.toIpPort());
+    EXPECT_TRUE(result.gotCredentials);
+}
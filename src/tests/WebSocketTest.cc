@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "WebSocketCodec.h"
+#include "WebSocketServer.h"
+
+using dws::StringPiece;
+using dws::net::Buffer;
+using dws::net::EventLoop;
+using dws::net::InetAddress;
+using dws::net::TcpConnectionPtr;
+using dws::net::WebSocketServer;
+namespace websocket = dws::net::websocket;
+
+namespace {
+
+// A masked client frame.
+std::string clientFrame(websocket::Opcode opcode, const std::string& payload, bool fin = true) {
+    const char key[4] = {0x11, 0x22, 0x33, 0x44};
+    std::string frame(1, static_cast<char>((fin ? 0x80 : 0) | opcode));
+    if (payload.size() < 126) {
+        frame.push_back(static_cast<char>(0x80 | payload.size()));
+    } else {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size()));
+    }
+    frame.append(key, 4);
+    for (std::size_t i = 0; i < payload.size(); ++i) {
+        frame.push_back(static_cast<char>(payload[i] ^ key[i % 4]));
+    }
+    return frame;
+}
+
+// A masked client frame header claiming @c length bytes, without them.
+std::string lengthFrame(websocket::Opcode opcode, uint64_t length, bool fin = true) {
+    std::string frame(1, static_cast<char>((fin ? 0x80 : 0) | opcode));
+    frame.push_back(static_cast<char>(0x80 | 127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        frame.push_back(static_cast<char>(length >> shift));
+    }
+    frame.append("\x11\x22\x33\x44", 4);
+    return frame;
+}
+
+std::string readExactly(int fd, std::size_t n) {
+    std::string result;
+    char buf[4096];
+    while (result.size() < n) {
+        ssize_t r = ::read(fd, buf, std::min(sizeof buf, n - result.size()));
+        if (r <= 0) {
+            break;
+        }
+        result.append(buf, r);
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(WebSocketCodecTest, AcceptKey) {
+    // the example of RFC 6455 section 1.3
+    EXPECT_EQ(websocket::acceptKey(StringPiece("dGhlIHNhbXBsZSBub25jZQ==")),
+              "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(WebSocketCodecTest, UnmaskMatchesScalar) {
+    const char key[4] = {'\x5a', '\xa5', '\x0f', '\xf0'};
+    for (std::size_t offset = 0; offset < 4; ++offset) {
+        for (std::size_t len : {0, 1, 7, 8, 15, 16, 31, 32, 33, 100, 1000}) {
+            std::vector<char> data(offset + len);
+            for (std::size_t i = 0; i < data.size(); ++i) {
+                data[i] = static_cast<char>(i * 31);
+            }
+            std::vector<char> expected = data;
+            for (std::size_t i = 0; i < len; ++i) {
+                expected[offset + i] = static_cast<char>(expected[offset + i] ^ key[i % 4]);
+            }
+            websocket::unmask(data.data() + offset, len, key);
+            EXPECT_EQ(data, expected) << "offset " << offset << " len " << len;
+        }
+    }
+}
+
+TEST(WebSocketCodecTest, FrameHeaderRoundTrip) {
+    for (std::size_t len : {0, 125, 126, 65535, 65536}) {
+        char header[websocket::kMaxHeaderBytes];
+        std::size_t n = websocket::encodeFrameHeader(header, websocket::kBinary, len);
+        websocket::FrameHeader parsed;
+        EXPECT_EQ(websocket::parseFrameHeader(header, n - 1, &parsed), websocket::kNeedMore);
+        ASSERT_EQ(websocket::parseFrameHeader(header, n, &parsed), websocket::kOk);
+        EXPECT_TRUE(parsed.fin);
+        EXPECT_FALSE(parsed.masked);
+        EXPECT_EQ(parsed.opcode, websocket::kBinary);
+        EXPECT_EQ(parsed.payloadLength, len);
+        EXPECT_EQ(parsed.headerBytes, n);
+    }
+    // fragmented ping
+    const char bad[2] = {websocket::kPing, 0};
+    websocket::FrameHeader parsed;
+    EXPECT_EQ(websocket::parseFrameHeader(bad, 2, &parsed), websocket::kBadFrame);
+    // 64 bit length with the most significant bit set
+    std::string huge = lengthFrame(websocket::kBinary, uint64_t(1) << 63);
+    EXPECT_EQ(websocket::parseFrameHeader(huge.data(), huge.size(), &parsed), websocket::kBadFrame);
+}
+
+TEST(WebSocketServerTest, HandshakeFragmentsPingAndBroadcast) {
+    EventLoop loop;
+    InetAddress listenAddr(29275, true);
+    WebSocketServer server(&loop, listenAddr, "WebSocketTest");
+    server.setThreadNum(2);
+    std::atomic<int> opened(0);
+    server.setOpenCallback([&](const TcpConnectionPtr&, const dws::net::HttpRequest& req) {
+        EXPECT_EQ(req.path(), StringPiece("/chat"));
+        if (++opened == 2) {
+            server.broadcast(StringPiece("to all"));
+        }
+    });
+    server.setMessageCallback(
+            [](const TcpConnectionPtr& conn, const StringPiece& message, websocket::Opcode op) {
+                WebSocketServer::send(conn, message, op);
+            });
+    server.start();
+
+    const std::string handshake =
+            "GET /chat HTTP/1.1\r\nHost: h\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    const std::string accepted =
+            "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+    const std::string broadcastFrame = websocket::encodeFrame(websocket::kText, StringPiece("to all"));
+
+    std::thread client([&] {
+        int fds[2];
+        for (int& fd : fds) {
+            fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            ASSERT_EQ(::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+            ASSERT_EQ(::write(fd, handshake.data(), handshake.size()),
+                      static_cast<ssize_t>(handshake.size()));
+            EXPECT_EQ(readExactly(fd, accepted.size()), accepted);
+        }
+        for (int fd : fds) {
+            EXPECT_EQ(readExactly(fd, broadcastFrame.size()), broadcastFrame);
+        }
+
+        std::string big(300, 'x');
+        std::string frames = clientFrame(websocket::kText, "hel", false) +
+                             clientFrame(websocket::kPing, "p") +
+                             clientFrame(websocket::kContinuation, "lo " + big) +
+                             clientFrame(websocket::kClose, "\x03\xe8");
+        ASSERT_EQ(::write(fds[0], frames.data(), frames.size()),
+                  static_cast<ssize_t>(frames.size()));
+        std::string expected = websocket::encodeFrame(websocket::kPong, StringPiece("p")) +
+                               websocket::encodeFrame(websocket::kText, StringPiece("hello " + big)) +
+                               websocket::encodeFrame(websocket::kClose, StringPiece("\x03\xe8"));
+        EXPECT_EQ(readExactly(fds[0], expected.size() + 1), expected);  // then EOF
+        for (int fd : fds) {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+    EXPECT_EQ(opened, 2);
+}
+
+TEST(WebSocketServerTest, RejectsContinuationLengthsWrappingTheLimit) {
+    EventLoop loop;
+    InetAddress listenAddr(29323, true);
+    WebSocketServer server(&loop, listenAddr, "WebSocketLimitTest");
+    server.setMaxMessageBytes(1024);
+    std::atomic<int> messages(0);
+    server.setMessageCallback(
+            [&](const TcpConnectionPtr&, const StringPiece&, websocket::Opcode) { ++messages; });
+    server.start();
+
+    const std::string handshake =
+            "GET / HTTP/1.1\r\nHost: h\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    std::thread client([&] {
+        // pending + length wraps to 2 and would pass a summed check
+        const uint64_t pending = 3;
+        struct Case {
+            uint64_t length;
+            uint16_t code;
+        } cases[] = {{0 - pending + 2, websocket::kProtocolError},
+                     {(uint64_t(1) << 63) - 1, websocket::kMessageTooBig}};
+        for (const Case& c : cases) {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            ASSERT_EQ(::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+            ASSERT_EQ(::write(fd, handshake.data(), handshake.size()),
+                      static_cast<ssize_t>(handshake.size()));
+            std::string response = readExactly(fd, 129);
+            ASSERT_EQ(response.substr(0, 12), "HTTP/1.1 101");
+            std::string frames = clientFrame(websocket::kText, "abc", false) +
+                                 lengthFrame(websocket::kContinuation, c.length) + "xx";
+            ASSERT_EQ(::write(fd, frames.data(), frames.size()),
+                      static_cast<ssize_t>(frames.size()));
+            const char code[2] = {static_cast<char>(c.code >> 8), static_cast<char>(c.code)};
+            std::string expected =
+                    websocket::encodeFrame(websocket::kClose, StringPiece(code, 2));
+            EXPECT_EQ(readExactly(fd, expected.size() + 1), expected);  // then EOF
+            ::close(fd);
+        }
+        loop.quit();
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+    EXPECT_EQ(messages, 0);
+}
+
+TEST(WebSocketServerTest, EchoesCloseStatusAndRejectsOneByteClose) {
+    EventLoop loop;
+    InetAddress listenAddr(29327, true);
+    WebSocketServer server(&loop, listenAddr, "WebSocketCloseTest");
+    server.start();
+
+    const std::string handshake =
+            "GET / HTTP/1.1\r\nHost: h\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    std::thread client([&] {
+        const char normal[2] = {static_cast<char>(1000 >> 8), static_cast<char>(1000 & 0xff)};
+        const char protocolError[2] = {static_cast<char>(websocket::kProtocolError >> 8),
+                                       static_cast<char>(websocket::kProtocolError & 0xff)};
+        struct Case {
+            std::string body;
+            std::string reply;
+        } cases[] = {{std::string(normal, 2) + "bye", std::string(normal, 2)},
+                     {"x", std::string(protocolError, 2)}};
+        for (const Case& c : cases) {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            ASSERT_EQ(::connect(fd, listenAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+            ASSERT_EQ(::write(fd, handshake.data(), handshake.size()),
+                      static_cast<ssize_t>(handshake.size()));
+            std::string response = readExactly(fd, 129);
+            ASSERT_EQ(response.substr(0, 12), "HTTP/1.1 101");
+            std::string frame = clientFrame(websocket::kClose, c.body);
+            ASSERT_EQ(::write(fd, frame.data(), frame.size()),
+                      static_cast<ssize_t>(frame.size()));
+            std::string expected = websocket::encodeFrame(websocket::kClose, StringPiece(c.reply));
+            EXPECT_EQ(readExactly(fd, expected.size() + 1), expected);  // then EOF
+            ::close(fd);
+        }
+        loop.quit();
+    });
+    loop.runAfter(5.0, [&] { loop.quit(); });
+    loop.loop();
+    client.join();
+}